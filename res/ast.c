@@ -1,5 +1,19 @@
 #include "ast.h"
 #include "scope.h"
+#include "context.h"
+#include "jit.h"
+#include "loopopt.h"
+#include "typeinfer.h"
+#include "heatmap.h"
+#include "generator.h"
+#include "task.h"
+#include "strlib.h"
+#include "snapshot.h"
+#include "module.h"
+#include "lazy.h"
+#include "inline.h"
+#include "bench.h"
+#include "trace.h"
 #include <stdbool.h>
 #include <string.h>
 #include <math.h>
@@ -19,51 +33,16 @@ Value create_int_value(int i) {
   return v;
 }
 
-char *process_escapes(const char *input) {
-  if (!input) return NULL;
-
-  char *output = malloc(strlen(input) + 1);
-  char *dest = output;
-
-  while (*input) {
-    if (*input == '\\') {
-      input++;
-      switch (*input) {
-        case 'n': *dest++ = '\n'; break;
-        case 't': *dest++ = '\t'; break;
-        case '\\': *dest++ = '\\'; break;
-        case '"': *dest++ = '"'; break;
-        default:  // Handle unknown escapes
-          fprintf(stderr, "Warning: Unknown escape \\%c\n", *input);
-          *dest++ = *input;
-      }
-    } else {
-      *dest++ = *input;
-    }
-    input++;
-  }
-  *dest = '\0';
-  return output;
+// Strip surrounding quotes and process escapes (see strval.h)
+Value create_str_value(const char *s) {
+  return create_string_value(string_unquote(s));
 }
 
-Value create_str_value(const char *s) {
+Value create_string_value(String *s) {
   Value v;
   v.type = TYPE_STRING;
-  // Validate that input is enclosed in quotes
-  if (s[0] != '"' || s[strlen(s)-1] != '"') {
-    v.data.str_val = process_escapes(s);
-    return v;
-
-  } else {
-    // Remove surrounding quotes and process escapes
-    char *temp = strdup(s + 1);          // Skip opening "
-    temp[strlen(temp)-1] = '\0';             // Remove trailing "
-
-    v.data.str_val = process_escapes(temp);  // Handle \n, \t, etc.
-    free(temp);
-
-    return v;
-  }
+  v.data.str_val = s;
+  return v;
 }
 
 Value create_bool_value(int i) {
@@ -73,6 +52,58 @@ Value create_bool_value(int i) {
   return v;
 }
 
+Value create_bigint_value(BigInt *b) {
+  int i;
+  if (bigint_to_int(b, &i)) {
+    bigint_release(b);
+    return create_int_value(i);
+  }
+  Value v;
+  v.type = TYPE_BIGINT;
+  v.data.big_val = b;
+  return v;
+}
+
+Value create_generator_value(Generator *g) {
+  Value v;
+  v.type = TYPE_GENERATOR;
+  v.data.gen_val = g;
+  return v;
+}
+
+Value create_channel_value(Channel *c) {
+  Value v;
+  v.type = TYPE_CHANNEL;
+  v.data.chan_val = c;
+  return v;
+}
+
+// Values are freed as soon as nothing refers to them, so only what
+// variables hold can grow the heap
+static void check_heap(BreezeContext *ctx) {
+  size_t in_use = heap_in_use(&ctx->heap);
+  if (ctx->max_heap && in_use > ctx->max_heap) {
+    if (ctx->function) {
+      breeze_limit_error(ctx, "Error: heap limit of %zu bytes exceeded in function '%s' (%zu bytes in use).\n",
+                         ctx->max_heap, ctx->function, in_use);
+    }
+    breeze_limit_error(ctx, "Error: heap limit of %zu bytes exceeded (%zu bytes in use).\n",
+                       ctx->max_heap, in_use);
+  }
+}
+
+void release_value(Value v) {
+  if (v.type == TYPE_STRING) {
+    string_release(v.data.str_val);
+  } else if (v.type == TYPE_BIGINT) {
+    bigint_release(v.data.big_val);
+  } else if (v.type == TYPE_GENERATOR) {
+    generator_release(v.data.gen_val);
+  } else if (v.type == TYPE_CHANNEL) {
+    channel_release(v.data.chan_val);
+  }
+}
+
 // Create a new AST node
 astnode_t *astnode_new(int type) {
   astnode_t *node = calloc(1, sizeof(astnode_t));
@@ -93,6 +124,18 @@ void astnode_add_child(astnode_t *parent, astnode_t *child, int index) {
   parent->child[index] = child;
 }
 
+// The statement list of first followed by that of rest (either may be NULL)
+astnode_t *stmts_join(astnode_t *first, astnode_t *rest) {
+  if (!first) return rest;
+  if (!rest) return first;
+  // Splice first in at the bottom of rest's left-recursive chain
+  astnode_t *bottom = rest;
+  while (bottom->child[1]) bottom = bottom->child[0];
+  bottom->child[1] = bottom->child[0];
+  bottom->child[0] = first;
+  return rest;
+}
+
 // Print the AST (for debugging)
 void print_ast(astnode_t *node, int depth) {
   if (!node) return;
@@ -103,6 +146,12 @@ void print_ast(astnode_t *node, int depth) {
   // Print node type and value
   switch (node->type) { 
     case NODE_INT:     printf("NUM: %d\n", node->data.num); break;
+    case NODE_BIGINT: {
+      char *digits = bigint_to_string(node->data.big);
+      printf("NUM: %s\n", digits);
+      free(digits);
+      break;
+    }
     case NODE_FLOAT:     printf("DEC: %f\n", node->data.dec); break;
     case NODE_ASSIGN:  printf("ASSIGN\n"); break;
     case NODE_ADD:     printf("ADD\n"); break;
@@ -156,6 +205,12 @@ void print_ast(astnode_t *node, int depth) {
       printf("Child node 2 (if-else's body):\n");
       print_ast(node->child[1], depth+1);
       break;
+    case NODE_YIELD:   printf("YIELD\n"); break;
+    case NODE_FOREACH: printf("FOR EACH %s in\n", node->data.id); break;
+    case NODE_SPAWN:   printf("SPAWN %s\n", node->data.id); break;
+    case NODE_SNAPSHOT: printf("SNAPSHOT\n"); break;
+    case NODE_IMPORT:  printf("IMPORT %s\n", node->data.id); break;
+    case NODE_BENCH:   printf("BENCHMARK\n"); break;
 
     //TODO: Add function nodes!
     default: printf("UNKNOWN NODE\n");
@@ -181,24 +236,101 @@ void free_ast(astnode_t *node) {
   if (node->type == NODE_ID && node->data.id) {
     free(node->data.id);
   }
+  loop_plan_free(node->plan);
+  if (node->literal) {
+    string_literal_free(node->literal);
+  }
+  if (node->type == NODE_BIGINT) {
+    bigint_literal_free(node->data.big);
+  }
+  lazy_free(node->lazy);
+  inline_free(node->inlined);
 
   free(node);
 }
 
 // ----------- EVALUATION FUNCTION -----------
 
-static Value evaluate_expr(astnode_t *node);
-void evaluate_while(astnode_t *node);
-void evaluate_for(astnode_t *node);
-void evaluate_if(astnode_t *node);
-void evaluate_ifelse(astnode_t *node);
-void evaluate_func(astnode_t *node);
-Value evaluate_funccall(astnode_t *node);
+static Value evaluate_expr(BreezeContext *ctx, astnode_t *node);
+void evaluate_while(BreezeContext *ctx, astnode_t *node);
+void evaluate_for(BreezeContext *ctx, astnode_t *node);
+void evaluate_if(BreezeContext *ctx, astnode_t *node);
+void evaluate_ifelse(BreezeContext *ctx, astnode_t *node);
+void evaluate_func(BreezeContext *ctx, astnode_t *node);
+void evaluate_foreach(BreezeContext *ctx, astnode_t *node);
+void evaluate_bench(BreezeContext *ctx, astnode_t *node);
+Value evaluate_funccall(BreezeContext *ctx, astnode_t *node);
+static Value call_function(BreezeContext *ctx, astnode_t *node, int spawn);
+
+// Store a value in a variable of the current scope, taking over its reference
+static void assign_value(BreezeContext *ctx, const char *name, Value value) {
+  switch(value.type) {
+    case TYPE_FLOAT:
+      put_symbol_float(ctx, name, value.data.float_val);
+      break;
+    case TYPE_INT:
+      put_symbol_int(ctx, name, value.data.int_val);
+      break;
+    case TYPE_STRING:
+      put_symbol_string(ctx, name, value.data.str_val);
+      string_release(value.data.str_val);
+      check_heap(ctx);
+      break;
+    case TYPE_BOOL:
+      put_symbol_bool(ctx, name, value.data.int_val);
+      break;        
+    case TYPE_BIGINT:
+      put_symbol_bigint(ctx, name, value.data.big_val);
+      bigint_release(value.data.big_val);
+      check_heap(ctx);
+      break;
+    case TYPE_GENERATOR:
+      put_symbol_generator(ctx, name, value.data.gen_val);
+      generator_release(value.data.gen_val);
+      break;
+    case TYPE_CHANNEL:
+      put_symbol_channel(ctx, name, value.data.chan_val);
+      channel_release(value.data.chan_val);
+      break;
+
+    default:
+      breeze_error(ctx, "Error: assignment's type cannot be recognized. Type is: '%d'.\n", value.type);
+  }
+}
+
+// Kept out of evaluate_ast: its line buffer would otherwise be on the
+// stack once per nested statement of every active call
+__attribute__((noinline))
+static void evaluate_read(BreezeContext *ctx, astnode_t *node) {
+  const char* varName = node->data.id;
+  if (ctx->out) {
+    fprintf(ctx->out, "What do you want this time? ...\n");
+    fflush(ctx->out);
+  }
+
+  char buffer[256];
+  if (!task_read_line(ctx, buffer, sizeof(buffer))) {
+      breeze_error(ctx, "Error reading input.\n");
+  }
+  // Remove trailing newline if present
+  char *newline = strchr(buffer, '\n');
+  if (newline) *newline = '\0';
+
+  // Always store it as string
+  String *line = string_new(buffer);
+  put_symbol_string(ctx, varName, line);
+  string_release(line);
+  check_heap(ctx);
+}
 
-void evaluate_ast(astnode_t *node) {
+void evaluate_ast(BreezeContext *ctx, astnode_t *node) {
   if (!node) {
-    fprintf(stderr, "Error: NULL pointer in evaluate_ast.\n");
-    exit(EXIT_FAILURE); 
+    breeze_error(ctx, "Error: NULL pointer in evaluate_ast.\n");
+  }
+  // Loops count their condition checks instead
+  if (node->type != NODE_STMTS && node->type != NODE_WHILE && node->type != NODE_FOR &&
+      node->type != NODE_BENCH) {
+    HEATMAP_HIT(ctx, node);
   }
 
   switch (node->type) {
@@ -206,112 +338,401 @@ void evaluate_ast(astnode_t *node) {
       // Evaluate all statements in sequence
       for (int i = 0; i < MAXCHILDREN; i++) {
         if (node->child[i]) {
-          evaluate_ast(node->child[i]);
+          evaluate_ast(ctx, node->child[i]);
         }
       }
       break;
 
     case NODE_ASSIGN:
-      Value value = evaluate_expr(node->child[0]);
-
-      switch(value.type) {
-        case TYPE_FLOAT:
-          put_symbol_float(node->data.id, value.data.float_val);
-          break;
-        case TYPE_INT:
-          put_symbol_int(node->data.id, value.data.int_val);
-          break;
-        case TYPE_STRING:
-          put_symbol_string(node->data.id, value.data.str_val);
-          break;
-        case TYPE_BOOL:
-          put_symbol_bool(node->data.id, value.data.int_val);
-          break;        
-
-        default:
-          fprintf(stderr, "Error: assignment's type cannot be recognized. Type is: '%d'.\n", value.type);
-          exit(EXIT_FAILURE);
-      }
+      assign_value(ctx, node->data.id, evaluate_expr(ctx, node->child[0]));
       break;
 
     case NODE_PRINT:
       if (!node->child[0]) {
-        fprintf(stderr, "Error: print node has no arguments\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: print node has no arguments\n");
       }
       
       astnode_t *args = node->child[0];
       for (int i = 0; i < MAXCHILDREN; i++) {
         if (args->child[i]) {
-          Value value = evaluate_expr(args->child[i]);
-          
+          Value value = evaluate_expr(ctx, args->child[i]);
+
+          // Arguments are always evaluated, output may be discarded
+          if (!ctx->out) {
+            release_value(value);
+            continue;
+          }
+
+
           // Handle different types
           if (value.type == TYPE_STRING) {
             // Print string WITHOUT quotes
-            printf("%s", value.data.str_val);
+            string_write(value.data.str_val, ctx->out);
           } else if (value.type == TYPE_FLOAT) {
-            printf("%f", value.data.float_val);
+            fprintf(ctx->out, "%f", value.data.float_val);
           } else if (value.type == TYPE_INT) {
-            printf("%d", value.data.int_val);
+            fprintf(ctx->out, "%d", value.data.int_val);
           } else if (value.type == TYPE_BOOL) {
-            printf("%s", value.data.int_val ? "true" : "false");
+            fprintf(ctx->out, "%s", value.data.int_val ? "true" : "false");
+          } else if (value.type == TYPE_BIGINT) {
+            char *digits = bigint_to_string(value.data.big_val);
+            fputs(digits, ctx->out);
+            free(digits);
+          } else if (value.type == TYPE_GENERATOR) {
+            fprintf(ctx->out, "<generator %s>", generator_name(value.data.gen_val));
+          } else if (value.type == TYPE_CHANNEL) {
+            fprintf(ctx->out, "<channel>");
           }
+          release_value(value);
         }
       }
       break;
 
     case NODE_READ:
-      const char* varName = node->data.id;
-      printf("What do you want this time? ...\n");
-      fflush(stdout);
-
-      char buffer[256];
-      if (!fgets(buffer, sizeof(buffer), stdin)) {
-          fprintf(stderr, "Error reading input.\n");
-          exit(EXIT_FAILURE);
-      }
-      // Remove trailing newline if present
-      char *newline = strchr(buffer, '\n');
-      if (newline) *newline = '\0';
-
-      // Always store it as string
-      put_symbol_string(varName, buffer);
+      evaluate_read(ctx, node);
       break;
 
     // TODO: Create a input() function-like expr. to use in runtime
 
     case NODE_WHILE:
-      evaluate_while(node);
+      evaluate_while(ctx, node);
       break;
 
     case NODE_FOR:
-      evaluate_for(node);
+      evaluate_for(ctx, node);
+      break;
+
+    case NODE_FOREACH:
+      evaluate_foreach(ctx, node);
+      break;
+
+    case NODE_BENCH:
+      evaluate_bench(ctx, node);
+      break;
+
+    case NODE_YIELD:
+      generator_yield(ctx, evaluate_expr(ctx, node->child[0]));
+      break;
+
+    case NODE_SPAWN:
+      call_function(ctx, node, 1);
+      break;
+
+    case NODE_SNAPSHOT:
+      if (ctx->snapshot) snapshot_take(ctx, node);
+      break;
+
+    case NODE_IMPORT:
+      module_import(ctx, node);
       break;
 
     case NODE_IF:
-      evaluate_if(node);
+      evaluate_if(ctx, node);
       break;
 
     case NODE_IFELSE:
-      evaluate_ifelse(node);
+      evaluate_ifelse(ctx, node);
       break;
 
     case NODE_FUNC:
-      evaluate_func(node);
+      evaluate_func(ctx, node);
       break;
 
     default:
       // For other nodes, evaluate as expression
-      evaluate_expr(node);
+      release_value(evaluate_expr(ctx, node));
       break;
   }
 }
 
-static Value evaluate_expr(astnode_t *node) {
+// A numeric operand as a float or double (bools count as ints)
+static double number_value(Value v) {
+  switch (v.type) {
+    case TYPE_FLOAT:  return v.data.float_val;
+    case TYPE_BIGINT: return bigint_to_double(v.data.big_val);
+    default:          return v.data.int_val;
+  }
+}
+
+// Generators and channels only pass values on
+static void reject_streams(BreezeContext *ctx, Value left, Value right) {
+  if (left.type == TYPE_GENERATOR || right.type == TYPE_GENERATOR) {
+    breeze_error(ctx, "Error: Cannot compute with a generator; loop over it with f{ x in g -> }\n");
+  }
+  if (left.type == TYPE_CHANNEL || right.type == TYPE_CHANNEL) {
+    breeze_error(ctx, "Error: Cannot compute with a channel; use send() and recv()\n");
+  }
+}
+
+// A new reference to an int, bool or bignum operand as a BigInt
+static BigInt *bigint_operand(Value v) {
+  if (v.type == TYPE_BIGINT) return bigint_retain(v.data.big_val);
+  return bigint_from_int64(v.data.int_val);
+}
+
+/**
+ * NODE_ADD, NODE_SUB, NODE_MUL or NODE_DIV with a bignum operand, or
+ * ints whose result overflows: exact between integers, in float when a
+ * float is involved or for a division. Releases both operands.
+ */
+static Value bigint_arith(BreezeContext *ctx, int op, Value left, Value right) {
+  static const char *verbs[] = {
+    [NODE_ADD] = "add", [NODE_SUB] = "subtract", [NODE_MUL] = "multiply", [NODE_DIV] = "divide"
+  };
+  reject_streams(ctx, left, right);
+  if (left.type == TYPE_STRING || right.type == TYPE_STRING) {
+    breeze_error(ctx, "Error: Cannot %s string values\n", verbs[op]);
+  }
+  if (op == NODE_ADD && (left.type == TYPE_BOOL || right.type == TYPE_BOOL)) {
+    breeze_error(ctx, "Error: Invalid types for addition\n");
+  }
+
+  Value result;
+  if (op == NODE_DIV || left.type == TYPE_FLOAT || right.type == TYPE_FLOAT) {
+    float left_val = (float)number_value(left);
+    float right_val = (float)number_value(right);
+    if (op == NODE_DIV && right_val == 0.0f && right.type != TYPE_BIGINT) {
+      breeze_error(ctx, "Error: Division by zero\n");
+    }
+    switch (op) {
+      case NODE_ADD: result = create_float_value(left_val + right_val); break;
+      case NODE_SUB: result = create_float_value(left_val - right_val); break;
+      case NODE_MUL: result = create_float_value(left_val * right_val); break;
+      default:       result = create_float_value(left_val / right_val); break;
+    }
+  } else {
+    BigInt *a = bigint_operand(left);
+    BigInt *b = bigint_operand(right);
+    switch (op) {
+      case NODE_ADD: result = create_bigint_value(bigint_add(a, b)); break;
+      case NODE_SUB: result = create_bigint_value(bigint_sub(a, b)); break;
+      default:       result = create_bigint_value(bigint_mul(a, b)); break;
+    }
+    bigint_release(a);
+    bigint_release(b);
+  }
+  release_value(left);
+  release_value(right);
+  return result;
+}
+
+static Value multiply_values(BreezeContext *ctx, Value left, Value right) {
+  float result;
+
+  reject_streams(ctx, left, right);
+  if (left.type == TYPE_BIGINT || right.type == TYPE_BIGINT) {
+    return bigint_arith(ctx, NODE_MUL, left, right);
+  }
+  if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
+    breeze_error(ctx, "Error: Cannot multiply string values\n");
+  }
+
+  if (left.type == TYPE_FLOAT || right.type == TYPE_FLOAT) {
+    float left_val = (left.type == TYPE_FLOAT) ? left.data.float_val : (float)left.data.int_val;
+    float right_val = (right.type == TYPE_FLOAT) ? right.data.float_val : (float)right.data.int_val;
+    result = left_val * right_val;
+    return create_float_value(result);
+  } else {
+    int product;
+    if (__builtin_mul_overflow(left.data.int_val, right.data.int_val, &product)) {
+      return bigint_arith(ctx, NODE_MUL, left, right);
+    }
+    return create_int_value(product);
+  }
+}
+
+// NODE_EXP: exact for an int or bignum base and a non-negative int exponent
+static Value power_values(BreezeContext *ctx, Value left, Value right) {
+  reject_streams(ctx, left, right);
+  if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
+    breeze_error(ctx, "Error: Cannot exponentiate string values\n");
+  }
+
+  if ((left.type == TYPE_INT || left.type == TYPE_BIGINT) &&
+      right.type == TYPE_INT && right.data.int_val >= 0) {
+    if (left.type == TYPE_INT) {
+      // By squaring in an int, until something overflows
+      int result = 1, square = left.data.int_val, exponent = right.data.int_val;
+      while (exponent) {
+        if ((exponent & 1) && __builtin_mul_overflow(result, square, &result)) break;
+        exponent >>= 1;
+        if (exponent && __builtin_mul_overflow(square, square, &square)) break;
+      }
+      if (!exponent) return create_int_value(result);
+    }
+    BigInt *base = bigint_operand(left);
+    Value power = create_bigint_value(bigint_pow(base, (unsigned long)right.data.int_val));
+    bigint_release(base);
+    release_value(left);
+    return power;
+  }
+
+  float base = (float)number_value(left);
+  float exponent = (float)number_value(right);
+  release_value(left);
+  release_value(right);
+  return create_float_value(pow(base, exponent));
+}
+
+// compare_values with a bignum operand: by numeric value
+static int compare_bigint(BreezeContext *ctx, enum BoolOpType op, Value left, Value right) {
+  if (op == OP_AND || op == OP_OR) {
+    int left_truth = left.type == TYPE_BIGINT || left.data.int_val;
+    int right_truth = right.type == TYPE_BIGINT || right.data.int_val;
+    return op == OP_AND ? left_truth && right_truth : left_truth || right_truth;
+  }
+
+  int order;
+  if (left.type == TYPE_STRING || right.type == TYPE_STRING) {
+    // A string is never equal to a number, and has no order with one
+    if (op == OP_EQ || op == OP_NEQ) return op == OP_NEQ;
+    breeze_error(ctx, "Error: Cannot compare a string with a number\n");
+  } else if (left.type == TYPE_FLOAT || right.type == TYPE_FLOAT) {
+    double left_val = number_value(left), right_val = number_value(right);
+    order = (left_val > right_val) - (left_val < right_val);
+  } else if (left.type == TYPE_BIGINT && right.type == TYPE_BIGINT) {
+    order = bigint_compare(left.data.big_val, right.data.big_val);
+  } else if (left.type == TYPE_BIGINT) {
+    // Bignums lie beyond every int
+    order = left.data.big_val->negative ? -1 : 1;
+  } else {
+    order = right.data.big_val->negative ? 1 : -1;
+  }
+
+  switch (op) {
+    case OP_EQ:  return order == 0;
+    case OP_NEQ: return order != 0;
+    case OP_LT:  return order < 0;
+    case OP_LE:  return order <= 0;
+    case OP_GT:  return order > 0;
+    case OP_GE:  return order >= 0;
+    default:     breeze_error(ctx, "Error: Unknown boolean operator\n");
+  }
+}
+
+// A binary NODE_BOOL_OP on evaluated operands
+static int compare_values(BreezeContext *ctx, enum BoolOpType op, Value left, Value right) {
+  if (left.type == TYPE_GENERATOR || right.type == TYPE_GENERATOR ||
+      left.type == TYPE_CHANNEL || right.type == TYPE_CHANNEL) {
+    // Generators and channels are only equal to themselves
+    if (op != OP_EQ && op != OP_NEQ) reject_streams(ctx, left, right);
+    int same = left.type == right.type && (left.type == TYPE_CHANNEL
+        ? left.data.chan_val == right.data.chan_val
+        : left.data.gen_val == right.data.gen_val);
+    return op == OP_EQ ? same : !same;
+  }
+  if (left.type == TYPE_BIGINT || right.type == TYPE_BIGINT) {
+    return compare_bigint(ctx, op, left, right);
+  }
+
+  if (op == OP_AND) {
+    return left.data.int_val && right.data.int_val;
+
+  } else if (op == OP_OR) {
+    return left.data.int_val || right.data.int_val;
+
+  } else if (op == OP_EQ) {
+
+    if(left.type == TYPE_STRING && right.type == TYPE_STRING) {
+      return string_compare(left.data.str_val, right.data.str_val) == 0;
+
+    } else {
+      return left.data.int_val == right.data.int_val;
+    }
+  } else if (op == OP_NEQ) {
+
+    if(left.type == TYPE_STRING && right.type == TYPE_STRING) {
+      return string_compare(left.data.str_val, right.data.str_val) == 1;
+
+    } else {
+      return left.data.int_val != right.data.int_val;
+    }
+  } else if (op == OP_LT) {
+    return left.data.int_val < right.data.int_val;
+  } else if (op == OP_LE) {
+    return left.data.int_val <= right.data.int_val;
+  } else if (op == OP_GT) {
+    return left.data.int_val > right.data.int_val;
+  } else if (op == OP_GE) {
+    return left.data.int_val >= right.data.int_val;
+  } else {
+    breeze_error(ctx, "Error: Unknown boolean operator\n");
+  }
+}
+
+// A cached invariant is only reused if recomputing it could not print a warning
+static int cacheable(BreezeContext *ctx, astnode_t *node, Value value) {
+  if (value.type == TYPE_STRING || value.type == TYPE_BIGINT ||
+      value.type == TYPE_GENERATOR || value.type == TYPE_CHANNEL) return 0;
+
+  if (node->type == NODE_ID || node->type == NODE_INDEX || node->type == NODE_STRLEN) {
+    SymbolNode *symbol = lookup_symbol(ctx, node->data.id);
+    if (symbol && symbol->type == TYPE_STRING && (symbol->data.string_val->flags & STRING_BACKSLASH)) {
+      return 0;
+    }
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (node->child[i] && !cacheable(ctx, node->child[i], create_int_value(0))) return 0;
+  }
+  return 1;
+}
+
+// An expression with a slot in the innermost running loop (see loopopt.h)
+static Value evaluate_cached(BreezeContext *ctx, astnode_t *node) {
+  LoopFrame *frame = ctx->loop;
+  const LoopSlot *slot = &frame->plan->slots[node->cache_slot];
+  LoopCache *cache = &frame->cache[node->cache_slot];
+
+  if (slot->kind == LOOP_INDUCTION) {
+    Value left = evaluate_expr(ctx, node->child[0]);
+    Value right = evaluate_expr(ctx, node->child[1]);
+    if (left.type != TYPE_INT || right.type != TYPE_INT) {
+      return multiply_values(ctx, left, right);
+    }
+
+    int var = (slot->var_child == 0 ? left : right).data.int_val;
+    int factor = (slot->var_child == 0 ? right : left).data.int_val;
+    if (cache->state != LOOP_CACHED || var != cache->last) {
+      int next, product, step;
+      if (cache->state == LOOP_CACHED &&
+          !__builtin_add_overflow(cache->last, slot->step, &next) && var == next &&
+          !__builtin_add_overflow(cache->product, cache->step, &product)) {
+        cache->product = product;
+      } else if (!__builtin_mul_overflow(var, factor, &product) &&
+                 !__builtin_mul_overflow(factor, slot->step, &step)) {
+        cache->product = product;
+        cache->step = step;
+        cache->state = LOOP_CACHED;
+      } else {
+        // Products beyond an int are bignums
+        cache->state = LOOP_EMPTY;
+        return multiply_values(ctx, left, right);
+      }
+      cache->last = var;
+    }
+    return create_int_value(cache->product);
+  }
+
+  if (cache->state == LOOP_CACHED) {
+    return cache->value;
+  }
+  ctx->loop = NULL;
+  Value value = evaluate_expr(ctx, node);
+  ctx->loop = frame;
+  if (cache->state == LOOP_EMPTY) {
+    cache->state = cacheable(ctx, node, value) ? LOOP_CACHED : LOOP_UNCACHED;
+    cache->value = value;
+  }
+  return value;
+}
+
+static Value evaluate_expr(BreezeContext *ctx, astnode_t *node) {
 
   if (!node) {
-    fprintf(stderr, "Error: NULL pointer in evaluate_expr.\n");
-    exit(EXIT_FAILURE); 
+    breeze_error(ctx, "Error: NULL pointer in evaluate_expr.\n");
+  }
+  if (node->cached_in && ctx->loop && ctx->loop->plan == node->cached_in) {
+    return evaluate_cached(ctx, node);
   }
 
   float result;
@@ -322,44 +743,76 @@ static Value evaluate_expr(astnode_t *node) {
     case NODE_INT:
       return create_int_value(node->data.num);
 
+    case NODE_BIGINT:
+      return create_bigint_value(node->data.big);
+
     case NODE_FLOAT:
       return create_float_value(node->data.dec);
 
     case NODE_STRING:
+      if (node->literal) {
+        return create_string_value(node->literal);
+      }
       return create_str_value(node->data.str);
 
     case NODE_ID:
-      symbol = lookup_symbol(node->data.id);
+      symbol = lookup_symbol(ctx, node->data.id);
       if (!symbol) {
-        fprintf(stderr, "Error: Undefined variable '%s'\n", node->data.id);
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Undefined variable '%s'\n", node->data.id);
       }
 
       switch (symbol->type) {
 
         case TYPE_STRING:
-          return create_str_value(symbol->data.string_val);
+          return create_string_value(string_value(symbol->data.string_val));
         case TYPE_FLOAT:
           return create_float_value(symbol->data.float_val);
         case TYPE_INT:
           return create_int_value(symbol->data.int_val);
         case TYPE_BOOL:
           return create_bool_value(symbol->data.int_val);
+        case TYPE_BIGINT:
+          return create_bigint_value(bigint_retain(symbol->data.big_val));
+        case TYPE_GENERATOR:
+          return create_generator_value(generator_retain(symbol->data.gen_val));
+        case TYPE_CHANNEL:
+          return create_channel_value(channel_retain(symbol->data.chan_val));
 
         default:
-          fprintf(stderr, "Error, the type of the variable isn't recognized\n");
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Error, the type of the variable isn't recognized\n");
       }
 
 
     case NODE_ADD:
-      left = evaluate_expr(node->child[0]);
-      right = evaluate_expr(node->child[1]);
+      left = evaluate_expr(ctx, node->child[0]);
+      right = evaluate_expr(ctx, node->child[1]);
+
+      // Proven ints (see typeinfer.h) only need an overflow check; a
+      // bignum operand or result takes the exact path
+      if (node->inferred == TI_INT) {
+        int sum;
+        if (left.type != TYPE_BIGINT && right.type != TYPE_BIGINT &&
+            !__builtin_add_overflow(left.data.int_val, right.data.int_val, &sum)) {
+          return create_int_value(sum);
+        }
+        return bigint_arith(ctx, NODE_ADD, left, right);
+      }
+
+      // Ints that stay ints need no further dispatch
+      if (left.type == TYPE_INT && right.type == TYPE_INT) {
+        int sum;
+        if (!__builtin_add_overflow(left.data.int_val, right.data.int_val, &sum)) {
+          return create_int_value(sum);
+        }
+        return bigint_arith(ctx, NODE_ADD, left, right);
+      }
+      if (left.type == TYPE_BIGINT || right.type == TYPE_BIGINT) {
+        return bigint_arith(ctx, NODE_ADD, left, right);
+      }
 
       // Ensure both values are numeric (int or float)
       if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
-        fprintf(stderr, "Error: Cannot add string values\n");
-        exit(EXIT_FAILURE); // Exit or handle the error as appropriate
+        breeze_error(ctx, "Error: Cannot add string values\n");
       }
 
       // Perform the addition and handle type promotion
@@ -368,21 +821,37 @@ static Value evaluate_expr(astnode_t *node) {
         float right_val = (right.type == TYPE_FLOAT) ? right.data.float_val : (float)right.data.int_val;
         result = left_val + right_val;
         return create_float_value(result);
-      } else if (left.type == TYPE_INT && right.type == TYPE_INT) {
-        int result = left.data.int_val + right.data.int_val;
-        return create_int_value(result);
       } else {
-        fprintf(stderr, "Error: Invalid types for addition\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Invalid types for addition\n");
       }
 
     case NODE_SUB:
-      left = evaluate_expr(node->child[0]);
-      right = evaluate_expr(node->child[1]);
+      left = evaluate_expr(ctx, node->child[0]);
+      right = evaluate_expr(ctx, node->child[1]);
+
+      if (node->inferred == TI_INT) {
+        int difference;
+        if (left.type != TYPE_BIGINT && right.type != TYPE_BIGINT &&
+            !__builtin_sub_overflow(left.data.int_val, right.data.int_val, &difference)) {
+          return create_int_value(difference);
+        }
+        return bigint_arith(ctx, NODE_SUB, left, right);
+      }
+
+      if (left.type == TYPE_INT && right.type == TYPE_INT) {
+        int difference;
+        if (!__builtin_sub_overflow(left.data.int_val, right.data.int_val, &difference)) {
+          return create_int_value(difference);
+        }
+        return bigint_arith(ctx, NODE_SUB, left, right);
+      }
+      if (left.type == TYPE_BIGINT || right.type == TYPE_BIGINT) {
+        return bigint_arith(ctx, NODE_SUB, left, right);
+      }
+      reject_streams(ctx, left, right);
 
       if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
-        fprintf(stderr, "Error: Cannot subtract string values\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Cannot subtract string values\n");
       }
 
       if (left.type == TYPE_FLOAT || right.type == TYPE_FLOAT) {
@@ -391,42 +860,49 @@ static Value evaluate_expr(astnode_t *node) {
         result = left_val - right_val;
         return create_float_value(result);
       } else {
-        int result = left.data.int_val - right.data.int_val;
-        return create_int_value(result);
+        int difference;
+        if (__builtin_sub_overflow(left.data.int_val, right.data.int_val, &difference)) {
+          return bigint_arith(ctx, NODE_SUB, left, right);
+        }
+        return create_int_value(difference);
       }
 
     case NODE_MUL:
-      left = evaluate_expr(node->child[0]);
-      right = evaluate_expr(node->child[1]);
-
-      if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
-        fprintf(stderr, "Error: Cannot multiply string values\n");
-        exit(EXIT_FAILURE);
+      left = evaluate_expr(ctx, node->child[0]);
+      right = evaluate_expr(ctx, node->child[1]);
+
+      if (node->inferred == TI_INT) {
+        int product;
+        if (left.type != TYPE_BIGINT && right.type != TYPE_BIGINT &&
+            !__builtin_mul_overflow(left.data.int_val, right.data.int_val, &product)) {
+          return create_int_value(product);
+        }
+        return bigint_arith(ctx, NODE_MUL, left, right);
       }
 
-      if (left.type == TYPE_FLOAT || right.type == TYPE_FLOAT) {
-        float left_val = (left.type == TYPE_FLOAT) ? left.data.float_val : (float)left.data.int_val;
-        float right_val = (right.type == TYPE_FLOAT) ? right.data.float_val : (float)right.data.int_val;
-        result = left_val * right_val;
-        return create_float_value(result);
-      } else {
-        result = left.data.int_val * right.data.int_val;
-        return create_int_value((int)result);
+      if (left.type == TYPE_INT && right.type == TYPE_INT) {
+        int product;
+        if (!__builtin_mul_overflow(left.data.int_val, right.data.int_val, &product)) {
+          return create_int_value(product);
+        }
       }
+      return multiply_values(ctx, left, right);
 
     case NODE_DIV:
-      left = evaluate_expr(node->child[0]);
-      right = evaluate_expr(node->child[1]);
+      left = evaluate_expr(ctx, node->child[0]);
+      right = evaluate_expr(ctx, node->child[1]);
 
+      if (left.type == TYPE_BIGINT || right.type == TYPE_BIGINT) {
+        return bigint_arith(ctx, NODE_DIV, left, right);
+      }
+      reject_streams(ctx, left, right);
       if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
-        fprintf(stderr, "Error: Cannot divide string values\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Cannot divide string values\n");
       }
 
       if ((right.type == TYPE_INT && right.data.int_val == 0) ||
         (right.type == TYPE_FLOAT && right.data.float_val == 0.0)) {
-        fprintf(stderr, "Error: Division by zero\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Division by zero\n");
       }
 
       float left_val = (left.type == TYPE_FLOAT) ? left.data.float_val : (float)left.data.int_val;
@@ -435,168 +911,129 @@ static Value evaluate_expr(astnode_t *node) {
       return create_float_value(result);
 
     case NODE_EXP:
-      left = evaluate_expr(node->child[0]);
-      right = evaluate_expr(node->child[1]);
-
-      if ((left.type == TYPE_STRING || right.type == TYPE_STRING)) {
-        fprintf(stderr, "Error: Cannot exponentiate string values\n");
-        exit(EXIT_FAILURE);
-      }
-
-      float base = (left.type == TYPE_FLOAT) ? left.data.float_val : (float)left.data.int_val;
-      float exponent = (right.type == TYPE_FLOAT) ? right.data.float_val : (float)right.data.int_val;
-      result = pow(base, exponent);
-      return create_float_value(result);
+      left = evaluate_expr(ctx, node->child[0]);
+      right = evaluate_expr(ctx, node->child[1]);
+      return power_values(ctx, left, right);
 
     case NODE_BOOL:
       return create_bool_value(node->data.boolean ? 1 : 0);
 
     case NODE_BOOL_OP:
-      left = evaluate_expr(node->child[0]);
+      left = evaluate_expr(ctx, node->child[0]);
 
       if (node->data.bool_op == OP_NOT) {
-        return create_bool_value((!left.data.bool_val) ? 1 : 0);
+        int truth = left.type != TYPE_BIGINT && !left.data.bool_val;
+        release_value(left);
+        return create_bool_value(truth ? 1 : 0);
       }
 
       // Only evaluate right child for binary operations
-      right = evaluate_expr(node->child[1]);
-
-      if (node->data.bool_op == OP_AND) {
-        return create_bool_value((left.data.int_val && right.data.int_val) ? 1 : 0);
-
-      } else if (node->data.bool_op == OP_OR) {
-        return create_bool_value((left.data.int_val || right.data.int_val) ? 1 : 0);
-
-      } else if (node->data.bool_op == OP_EQ) {
-
-        if(left.type == TYPE_STRING && right.type == TYPE_STRING) {
-          return create_bool_value(
-            strcmp(left.data.str_val, right.data.str_val) == 0 ? 
-            1 : 0
-          );
-
-        } else {
-          return create_bool_value((left.data.int_val == right.data.int_val) ? 1 : 0);
-        }
-      } else if (node->data.bool_op == OP_NEQ) {
-
-        if(left.type == TYPE_STRING && right.type == TYPE_STRING) {
-          return create_bool_value(
-            strcmp(left.data.str_val, right.data.str_val) == 1 ? 
-            1 : 0
-          );
+      right = evaluate_expr(ctx, node->child[1]);
 
-        } else {
-          return create_bool_value((left.data.int_val == right.data.int_val) ? 0 : 1);
-        }
-      } else if (node->data.bool_op == OP_LT) { 
-        return create_bool_value((left.data.int_val < right.data.int_val) ? 1 : 0);
-      } else if (node->data.bool_op == OP_LE) {
-        return create_bool_value((left.data.int_val <= right.data.int_val) ? 1 : 0);
-      } else if (node->data.bool_op == OP_GT) {
-        return create_bool_value((left.data.int_val > right.data.int_val) ? 1 : 0);
-      } else if (node->data.bool_op == OP_GE) {
-        return create_bool_value((left.data.int_val >= right.data.int_val) ? 1 : 0);
-      } else {
-        fprintf(stderr, "Error: Unknown boolean operator\n");
-        exit(EXIT_FAILURE);
-      }
+      int truth = compare_values(ctx, node->data.bool_op, left, right);
+      release_value(left);
+      release_value(right);
+      return create_bool_value(truth ? 1 : 0);
 
     case NODE_FUNCCALL:
-      return evaluate_funccall(node);
+      return evaluate_funccall(ctx, node);
       break;
 
+    case NODE_ARG: {
+      // Read the way a parameter bound to it would be
+      Value arg = ctx->args[node->data.num];
+      switch (arg.type) {
+        case TYPE_STRING:    return create_string_value(string_value(arg.data.str_val));
+        case TYPE_BIGINT:    return create_bigint_value(bigint_retain(arg.data.big_val));
+        case TYPE_GENERATOR: return create_generator_value(generator_retain(arg.data.gen_val));
+        case TYPE_CHANNEL:   return create_channel_value(channel_retain(arg.data.chan_val));
+        default:             return arg;
+      }
+    }
+
     case NODE_FUNCRET:
       if(node->child[0]) {
-        return evaluate_expr(node->child[0]);
+        return evaluate_expr(ctx, node->child[0]);
       } else {
-        fprintf(stderr, "Error: There isn't an expression associated to this return statement.\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: There isn't an expression associated to this return statement.\n");
       }
 
     case NODE_INDEX:
-      SymbolNode *symbol = lookup_symbol(node->data.id);
+      SymbolNode *symbol = lookup_symbol(ctx, node->data.id);
 
       if (!symbol) {
-        fprintf(stderr, "Error: Undefined variable '%s'\n", node->data.id);
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Undefined variable '%s'\n", node->data.id);
       } else if(symbol->type != TYPE_STRING) {
-        fprintf(stderr, "Error: indexing is only supported on strings for now.\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: indexing is only supported on strings for now.\n");
       }
       
-      const char *str = symbol->data.string_val;
-      int length = strlen(str);
+      String *str = symbol->data.string_val;
+      int length = str->length;
 
       astnode_t *slice = node->child[0];
 
       if (!slice || slice->type != NODE_SLICE){
-        fprintf(stderr, "Error: element inside braces has to be a slice!\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: element inside braces has to be a slice!\n");
       } else if (!slice->child[0]) {
-        fprintf(stderr, "Error: we need at least one element inside the slice!\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: we need at least one element inside the slice!\n");
       }
 
       // TODO: Check that slice1 is an int
-      int slice1 = evaluate_expr(slice->child[0]).data.int_val;
+      Value bound = evaluate_expr(ctx, slice->child[0]);
+      int slice1 = bound.data.int_val;
+      release_value(bound);
 
       if (slice1 < 0 || slice1 >= length) {
-          fprintf(stderr, "Error: string index %d out of range (length %d).\n", slice1, length);
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Error: string index %d out of range (length %d).\n", slice1, length);
       }
 
       if (slice->child[1]) {
         // TODO: Check that slice2 is an int
-        int slice2 = evaluate_expr(slice->child[1]).data.int_val;
+        bound = evaluate_expr(ctx, slice->child[1]);
+        int slice2 = bound.data.int_val;
+        release_value(bound);
         if (slice2 < 0 || slice2 >= length) {
-          fprintf(stderr, "Error: string index %d out of range (length %d).\n", slice2, length);
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Error: string index %d out of range (length %d).\n", slice2, length);
         } else if (slice1 > slice2){
-          fprintf(stderr, "Error: slice val 1 '%d' shouldn't be greater than slice val 2 '%d'\n", slice1, slice2);
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Error: slice val 1 '%d' shouldn't be greater than slice val 2 '%d'\n", slice1, slice2);
         }
 
-        int slicelen = slice2 - slice1 + 1;
-        char finalStr[slicelen + 1];  // +1 for the terminating null
-        
-        strncpy(finalStr, str + slice1, slicelen);
-        
-        // Place terminating null at index slicelen
-        finalStr[slicelen] = '\0';
-        
-        return create_str_value(finalStr);
+        // A view into the variable's characters, unless they need processing
+        String *view = string_slice(str, slice1, slice2 - slice1 + 1);
+        Value sliced = create_string_value(string_value(view));
+        string_release(view);
+        return sliced;
 
       } else {
+        char c = str->chars[slice1];
+        if (c != '\\' && c != '"') {
+          return create_string_value(string_char((unsigned char)c));
+        }
         // Build a new single‐character string
         char singleChar[2];
-        singleChar[0] = str[slice1];
+        singleChar[0] = c;
         singleChar[1] = '\0';
 
         return create_str_value(singleChar);
       }
 
     case NODE_STRLEN:
-      symbol = lookup_symbol(node->data.id);
+      symbol = lookup_symbol(ctx, node->data.id);
       if (!symbol) {
-        fprintf(stderr, "Error: Undefined variable '%s'\n", node->data.id);
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Undefined variable '%s'\n", node->data.id);
       } else if (symbol->type != TYPE_STRING) {
-        fprintf(stderr, "Error: Variable '%s' must be of type string!\n", node->data.id);
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Variable '%s' must be of type string!\n", node->data.id);
       } else if (symbol->data.string_val == NULL) {
-        fprintf(stderr, "Error: Variable '%s' is uninitialized (NULL)\n", node->data.id);
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: Variable '%s' is uninitialized (NULL)\n", node->data.id);
       }
-      return create_int_value(strlen(symbol->data.string_val));
+      return create_int_value(symbol->data.string_val->length);
 
     default:
-      fprintf(stderr, "Error: Unknown node type in evaluation. Maybe you should use evaluate_ast() instead of evaluate_expr()? Node type: %d\n", node->type);
-      exit(EXIT_FAILURE);
+      breeze_error(ctx, "Error: Unknown node type in evaluation. Maybe you should use evaluate_ast() instead of evaluate_expr()? Node type: %d\n", node->type);
   }
 }
 
-Value evaluate_funcbody(astnode_t* node) {
+Value evaluate_funcbody(BreezeContext *ctx, astnode_t * node) {
   if (node->type == NODE_STMTS && node) {
     // Evaluate all statements in sequence
     for (int i = 0; i < MAXCHILDREN; i++) {
@@ -604,21 +1041,21 @@ Value evaluate_funcbody(astnode_t* node) {
       if (node->child[i]->type == NODE_FUNCRET) {
         // When a return is reached, stop funcbody evaluation and 
         // yield return's associated expression
-          return evaluate_expr(node->child[i]);
+          HEATMAP_HIT(ctx, node->child[i]);
+          return evaluate_expr(ctx, node->child[i]);
       } else {
         // Otherwise, evaluate this existing child and move on.
-        evaluate_ast(node->child[i]);
+        evaluate_ast(ctx, node->child[i]);
       }
     }
   } else {
-    fprintf(stderr, "Error: Invalid function body.\n");
-    exit(EXIT_FAILURE); 
+    breeze_error(ctx, "Error: Invalid function body.\n");
   }
   // return 0 if no return was found
   return create_int_value(0);
 }
 
-void evaluate_loop(astnode_t* node){
+void evaluate_loop(BreezeContext *ctx, astnode_t * node){
   if (node->type == NODE_STMTS && node) {
     // Evaluate all statements in sequence
     for (int i = 0; i < MAXCHILDREN; i++) {
@@ -631,48 +1068,99 @@ void evaluate_loop(astnode_t* node){
         continue;
       } else {
         // Otherwise, evaluate this existing child and move on.
-        evaluate_ast(node->child[i]);
+        evaluate_ast(ctx, node->child[i]);
       }
     }
   } else {
-    fprintf(stderr, "Error: Invalid function body.\n");
-    exit(EXIT_FAILURE); 
+    breeze_error(ctx, "Error: Invalid function body.\n");
+  }
+}
+
+// Start a run of a loop with cached invariants; plan is NULL when it has none
+static void loop_enter(BreezeContext *ctx, LoopFrame *frame, const LoopPlan *plan, LoopCache *cache) {
+  frame->plan = (plan && plan->count > 0) ? plan : NULL;
+  if (!frame->plan) return;
+  memset(cache, 0, sizeof(LoopCache) * plan->count);
+  frame->cache = cache;
+  frame->parent = ctx->loop;
+  ctx->loop = frame;
+}
+
+static void loop_leave(BreezeContext *ctx, LoopFrame *frame) {
+  if (frame->plan) {
+    ctx->loop = frame->parent;
   }
 }
 
-void evaluate_while(astnode_t *node) {
+void evaluate_while(BreezeContext *ctx, astnode_t *node) {
   if (!node || node->type != NODE_WHILE) {
-    fprintf(stderr, "Error: Invalid while loop node\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: Invalid while loop node\n");
   }
 
   astnode_t *condition = node->child[0];
   astnode_t *body = node->child[1];
 
   if (!condition || !body) {
-    fprintf(stderr, "Error: While loop missing condition or body\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: While loop missing condition or body\n");
   }
 
+  LoopFrame frame;
+  LoopCache cache[(node->plan && node->plan->count > 0) ? node->plan->count : 1];
+  loop_enter(ctx, &frame, node->plan, cache);
+  long long traced = TRACE_START(ctx);
+  int iterations = 0;
+
   while (1) {
-    Value cond_value = evaluate_expr(condition);
+    GOVERN(ctx, node, NULL);
+    HEATMAP_HIT(ctx, node);
+    // Hot loops continue in compiled code from this condition check
+    if (ctx->jit && jit_loop(ctx, node)) {
+      break;
+    }
+    Value cond_value = evaluate_expr(ctx, condition);
 
     if (cond_value.type != TYPE_BOOL) {
-      fprintf(stderr, "Error: While loop condition must evaluate to a boolean\n");
-      exit(EXIT_FAILURE);
+      breeze_error(ctx, "Error: While loop condition must evaluate to a boolean\n");
     }
     /* When the condition is not valid anymore, we exit the loop */
     if (!cond_value.data.int_val) {
       break;
     }
-    evaluate_loop(body);
+    evaluate_loop(ctx, body);
+    iterations++;
+  }
+  loop_leave(ctx, &frame);
+  TRACE_END(ctx, node, traced, iterations);
+}
+
+// `i OP b` with the counter's current value, compared like NODE_BOOL_OP does
+static int counted_condition(BreezeContext *ctx, astnode_t *condition, int counter_child, int i) {
+  Value bound = evaluate_expr(ctx, condition->child[1 - counter_child]);
+  if (bound.type == TYPE_BIGINT) {
+    Value counter = create_int_value(i);
+    int truth = counter_child == 0 ? compare_values(ctx, condition->data.bool_op, counter, bound)
+                                   : compare_values(ctx, condition->data.bool_op, bound, counter);
+    release_value(bound);
+    return truth;
+  }
+  int left = counter_child == 0 ? i : bound.data.int_val;
+  int right = counter_child == 0 ? bound.data.int_val : i;
+  release_value(bound);
+
+  switch (condition->data.bool_op) {
+    case OP_EQ:  return left == right;
+    case OP_NEQ: return left != right;
+    case OP_LT:  return left < right;
+    case OP_LE:  return left <= right;
+    case OP_GT:  return left > right;
+    case OP_GE:  return left >= right;
+    default:     return 0;
   }
 }
 
-void evaluate_for(astnode_t *node) {
+void evaluate_for(BreezeContext *ctx, astnode_t *node) {
   if (!node || node->type != NODE_FOR) {
-    fprintf(stderr, "Error: Invalid for loop node\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: Invalid for loop node\n");
   }
 
   astnode_t *init =       node->child[0];
@@ -681,72 +1169,172 @@ void evaluate_for(astnode_t *node) {
   astnode_t *body =       node->child[3];
 
   if (!init || !condition || !update || !body) {
-    fprintf(stderr, "Error: For loop missing a fundamental building block (init | conditiion | update | body)\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: For loop missing a fundamental building block (init | conditiion | update | body)\n");
+  }
+
+  evaluate_ast(ctx, init);
+
+  LoopFrame frame;
+  LoopCache cache[(node->plan && node->plan->count > 0) ? node->plan->count : 1];
+  loop_enter(ctx, &frame, node->plan, cache);
+
+  // Counted loops step their int counter in place (see loopopt.h)
+  SymbolNode *counter = NULL;
+  if (node->plan && node->plan->counted) {
+    counter = lookup_symbol(ctx, init->data.id);
+    if (counter && counter->type != TYPE_INT) {
+      counter = NULL;
+    }
   }
 
-  evaluate_ast(init);
+  long long traced = TRACE_START(ctx);
+  int iterations = 0;
 
   while(1) {
-    Value cond_value = evaluate_expr(condition);
+    GOVERN(ctx, node, NULL);
+    HEATMAP_HIT(ctx, node);
+    if (ctx->jit && jit_loop(ctx, node)) {
+      break;
+    }
+    if (counter) {
+      if (!counted_condition(ctx, condition, node->plan->counter_child, counter->data.int_val)) {
+        break;
+      }
+      evaluate_loop(ctx, body);
+      iterations++;
+      int next;
+      if (__builtin_add_overflow(counter->data.int_val, node->plan->counter_step, &next)) {
+        // The counter becomes a bignum: step it the general way from now on
+        evaluate_ast(ctx, update);
+        counter = NULL;
+      } else {
+        counter->data.int_val = next;
+      }
+      continue;
+    }
+    Value cond_value = evaluate_expr(ctx, condition);
 
     if (cond_value.type != TYPE_BOOL) {
-      fprintf(stderr, "Error: For loop condition must evaluate to a boolean\n");
-      exit(EXIT_FAILURE);
+      breeze_error(ctx, "Error: For loop condition must evaluate to a boolean\n");
     }
     /* When the condition is not valid anymore, we exit the loop */
     if (!cond_value.data.int_val) {
       break;
     }
-    evaluate_loop(body);
-    evaluate_ast(update);
+    evaluate_loop(ctx, body);
+    iterations++;
+    evaluate_ast(ctx, update);
   }
+  loop_leave(ctx, &frame);
+  TRACE_END(ctx, node, traced, iterations);
 }
 
-void evaluate_if(astnode_t *node) {
-  if (!node || node->type != NODE_IF) {
-    fprintf(stderr, "Error: Invalid if statement node\n");
+// f{ x in g -> }: pull values from a generator until its body returns,
+// or from a channel until it is closed and empty
+void evaluate_foreach(BreezeContext *ctx, astnode_t *node) {
+  Value source = evaluate_expr(ctx, node->child[0]);
+  if (source.type != TYPE_GENERATOR && source.type != TYPE_CHANNEL) {
+    release_value(source);
+    breeze_error(ctx, "Error: f{ %s in ... } needs a generator or a channel\n", node->data.id);
+  }
+
+  // Registered so a generator or task abandoned inside this loop can drop the source
+  ForEachFrame frame = { source, ctx->foreach };
+  ctx->foreach = &frame;
+  long long traced = TRACE_START(ctx);
+  int iterations = 0;
+
+  Value item;
+  while (1) {
+    GOVERN(ctx, node, NULL);
+    HEATMAP_HIT(ctx, node);
+    int more = source.type == TYPE_CHANNEL
+        ? channel_recv(ctx, channel_retain(source.data.chan_val), &item)
+        : generator_next(ctx, source.data.gen_val, &item);
+    if (!more) {
+      break;
+    }
+    assign_value(ctx, node->data.id, item);
+    evaluate_loop(ctx, node->child[1]);
+    iterations++;
+  }
+  ctx->foreach = frame.outer;
+  release_value(source);
+  TRACE_END(ctx, node, traced, iterations);
+}
+
+// b{ label, n -> }: time n runs of the body after a warm-up (see bench.h)
+void evaluate_bench(BreezeContext *ctx, astnode_t *node) {
+  Value label = evaluate_expr(ctx, node->child[0]);
+  if (label.type != TYPE_STRING) {
+    release_value(label);
+    breeze_error(ctx, "Error: b{} needs a string label\n");
+  }
+  Value count = evaluate_expr(ctx, node->child[1]);
+  if (count.type != TYPE_INT || count.data.int_val <= 0 || count.data.int_val > BENCH_MAX_RUNS) {
+    release_value(label);
+    release_value(count);
+    breeze_error(ctx, "Error: b{} needs a number of runs that is an int from 1 to %d\n", BENCH_MAX_RUNS);
+  }
+  int runs = count.data.int_val;
+  long long *samples = malloc(sizeof(long long) * (size_t)runs);
+  if (!samples) {
+    fprintf(stderr, "Error: Memory allocation for a benchmark failed.\n");
     exit(EXIT_FAILURE);
   }
 
+  // Each run is timed alone, so the cost of the loop around it is left out
+  for (int i = -bench_warmup(runs); i < runs; i++) {
+    GOVERN(ctx, node, NULL);
+    HEATMAP_HIT(ctx, node);
+    long long start = bench_now();
+    evaluate_loop(ctx, node->child[2]);
+    long long took = bench_now() - start;
+    if (i >= 0) samples[i] = took;
+  }
+  bench_report(ctx->out, label.data.str_val, samples, runs);
+  free(samples);
+  release_value(label);
+}
+
+void evaluate_if(BreezeContext *ctx, astnode_t *node) {
+  if (!node || node->type != NODE_IF) {
+    breeze_error(ctx, "Error: Invalid if statement node\n");
+  }
+
   astnode_t *condition = node->child[0];
   astnode_t *body = node->child[1];
 
   if (!condition || !body) {
-    fprintf(stderr, "Error: If statement missing condition or body\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: If statement missing condition or body\n");
   }
 
-  Value cond_value = evaluate_expr(condition);
+  Value cond_value = evaluate_expr(ctx, condition);
 
   if (cond_value.type != TYPE_BOOL) {
-    fprintf(stderr, "Error: If statement condition must evaluate to a boolean\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: If statement condition must evaluate to a boolean\n");
   }
 
   if (cond_value.data.int_val) {
-    evaluate_ast(body);
+    evaluate_ast(ctx, body);
   }
 }
 
-void evaluate_ifelse(astnode_t *node) {
+void evaluate_ifelse(BreezeContext *ctx, astnode_t *node) {
   if (!node || node->type != NODE_IFELSE) {
-    fprintf(stderr, "Error: Invalid if-else statement node\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: Invalid if-else statement node\n");
   }
 
   astnode_t *condition = node->child[0];
 
   if (!condition) {
-    fprintf(stderr, "Error: If-else statement missing condition\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: If-else statement missing condition\n");
   }
 
-  Value cond_value = evaluate_expr(condition);
+  Value cond_value = evaluate_expr(ctx, condition);
 
   if (cond_value.type != TYPE_BOOL) {
-    fprintf(stderr, "Error: If statement condition must evaluate to a boolean\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: If statement condition must evaluate to a boolean\n");
   }
   astnode_t *body;
 
@@ -757,76 +1345,187 @@ void evaluate_ifelse(astnode_t *node) {
   }
 
   if (!body) {
-    fprintf(stderr, "Error: If-else statement missing body\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: If-else statement missing body\n");
   }
-  evaluate_ast(body);
+  evaluate_ast(ctx, body);
 }
 
-void evaluate_func(astnode_t * node) {
+void evaluate_func(BreezeContext *ctx, astnode_t * node) {
   const char *funcName = node->data.id;
 
-  SymbolNode *symbol = lookup_symbol(funcName);
+  SymbolNode *symbol = lookup_symbol(ctx, funcName);
   if (symbol) {
-    fprintf(stderr, "Error: this function has already been defined in the script!\n");
-    exit(EXIT_FAILURE);
+    breeze_error(ctx, "Error: this function has already been defined in the script!\n");
   } else {
-    put_symbol_function(funcName, node);
+    put_symbol_function(ctx, funcName, node);
+  }
+}
+
+// A call to a string builtin, or to channel operation `op` when builtin is NULL
+static Value call_builtin(BreezeContext *ctx, astnode_t *node, const StringBuiltin *builtin, ChannelOp op) {
+  astnode_t *argListNode = node->child[0];
+  int argCount = 0;
+  while (argCount < MAXCHILDREN && argListNode->child[argCount]) {
+    argCount++;
+  }
+  Value argValues[argCount > 0 ? argCount : 1];
+  for (int i = 0; i < argCount; i++) {
+    argValues[i] = evaluate_expr(ctx, argListNode->child[i]);
   }
+  Value ret = builtin ? strlib_call(ctx, builtin, argValues, argCount)
+                      : channel_call(ctx, op, argValues, argCount);
+  check_heap(ctx);
+  return ret;
 }
 
-Value evaluate_funccall(astnode_t * node) {
+/**
+ * A NODE_FUNCCALL, or a NODE_SPAWN when `spawn` is set: the same
+ * arguments and frame, but the body is handed to a new task and the
+ * result is 0.
+ */
+static Value call_function(BreezeContext *ctx, astnode_t *node, int spawn) {
   // 1. Look up the function by name in the current scopes
-  SymbolNode *fnSymbol = lookup_symbol(node->data.id);
+  SymbolNode *fnSymbol = lookup_symbol(ctx, node->data.id);
   if (!fnSymbol || fnSymbol->type != TYPE_FUNCTION) {
-    fprintf(stderr, "Error: '%s' is not defined as a function.\n", node->data.id);
-    exit(EXIT_FAILURE);
+    // Names the script does not define as functions may be builtins
+    ChannelOp op = channel_builtin(node->data.id);
+    const StringBuiltin *builtin = op ? NULL : strlib_lookup(node->data.id);
+    int timer = !op && !builtin && bench_builtin(node->data.id);
+    if ((builtin || op || timer) && spawn) {
+      breeze_error(ctx, "Error: cannot spawn builtin '%s'.\n", node->data.id);
+    } else if (timer) {
+      if (node->child[0]->child[0]) breeze_error(ctx, "Error: clock() takes no arguments.\n");
+      return bench_clock(ctx);
+    } else if (builtin || op) {
+      return call_builtin(ctx, node, builtin, op);
+    }
+    breeze_error(ctx, "Error: '%s' is not defined as a function.\n", node->data.id);
   }
 
   // 2. Retrieve the function AST
   astnode_t *funcDefNode = fnSymbol->data.func_ast; // NODE_FUNC
   astnode_t *paramList = funcDefNode->child[0];     // parameters
-  astnode_t *funcBody  = funcDefNode->child[1];     // body (NODE_STMTS)
+  astnode_t *funcBody  = lazy_body(ctx, funcDefNode); // body (NODE_STMTS), parsed now if lazy
 
   // 3. Evaluate arguments (the child[0] of the call node is the argList)
   astnode_t *argListNode = node->child[0];
-  Value argValues[MAXCHILDREN] = {0};
   int argCount = 0;
-  for (int i = 0; i < MAXCHILDREN; i++) {
-    if (!argListNode->child[i]) break;
-    argValues[argCount++] = evaluate_expr(argListNode->child[i]);
+  while (argCount < MAXCHILDREN && argListNode->child[argCount]) {
+    argCount++;
+  }
+  // Sized to the call: this frame is on the stack once per active call
+  Value argValues[argCount > 0 ? argCount : 1];
+  for (int i = 0; i < argCount; i++) {
+    argValues[i] = evaluate_expr(ctx, argListNode->child[i]);
   }
 
-  // 4. push_scope for the new function call
-  push_scope();
+  // Hot functions with int/float/bool arguments may run as compiled code
+  Value ret;
+  if (ctx->jit && !spawn && !funcDefNode->generator && jit_call(ctx, funcDefNode, argValues, argCount, &ret)) {
+    return ret;
+  }
+
+  // 4. push_scope for the new function call, if the run's limits allow it
+  GOVERN(ctx, funcDefNode, NULL);
+  if (ctx->depth >= ctx->max_depth ||
+      (ctx->stack_limit && (const char *)__builtin_frame_address(0) < ctx->stack_limit)) {
+    breeze_stack_overflow(ctx, node->data.id);
+  }
+  const char *caller = ctx->function;
+  ctx->function = node->data.id;
+  ctx->depth++;
+  push_scope(ctx);
 
   // 5. Bind arguments to parameters in this new top scope
   for (int i = 0; i < argCount; i++) {
     astnode_t *paramNode = paramList->child[i];
     if (!paramNode) {
-      fprintf(stderr, "Error: too many arguments for function '%s'.\n", node->data.id);
-      exit(EXIT_FAILURE);
+      breeze_error(ctx, "Error: too many arguments for function '%s'.\n", node->data.id);
     }
     const char *paramName = paramNode->data.id;
     Value v = argValues[i];
     // store param in top scope
     switch (v.type) {
-      case TYPE_INT:    put_symbol_int(paramName, v.data.int_val);       break;
-      case TYPE_FLOAT:  put_symbol_float(paramName, v.data.float_val);   break;
-      case TYPE_STRING: put_symbol_string(paramName, v.data.str_val);    break;
-      case TYPE_BOOL:   put_symbol_bool(paramName, v.data.int_val);      break;
+      case TYPE_INT:    put_symbol_int(ctx, paramName, v.data.int_val);       break;
+      case TYPE_FLOAT:  put_symbol_float(ctx, paramName, v.data.float_val);   break;
+      case TYPE_STRING: put_symbol_string(ctx, paramName, v.data.str_val);    break;
+      case TYPE_BOOL:   put_symbol_bool(ctx, paramName, v.data.int_val);      break;
+      case TYPE_BIGINT: put_symbol_bigint(ctx, paramName, v.data.big_val);    break;
+      case TYPE_GENERATOR: put_symbol_generator(ctx, paramName, v.data.gen_val); break;
+      case TYPE_CHANNEL: put_symbol_channel(ctx, paramName, v.data.chan_val); break;
       default:
-        fprintf(stderr, "Error: unrecognized parameter type.\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Error: unrecognized parameter type.\n");
     }
+    release_value(v);
   }
+  check_heap(ctx);
   // TODO: check if there are leftover parameters with no arguments
+
+  // A generator function keeps the frame and runs its body on demand,
+  // a spawned one runs it as a task
+  if (funcDefNode->generator || spawn) {
+    Scope *frame = detach_scope(ctx);
+    ctx->depth--;
+    ctx->function = caller;
+    if (!spawn) {
+      return create_generator_value(generator_new(ctx, funcDefNode, frame));
+    }
+    if (funcDefNode->generator) {
+      free_scope(frame);
+      breeze_error(ctx, "Error: cannot spawn generator function '%s'.\n", node->data.id);
+    }
+    task_spawn(ctx, funcDefNode, frame);
+    return create_int_value(0);
+  }
+
   // 6. Evaluate the function body, capturing the possible return value
-  Value ret = evaluate_funcbody(funcBody);
+  long long traced = TRACE_START(ctx);
+  ret = evaluate_funcbody(ctx, funcBody);
+  TRACE_END(ctx, funcDefNode, traced, 0);
 
   // 7. pop_scope
-  pop_scope();
+  pop_scope(ctx);
+  ctx->depth--;
+  ctx->function = caller;
 
   // 8. Return final value
   return ret;
 }
+
+/**
+ * A call with its callee's expression copied in (see inline.h): the
+ * arguments are evaluated as for call_function, then the copy reads them
+ * from ctx->args instead of a scope of parameters.
+ */
+static Value call_inlined(BreezeContext *ctx, astnode_t *node) {
+  Inline *in = node->inlined;
+  Value argValues[in->argc > 0 ? in->argc : 1];
+  for (int i = 0; i < in->argc; i++) {
+    argValues[i] = evaluate_expr(ctx, node->child[0]->child[i]);
+  }
+
+  GOVERN(ctx, in->def, NULL);
+  Value *caller_args = ctx->args;
+  const char *caller = ctx->function;
+  ctx->args = argValues;
+  ctx->function = node->data.id;
+  Value ret = evaluate_expr(ctx, in->expr);
+  ctx->args = caller_args;
+  ctx->function = caller;
+
+  for (int i = 0; i < in->argc; i++) {
+    release_value(argValues[i]);
+  }
+  return ret;
+}
+
+Value evaluate_funccall(BreezeContext *ctx, astnode_t *node) {
+  // The heatmap counts the lines of every call and the trace times it, so they get real ones
+  if (node->inlined && !ctx->heatmap && !ctx->trace) {
+    SymbolNode *fnSymbol = lookup_symbol(ctx, node->data.id);
+    if (fnSymbol && fnSymbol->type == TYPE_FUNCTION && fnSymbol->data.func_ast == node->inlined->def) {
+      return call_inlined(ctx, node);
+    }
+  }
+  return call_function(ctx, node, 0);
+}
@@ -6,19 +6,35 @@
 
 // Include ValueType and Value structures 
 #include "symtab.h"
+#include "strval.h"
+#include "bigint.h"
+
+// Evaluation runs against an interpreter context (see context.h)
+typedef struct BreezeContext BreezeContext;
 
 
 // Helper functions to create values
 Value create_float_value(float f);
 Value create_int_value(int i);
-Value create_string_value(const char* s);
+Value create_str_value(const char *s);
+Value create_string_value(String *s);  // Takes over the reference
 Value create_bool_value(int i);
+Value create_bigint_value(BigInt *b);  // Takes over the reference; an int if it fits
+Value create_generator_value(struct Generator *g);  // Takes over the reference
+Value create_channel_value(struct Channel *c);      // Takes over the reference
+
+// Drop the reference a string, bignum, generator or channel value holds (others own nothing)
+void release_value(Value v);
 
 // AST Functions
 astnode_t *astnode_new(int type);
 void astnode_add_child(astnode_t *parent, astnode_t *child, int index);
+astnode_t *stmts_join(astnode_t *first, astnode_t *rest);
 void print_ast(astnode_t *node, int depth);
 void free_ast(astnode_t *node);
-void evaluate_ast(astnode_t *node);
+void evaluate_ast(BreezeContext *ctx, astnode_t *node);
+
+// Run a function body until its first direct `return` (0 without one)
+Value evaluate_funcbody(BreezeContext *ctx, astnode_t *body);
 
 #endif // AST_H
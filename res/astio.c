@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "astio.h"
+#include "ast.h"
+#include "generator.h"
+#include "typeinfer.h"
+
+unsigned long long astio_hash(const char *data, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash ^ length;
+}
+
+// Nodes whose data is an identifier
+static int has_id(int type) {
+  switch (type) {
+    case NODE_ID: case NODE_ASSIGN: case NODE_FUNC: case NODE_FUNCCALL: case NODE_READ:
+    case NODE_INDEX: case NODE_STRLEN: case NODE_FOREACH: case NODE_SPAWN: case NODE_IMPORT:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// ----------- WRITING -----------
+
+void astio_put(FILE *out, const void *data, size_t size) {
+  fwrite(data, 1, size, out);
+}
+
+void astio_put_u32(FILE *out, uint32_t v) { astio_put(out, &v, sizeof(v)); }
+void astio_put_i32(FILE *out, int32_t v) { astio_put(out, &v, sizeof(v)); }
+void astio_put_u64(FILE *out, uint64_t v) { astio_put(out, &v, sizeof(v)); }
+
+void astio_put_text(FILE *out, const char *text, size_t length) {
+  if (!text) {
+    astio_put_u32(out, ASTIO_NO_TEXT);
+    return;
+  }
+  astio_put_u32(out, (uint32_t)length);
+  astio_put(out, text, length);
+}
+
+void astio_put_bigint(FILE *out, const BigInt *b) {
+  char *digits = bigint_to_string(b);
+  astio_put_text(out, digits, strlen(digits));
+  free(digits);
+}
+
+void astio_put_node(FILE *out, const astnode_t *node) {
+  astio_put_i32(out, node->type);
+  astio_put_i32(out, node->line);
+  astio_put_i32(out, node->column);
+  astio_put(out, &node->inferred, 1);
+
+  switch (node->type) {
+    case NODE_INT:     astio_put_i32(out, node->data.num); break;
+    case NODE_BOOL:    astio_put_i32(out, node->data.boolean); break;
+    case NODE_BOOL_OP: astio_put_i32(out, node->data.bool_op); break;
+    case NODE_FLOAT:   astio_put(out, &node->data.dec, sizeof(float)); break;
+    case NODE_BIGINT:  astio_put_bigint(out, node->data.big); break;
+    case NODE_STRING:
+      astio_put_text(out, node->data.str, node->data.str ? strlen(node->data.str) : 0);
+      break;
+    default:
+      if (has_id(node->type)) {
+        astio_put_text(out, node->data.id, node->data.id ? strlen(node->data.id) : 0);
+      }
+      break;
+  }
+
+  uint64_t children = 0;
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (node->child[i]) children |= (uint64_t)1 << i;
+  }
+  astio_put_u64(out, children);
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (node->child[i]) astio_put_node(out, node->child[i]);
+  }
+}
+
+// ----------- READING -----------
+
+const char *astio_take(AstReader *r, size_t size) {
+  if (r->failed || (size_t)(r->end - r->p) < size) {
+    r->failed = 1;
+    return NULL;
+  }
+  const char *at = r->p;
+  r->p += size;
+  return at;
+}
+
+uint32_t astio_take_u32(AstReader *r) {
+  uint32_t v = 0;
+  const char *at = astio_take(r, sizeof(v));
+  if (at) memcpy(&v, at, sizeof(v));
+  return v;
+}
+
+int32_t astio_take_i32(AstReader *r) {
+  int32_t v = 0;
+  const char *at = astio_take(r, sizeof(v));
+  if (at) memcpy(&v, at, sizeof(v));
+  return v;
+}
+
+uint64_t astio_take_u64(AstReader *r) {
+  uint64_t v = 0;
+  const char *at = astio_take(r, sizeof(v));
+  if (at) memcpy(&v, at, sizeof(v));
+  return v;
+}
+
+float astio_take_float(AstReader *r) {
+  float v = 0;
+  const char *at = astio_take(r, sizeof(v));
+  if (at) memcpy(&v, at, sizeof(v));
+  return v;
+}
+
+const char *astio_take_text(AstReader *r, uint32_t *length) {
+  *length = astio_take_u32(r);
+  if (r->failed || *length == ASTIO_NO_TEXT) return NULL;
+  return astio_take(r, *length);
+}
+
+char *astio_take_string(AstReader *r) {
+  uint32_t length;
+  const char *text = astio_take_text(r, &length);
+  return text ? strndup(text, length) : NULL;
+}
+
+BigInt *astio_take_bigint(AstReader *r) {
+  uint32_t length;
+  const char *text = astio_take_text(r, &length);
+  int negative = text && length > 0 && text[0] == '-';
+  if (!text || length == (uint32_t)negative) {
+    r->failed = 1;
+    return NULL;
+  }
+  for (uint32_t i = (uint32_t)negative; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      r->failed = 1;
+      return NULL;
+    }
+  }
+  char *digits = strndup(text + negative, length - (uint32_t)negative);
+  BigInt *b = bigint_from_string(digits);
+  free(digits);
+  if (negative) {
+    BigInt *negated = bigint_negate(b);
+    bigint_release(b);
+    b = negated;
+  }
+  return b;
+}
+
+astnode_t *astio_take_node(AstReader *r) {
+  int32_t type = astio_take_i32(r);
+  if (r->failed || type < 0 || type > NODE_ERROR) {
+    r->failed = 1;
+    return NULL;
+  }
+  astnode_t *node = astnode_new(type);
+  node->line = astio_take_i32(r);
+  node->column = astio_take_i32(r);
+  const char *inferred = astio_take(r, 1);
+  if (inferred && (unsigned char)*inferred > TI_STRING) r->failed = 1;
+  if (inferred && r->types) node->inferred = (unsigned char)*inferred;
+
+  switch (type) {
+    case NODE_INT:     node->data.num = astio_take_i32(r); break;
+    case NODE_BOOL:    node->data.boolean = astio_take_i32(r); break;
+    case NODE_BOOL_OP: node->data.bool_op = (enum BoolOpType)astio_take_i32(r); break;
+    case NODE_FLOAT:   node->data.dec = astio_take_float(r); break;
+    case NODE_BIGINT: {
+      BigInt *b = astio_take_bigint(r);
+      // free_ast() frees the bignum of every NODE_BIGINT
+      if (b) {
+        node->data.big = bigint_literal(b);
+        bigint_release(b);
+      } else {
+        node->type = NODE_INT;
+      }
+      break;
+    }
+    case NODE_STRING:
+      node->data.str = astio_take_string(r);
+      if (node->data.str) node->literal = string_literal(node->data.str);
+      break;
+    default:
+      if (has_id(type)) node->data.id = astio_take_string(r);
+      break;
+  }
+
+  uint64_t children = astio_take_u64(r);
+  if (children >> MAXCHILDREN) r->failed = 1;
+  for (int i = 0; i < MAXCHILDREN && !r->failed; i++) {
+    if (children & ((uint64_t)1 << i)) node->child[i] = astio_take_node(r);
+  }
+  if (type == NODE_FUNC) node->generator = generator_yields(node->child[1]);
+  return node;
+}
+
+// ----------- FILES -----------
+
+const char *astio_map(const char *path, size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return NULL;
+  *size = (size_t)st.st_size;
+  return map;
+}
+
+void astio_unmap(const char *map, size_t size) {
+  munmap((void *)map, size);
+}
+
+FILE *astio_create(const char *path, char **partial) {
+  // Named after the process, as several may write the same file at once
+  size_t size = strlen(path) + 32;
+  *partial = malloc(size);
+  if (!*partial) return NULL;
+  snprintf(*partial, size, "%s.%ld.tmp", path, (long)getpid());
+  FILE *out = fopen(*partial, "wb");
+  if (!out) {
+    free(*partial);
+    *partial = NULL;
+  }
+  return out;
+}
+
+int astio_commit(FILE *out, char *partial, const char *path) {
+  int failed = ferror(out);
+  if (fclose(out) != 0 || failed || rename(partial, path) != 0) {
+    remove(partial);
+    free(partial);
+    return -1;
+  }
+  free(partial);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef ASTIO_H
+#define ASTIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "symtab.h"
+#include "bigint.h"
+
+/**
+ * Binary form of ASTs and values for the files the interpreter writes
+ * and later reads back itself: snapshots (snapshot.h) and compiled
+ * modules (module.h). Everything is in the byte order of the machine,
+ * as these files are caches, not an interchange format.
+ *
+ * Texts are a u32 length and the bytes (ASTIO_NO_TEXT for NULL); an AST
+ * node is its type, position, inferred type and data, then a mask of
+ * its children followed by them. Files record NODE_ERROR so that the ones written by
+ * a build with other node numbers are ignored.
+ */
+
+#define ASTIO_NO_TEXT UINT32_MAX
+
+// 64-bit FNV-1a of the bytes, mixed with their length
+unsigned long long astio_hash(const char *data, size_t length);
+
+void astio_put(FILE *out, const void *data, size_t size);
+void astio_put_u32(FILE *out, uint32_t v);
+void astio_put_i32(FILE *out, int32_t v);
+void astio_put_u64(FILE *out, uint64_t v);
+void astio_put_text(FILE *out, const char *text, size_t length);
+void astio_put_bigint(FILE *out, const BigInt *b);
+void astio_put_node(FILE *out, const astnode_t *node);
+
+/**
+ * Decodes a file mapped with astio_map(). Any read past its end marks
+ * the reader as failed; from then on reads return zeros and NULLs.
+ */
+typedef struct AstReader {
+  const char *p, *end;
+  int failed;
+  int types;      // Keep the inferred types stored with the nodes
+} AstReader;
+
+// The next `size` bytes of the mapping, or NULL
+const char *astio_take(AstReader *r, size_t size);
+uint32_t astio_take_u32(AstReader *r);
+int32_t astio_take_i32(AstReader *r);
+uint64_t astio_take_u64(AstReader *r);
+float astio_take_float(AstReader *r);
+
+// The bytes of a text in the mapping, NULL for ASTIO_NO_TEXT (or on failure)
+const char *astio_take_text(AstReader *r, uint32_t *length);
+char *astio_take_string(AstReader *r);
+BigInt *astio_take_bigint(AstReader *r);
+
+/**
+ * A copy of the AST, with the literals and generator flags the parser
+ * would have set. Loop plans are not stored: run loop_optimize() on the
+ * result. Inferred types only hold for the program they were inferred
+ * in; unless r->types is set, run infer_types() as well.
+ */
+astnode_t *astio_take_node(AstReader *r);
+
+// Map a whole file read-only, NULL if it is missing or empty
+const char *astio_map(const char *path, size_t *size);
+void astio_unmap(const char *map, size_t size);
+
+/**
+ * Files are written next to their target and renamed over it, so that
+ * readers never see half a file. astio_create() opens the partial file
+ * (NULL on failure); astio_commit() closes it and renames it to `path`,
+ * or removes it and returns -1 if anything failed.
+ */
+FILE *astio_create(const char *path, char **partial);
+int astio_commit(FILE *out, char *partial, const char *path);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "breeze.h"
+#include "batch.h"
+
+// Output captured from one stream of a worker
+typedef struct {
+    char *data;
+    size_t len, cap;
+    int fd;                 // Read end of the pipe (-1 once at EOF)
+} Capture;
+
+typedef struct {
+    const char *path;
+    pid_t pid;
+    Capture out, err;
+    struct timespec start;
+    double wall_ms, cpu_ms;
+    int status;             // As returned by wait4
+    int finished;
+} Job;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static double cpu_ms(const struct rusage *usage) {
+    return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1e3 +
+           (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e3;
+}
+
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+// Append what is available on the pipe; returns 0 once the worker closed it
+static int drain(Capture *c) {
+    if (c->len + 4096 > c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 8192;
+        c->data = realloc(c->data, c->cap);
+        if (!c->data) {
+            fprintf(stderr, "Error: Memory allocation for batch output failed.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ssize_t n = read(c->fd, c->data + c->len, c->cap - c->len);
+    if (n < 0 && errno == EINTR) return 1;
+    if (n <= 0) {
+        close(c->fd);
+        c->fd = -1;
+        return 0;
+    }
+    c->len += (size_t)n;
+    return 1;
+}
+
+static int start_job(Job *job, BatchRunner run, void *arg) {
+    int out[2], err[2];
+    if (pipe(out) != 0) return -1;
+    if (pipe(err) != 0) {
+        close(out[0]);
+        close(out[1]);
+        return -1;
+    }
+
+    // Nothing buffered may be duplicated into the worker
+    fflush(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &job->start);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_RDONLY);
+        if (null >= 0) dup2(null, STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+
+        int status = run(job->path, arg);
+        fflush(NULL);
+        _exit(status);
+    }
+
+    close(out[1]);
+    close(err[1]);
+    if (pid < 0) {
+        close(out[0]);
+        close(err[0]);
+        return -1;
+    }
+    job->pid = pid;
+    job->out.fd = out[0];
+    job->err.fd = err[0];
+    return 0;
+}
+
+static void finish_job(Job *job) {
+    struct rusage usage;
+    struct timespec end;
+    while (wait4(job->pid, &job->status, 0, &usage) < 0 && errno == EINTR) {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->wall_ms = elapsed_ms(&job->start, &end);
+    job->cpu_ms = cpu_ms(&usage);
+    job->finished = 1;
+}
+
+static void describe_status(const Job *job, char *buf, size_t size) {
+    if (WIFSIGNALED(job->status)) {
+        snprintf(buf, size, "signal %d", WTERMSIG(job->status));
+    } else if (WEXITSTATUS(job->status) == 0) {
+        snprintf(buf, size, "ok");
+    } else if (WEXITSTATUS(job->status) == BREEZE_EXIT_LIMIT) {
+        snprintf(buf, size, "limit");
+    } else {
+        snprintf(buf, size, "exit %d", WEXITSTATUS(job->status));
+    }
+}
+
+int breeze_batch(char **scripts, int count, int jobs, BatchRunner run, void *arg) {
+    Job *all = calloc((size_t)count, sizeof(Job));
+    struct pollfd *fds = calloc((size_t)jobs * 2, sizeof(struct pollfd));
+    Capture **owners = calloc((size_t)jobs * 2, sizeof(Capture *));
+    if (!all || !fds || !owners) {
+        fprintf(stderr, "Error: Memory allocation for the batch failed.\n");
+        return 1;
+    }
+
+    struct timespec batch_start, batch_end;
+    clock_gettime(CLOCK_MONOTONIC, &batch_start);
+
+    int next = 0;       // Next script to start
+    int emitted = 0;    // Scripts whose output has been replayed
+    int running = 0;
+    int failed = 0;
+    while (emitted < count) {
+        while (running < jobs && next < count) {
+            Job *job = &all[next];
+            job->path = scripts[next++];
+            if (start_job(job, run, arg) != 0) {
+                perror("Failed to start a batch worker");
+                job->status = EXIT_FAILURE << 8;
+                job->finished = 1;
+                job->out.fd = job->err.fd = -1;
+                continue;
+            }
+            running++;
+        }
+
+        // Wait for output from every running worker
+        int nfds = 0;
+        for (int i = emitted; i < next; i++) {
+            Capture *streams[2] = {&all[i].out, &all[i].err};
+            for (int s = 0; s < 2; s++) {
+                if (streams[s]->fd < 0) continue;
+                fds[nfds].fd = streams[s]->fd;
+                fds[nfds].events = POLLIN;
+                owners[nfds++] = streams[s];
+            }
+        }
+        if (nfds > 0 && poll(fds, (nfds_t)nfds, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        for (int i = 0; i < nfds; i++) {
+            if (fds[i].revents) drain(owners[i]);
+        }
+
+        // A worker is done when it closed both streams
+        for (int i = emitted; i < next; i++) {
+            if (!all[i].finished && all[i].out.fd < 0 && all[i].err.fd < 0) {
+                finish_job(&all[i]);
+                running--;
+            }
+        }
+
+        // Replay finished scripts in input order
+        while (emitted < next && all[emitted].finished) {
+            Job *job = &all[emitted++];
+            write_all(STDOUT_FILENO, job->out.data, job->out.len);
+            write_all(STDERR_FILENO, job->err.data, job->err.len);
+            free(job->out.data);
+            free(job->err.data);
+            if (!WIFEXITED(job->status) || WEXITSTATUS(job->status) != 0) failed++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &batch_end);
+    double wall = elapsed_ms(&batch_start, &batch_end), cpu = 0;
+    fprintf(stderr, "\n%12s %12s  %-8s %s\n", "wall ms", "cpu ms", "status", "script");
+    for (int i = 0; i < count; i++) {
+        char status[32];
+        describe_status(&all[i], status, sizeof(status));
+        fprintf(stderr, "%12.3f %12.3f  %-8s %s\n", all[i].wall_ms, all[i].cpu_ms, status, all[i].path);
+        cpu += all[i].cpu_ms;
+    }
+    fprintf(stderr, "%d scripts, %d failed, %d jobs: %.3f ms wall, %.3f ms cpu (%.2fx parallel)\n",
+            count, failed, jobs, wall, cpu, wall > 0 ? cpu / wall : 0.0);
+
+    free(all);
+    free(fds);
+    free(owners);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/**
+ * Batch mode (--jobs N): run many scripts in one invocation.
+ *
+ * Every script runs in its own forked worker, at most `jobs` at a time,
+ * so a runtime error or a limit only ends that script. A worker's stdout
+ * and stderr are captured through pipes and replayed in input order as
+ * soon as every earlier script has finished, so the combined output is
+ * the same as running the scripts one after another. Workers read
+ * `what?` input from /dev/null.
+ */
+
+// Runs one script inside a worker; the result becomes its exit status
+typedef int (*BatchRunner)(const char *path, void *arg);
+
+/**
+ * Run `count` scripts with up to `jobs` workers and print a per-script
+ * timing summary to stderr. Returns 0 if every script exited with
+ * status 0, 1 otherwise.
+ */
+int breeze_batch(char **scripts, int count, int jobs, BatchRunner run, void *arg);
+
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "bench.h"
+#include "context.h"
+#include "ast.h"
+
+// Back-to-back clock readings taken to measure what one costs
+#define CALIBRATION_READS 1000
+
+static pthread_once_t calibrated = PTHREAD_ONCE_INIT;
+static long long clock_cost;
+
+long long bench_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int bench_builtin(const char *name) {
+  return strcmp(name, "clock") == 0;
+}
+
+Value bench_clock(BreezeContext *ctx) {
+  const struct timespec *start = &ctx->governor.started;
+  long long ns = bench_now() - ((long long)start->tv_sec * 1000000000LL + start->tv_nsec);
+  if (ns <= INT_MAX) return create_int_value((int)ns);
+  return create_bigint_value(bigint_from_int64(ns));
+}
+
+int bench_warmup(int runs) {
+  return runs >= 10 ? runs / 10 : 1;
+}
+
+// The cheapest of many empty timings: what a sample of a body doing nothing reads
+static void calibrate(void) {
+  long long best = LLONG_MAX;
+  for (int i = 0; i < CALIBRATION_READS; i++) {
+    long long start = bench_now();
+    long long took = bench_now() - start;
+    if (took < best) best = took;
+  }
+  clock_cost = best;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+// "850 ns", "1.31 us", "12.04 ms", "1.50 s"
+static void format_time(char *buf, size_t size, long long ns) {
+  if (ns < 1000) {
+    snprintf(buf, size, "%lld ns", ns);
+  } else if (ns < 1000000) {
+    snprintf(buf, size, "%.2f us", ns / 1e3);
+  } else if (ns < 1000000000) {
+    snprintf(buf, size, "%.2f ms", ns / 1e6);
+  } else {
+    snprintf(buf, size, "%.2f s", ns / 1e9);
+  }
+}
+
+void bench_report(FILE *out, const String *label, long long *samples, int runs) {
+  if (!out) return;
+  pthread_once(&calibrated, calibrate);
+  for (int i = 0; i < runs; i++) {
+    samples[i] = samples[i] > clock_cost ? samples[i] - clock_cost : 0;
+  }
+  qsort(samples, (size_t)runs, sizeof(long long), compare_samples);
+
+  // Nearest rank: the smallest sample at least 99% of the runs do not exceed
+  long long p99 = samples[(int)(((long long)runs * 99 + 99) / 100) - 1];
+  char min[32], median[32], tail[32];
+  format_time(min, sizeof(min), samples[0]);
+  format_time(median, sizeof(median), samples[runs / 2]);
+  format_time(tail, sizeof(tail), p99);
+
+  fputs("b{ ", out);
+  string_write(label, out);
+  fprintf(out, " }: %d run%s, min %s, median %s, p99 %s\n",
+          runs, runs == 1 ? "" : "s", min, median, tail);
+}
@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Timing from inside a script.
+ *
+ * clock() reads the monotonic clock, in nanoseconds since the run
+ * started. It is an int for the first two seconds or so and a bignum
+ * after that; the difference of two close readings is an int again.
+ *
+ * b{ label, n -> body }; times body: it runs n / 10 times (at least once)
+ * to warm up, then n times with each run timed on its own, and prints
+ *
+ *   b{ label }: n runs, min 1.20 us, median 1.31 us, p99 2.05 us
+ *
+ * The cost of reading the clock, measured once per process, is taken
+ * off every run. The body runs in the enclosing scope like a loop body,
+ * so variables it sets carry over from one run to the next and setup
+ * placed before the block is not timed.
+ */
+
+#define BENCH_MAX_RUNS 10000000
+
+// Nanoseconds on the monotonic clock
+long long bench_now(void);
+
+/**
+ * clock() is a builtin rather than a keyword: like those of strlib.h it
+ * serves calls to a name that is not bound to a d{} function, so a
+ * script may still define its own clock() or use `clock` as a variable.
+ */
+int bench_builtin(const char *name);
+
+// clock(): nanoseconds since ctx's run started
+Value bench_clock(BreezeContext *ctx);
+
+// Untimed runs before `runs` timed ones
+int bench_warmup(int runs);
+
+/**
+ * Print the statistics of the run times in samples (nanoseconds, which
+ * still include reading the clock) to out; NULL prints nothing. The
+ * samples are reordered.
+ */
+void bench_report(FILE *out, const struct String *label, long long *samples, int runs);
+
+#endif
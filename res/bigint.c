@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "bigint.h"
+#include "heap.h"
+
+#define KARATSUBA_THRESHOLD 32    // Limbs below which schoolbook multiplication wins
+#define RECIPROCAL_THRESHOLD 16   // Limbs below which reciprocals are found bit by bit
+#define CONVERT_THRESHOLD 32      // Limbs below which printing divides by 10^9 repeatedly
+#define DIGITS_PER_LIMB 9         // 10^9 is the largest power of ten in a limb
+
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+
+static void *bigint_alloc(size_t size) {
+  void *mem = malloc(size ? size : 1);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed for an integer.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+static limb_t *limbs_new(int count) {
+  return bigint_alloc(sizeof(limb_t) * (size_t)count);
+}
+
+static limb_t *limbs_zero(int count) {
+  limb_t *limbs = limbs_new(count);
+  memset(limbs, 0, sizeof(limb_t) * (size_t)count);
+  return limbs;
+}
+
+// A positive BigInt with room for capacity limbs, not yet filled in
+static BigInt *bigint_make(int capacity) {
+  BigInt *b = bigint_alloc(sizeof(BigInt) + sizeof(limb_t) * (size_t)capacity);
+  b->refs = 1;
+  b->negative = 0;
+  b->length = capacity;
+  b->size = (int)(sizeof(BigInt) + sizeof(limb_t) * (size_t)capacity);
+  b->account = heap_account;
+  heap_charge(b->account, b->size);
+  return b;
+}
+
+/* Magnitudes: little-endian limb arrays with explicit lengths. Leading
+   zero limbs are allowed on input unless noted. */
+
+static int mag_trim(const limb_t *a, int n) {
+  while (n > 0 && a[n - 1] == 0) n--;
+  return n;
+}
+
+static int mag_cmp(const limb_t *a, int an, const limb_t *b, int bn) {
+  an = mag_trim(a, an);
+  bn = mag_trim(b, bn);
+  if (an != bn) return an < bn ? -1 : 1;
+  for (int i = an - 1; i >= 0; i--) {
+    if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+// r[0..max(an, bn)] = a + b
+static void mag_add(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn) {
+  if (an < bn) {
+    const limb_t *t = a; a = b; b = t;
+    int tn = an; an = bn; bn = tn;
+  }
+  dlimb_t carry = 0;
+  int i;
+  for (i = 0; i < bn; i++) {
+    carry += (dlimb_t)a[i] + b[i];
+    r[i] = (limb_t)carry;
+    carry >>= 32;
+  }
+  for (; i < an; i++) {
+    carry += a[i];
+    r[i] = (limb_t)carry;
+    carry >>= 32;
+  }
+  r[an] = (limb_t)carry;
+}
+
+// r[0..an) = a - b, where a >= b and bn <= an; r may be a
+static void mag_sub(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn) {
+  dlimb_t borrow = 0;
+  int i;
+  for (i = 0; i < bn; i++) {
+    dlimb_t d = (dlimb_t)a[i] - b[i] - borrow;
+    r[i] = (limb_t)d;
+    borrow = (d >> 32) & 1;
+  }
+  for (; i < an; i++) {
+    dlimb_t d = (dlimb_t)a[i] - borrow;
+    r[i] = (limb_t)d;
+    borrow = (d >> 32) & 1;
+  }
+}
+
+// r[0..rn) += a, where the sum fits in rn limbs
+static void mag_add_into(limb_t *r, int rn, const limb_t *a, int an) {
+  an = mag_trim(a, an);
+  dlimb_t carry = 0;
+  int i;
+  for (i = 0; i < an; i++) {
+    carry += (dlimb_t)r[i] + a[i];
+    r[i] = (limb_t)carry;
+    carry >>= 32;
+  }
+  for (; carry && i < rn; i++) {
+    carry += r[i];
+    r[i] = (limb_t)carry;
+    carry >>= 32;
+  }
+}
+
+// r[0..rn) -= a, where r >= a
+static void mag_sub_into(limb_t *r, int rn, const limb_t *a, int an) {
+  an = mag_trim(a, an);
+  dlimb_t borrow = 0;
+  int i;
+  for (i = 0; i < an; i++) {
+    dlimb_t d = (dlimb_t)r[i] - a[i] - borrow;
+    r[i] = (limb_t)d;
+    borrow = (d >> 32) & 1;
+  }
+  for (; borrow && i < rn; i++) {
+    dlimb_t d = (dlimb_t)r[i] - borrow;
+    r[i] = (limb_t)d;
+    borrow = (d >> 32) & 1;
+  }
+}
+
+static void mag_add_one(limb_t *r, int rn) {
+  limb_t one = 1;
+  mag_add_into(r, rn, &one, 1);
+}
+
+static void mag_sub_one(limb_t *r, int rn) {
+  limb_t one = 1;
+  mag_sub_into(r, rn, &one, 1);
+}
+
+// r[0..an+bn) = a * b, the quadratic way
+static void mag_mul_school(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn) {
+  memset(r, 0, sizeof(limb_t) * (size_t)(an + bn));
+  for (int i = 0; i < an; i++) {
+    limb_t ai = a[i];
+    if (!ai) continue;
+    dlimb_t carry = 0;
+    for (int j = 0; j < bn; j++) {
+      carry += (dlimb_t)ai * b[j] + r[i + j];
+      r[i + j] = (limb_t)carry;
+      carry >>= 32;
+    }
+    r[i + bn] = (limb_t)carry;
+  }
+}
+
+/**
+ * r[0..an+bn) = a * b; r must not overlap the inputs. Long balanced
+ * operands split in halves, a = a1*B^h + a0, and take three products
+ * instead of four: a0*b0, a1*b1 and (a0+a1)*(b0+b1), the middle term
+ * being the last minus the other two. Unbalanced ones are multiplied a
+ * slice of the longer operand at a time.
+ */
+static void mag_mul(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn) {
+  int rn = an + bn;
+  an = mag_trim(a, an);
+  bn = mag_trim(b, bn);
+  if (an < bn) {
+    const limb_t *t = a; a = b; b = t;
+    int tn = an; an = bn; bn = tn;
+  }
+  memset(r + an + bn, 0, sizeof(limb_t) * (size_t)(rn - an - bn));
+
+  if (bn < KARATSUBA_THRESHOLD) {
+    if (bn == 0) {
+      memset(r, 0, sizeof(limb_t) * (size_t)an);
+    } else {
+      mag_mul_school(r, a, an, b, bn);
+    }
+    return;
+  }
+
+  if (2 * bn <= an) {
+    limb_t *t = limbs_new(2 * bn);
+    memset(r, 0, sizeof(limb_t) * (size_t)(an + bn));
+    for (int i = 0; i < an; i += bn) {
+      int n = an - i < bn ? an - i : bn;
+      mag_mul(t, a + i, n, b, bn);
+      mag_add_into(r + i, an + bn - i, t, n + bn);
+    }
+    free(t);
+    return;
+  }
+
+  int h = (an + 1) / 2;             // bn >= h, so b splits too
+  int top = an + bn - 2 * h;
+  limb_t *t = limbs_new(4 * h + 4);
+  limb_t *sa = t, *sb = t + h + 1, *z1 = t + 2 * h + 2;
+
+  mag_mul(r, a, h, b, h);                             // z0
+  mag_mul(r + 2 * h, a + h, an - h, b + h, bn - h);   // z2
+  mag_add(sa, a, h, a + h, an - h);
+  mag_add(sb, b, h, b + h, bn - h);
+  mag_mul(z1, sa, h + 1, sb, h + 1);
+  mag_sub_into(z1, 2 * h + 2, r, 2 * h);
+  mag_sub_into(z1, 2 * h + 2, r + 2 * h, top);
+  mag_add_into(r + h, an + bn - h, z1, 2 * h + 2);
+  free(t);
+}
+
+// Divide a[0..n) by d in place, returning the remainder
+static limb_t mag_div_small(limb_t *a, int n, limb_t d) {
+  dlimb_t rem = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    dlimb_t cur = (rem << 32) | a[i];
+    a[i] = (limb_t)(cur / d);
+    rem = cur % d;
+  }
+  return (limb_t)rem;
+}
+
+/**
+ * r[0..m+2) = floor(B^2m / p) for an m-limb p with a nonzero top limb,
+ * B being 2^32. Short divisors take a binary long division; long ones
+ * halve the precision, recurse on the top limbs of p, and take one
+ * Newton step r += r * (B^2m - p*r) / B^2m, which doubles the correct
+ * limbs. A few unit corrections then make the result exact, so the
+ * cost is a small multiple of one m-limb product.
+ */
+static void reciprocal(limb_t *r, const limb_t *p, int m) {
+  memset(r, 0, sizeof(limb_t) * (size_t)(m + 2));
+
+  if (m <= RECIPROCAL_THRESHOLD) {
+    limb_t *rem = limbs_zero(m + 1);
+    for (long bit = 64L * m; bit >= 0; bit--) {
+      limb_t carry = bit == 64L * m;
+      for (int i = 0; i <= m; i++) {
+        limb_t next = rem[i] >> 31;
+        rem[i] = (rem[i] << 1) | carry;
+        carry = next;
+      }
+      if (mag_cmp(rem, m + 1, p, m) >= 0) {
+        mag_sub_into(rem, m + 1, p, m);
+        r[bit / 32] |= (limb_t)1 << (bit % 32);
+      }
+    }
+    free(rem);
+    return;
+  }
+
+  int h = m / 2 + 2;                // A guard limb or two over half
+  int wide = 2 * m + 2;
+  limb_t *half = limbs_new(h + 2);
+  limb_t *product = limbs_new(wide + 1);
+  limb_t *power = limbs_zero(wide);
+  power[2 * m] = 1;                 // B^2m
+
+  reciprocal(half, p + (m - h), h);
+  memcpy(r + (m - h), half, sizeof(limb_t) * (size_t)(h + 2));
+  free(half);
+
+  // Newton step; the error term is far shorter than m limbs
+  mag_mul(product, p, m, r, m + 2);
+  int over = mag_cmp(product, wide, power, wide) > 0;
+  limb_t *error = limbs_new(wide);
+  if (over) {
+    mag_sub(error, product, wide, power, wide);
+  } else {
+    mag_sub(error, power, wide, product, wide);
+  }
+  int en = mag_trim(error, wide);
+  limb_t *step = limbs_new(m + 2 + en);
+  mag_mul(step, r, m + 2, error, en);
+  int sn = m + 2 + en;
+  if (sn > 2 * m) {
+    if (over) {
+      mag_sub_into(r, m + 2, step + 2 * m, sn - 2 * m);
+      if (mag_trim(step, 2 * m)) mag_sub_one(r, m + 2);
+    } else {
+      mag_add_into(r, m + 2, step + 2 * m, sn - 2 * m);
+    }
+  }
+  free(step);
+  free(error);
+
+  // Corrections: settle p*r <= B^2m < p*(r+1)
+  mag_mul(product, p, m, r, m + 2);
+  while (mag_cmp(product, wide, power, wide) > 0) {
+    mag_sub_one(r, m + 2);
+    mag_sub_into(product, wide, p, m);
+  }
+  for (;;) {
+    mag_add_into(product, wide, p, m);
+    if (mag_cmp(product, wide, power, wide) > 0) break;
+    mag_add_one(r, m + 2);
+  }
+  free(power);
+  free(product);
+}
+
+// Powers 10^(9*2^k) for decimal conversion, with reciprocals made on demand
+typedef struct Power {
+  limb_t *limbs;
+  int length;
+  limb_t *recip;
+} Power;
+
+/**
+ * q = x / p and r = x % p for x < p^2 (Barrett reduction). With
+ * R = floor(B^2m / p), the estimate (x / B^(m-1)) * R / B^(m+1) is at
+ * most two below the quotient; q and r must hold n-m+2 and m+1 limbs.
+ */
+static void divmod_power(Power *pw, const limb_t *x, int n, limb_t *q, limb_t *r) {
+  int m = pw->length;
+  int qn = n - m + 2;
+  if (!pw->recip) {
+    pw->recip = limbs_new(m + 2);
+    reciprocal(pw->recip, pw->limbs, m);
+  }
+
+  int xhn = n - (m - 1);
+  limb_t *product = limbs_new(xhn + m + 2);
+  mag_mul(product, x + (m - 1), xhn, pw->recip, m + 2);
+  memcpy(q, product + (m + 1), sizeof(limb_t) * (size_t)qn);
+  free(product);
+
+  limb_t *rem = limbs_new(n + 2);
+  limb_t *qp = limbs_new(qn + m);
+  memcpy(rem, x, sizeof(limb_t) * (size_t)n);
+  rem[n] = rem[n + 1] = 0;
+  mag_mul(qp, q, qn, pw->limbs, m);
+  mag_sub_into(rem, n + 2, qp, qn + m);
+  free(qp);
+  while (mag_cmp(rem, n + 2, pw->limbs, m) >= 0) {
+    mag_sub_into(rem, n + 2, pw->limbs, m);
+    mag_add_one(q, qn);
+  }
+  memcpy(r, rem, sizeof(limb_t) * (size_t)(m + 1));
+  free(rem);
+}
+
+/**
+ * Write x as decimal digits ending just before `end`, zero-padded to
+ * `width` digits (0: no padding). Returns the first digit. Up to eight
+ * leading zeros may be written before a padded field; the caller fills
+ * that space afterwards.
+ */
+static char *convert_small(const limb_t *x, int n, char *end, int width) {
+  limb_t *t = limbs_new(n);
+  memcpy(t, x, sizeof(limb_t) * (size_t)n);
+  n = mag_trim(t, n);
+  char *p = end;
+  do {
+    limb_t chunk = mag_div_small(t, n, 1000000000u);
+    n = mag_trim(t, n);
+    for (int i = 0; i < DIGITS_PER_LIMB; i++) {
+      *--p = (char)('0' + chunk % 10);
+      chunk /= 10;
+    }
+  } while (n > 0);
+  free(t);
+
+  if (width) {
+    while (p > end - width) *--p = '0';
+    return end - width;
+  }
+  while (p < end - 1 && *p == '0') p++;
+  return p;
+}
+
+static char *convert(Power *pw, int k, const limb_t *x, int n, char *end, int width) {
+  n = mag_trim(x, n);
+  if (!width) {
+    while (k >= 0 && mag_cmp(x, n, pw[k].limbs, pw[k].length) < 0) k--;
+  }
+  if (k < 0 || n < CONVERT_THRESHOLD) return convert_small(x, n, end, width);
+  if (n < pw[k].length) {
+    return convert(pw, k - 1, x, n, end, width);
+  }
+
+  int low = DIGITS_PER_LIMB << k;
+  limb_t *q = limbs_new(n - pw[k].length + 2);
+  limb_t *r = limbs_new(pw[k].length + 1);
+  divmod_power(&pw[k], x, n, q, r);
+  char *start = convert(pw, k - 1, r, pw[k].length + 1, end, low);
+  free(r);
+  start = convert(pw, k - 1, q, n - pw[k].length + 2, start, width ? width - low : 0);
+  free(q);
+  return start;
+}
+
+char *bigint_to_string(const BigInt *b) {
+  int n = b->length;
+  size_t size = (size_t)n * 10 + 32;
+  char *buf = bigint_alloc(size);
+  char *end = buf + size - 1;
+  *end = '\0';
+
+  // Every power that can divide b: squares while they may not exceed it
+  Power pw[40];
+  int count = 0;
+  if (n >= CONVERT_THRESHOLD) {
+    pw[0].limbs = limbs_new(1);
+    pw[0].limbs[0] = 1000000000u;
+    pw[0].length = 1;
+    pw[0].recip = NULL;
+    count = 1;
+    while (2 * pw[count - 1].length - 1 <= n) {
+      Power *prev = &pw[count - 1];
+      Power *next = &pw[count++];
+      next->limbs = limbs_new(2 * prev->length);
+      mag_mul(next->limbs, prev->limbs, prev->length, prev->limbs, prev->length);
+      next->length = mag_trim(next->limbs, 2 * prev->length);
+      next->recip = NULL;
+    }
+  }
+
+  char *start = convert(pw, count - 1, b->limbs, n, end, 0);
+  if (b->negative) *--start = '-';
+  for (int i = 0; i < count; i++) {
+    free(pw[i].limbs);
+    free(pw[i].recip);
+  }
+  memmove(buf, start, (size_t)(end - start) + 1);
+  return buf;
+}
+
+// Trim leading zero limbs; zero is never negative
+static BigInt *normalize(BigInt *b) {
+  b->length = mag_trim(b->limbs, b->length);
+  if (!b->length) b->negative = 0;
+  return b;
+}
+
+BigInt *bigint_from_int64(int64_t value) {
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  BigInt *b = bigint_make(2);
+  b->limbs[0] = (limb_t)magnitude;
+  b->limbs[1] = (limb_t)(magnitude >> 32);
+  b->negative = value < 0;
+  return normalize(b);
+}
+
+BigInt *bigint_from_string(const char *digits) {
+  int count = (int)strlen(digits);
+  BigInt *b = bigint_make(count / DIGITS_PER_LIMB + 2);
+  int n = 0;
+  // b = b * 10^k + the next k digits, nine at a time after the first chunk
+  for (int i = 0; i < count; ) {
+    int take = i == 0 && count % DIGITS_PER_LIMB ? count % DIGITS_PER_LIMB : DIGITS_PER_LIMB;
+    limb_t chunk = 0, scale = 1;
+    for (int j = 0; j < take; j++, i++) {
+      chunk = chunk * 10 + (limb_t)(digits[i] - '0');
+      scale *= 10;
+    }
+    dlimb_t carry = chunk;
+    for (int k = 0; k < n; k++) {
+      carry += (dlimb_t)b->limbs[k] * scale;
+      b->limbs[k] = (limb_t)carry;
+      carry >>= 32;
+    }
+    if (carry) b->limbs[n++] = (limb_t)carry;
+  }
+  b->length = n;
+  return normalize(b);
+}
+
+BigInt *bigint_retain(BigInt *b) {
+  if (b->refs) b->refs++;
+  return b;
+}
+
+void bigint_release(BigInt *b) {
+  if (!b || !b->refs || --b->refs > 0) return;
+  heap_charge(b->account, -b->size);
+  free(b);
+}
+
+BigInt *bigint_literal(const BigInt *b) {
+  BigInt *r = bigint_make(b->length);
+  memcpy(r->limbs, b->limbs, sizeof(limb_t) * (size_t)b->length);
+  r->negative = b->negative;
+  r->refs = 0;
+  // Owned by the AST, not a runtime value
+  heap_charge(r->account, -r->size);
+  r->account = NULL;
+  return r;
+}
+
+void bigint_literal_free(BigInt *b) {
+  free(b);
+}
+
+int bigint_to_int(const BigInt *b, int *value) {
+  if (b->length > 1) return 0;
+  uint32_t magnitude = b->length ? b->limbs[0] : 0;
+  if (b->negative) {
+    if (magnitude > (uint32_t)INT_MAX + 1) return 0;
+    *value = (int)-(int64_t)magnitude;
+  } else {
+    if (magnitude > INT_MAX) return 0;
+    *value = (int)magnitude;
+  }
+  return 1;
+}
+
+double bigint_to_double(const BigInt *b) {
+  int low = b->length > 3 ? b->length - 3 : 0;
+  double d = 0;
+  for (int i = b->length - 1; i >= low; i--) {
+    d = d * 4294967296.0 + b->limbs[i];
+  }
+  d = ldexp(d, 32 * low);
+  return b->negative ? -d : d;
+}
+
+static BigInt *add_signed(const BigInt *a, const BigInt *b, int b_negative) {
+  BigInt *r;
+  if (a->negative == b_negative) {
+    int n = a->length > b->length ? a->length : b->length;
+    r = bigint_make(n + 1);
+    mag_add(r->limbs, a->limbs, a->length, b->limbs, b->length);
+    r->negative = a->negative;
+  } else if (mag_cmp(a->limbs, a->length, b->limbs, b->length) >= 0) {
+    r = bigint_make(a->length);
+    mag_sub(r->limbs, a->limbs, a->length, b->limbs, b->length);
+    r->negative = a->negative;
+  } else {
+    r = bigint_make(b->length);
+    mag_sub(r->limbs, b->limbs, b->length, a->limbs, a->length);
+    r->negative = b_negative;
+  }
+  return normalize(r);
+}
+
+BigInt *bigint_negate(const BigInt *b) {
+  BigInt *r = bigint_make(b->length);
+  memcpy(r->limbs, b->limbs, sizeof(limb_t) * (size_t)b->length);
+  r->negative = !b->negative;
+  return normalize(r);
+}
+
+BigInt *bigint_add(const BigInt *a, const BigInt *b) {
+  return add_signed(a, b, b->negative);
+}
+
+BigInt *bigint_sub(const BigInt *a, const BigInt *b) {
+  return add_signed(a, b, !b->negative);
+}
+
+BigInt *bigint_mul(const BigInt *a, const BigInt *b) {
+  BigInt *r = bigint_make(a->length + b->length);
+  mag_mul(r->limbs, a->limbs, a->length, b->limbs, b->length);
+  r->negative = a->negative != b->negative;
+  return normalize(r);
+}
+
+BigInt *bigint_pow(const BigInt *base, unsigned long exponent) {
+  BigInt *result = bigint_from_int64(1);
+  BigInt *square = bigint_retain((BigInt *)base);
+  while (exponent) {
+    if (exponent & 1) {
+      BigInt *t = bigint_mul(result, square);
+      bigint_release(result);
+      result = t;
+    }
+    exponent >>= 1;
+    if (exponent) {
+      BigInt *t = bigint_mul(square, square);
+      bigint_release(square);
+      square = t;
+    }
+  }
+  bigint_release(square);
+  return result;
+}
+
+int bigint_compare(const BigInt *a, const BigInt *b) {
+  if (a->negative != b->negative) return a->negative ? -1 : 1;
+  int c = mag_cmp(a->limbs, a->length, b->limbs, b->length);
+  return a->negative ? -c : c;
+}
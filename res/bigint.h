@@ -0,0 +1,62 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "heap.h"
+
+/**
+ * Arbitrary-precision integers. The interpreter keeps ints in machine
+ * words and only promotes a result to a BigInt when it overflows; results
+ * that fit again are demoted, so a BigInt value never fits in an int.
+ *
+ * BigInts are immutable and reference counted like strings (strval.h):
+ * every function returning a BigInt returns a new reference, arguments
+ * are borrowed. Magnitudes are 32-bit limbs, least significant first.
+ * Products of long operands use Karatsuba multiplication, powers use
+ * squaring, and bigint_to_string() converts by divide and conquer with
+ * Newton reciprocals, so printing a huge number is sub-quadratic.
+ */
+
+typedef struct BigInt {
+  int refs;             // 0 for a literal, which is never reference counted
+  int negative;
+  int length;           // Limbs in use; the most significant one is nonzero
+  int size;             // Bytes allocated for it
+  HeapAccount *account; // Charged with size (see heap.h)
+  uint32_t limbs[];
+} BigInt;
+
+BigInt *bigint_from_int64(int64_t value);
+BigInt *bigint_from_string(const char *digits);   // Decimal digits, no sign
+
+BigInt *bigint_retain(BigInt *b);
+void bigint_release(BigInt *b);
+
+/**
+ * A copy of b owned by an AST node. Evaluations on any number of threads
+ * hand it out as a value without touching it, so it is not reference
+ * counted and not part of the heap; free it with bigint_literal_free().
+ */
+BigInt *bigint_literal(const BigInt *b);
+void bigint_literal_free(BigInt *b);
+
+// Store b in *value and return 1 if it fits in an int
+int bigint_to_int(const BigInt *b, int *value);
+
+// Closest double (+-inf beyond its range)
+double bigint_to_double(const BigInt *b);
+
+BigInt *bigint_negate(const BigInt *b);
+BigInt *bigint_add(const BigInt *a, const BigInt *b);
+BigInt *bigint_sub(const BigInt *a, const BigInt *b);
+BigInt *bigint_mul(const BigInt *a, const BigInt *b);
+BigInt *bigint_pow(const BigInt *base, unsigned long exponent);
+
+// -1, 0 or 1 like a numeric comparison
+int bigint_compare(const BigInt *a, const BigInt *b);
+
+// Decimal digits with a leading '-' if negative (malloc'd)
+char *bigint_to_string(const BigInt *b);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "common_lib.h"
+#include "breeze.h"
+#include "task.h"
+#include "module.h"
+
+// A compiled program is just the AST produced by one parse
+struct BreezeProgram {
+    astnode_t *root;
+};
+
+void breeze_set_io(BreezeContext *ctx, FILE *in, FILE *out, FILE *err) {
+    ctx->in = in;
+    ctx->out = out;
+    ctx->err = err;
+}
+
+void breeze_set_max_heap(BreezeContext *ctx, size_t bytes) {
+    ctx->max_heap = bytes;
+}
+
+void breeze_set_max_depth(BreezeContext *ctx, int depth) {
+    ctx->max_depth = depth > 0 ? depth : BREEZE_MAX_DEPTH;
+}
+
+void breeze_set_max_ops(BreezeContext *ctx, long long ops) {
+    ctx->governor.max_ops = ops > 0 ? ops : 0;
+}
+
+void breeze_set_timeout(BreezeContext *ctx, double seconds) {
+    ctx->governor.max_seconds = seconds > 0 ? seconds : 0;
+}
+
+BreezeProgram *breeze_compile(const char *source, size_t length,
+                              char *error, size_t error_size) {
+    BreezeContext *ctx = breeze_context_new();
+    ctx->err = NULL;
+
+    // Grammar actions report some errors through breeze_error
+    jmp_buf recover;
+    volatile int status = 1;
+    ctx->error_jmp = &recover;
+    if (setjmp(recover) == 0) {
+        status = breeze_parse_buffer(ctx, source, length);
+    }
+    ctx->error_jmp = NULL;
+
+    if (status != 0 || !ctx->root_ast) {
+        if (error && error_size > 0) {
+            snprintf(error, error_size, "%s", ctx->error[0] ? ctx->error : "Parsing failed.");
+        }
+        breeze_context_free(ctx);
+        return NULL;
+    }
+
+    BreezeProgram *program = malloc(sizeof(BreezeProgram));
+    if (!program) {
+        fprintf(stderr, "Error: Memory allocation for BreezeProgram failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Take the AST over so freeing the parse context leaves it alive
+    program->root = ctx->root_ast;
+    ctx->root_ast = NULL;
+    breeze_context_free(ctx);
+    return program;
+}
+
+void breeze_program_free(BreezeProgram *program) {
+    if (!program) return;
+    free_ast(program->root);
+    free(program);
+}
+
+void breeze_reset(BreezeContext *ctx) {
+    while (ctx->current_scope) {
+        pop_scope(ctx);
+    }
+    init_scopes(ctx);
+    module_forget(ctx);
+    ctx->error[0] = '\0';
+}
+
+void breeze_set_int(BreezeContext *ctx, const char *name, int value) {
+    put_symbol_int(ctx, name, value);
+}
+
+void breeze_set_float(BreezeContext *ctx, const char *name, float value) {
+    put_symbol_float(ctx, name, value);
+}
+
+void breeze_set_bool(BreezeContext *ctx, const char *name, int value) {
+    put_symbol_bool(ctx, name, value);
+}
+
+void breeze_set_string(BreezeContext *ctx, const char *name, const char *value) {
+    String *s = string_new(value);
+    put_symbol_string(ctx, name, s);
+    string_release(s);
+}
+
+typedef struct {
+    const BreezeProgram *program;
+    int status;
+} RunJob;
+
+static void run_program(BreezeContext *ctx, void *data) {
+    RunJob *job = data;
+    Scope *global = ctx->current_scope;
+    jmp_buf *outer = ctx->error_jmp;
+    jmp_buf recover;
+
+    ctx->error[0] = '\0';
+    ctx->error_jmp = &recover;
+    ctx->limit_exceeded = 0;
+    if (setjmp(recover) != 0) {
+        // Discard the scopes of the calls that were active when it failed
+        while (ctx->current_scope && ctx->current_scope != global) {
+            pop_scope(ctx);
+        }
+        ctx->loop = NULL;
+        ctx->foreach = NULL;
+        ctx->generator = NULL;
+        ctx->module = NULL;
+        task_discard_all(ctx);
+        ctx->depth = 0;
+        ctx->function = NULL;
+        ctx->args = NULL;
+        ctx->error_jmp = outer;
+        job->status = ctx->limit_exceeded ? BREEZE_LIMIT : -1;
+        return;
+    }
+
+    evaluate_ast(ctx, job->program->root);
+    task_wait_all(ctx);
+    ctx->error_jmp = outer;
+    job->status = 0;
+}
+
+int breeze_run(BreezeContext *ctx, const BreezeProgram *program) {
+    RunJob job = { program, -1 };
+    // run_program's setjmp has to be on the stack that evaluates
+    breeze_with_stack(ctx, run_program, &job);
+    return job.status;
+}
+
+// Find a global variable of the requested type, or NULL
+static SymbolNode *lookup_typed(BreezeContext *ctx, const char *name, ValueType type) {
+    SymbolNode *sym = lookup_symbol(ctx, name);
+    return (sym && sym->type == type) ? sym : NULL;
+}
+
+int breeze_get_int(BreezeContext *ctx, const char *name, int *value) {
+    SymbolNode *sym = lookup_typed(ctx, name, TYPE_INT);
+    if (!sym) return -1;
+    *value = sym->data.int_val;
+    return 0;
+}
+
+int breeze_get_float(BreezeContext *ctx, const char *name, float *value) {
+    SymbolNode *sym = lookup_typed(ctx, name, TYPE_FLOAT);
+    if (!sym) return -1;
+    *value = sym->data.float_val;
+    return 0;
+}
+
+int breeze_get_bool(BreezeContext *ctx, const char *name, int *value) {
+    SymbolNode *sym = lookup_typed(ctx, name, TYPE_BOOL);
+    if (!sym) return -1;
+    *value = sym->data.bool_val;
+    return 0;
+}
+
+const char *breeze_get_string(BreezeContext *ctx, const char *name) {
+    SymbolNode *sym = lookup_typed(ctx, name, TYPE_STRING);
+    return sym ? string_cstr(sym->data.string_val) : NULL;
+}
+
+const char *breeze_last_error(const BreezeContext *ctx) {
+    return ctx->error;
+}
@@ -0,0 +1,122 @@
+#ifndef BREEZE_H
+#define BREEZE_H
+
+/**
+ * libbreeze: embedding API for the BreezeLang interpreter.
+ *
+ * A script is compiled once into a BreezeProgram, which can then be run
+ * any number of times on a BreezeContext without being parsed again:
+ *
+ *   BreezeProgram *prog = breeze_compile(src, strlen(src), err, sizeof(err));
+ *   BreezeContext *ctx = breeze_context_new();
+ *   breeze_set_io(ctx, NULL, NULL, NULL);
+ *   for (each request) {
+ *       breeze_reset(ctx);
+ *       breeze_set_int(ctx, "n", request_n);
+ *       if (breeze_run(ctx, prog) == 0) breeze_get_int(ctx, "result", &result);
+ *   }
+ *
+ * One program can be shared by several contexts, each used from its own
+ * thread. Runs only read it: string and big integer literals are static
+ * rather than reference counted, and everything else a run keeps (JIT
+ * code, loop caches, heap use) belongs to its context. The one exception
+ * is a function body whose parsing was deferred (lazy.h): the first call
+ * parses it under a lock and publishes it to the other threads.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define BREEZE_API __attribute__((visibility("default")))
+
+typedef struct BreezeContext BreezeContext;
+typedef struct BreezeProgram BreezeProgram;
+
+// Result of breeze_run, and exit status of the interpreter, for a run stopped by a limit
+#define BREEZE_LIMIT (-2)
+#define BREEZE_EXIT_LIMIT 3
+
+// Create a context with an empty global scope, reading stdin and writing stdout.
+BREEZE_API BreezeContext *breeze_context_new(void);
+
+// Release the context and every variable it still holds.
+BREEZE_API void breeze_context_free(BreezeContext *ctx);
+
+/**
+ * Redirect the streams used by `what? ->`, `print` and error reporting.
+ * Passing NULL disables the stream: reads fail, prints and diagnostics
+ * are discarded (the last error is still available via breeze_last_error).
+ */
+BREEZE_API void breeze_set_io(BreezeContext *ctx, FILE *in, FILE *out, FILE *err);
+
+/**
+ * Fail a run with a runtime error once the strings and big integers it
+ * holds exceed `bytes` (0: no limit). Only values allocated by this
+ * context count, not those of contexts running on other threads.
+ */
+BREEZE_API void breeze_set_max_heap(BreezeContext *ctx, size_t bytes);
+
+/**
+ * Fail a run with "stack overflow at function X" once script calls nest
+ * deeper than `depth` (<= 0: the default of 100000). Runs get a stack
+ * sized for it, and memory grows only with the calls actually active.
+ */
+BREEZE_API void breeze_set_max_depth(BreezeContext *ctx, int depth);
+
+/**
+ * Stop a run once it has performed `ops` operations (0: no limit). Each
+ * loop iteration and each script function call counts as one.
+ */
+BREEZE_API void breeze_set_max_ops(BreezeContext *ctx, long long ops);
+
+/**
+ * Stop a run once it has taken `seconds` of wall-clock time (0: no limit).
+ * The clock is checked every few thousand operations.
+ */
+BREEZE_API void breeze_set_timeout(BreezeContext *ctx, double seconds);
+
+/**
+ * Parse a source buffer into a reusable program.
+ * Returns NULL on a syntax error, with the message copied to `error`
+ * (if non-NULL) truncated to `error_size` bytes.
+ */
+BREEZE_API BreezeProgram *breeze_compile(const char *source, size_t length,
+                                         char *error, size_t error_size);
+BREEZE_API void breeze_program_free(BreezeProgram *program);
+
+/**
+ * Drop every global (variables and function definitions) so the context
+ * can start a fresh run. Call it before setting the inputs of a run.
+ */
+BREEZE_API void breeze_reset(BreezeContext *ctx);
+
+// Define input variables in the global scope before breeze_run.
+BREEZE_API void breeze_set_int(BreezeContext *ctx, const char *name, int value);
+BREEZE_API void breeze_set_float(BreezeContext *ctx, const char *name, float value);
+BREEZE_API void breeze_set_bool(BreezeContext *ctx, const char *name, int value);
+BREEZE_API void breeze_set_string(BreezeContext *ctx, const char *name, const char *value);
+
+/**
+ * Execute a compiled program against the context's globals.
+ * Returns 0 on success, -1 on a runtime error, or BREEZE_LIMIT when the
+ * run exceeded its operation, time, heap or depth limit (see
+ * breeze_last_error for the message).
+ * Runtime errors never terminate the host process.
+ */
+BREEZE_API int breeze_run(BreezeContext *ctx, const BreezeProgram *program);
+
+/**
+ * Read a global variable after a run. The getters return 0 and store the
+ * value if the variable exists with that type, -1 otherwise.
+ * breeze_get_string returns NULL on a miss; the string stays owned by
+ * the context and is valid until the variable changes or is reset.
+ */
+BREEZE_API int breeze_get_int(BreezeContext *ctx, const char *name, int *value);
+BREEZE_API int breeze_get_float(BreezeContext *ctx, const char *name, float *value);
+BREEZE_API int breeze_get_bool(BreezeContext *ctx, const char *name, int *value);
+BREEZE_API const char *breeze_get_string(BreezeContext *ctx, const char *name);
+
+// Message of the last parse or runtime error ("" if none).
+BREEZE_API const char *breeze_last_error(const BreezeContext *ctx);
+
+#endif
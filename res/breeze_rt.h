@@ -0,0 +1,613 @@
+#ifndef BREEZE_RT_H
+#define BREEZE_RT_H
+
+/**
+ * Runtime for C programs generated with --emit-c (see emit_c.h).
+ *
+ * Header-only, so a generated program builds with nothing but this file:
+ *
+ *   BreezeLangCompiler --emit-c out.c script.bl
+ *   gcc -O2 -I res out.c -o script -lm
+ *
+ * The emitter uses native C types wherever the type of a value is known
+ * statically and falls back to BzValue and the generic operations below
+ * otherwise. Each of them reproduces the matching case of evaluate_expr
+ * and evaluate_ast in ast.c, error messages included, so a compiled
+ * script prints exactly what the interpreter prints.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+
+#define BZ_ERROR_MAX 256
+
+// Generated programs use only part of the runtime
+#define BZ_FN static __attribute__((unused))
+
+/**
+ * Ints outgrow a machine word as they do in the interpreter: a result
+ * that overflows becomes a bignum, and one that fits again is an int.
+ * Native int variables are BzInt, 64 bits wide: a value in the int range
+ * is that int, anything else is a BzBig pointer with the top bit set, so
+ * ints stay plain integers and pay one range check per operation.
+ * Bignums, like strings, are never freed.
+ */
+typedef int64_t BzInt;
+
+typedef struct {
+  int negative;
+  int length;         // Limbs in use; the most significant one is nonzero
+  uint32_t *limbs;    // Least significant first
+} BzBig;
+
+#define BZ_BIG_TAG (UINT64_C(1) << 63)
+
+// Same order as ValueType in symtab.h; BZ_UNSET marks a variable never assigned
+typedef enum { BZ_FLOAT, BZ_INT, BZ_STRING, BZ_BOOL, BZ_UNSET, BZ_BIG } BzType;
+
+typedef struct {
+  BzType type;
+  union {
+    float f;
+    int i;          // ints and bools
+    const char *s;  // strings are immutable once created
+    const BzBig *b;
+  } v;
+} BzValue;
+
+#define BZ_UNSET_VALUE { BZ_UNSET, { 0 } }
+
+typedef enum { BZ_OP_AND, BZ_OP_OR, BZ_OP_EQ, BZ_OP_NEQ, BZ_OP_LT, BZ_OP_LE, BZ_OP_GT, BZ_OP_GE } BzOp;
+
+/**
+ * Variables of one active scope, for programs that rely on dynamic
+ * scoping (a function reading a variable of its caller). Frames form
+ * the same chain as the interpreter's scope stack, globals at the bottom.
+ */
+typedef struct BzFrame {
+  struct BzFrame *parent;
+  int count;
+  const char *const *names;
+  BzValue *slots;
+} BzFrame;
+
+static BzFrame *bz_frame __attribute__((unused));
+
+// ----------- ERRORS AND CONSTRUCTORS -----------
+
+__attribute__((noreturn, format(printf, 1, 2), unused))
+static void bz_error(const char *fmt, ...) {
+  char message[BZ_ERROR_MAX];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  fputs(message, stderr);
+  exit(EXIT_FAILURE);
+}
+
+static inline BzValue bz_int(int i)            { BzValue v; v.type = BZ_INT;    v.v.i = i; return v; }
+static inline BzValue bz_float(float f)        { BzValue v; v.type = BZ_FLOAT;  v.v.f = f; return v; }
+static inline BzValue bz_bool(int b)           { BzValue v; v.type = BZ_BOOL;   v.v.i = b; return v; }
+static inline BzValue bz_string(const char *s) { BzValue v; v.type = BZ_STRING; v.v.s = s; return v; }
+
+static inline int bz_bits(float f) {
+  int i;
+  memcpy(&i, &f, sizeof(i));
+  return i;
+}
+
+// ----------- INTEGERS -----------
+
+static inline int bz_small(BzInt x) { return x == (int)x; }
+
+static inline const BzBig *bz_big(BzInt x) {
+  return (const BzBig *)(uintptr_t)((uint64_t)x & ~BZ_BIG_TAG);
+}
+
+BZ_FN BzBig *bz_big_new(int length) {
+  BzBig *b = malloc(sizeof(BzBig) + sizeof(uint32_t) * (size_t)(length > 0 ? length : 1));
+  if (!b) bz_error("Error: Memory allocation failed for an integer.\n");
+  b->negative = 0;
+  b->length = length;
+  b->limbs = (uint32_t *)(b + 1);
+  return b;
+}
+
+// Trim b and return it, or the int it equals (create_bigint_value() from ast.c)
+BZ_FN BzInt bz_big_result(BzBig *b) {
+  while (b->length > 0 && b->limbs[b->length - 1] == 0) b->length--;
+  if (b->length <= 1) {
+    int64_t magnitude = b->length ? b->limbs[0] : 0;
+    int64_t value = b->negative ? -magnitude : magnitude;
+    if (bz_small(value)) {
+      free(b);
+      return value;
+    }
+  }
+  return (BzInt)((uint64_t)(uintptr_t)b | BZ_BIG_TAG);
+}
+
+// x as a bignum, spelling out an int in the caller's room
+static inline const BzBig *bz_big_view(BzInt x, BzBig *room, uint32_t limbs[2]) {
+  if (!bz_small(x)) return bz_big(x);
+  uint64_t magnitude = x < 0 ? -(uint64_t)x : (uint64_t)x;
+  limbs[0] = (uint32_t)magnitude;
+  limbs[1] = (uint32_t)(magnitude >> 32);
+  room->negative = x < 0;
+  room->length = limbs[1] ? 2 : limbs[0] ? 1 : 0;
+  room->limbs = limbs;
+  return room;
+}
+
+static inline int bz_mag_cmp(const BzBig *a, const BzBig *b) {
+  if (a->length != b->length) return a->length < b->length ? -1 : 1;
+  for (int i = a->length - 1; i >= 0; i--) {
+    if (a->limbs[i] != b->limbs[i]) return a->limbs[i] < b->limbs[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+// a + b, with b's sign taken as b_negative
+BZ_FN BzInt bz_big_add_signed(const BzBig *a, const BzBig *b, int b_negative) {
+  const BzBig *x = a, *y = b;
+  int x_negative = a->negative, y_negative = b_negative;
+  if (bz_mag_cmp(a, b) < 0) {
+    x = b;
+    y = a;
+    x_negative = b_negative;
+    y_negative = a->negative;
+  }
+  BzBig *r = bz_big_new(x->length + 1);
+  uint64_t carry = 0;
+  for (int i = 0; i < x->length; i++) {
+    uint64_t yi = i < y->length ? y->limbs[i] : 0;
+    if (x_negative == y_negative) {
+      carry += x->limbs[i] + yi;
+      r->limbs[i] = (uint32_t)carry;
+      carry >>= 32;
+    } else {
+      uint64_t d = x->limbs[i] - yi - carry;
+      r->limbs[i] = (uint32_t)d;
+      carry = (d >> 32) & 1;
+    }
+  }
+  r->limbs[x->length] = x_negative == y_negative ? (uint32_t)carry : 0;
+  r->negative = x_negative;
+  return bz_big_result(r);
+}
+
+BZ_FN BzInt bz_big_mul(const BzBig *a, const BzBig *b) {
+  BzBig *r = bz_big_new(a->length + b->length);
+  memset(r->limbs, 0, sizeof(uint32_t) * (size_t)r->length);
+  for (int i = 0; i < a->length; i++) {
+    uint64_t carry = 0;
+    for (int j = 0; j < b->length; j++) {
+      carry += (uint64_t)a->limbs[i] * b->limbs[j] + r->limbs[i + j];
+      r->limbs[i + j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    r->limbs[i + b->length] = (uint32_t)carry;
+  }
+  r->negative = a->negative != b->negative;
+  return bz_big_result(r);
+}
+
+// The exact a + b, a - b or a * b once a bignum is involved or an int overflowed
+BZ_FN BzInt bz_big_arith(char op, BzInt a, BzInt b) {
+  BzBig a_room, b_room;
+  uint32_t a_limbs[2], b_limbs[2];
+  const BzBig *x = bz_big_view(a, &a_room, a_limbs);
+  const BzBig *y = bz_big_view(b, &b_room, b_limbs);
+  if (op == '*') return bz_big_mul(x, y);
+  return bz_big_add_signed(x, y, op == '+' ? y->negative : !y->negative);
+}
+
+// -1, 0 or 1 by numeric value
+BZ_FN int bz_big_order(BzInt a, BzInt b) {
+  BzBig a_room, b_room;
+  uint32_t a_limbs[2], b_limbs[2];
+  const BzBig *x = bz_big_view(a, &a_room, a_limbs);
+  const BzBig *y = bz_big_view(b, &b_room, b_limbs);
+  if (x->negative != y->negative) return x->negative ? -1 : 1;
+  int order = bz_mag_cmp(x, y);
+  return x->negative ? -order : order;
+}
+
+// bigint_to_double() from bigint.c: the top three limbs, scaled
+BZ_FN double bz_big_to_double(const BzBig *b) {
+  int low = b->length > 3 ? b->length - 3 : 0;
+  double d = 0;
+  for (int i = b->length - 1; i >= low; i--) {
+    d = d * 4294967296.0 + b->limbs[i];
+  }
+  d = ldexp(d, 32 * low);
+  return b->negative ? -d : d;
+}
+
+// A literal beyond an int, as decimal digits
+BZ_FN BzInt bz_big_digits(const char *digits) {
+  int negative = *digits == '-';
+  if (negative) digits++;
+  BzBig *b = bz_big_new((int)strlen(digits) / 9 + 2);
+  b->length = 0;
+  for (const char *p = digits; *p; p++) {
+    uint64_t carry = (uint64_t)(*p - '0');
+    for (int i = 0; i < b->length; i++) {
+      carry += (uint64_t)b->limbs[i] * 10;
+      b->limbs[i] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    if (carry) b->limbs[b->length++] = (uint32_t)carry;
+  }
+  b->negative = negative;
+  return bz_big_result(b);
+}
+
+// If a and the result are ints, so was b: no bignum lies within 2^32 of an int
+static inline BzInt bz_iadd(BzInt a, BzInt b) {
+  BzInt result = (BzInt)((uint64_t)a + (uint64_t)b);
+  if (bz_small(a) && bz_small(result)) return result;
+  return bz_big_arith('+', a, b);
+}
+static inline BzInt bz_isub(BzInt a, BzInt b) {
+  BzInt result = (BzInt)((uint64_t)a - (uint64_t)b);
+  if (bz_small(a) && bz_small(result)) return result;
+  return bz_big_arith('-', a, b);
+}
+static inline BzInt bz_imul(BzInt a, BzInt b) {
+  int result;
+  if (bz_small(a) && bz_small(b) && !__builtin_mul_overflow((int)a, (int)b, &result)) return result;
+  return bz_big_arith('*', a, b);
+}
+// By squaring, for exponent >= 0; exact like power_values() in ast.c
+BZ_FN BzInt bz_ipow(BzInt base, int exponent) {
+  BzInt result = 1;
+  while (exponent) {
+    if (exponent & 1) result = bz_imul(result, base);
+    exponent >>= 1;
+    if (exponent) base = bz_imul(base, base);
+  }
+  return result;
+}
+static inline float bz_pow(float base, float exponent) { return pow(base, exponent); }
+
+// Comparisons and logic on ints, bools and bignums (a bignum is never 0)
+static inline int bz_icmp(BzOp op, BzInt a, BzInt b) {
+  if (op == BZ_OP_AND) return a && b;
+  if (op == BZ_OP_OR) return a || b;
+  int order = bz_small(a) && bz_small(b) ? (a > b) - (a < b) : bz_big_order(a, b);
+  switch (op) {
+    case BZ_OP_EQ:  return order == 0;
+    case BZ_OP_NEQ: return order != 0;
+    case BZ_OP_LT:  return order < 0;
+    case BZ_OP_LE:  return order <= 0;
+    case BZ_OP_GT:  return order > 0;
+    default:        return order >= 0;
+  }
+}
+
+static inline float bz_ifloat(BzInt x) {
+  return bz_small(x) ? (float)(int)x : (float)bz_big_to_double(bz_big(x));
+}
+
+// The int the interpreter reads from a value that may be a bignum (only its sign matters)
+static inline int bz_ipayload(BzInt x) {
+  if (bz_small(x)) return (int)x;
+  return bz_big(x)->negative ? INT_MIN : INT_MAX;
+}
+
+static inline BzValue bz_box_int(BzInt x) {
+  if (bz_small(x)) return bz_int((int)x);
+  BzValue v;
+  v.type = BZ_BIG;
+  v.v.b = bz_big(x);
+  return v;
+}
+
+static inline BzInt bz_unbox_int(BzValue v) {
+  if (v.type == BZ_BIG) return (BzInt)((uint64_t)(uintptr_t)v.v.b | BZ_BIG_TAG);
+  return v.v.i;
+}
+
+// The int the interpreter sees when it reads Value.data.int_val
+static inline int bz_payload(BzValue v) {
+  switch (v.type) {
+    case BZ_FLOAT:  return bz_bits(v.v.f);
+    case BZ_STRING: return (int)(uint32_t)(uintptr_t)v.v.s;
+    case BZ_BIG:    return bz_ipayload(bz_unbox_int(v));
+    default:        return v.v.i;
+  }
+}
+
+static inline float bz_to_float(BzValue v) {
+  if (v.type == BZ_BIG) return (float)bz_big_to_double(v.v.b);
+  return v.type == BZ_FLOAT ? v.v.f : (float)v.v.i;
+}
+
+// ----------- STRINGS -----------
+
+// process_escapes() from ast.c
+BZ_FN char *bz_escapes(const char *input) {
+  char *output = malloc(strlen(input) + 1);
+  char *dest = output;
+  if (!output) bz_error("Error: Memory allocation failed.\n");
+
+  while (*input) {
+    if (*input == '\\') {
+      input++;
+      switch (*input) {
+        case 'n': *dest++ = '\n'; break;
+        case 't': *dest++ = '\t'; break;
+        case '\\': *dest++ = '\\'; break;
+        case '"': *dest++ = '"'; break;
+        default:
+          fprintf(stderr, "Warning: Unknown escape \\%c\n", *input);
+          *dest++ = *input;
+          if (!*input) {
+            *dest = '\0';
+            return output;
+          }
+      }
+    } else {
+      *dest++ = *input;
+    }
+    input++;
+  }
+  *dest = '\0';
+  return output;
+}
+
+/**
+ * create_str_value() from ast.c: the interpreter runs every string it
+ * reads through it, stripping surrounding quotes and processing escapes.
+ * Strings with neither are returned as they are, without copying.
+ */
+BZ_FN const char *bz_str_value(const char *s) {
+  size_t length = strlen(s);
+  int quoted = length > 0 && s[0] == '"' && s[length - 1] == '"';
+  if (!quoted && !strchr(s, '\\')) return s;
+  if (!quoted) return bz_escapes(s);
+  if (length < 2) return "";
+
+  char *inner = strdup(s + 1);
+  inner[length - 2] = '\0';
+  char *result = bz_escapes(inner);
+  free(inner);
+  return result;
+}
+
+BZ_FN const char *bz_read(void) {
+  char buffer[256];
+  printf("What do you want this time? ...\n");
+  fflush(stdout);
+  if (!fgets(buffer, sizeof(buffer), stdin)) {
+    bz_error("Error reading input.\n");
+  }
+  char *newline = strchr(buffer, '\n');
+  if (newline) *newline = '\0';
+  return strdup(buffer);
+}
+
+// NODE_INDEX and NODE_STRLEN read the variable itself, not a processed copy
+static inline const char *bz_indexed(const char *name, BzValue var) {
+  if (var.type == BZ_UNSET) bz_error("Error: Undefined variable '%s'\n", name);
+  if (var.type != BZ_STRING) bz_error("Error: indexing is only supported on strings for now.\n");
+  return var.v.s;
+}
+
+static inline int bz_check_index(const char *s, int index) {
+  int length = strlen(s);
+  if (index < 0 || index >= length) {
+    bz_error("Error: string index %d out of range (length %d).\n", index, length);
+  }
+  return index;
+}
+
+BZ_FN const char *bz_char_at(const char *s, int index) {
+  char single[2] = { s[index], '\0' };
+  const char *result = bz_str_value(single);
+  return result == single ? strdup(single) : result;
+}
+
+BZ_FN const char *bz_slice(const char *s, int start, int end) {
+  bz_check_index(s, end);
+  if (start > end) {
+    bz_error("Error: slice val 1 '%d' shouldn't be greater than slice val 2 '%d'\n", start, end);
+  }
+  int length = end - start + 1;
+  char *slice = malloc(length + 1);
+  if (!slice) bz_error("Error: Memory allocation failed.\n");
+  memcpy(slice, s + start, length);
+  slice[length] = '\0';
+
+  const char *result = bz_str_value(slice);
+  if (result != slice) free(slice);
+  return result;
+}
+
+static inline int bz_len(const char *name, BzValue var) {
+  if (var.type == BZ_UNSET) bz_error("Error: Undefined variable '%s'\n", name);
+  if (var.type != BZ_STRING) bz_error("Error: Variable '%s' must be of type string!\n", name);
+  return strlen(var.v.s);
+}
+
+// ----------- VARIABLES -----------
+
+static inline BzValue bz_get(const char *name, BzValue var) {
+  if (var.type == BZ_UNSET) bz_error("Error: Undefined variable '%s'\n", name);
+  return var;
+}
+
+// Reading a variable through NODE_ID also processes strings
+static inline BzValue bz_load(BzValue var) {
+  if (var.type == BZ_STRING) var.v.s = bz_str_value(var.v.s);
+  return var;
+}
+
+// lookup_symbol(): innermost frame first, unset slots are not defined yet
+BZ_FN BzValue bz_lookup(const char *name) {
+  for (BzFrame *frame = bz_frame; frame; frame = frame->parent) {
+    for (int i = 0; i < frame->count; i++) {
+      if (frame->slots[i].type != BZ_UNSET && strcmp(frame->names[i], name) == 0) {
+        return frame->slots[i];
+      }
+    }
+  }
+  bz_error("Error: Undefined variable '%s'\n", name);
+}
+
+// ----------- GENERIC OPERATIONS -----------
+
+BZ_FN BzValue bz_add(BzValue a, BzValue b) {
+  if (a.type == BZ_STRING || b.type == BZ_STRING) bz_error("Error: Cannot add string values\n");
+  if (a.type == BZ_FLOAT || b.type == BZ_FLOAT) return bz_float(bz_to_float(a) + bz_to_float(b));
+  if ((a.type == BZ_INT || a.type == BZ_BIG) && (b.type == BZ_INT || b.type == BZ_BIG)) {
+    return bz_box_int(bz_iadd(bz_unbox_int(a), bz_unbox_int(b)));
+  }
+  bz_error("Error: Invalid types for addition\n");
+}
+
+BZ_FN BzValue bz_sub(BzValue a, BzValue b) {
+  if (a.type == BZ_STRING || b.type == BZ_STRING) bz_error("Error: Cannot subtract string values\n");
+  if (a.type == BZ_FLOAT || b.type == BZ_FLOAT) return bz_float(bz_to_float(a) - bz_to_float(b));
+  return bz_box_int(bz_isub(bz_unbox_int(a), bz_unbox_int(b)));
+}
+
+BZ_FN BzValue bz_mul(BzValue a, BzValue b) {
+  if (a.type == BZ_STRING || b.type == BZ_STRING) bz_error("Error: Cannot multiply string values\n");
+  if (a.type == BZ_FLOAT || b.type == BZ_FLOAT) return bz_float(bz_to_float(a) * bz_to_float(b));
+  return bz_box_int(bz_imul(bz_unbox_int(a), bz_unbox_int(b)));
+}
+
+__attribute__((noreturn, unused))
+static void bz_division_by_zero(void) {
+  bz_error("Error: Division by zero\n");
+}
+
+BZ_FN BzValue bz_div(BzValue a, BzValue b) {
+  if (a.type == BZ_STRING || b.type == BZ_STRING) bz_error("Error: Cannot divide string values\n");
+  // With a bignum operand a false divisor counts as zero too (bigint_arith() in ast.c)
+  int big = a.type == BZ_BIG || b.type == BZ_BIG;
+  if ((b.type == BZ_INT && b.v.i == 0) || (b.type == BZ_FLOAT && b.v.f == 0.0) ||
+      (big && b.type == BZ_BOOL && b.v.i == 0)) {
+    bz_division_by_zero();
+  }
+  return bz_float(bz_to_float(a) / bz_to_float(b));
+}
+
+BZ_FN BzValue bz_exp(BzValue a, BzValue b) {
+  if (a.type == BZ_STRING || b.type == BZ_STRING) bz_error("Error: Cannot exponentiate string values\n");
+  if ((a.type == BZ_INT || a.type == BZ_BIG) && b.type == BZ_INT && b.v.i >= 0) {
+    return bz_box_int(bz_ipow(bz_unbox_int(a), b.v.i));
+  }
+  return bz_float(bz_pow(bz_to_float(a), bz_to_float(b)));
+}
+
+// compare_bigint() from ast.c: by numeric value
+BZ_FN int bz_compare_big(BzOp op, BzValue a, BzValue b) {
+  if (op == BZ_OP_AND || op == BZ_OP_OR) {
+    int x = a.type == BZ_BIG || bz_payload(a), y = b.type == BZ_BIG || bz_payload(b);
+    return op == BZ_OP_AND ? x && y : x || y;
+  }
+  int order;
+  if (a.type == BZ_STRING || b.type == BZ_STRING) {
+    if (op == BZ_OP_EQ || op == BZ_OP_NEQ) return op == BZ_OP_NEQ;
+    bz_error("Error: Cannot compare a string with a number\n");
+  } else if (a.type == BZ_FLOAT || b.type == BZ_FLOAT) {
+    double x = a.type == BZ_BIG ? bz_big_to_double(a.v.b) : a.type == BZ_FLOAT ? a.v.f : a.v.i;
+    double y = b.type == BZ_BIG ? bz_big_to_double(b.v.b) : b.type == BZ_FLOAT ? b.v.f : b.v.i;
+    order = (x > y) - (x < y);
+  } else {
+    order = bz_big_order(bz_unbox_int(a), bz_unbox_int(b));
+  }
+  switch (op) {
+    case BZ_OP_EQ:  return order == 0;
+    case BZ_OP_NEQ: return order != 0;
+    case BZ_OP_LT:  return order < 0;
+    case BZ_OP_LE:  return order <= 0;
+    case BZ_OP_GT:  return order > 0;
+    default:        return order >= 0;
+  }
+}
+
+BZ_FN int bz_compare(BzOp op, BzValue a, BzValue b) {
+  if (a.type == BZ_BIG || b.type == BZ_BIG) return bz_compare_big(op, a, b);
+  int both_strings = a.type == BZ_STRING && b.type == BZ_STRING;
+  int x = bz_payload(a), y = bz_payload(b);
+  switch (op) {
+    case BZ_OP_AND: return x && y;
+    case BZ_OP_OR:  return x || y;
+    case BZ_OP_EQ:  return both_strings ? strcmp(a.v.s, b.v.s) == 0 : x == y;
+    case BZ_OP_NEQ: return both_strings ? strcmp(a.v.s, b.v.s) == 1 : x != y;
+    case BZ_OP_LT:  return x < y;
+    case BZ_OP_LE:  return x <= y;
+    case BZ_OP_GT:  return x > y;
+    case BZ_OP_GE:  return x >= y;
+  }
+  return 0;
+}
+
+static inline int bz_cond(BzValue v, const char *error) {
+  if (v.type != BZ_BOOL) bz_error("%s", error);
+  return v.v.i != 0;
+}
+
+// ----------- OUTPUT -----------
+
+// Decimal digits of a bignum, nine at a time by repeated division
+BZ_FN void bz_print_big(const BzBig *b) {
+  int n = b->length;
+  uint32_t *work = malloc(sizeof(uint32_t) * (size_t)n);
+  uint32_t *chunks = malloc(sizeof(uint32_t) * (size_t)(2 * n + 1));
+  if (!work || !chunks) bz_error("Error: Memory allocation failed.\n");
+  memcpy(work, b->limbs, sizeof(uint32_t) * (size_t)n);
+  int count = 0;
+  do {
+    uint64_t rest = 0;
+    for (int i = n - 1; i >= 0; i--) {
+      uint64_t current = rest << 32 | work[i];
+      work[i] = (uint32_t)(current / 1000000000);
+      rest = current % 1000000000;
+    }
+    chunks[count++] = (uint32_t)rest;
+    while (n > 0 && work[n - 1] == 0) n--;
+  } while (n > 0);
+  if (b->negative) putchar('-');
+  printf("%u", (unsigned)chunks[count - 1]);
+  for (int i = count - 2; i >= 0; i--) printf("%09u", (unsigned)chunks[i]);
+  free(work);
+  free(chunks);
+}
+
+static inline void bz_print_int(BzInt i) {
+  if (bz_small(i)) printf("%d", (int)i);
+  else bz_print_big(bz_big(i));
+}
+static inline void bz_print_float(float f)        { printf("%f", f); }
+static inline void bz_print_bool(int b)           { fputs(b ? "true" : "false", stdout); }
+static inline void bz_print_str(const char *s)    { fputs(s, stdout); }
+
+BZ_FN void bz_print(BzValue v) {
+  switch (v.type) {
+    case BZ_STRING: bz_print_str(v.v.s);   break;
+    case BZ_FLOAT:  bz_print_float(v.v.f); break;
+    case BZ_INT:    bz_print_int(v.v.i);   break;
+    case BZ_BIG:    bz_print_big(v.v.b);   break;
+    case BZ_BOOL:   bz_print_bool(v.v.i);  break;
+    default:        break;
+  }
+}
+
+// The interpreter reports a successful parse before running the script
+static inline void bz_start(void) {
+  printf("Parsing completed successfully.\n");
+  printf("\nBreezeLang script output: \n");
+}
+
+#endif
@@ -9,5 +9,6 @@
 #include "ast.h"
 #include "symtab.h"
 #include "scope.h"
+#include "context.h"
 
 #endif
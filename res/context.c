@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include "common_lib.h"
+#include "parser.tab.h"
+#include "jit.h"
+#include "loopopt.h"
+#include "typeinfer.h"
+#include "task.h"
+#include "module.h"
+#include "inline.h"
+#include "parallel.h"
+#include "coroutine.h"
+
+// Reentrant scanner API generated by flex (%option reentrant)
+int yylex_init_extra(BreezeContext *extra, yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+void yyset_in(FILE *in, yyscan_t scanner);
+void yyset_lineno(int line_number, yyscan_t scanner);
+void *yy_scan_bytes(const char *bytes, int length, yyscan_t scanner);
+void yy_delete_buffer(void *buffer, yyscan_t scanner);
+
+BreezeContext *breeze_context_new(void) {
+    BreezeContext *ctx = calloc(1, sizeof(BreezeContext));
+    if (!ctx) {
+        fprintf(stderr, "Error: Memory allocation for BreezeContext failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (yylex_init_extra(ctx, &ctx->scanner) != 0) {
+        fprintf(stderr, "Error: Could not initialize the scanner.\n");
+        exit(EXIT_FAILURE);
+    }
+    ctx->in = stdin;
+    ctx->out = stdout;
+    ctx->err = stderr;
+    ctx->max_depth = BREEZE_MAX_DEPTH;
+    ctx->inline_size = INLINE_DEFAULT_SIZE;
+    init_scopes(ctx);
+    return ctx;
+}
+
+void breeze_context_free(BreezeContext *ctx) {
+    if (!ctx) return;
+
+    free_scopes(ctx);
+    module_forget(ctx);
+    free_ast(ctx->root_ast);
+    jit_free(ctx->jit);
+    yylex_destroy(ctx->scanner);
+    if (ctx->stack) coroutine_stack_free(ctx->stack, ctx->stack_size);
+    free(ctx);
+}
+
+// The rest of a file (malloc'd; NULL on a read error)
+static char *read_all(FILE *in, size_t *length) {
+    size_t size = 64 * 1024;
+    char *source = malloc(size);
+    *length = 0;
+    while (source) {
+        *length += fread(source + *length, 1, size - *length, in);
+        if (*length < size) break;
+        size *= 2;
+        char *bigger = realloc(source, size);
+        if (!bigger) free(source);
+        source = bigger;
+    }
+    if (source && ferror(in)) {
+        free(source);
+        source = NULL;
+    }
+    return source;
+}
+
+int breeze_parse_file(BreezeContext *ctx, FILE *in) {
+    if (ctx->parse_jobs != 1) {
+        // Chunks of the script go to different threads, so it must all be at hand
+        size_t length;
+        char *source = read_all(in, &length);
+        if (!source) {
+            snprintf(ctx->error, sizeof(ctx->error), "Error: Could not read the script.");
+            if (ctx->err) {
+                fprintf(ctx->err, "%s\n", ctx->error);
+            }
+            return 1;
+        }
+        int status = breeze_parse_buffer(ctx, source, length);
+        free(source);
+        return status;
+    }
+    yyset_in(in, ctx->scanner);
+    yyset_lineno(1, ctx->scanner);
+    int status = yyparse(ctx->scanner, ctx);
+    if (status == 0) {
+        loop_optimize(ctx->root_ast);
+        infer_types(ctx->root_ast);
+        inline_calls(ctx->root_ast, ctx->inline_size);
+    }
+    return status;
+}
+
+int breeze_parse_source(BreezeContext *ctx, const char *source, size_t length) {
+    void *buffer = yy_scan_bytes(source, (int)length, ctx->scanner);
+    yyset_lineno(1, ctx->scanner);
+    int status = yyparse(ctx->scanner, ctx);
+    yy_delete_buffer(buffer, ctx->scanner);
+    return status;
+}
+
+int breeze_parse_buffer(BreezeContext *ctx, const char *source, size_t length) {
+    int status = parse_parallel(ctx, source, length);
+    if (status == 0) {
+        loop_optimize(ctx->root_ast);
+        infer_types(ctx->root_ast);
+        inline_calls(ctx->root_ast, ctx->inline_size);
+    }
+    return status;
+}
+
+static void evaluate_root(BreezeContext *ctx, void *root) {
+    evaluate_ast(ctx, root);
+    task_wait_all(ctx);
+}
+
+void breeze_evaluate(BreezeContext *ctx) {
+    if (!ctx->root_ast) {
+        breeze_error(ctx, "Error: No program to evaluate.\n");
+    }
+    breeze_with_stack(ctx, evaluate_root, ctx->root_ast);
+}
+
+// Room left below the limit for builtins, printf and the JIT's helpers
+#define STACK_RESERVE (64 * 1024)
+
+typedef struct {
+    BreezeContext *ctx;
+    void (*fn)(BreezeContext *, void *);
+    void *arg;
+    Coroutine caller;         // Where the run returns to
+    Coroutine run;            // On ctx->stack (stack NULL: the caller's own stack)
+} StackJob;
+
+static void run_stack_job(void *data) {
+    StackJob *job = data;
+    BreezeContext *ctx = job->ctx;
+    const char *outer = ctx->stack_limit;
+    pthread_attr_t attr;
+    void *low;
+    size_t size;
+
+    if (job->run.stack) {
+        ctx->stack_limit = job->run.stack + STACK_RESERVE;
+    } else if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if (pthread_attr_getstack(&attr, &low, &size) == 0 && size > 2 * STACK_RESERVE) {
+            ctx->stack_limit = (const char *)low + STACK_RESERVE;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    HeapAccount *outer_heap = heap_enter(&ctx->heap);
+    governor_start(ctx);
+    job->fn(ctx, job->arg);
+    heap_enter(outer_heap);
+    ctx->stack_limit = outer;
+    if (job->run.stack) coroutine_switch(&job->run, &job->caller);
+}
+
+void breeze_with_stack(BreezeContext *ctx, void (*fn)(BreezeContext *, void *), void *arg) {
+    StackJob job = { ctx, fn, arg, { 0 }, { 0 } };
+    size_t size = (size_t)ctx->max_depth * BREEZE_FRAME_STACK + 2 * STACK_RESERVE;
+
+    // Made once and kept by the context; a larger --max-depth replaces it
+    if (ctx->stack && ctx->stack_size < size) {
+        coroutine_stack_free(ctx->stack, ctx->stack_size);
+        ctx->stack = NULL;
+    }
+    if (!ctx->stack) {
+        ctx->stack = coroutine_stack_new(size);
+        ctx->stack_size = ctx->stack ? size : 0;
+    }
+    // A run started from inside a run (or without a stack) stays where it is
+    if (!ctx->stack || ctx->stack_limit) {
+        run_stack_job(&job);
+        return;
+    }
+    coroutine_start_on(&job.run, ctx->stack, ctx->stack_size, run_stack_job, &job);
+    coroutine_switch(&job.caller, &job.run);
+}
+
+void breeze_stack_overflow(BreezeContext *ctx, const char *function) {
+    breeze_limit_error(ctx, "Error: stack overflow at function '%s' (%d calls deep).\n",
+                 function, ctx->depth);
+}
+
+// Store and print the message; the caller decides how to unwind
+static void report_error(BreezeContext *ctx, const char *fmt, va_list args) {
+    vsnprintf(ctx->error, sizeof(ctx->error), fmt, args);
+
+    if (ctx->err) {
+        fputs(ctx->error, ctx->err);
+    }
+
+    // Keep the stored message on one line for embedders
+    size_t len = strlen(ctx->error);
+    if (len > 0 && ctx->error[len - 1] == '\n') {
+        ctx->error[len - 1] = '\0';
+    }
+}
+
+void breeze_error(BreezeContext *ctx, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    report_error(ctx, fmt, args);
+    va_end(args);
+
+    if (ctx->error_jmp) {
+        longjmp(*ctx->error_jmp, 1);
+    }
+    exit(EXIT_FAILURE);
+}
+
+void breeze_limit_error(BreezeContext *ctx, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    report_error(ctx, fmt, args);
+    va_end(args);
+
+    ctx->limit_exceeded = 1;
+    if (ctx->error_jmp) {
+        longjmp(*ctx->error_jmp, 1);
+    }
+    exit(BREEZE_EXIT_LIMIT);
+}
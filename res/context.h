@@ -0,0 +1,127 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "symtab.h"
+#include "scope.h"
+#include "governor.h"
+#include "heap.h"
+#include "breeze.h"
+
+#define BREEZE_ERROR_MAX 256
+
+// Default limit on nested script calls
+#define BREEZE_MAX_DEPTH 100000
+
+/**
+ * Native stack reserved per script call. Measured with the Makefile's
+ * unoptimized build: 1.2-1.5K for a call inside an if, a loop or a
+ * builtin's arguments, 2.4K for one inside if/for/if-else; -O2 needs
+ * half of that. Bodies nested deeper still stop with a stack overflow
+ * error, only at a smaller depth.
+ */
+#define BREEZE_FRAME_STACK 3072
+
+/**
+ * A BreezeContext owns everything one interpreter instance needs:
+ * the scope stack, the AST produced by the parser and the reentrant
+ * flex scanner. Nothing is process-global, so independent contexts
+ * can parse and run scripts concurrently on separate threads.
+ */
+struct BreezeContext {
+    Scope *current_scope;     // Top of this interpreter's scope stack
+    BindingTable bindings;    // Innermost symbol of every name (see scope.h)
+    astnode_t *root_ast;      // Program built by the last successful parse
+    void *scanner;            // Reentrant flex scanner (yyscan_t)
+
+    FILE *in;                 // Source for `what? ->` (NULL: reads fail)
+    FILE *out;                // Destination of `print` (NULL: discarded)
+    FILE *err;                // Diagnostics (NULL: only kept in `error`)
+
+    char error[BREEZE_ERROR_MAX]; // Last parse or runtime error message
+    jmp_buf *error_jmp;       // Set while an embedder can recover from errors
+    int limit_exceeded;       // The last error came from breeze_limit_error
+
+    struct JitState *jit;     // Compiled hot code (NULL: interpreter only)
+    struct LoopFrame *loop;   // Innermost running loop with cached invariants
+    struct ForEachFrame *foreach; // Innermost running f{ x in g } loop
+    struct Generator *generator;  // Generator whose body is running (NULL: none)
+    struct Scheduler *tasks;  // Spawned tasks of the current run (NULL: none yet)
+    struct Heatmap *heatmap;  // Per-line execution counts (NULL: not profiling)
+    struct Trace *trace;      // Timeline of calls and loops (NULL: not tracing)
+    const char *snapshot;     // File `snapshot;` writes to (NULL: the marker does nothing)
+    unsigned long long snapshot_key; // Source hash recorded in it (see snapshot.h)
+    const char *import_dir;   // Where the script's imports are found (NULL: the working directory)
+    struct Module *module;    // Module whose top level is running (NULL: the script's)
+    struct ImportedModule *imports; // Modules the current run imported (see module.h)
+    int lazy_parse;           // Parse function bodies at their first call (see lazy.h)
+    int parse_line, parse_column; // Where the source being parsed starts (0: 1:1)
+    int parse_jobs;           // Threads parsing a long script (see parallel.h; 0: one per core)
+    size_t max_heap;          // Limit on heap.in_use (0: unlimited)
+    HeapAccount heap;         // Bytes of the values this context allocated (see heap.h)
+
+    Governor governor;        // Operation and time limits of the current run
+    const char *function;     // Script function being interpreted (NULL: top level)
+    Value *args;              // Arguments of the inlined call being evaluated (see inline.h)
+    int inline_size;          // Inline functions of at most this many nodes (0: none)
+    int depth;                // Script calls currently active
+    int max_depth;            // Deeper calls fail with a stack overflow
+    const char *stack_limit;  // Calls must keep the native stack above this
+    char *stack;              // Evaluation stack, kept for the next run (see breeze_with_stack)
+    size_t stack_size;
+};
+
+/**
+ * breeze_context_new() and breeze_context_free() are part of the public
+ * embedding API in breeze.h. A new context starts with an initialized
+ * global scope, its own scanner and the standard streams.
+ */
+
+/**
+ * Parse a whole script from an open file (or from a memory buffer)
+ * into ctx->root_ast. Returns 0 on success, non-zero on a syntax error.
+ * A long script is parsed on several threads (see parallel.h); a file
+ * is then read whole first.
+ */
+int breeze_parse_file(BreezeContext *ctx, FILE *in);
+int breeze_parse_buffer(BreezeContext *ctx, const char *source, size_t length);
+
+// breeze_parse_buffer without the analysis passes, for callers that run their own
+int breeze_parse_source(BreezeContext *ctx, const char *source, size_t length);
+
+// Evaluate the program stored in ctx->root_ast.
+void breeze_evaluate(BreezeContext *ctx);
+
+/**
+ * Run fn(ctx, arg) on the context's evaluation stack, which holds
+ * ctx->max_depth nested script calls. It is reserved by the first run
+ * and switched to as a coroutine (coroutine.h) on the calling thread, so
+ * later runs reuse it without a thread or a mapping of their own. Pages
+ * are only committed as calls reach them. Evaluation always goes through
+ * here, so deep recursion ends in breeze_stack_overflow() rather than a
+ * crash.
+ */
+void breeze_with_stack(BreezeContext *ctx, void (*fn)(BreezeContext *, void *), void *arg);
+
+// Error for a call that would nest deeper than allowed
+__attribute__((noreturn))
+void breeze_stack_overflow(BreezeContext *ctx, const char *function);
+
+/**
+ * Report an error: the message is stored in ctx->error and written to
+ * ctx->err. If an embedder armed ctx->error_jmp we unwind to it,
+ * otherwise the process exits as it always has.
+ */
+__attribute__((noreturn, format(printf, 2, 3)))
+void breeze_error(BreezeContext *ctx, const char *fmt, ...);
+
+/**
+ * Report a run that exceeded one of its limits (operations, time, heap
+ * or call depth). Like breeze_error, but breeze_run returns BREEZE_LIMIT
+ * and the process exits with BREEZE_EXIT_LIMIT.
+ */
+__attribute__((noreturn, format(printf, 2, 3)))
+void breeze_limit_error(BreezeContext *ctx, const char *fmt, ...);
+
+#endif
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "coroutine.h"
+
+// Stacks of finished coroutines kept for the next ones
+#define COROUTINE_SPARES 16
+
+static char *spares[COROUTINE_SPARES];
+static int spare_count;
+static pthread_mutex_t spares_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef COROUTINE_FAST_SWITCH
+/**
+ * coroutine_switch pushes the callee-saved registers, stores the stack
+ * pointer in from->sp, loads to->sp and pops them again. A new stack is
+ * prepared so that this "returns" into coroutine_entry with the entry
+ * function in r12 and its argument in r13.
+ */
+void coroutine_entry(void);
+
+__asm__(
+  ".text\n"
+  ".globl coroutine_switch\n"
+  ".hidden coroutine_switch\n"
+  ".type coroutine_switch, @function\n"
+  "coroutine_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq (%rsi), %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size coroutine_switch, .-coroutine_switch\n"
+  ".globl coroutine_entry\n"
+  ".hidden coroutine_entry\n"
+  ".type coroutine_entry, @function\n"
+  "coroutine_entry:\n"
+  "  movq %r13, %rdi\n"
+  "  call *%r12\n"
+  "  ud2\n"
+  ".size coroutine_entry, .-coroutine_entry\n");
+
+static void prepare(Coroutine *co) {
+  // Popped by coroutine_switch: r15, r14, r13, r12, rbx, rbp, then the
+  // return address, which leaves the stack 16-byte aligned for the call
+  uintptr_t top = ((uintptr_t)co->stack + co->size - 16) & ~(uintptr_t)15;
+  void **sp = (void **)(top - 7 * sizeof(void *));
+  for (int i = 0; i < 6; i++) sp[i] = NULL;
+  sp[2] = co->arg;
+  sp[3] = (void *)co->entry;
+  sp[6] = (void *)coroutine_entry;
+  co->sp = sp;
+}
+#else
+// The coroutine being switched to, for run_entry(): makecontext() cannot pass a pointer
+static _Thread_local Coroutine *starting;
+
+static void run_entry(void) {
+  Coroutine *co = starting;
+  co->entry(co->arg);
+}
+
+static void prepare(Coroutine *co) {
+  getcontext(&co->context);
+  co->context.uc_stack.ss_sp = co->stack;
+  co->context.uc_stack.ss_size = co->size;
+  co->context.uc_link = NULL;
+  makecontext(&co->context, run_entry, 0);
+}
+
+void coroutine_switch(Coroutine *from, Coroutine *to) {
+  starting = to;
+  swapcontext(&from->context, &to->context);
+}
+#endif
+
+char *coroutine_stack_new(size_t size) {
+  char *stack = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED) return NULL;
+  // Overflowing the reserve hits a guard page rather than other memory
+  mprotect(stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+  return stack;
+}
+
+void coroutine_stack_free(char *stack, size_t size) {
+  munmap(stack, size);
+}
+
+void coroutine_start_on(Coroutine *co, char *stack, size_t size, void (*entry)(void *), void *arg) {
+  co->stack = stack;
+  co->size = size;
+  co->entry = entry;
+  co->arg = arg;
+  prepare(co);
+}
+
+int coroutine_start(Coroutine *co, void (*entry)(void *), void *arg) {
+  char *stack = NULL;
+  pthread_mutex_lock(&spares_lock);
+  if (spare_count > 0) {
+    stack = spares[--spare_count];
+  }
+  pthread_mutex_unlock(&spares_lock);
+
+  if (!stack) {
+    stack = coroutine_stack_new(COROUTINE_STACK);
+    if (!stack) return -1;
+  }
+  coroutine_start_on(co, stack, COROUTINE_STACK, entry, arg);
+  return 0;
+}
+
+void coroutine_free(Coroutine *co) {
+  if (!co->stack) return;
+  pthread_mutex_lock(&spares_lock);
+  if (spare_count < COROUTINE_SPARES) {
+    spares[spare_count++] = co->stack;
+    co->stack = NULL;
+  }
+  pthread_mutex_unlock(&spares_lock);
+  if (co->stack) {
+    coroutine_stack_free(co->stack, COROUTINE_STACK);
+    co->stack = NULL;
+  }
+}
+
+const char *coroutine_stack_limit(const Coroutine *co) {
+  return co->stack ? co->stack + COROUTINE_RESERVE : NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stddef.h>
+#include <ucontext.h>
+
+/**
+ * Stackful coroutines: code that runs on a stack of its own and can be
+ * suspended anywhere, keeping its position as plain C frames. Generators
+ * (generator.h) and tasks (task.h) are built on them.
+ *
+ * On x86-64 a switch only saves the registers a call preserves, which is
+ * far cheaper than swapcontext() and the signal mask system call it
+ * makes each time. Other targets use ucontext, and so do AddressSanitizer
+ * builds: it follows swapcontext() but not a hand-written switch.
+ */
+
+#if defined(__x86_64__) && !defined(__SANITIZE_ADDRESS__)
+#define COROUTINE_FAST_SWITCH 1
+#endif
+
+// Stack of a coroutine: reserved up front, committed as it is used
+#define COROUTINE_STACK (1024 * 1024)
+
+// Kept free below the call-depth check, like breeze_with_stack does
+#define COROUTINE_RESERVE (64 * 1024)
+
+typedef struct Coroutine {
+#ifdef COROUTINE_FAST_SWITCH
+  void *sp;                   // Saved stack pointer (first: the switch code relies on it)
+#else
+  ucontext_t context;
+#endif
+  char *stack;                // NULL for code already running on a thread's stack
+  size_t size;                // Bytes of stack
+  void (*entry)(void *);
+  void *arg;
+} Coroutine;
+
+/**
+ * Give `co` a fresh stack on which the first switch to it calls
+ * entry(arg). entry never returns: it ends by switching away for good.
+ * Returns 0, or -1 if no stack could be allocated.
+ */
+int coroutine_start(Coroutine *co, void (*entry)(void *), void *arg);
+
+/**
+ * The same on a stack of `size` bytes from coroutine_stack_new(), which
+ * stays the caller's: coroutine_free() must not be called for `co`.
+ */
+void coroutine_start_on(Coroutine *co, char *stack, size_t size, void (*entry)(void *), void *arg);
+
+// Reserve a stack of size bytes, committed as it is used (NULL on failure)
+char *coroutine_stack_new(size_t size);
+void coroutine_stack_free(char *stack, size_t size);
+
+/**
+ * Suspend the running code into `from` and continue `to`. A zeroed
+ * Coroutine can be used as `from` for code on a thread's own stack.
+ */
+void coroutine_switch(Coroutine *from, Coroutine *to);
+
+// Give back the stack of a coroutine that will not run again (never the running one)
+void coroutine_free(Coroutine *co);
+
+// Calls must keep the native stack above this (NULL for a thread's own stack)
+const char *coroutine_stack_limit(const Coroutine *co);
+
+#endif
@@ -0,0 +1,1288 @@
+#include <stdarg.h>
+#include <limits.h>
+#include "common_lib.h"
+#include "emit_c.h"
+#include "strlib.h"
+#include "task.h"
+#include "bench.h"
+#include "typeinfer.h"
+
+// Static types; ST_BOT means "not known yet" while types are inferred
+typedef enum { ST_BOT, ST_INT, ST_FLOAT, ST_BOOL, ST_STRING, ST_DYN } StaticType;
+
+typedef struct {
+  const char *name;
+  StaticType type;
+  int checked;        // may be read before it is assigned
+  int slot;           // position in the scope's frame
+} EmitVar;
+
+// The top level or one function
+typedef struct {
+  astnode_t *def;     // NODE_FUNC, NULL for the top level
+  const char *name;
+  EmitVar *vars;
+  int nvars;
+  int nparams;        // the first nparams vars are the parameters
+  StaticType ret;
+  int temps;
+} EmitScope;
+
+typedef struct {
+  FILE *out;
+  EmitScope top;
+  EmitScope *funcs;
+  int nfuncs;
+  int frames;         // dynamic scoping is resolved with runtime frames
+  int changed;        // type inference has not reached its fixpoint
+  int failed;
+  int indent;
+} Emitter;
+
+// An emitted expression: side-effect free C code of the given type.
+// Anything with effects has already been emitted into a temporary.
+typedef struct {
+  char *code;
+  StaticType type;
+} Operand;
+
+static const char *ERR_UNKNOWN_NODE =
+  "Error: Unknown node type in evaluation. Maybe you should use evaluate_ast() instead of evaluate_expr()? Node type: %d\\n";
+
+// ----------- HELPERS -----------
+
+static void *emit_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed in the C emitter.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+static char *format(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+
+  char *text = emit_alloc(NULL, (size_t)length + 1);
+  va_start(args, fmt);
+  vsnprintf(text, (size_t)length + 1, fmt, args);
+  va_end(args);
+  return text;
+}
+
+static void reject(Emitter *e, const char *fmt, const char *name) {
+  if (e->failed) return;
+  fprintf(stderr, "Error: --emit-c cannot compile this script: ");
+  fprintf(stderr, fmt, name);
+  fprintf(stderr, "\n");
+  e->failed = 1;
+}
+
+static void line(Emitter *e, const char *fmt, ...) {
+  va_list args;
+  fprintf(e->out, "%*s", e->indent * 2, "");
+  va_start(args, fmt);
+  vfprintf(e->out, fmt, args);
+  va_end(args);
+  fputc('\n', e->out);
+}
+
+// Quote a string as a C literal
+static char *c_literal(const char *s) {
+  char *text = emit_alloc(NULL, strlen(s) * 4 + 3);
+  char *dest = text;
+  *dest++ = '"';
+  for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      *dest++ = '\\';
+      *dest++ = (char)*p;
+    } else if (*p == '\n') {
+      *dest++ = '\\';
+      *dest++ = 'n';
+    } else if (*p == '\t') {
+      *dest++ = '\\';
+      *dest++ = 't';
+    } else if (*p < 32 || *p >= 127) {
+      dest += sprintf(dest, "\\%03o", *p);
+    } else {
+      *dest++ = (char)*p;
+    }
+  }
+  *dest++ = '"';
+  *dest = '\0';
+  return text;
+}
+
+static const char *c_type(StaticType type) {
+  switch (type) {
+    case ST_INT:    return "BzInt";
+    case ST_FLOAT:  return "float";
+    case ST_STRING: return "const char *";
+    case ST_DYN:    return "BzValue";
+    default:        return "int";
+  }
+}
+
+static StaticType join(StaticType a, StaticType b) {
+  if (a == ST_BOT) return b;
+  if (b == ST_BOT || a == b) return a;
+  return ST_DYN;
+}
+
+static Operand operand(char *code, StaticType type) {
+  Operand op = { code, type };
+  return op;
+}
+
+// Value of an expression that can never complete (it raised an error)
+static Operand unreachable(void) {
+  return operand(format("0"), ST_BOT);
+}
+
+// ----------- SCOPES AND VARIABLES -----------
+
+static EmitVar *find_var(EmitScope *scope, const char *name) {
+  for (int i = 0; i < scope->nvars; i++) {
+    if (strcmp(scope->vars[i].name, name) == 0) return &scope->vars[i];
+  }
+  return NULL;
+}
+
+static EmitVar *add_var(EmitScope *scope, const char *name) {
+  EmitVar *var = find_var(scope, name);
+  if (var) return var;
+  scope->vars = emit_alloc(scope->vars, sizeof(EmitVar) * (scope->nvars + 1));
+  var = &scope->vars[scope->nvars];
+  var->name = name;
+  var->type = ST_BOT;
+  var->checked = 0;
+  var->slot = scope->nvars++;
+  return var;
+}
+
+static EmitScope *find_func(Emitter *e, const char *name) {
+  for (int i = 0; i < e->nfuncs; i++) {
+    if (strcmp(e->funcs[i].name, name) == 0) return &e->funcs[i];
+  }
+  return NULL;
+}
+
+static int is_function_local(Emitter *e, const char *name) {
+  for (int i = 0; i < e->nfuncs; i++) {
+    if (find_var(&e->funcs[i], name)) return 1;
+  }
+  return 0;
+}
+
+// Variables written by a scope: assignments (including for init/update) and reads
+static void collect_vars(Emitter *e, EmitScope *scope, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC) {
+    if (scope->def) reject(e, "function '%s' is defined inside another function", node->data.id);
+    return;
+  }
+  if (node->type == NODE_FOREACH) {
+    reject(e, "the f{ %s in ... } loop needs generators or channels", node->data.id);
+    return;
+  }
+  if (node->type == NODE_SPAWN) {
+    reject(e, "spawn %s() needs the task scheduler", node->data.id);
+    return;
+  }
+  if (node->type == NODE_YIELD) {
+    reject(e, "%s outside a generator", "yield");
+    return;
+  }
+  if (node->type == NODE_BENCH) {
+    reject(e, "%s needs the interpreter", "a b{} benchmark");
+    return;
+  }
+  if (node->type == NODE_IMPORT) {
+    reject(e, "import %s needs the module loader", node->data.id);
+    return;
+  }
+  if (node->type == NODE_FUNCCALL && !find_func(e, node->data.id) && strlib_lookup(node->data.id)) {
+    reject(e, "the string builtin %s() is not supported", node->data.id);
+    return;
+  }
+  if (node->type == NODE_FUNCCALL && !find_func(e, node->data.id) && channel_builtin(node->data.id)) {
+    reject(e, "%s are not supported", "channels");
+    return;
+  }
+  if (node->type == NODE_FUNCCALL && !find_func(e, node->data.id) && bench_builtin(node->data.id)) {
+    reject(e, "%s needs the interpreter", "clock()");
+    return;
+  }
+  if (node->type == NODE_ASSIGN || node->type == NODE_READ) {
+    // Qualified names belong to modules, and are no C identifiers
+    if (strchr(node->data.id, '.')) {
+      reject(e, "the qualified name %s needs the module loader", node->data.id);
+      return;
+    }
+    add_var(scope, node->data.id);
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect_vars(e, scope, node->child[i]);
+}
+
+// Function definitions reachable from the top level (inside its loops and ifs too)
+static void collect_funcs(Emitter *e, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC) {
+    if (node->generator) {
+      reject(e, "function '%s' is a generator", node->data.id);
+      return;
+    }
+    if (find_func(e, node->data.id)) {
+      reject(e, "function '%s' is defined more than once", node->data.id);
+      return;
+    }
+    e->funcs = emit_alloc(e->funcs, sizeof(EmitScope) * (e->nfuncs + 1));
+    EmitScope *f = &e->funcs[e->nfuncs++];
+    memset(f, 0, sizeof(*f));
+    f->def = node;
+    f->name = node->data.id;
+    return;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect_funcs(e, node->child[i]);
+}
+
+static void collect_names_in_exprs(Emitter *e, astnode_t *node) {
+  if (!node || e->failed) return;
+  if ((node->type == NODE_ID || node->type == NODE_INDEX || node->type == NODE_STRLEN) &&
+      find_func(e, node->data.id)) {
+    reject(e, "'%s' is used both as a function and as a variable", node->data.id);
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect_names_in_exprs(e, node->child[i]);
+}
+
+// ----------- DEFINITE ASSIGNMENT -----------
+
+/**
+ * Walk a scope in execution order, tracking which of its variables are
+ * definitely assigned. Reads that may happen before an assignment need
+ * a runtime check (globals) or a lookup through the callers (functions).
+ */
+static void check_read(Emitter *e, EmitScope *scope, const char *name, const char *defined) {
+  EmitVar *var = find_var(scope, name);
+  if (var && defined[var->slot]) return;
+
+  if (!scope->def) {
+    if (var) var->checked = 1;
+    return;
+  }
+  // Some caller may hold the variable: resolve it like lookup_symbol
+  if (is_function_local(e, name)) {
+    e->frames = 1;
+    return;
+  }
+  EmitVar *global = find_var(&e->top, name);
+  if (global) global->checked = 1;
+}
+
+static void defs_expr(Emitter *e, EmitScope *scope, astnode_t *node, const char *defined) {
+  if (!node) return;
+  switch (node->type) {
+    case NODE_ID:
+    case NODE_INDEX:
+    case NODE_STRLEN:
+      check_read(e, scope, node->data.id, defined);
+      break;
+    case NODE_FUNCCALL: {
+      // Parameters left without an argument are looked up in the callers
+      EmitScope *callee = find_func(e, node->data.id);
+      int argc = 0;
+      while (argc < MAXCHILDREN && node->child[0] && node->child[0]->child[argc]) argc++;
+      if (callee && argc < callee->nparams) e->frames = 1;
+      break;
+    }
+    default:
+      break;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) defs_expr(e, scope, node->child[i], defined);
+}
+
+static void defs_stmt(Emitter *e, EmitScope *scope, astnode_t *node, char *defined);
+
+static void defs_block(Emitter *e, EmitScope *scope, astnode_t *node, const char *defined) {
+  char *inner = emit_alloc(NULL, (size_t)scope->nvars + 1);
+  memcpy(inner, defined, (size_t)scope->nvars + 1);
+  defs_stmt(e, scope, node, inner);
+  free(inner);
+}
+
+static void defs_assign(Emitter *e, EmitScope *scope, astnode_t *node, char *defined) {
+  defs_expr(e, scope, node->child[0], defined);
+  EmitVar *var = find_var(scope, node->data.id);
+  if (var) defined[var->slot] = 1;
+}
+
+static void defs_stmt(Emitter *e, EmitScope *scope, astnode_t *node, char *defined) {
+  if (!node) return;
+  char *other;
+
+  switch (node->type) {
+    case NODE_STMTS:
+      for (int i = 0; i < MAXCHILDREN; i++) defs_stmt(e, scope, node->child[i], defined);
+      break;
+    case NODE_ASSIGN:
+      defs_assign(e, scope, node, defined);
+      break;
+    case NODE_READ:
+      defined[find_var(scope, node->data.id)->slot] = 1;
+      break;
+    case NODE_FUNC:
+      break;
+    case NODE_WHILE:
+      defs_expr(e, scope, node->child[0], defined);
+      defs_block(e, scope, node->child[1], defined);
+      break;
+    case NODE_FOR:
+      defs_assign(e, scope, node->child[0], defined);
+      defs_expr(e, scope, node->child[1], defined);
+      other = emit_alloc(NULL, (size_t)scope->nvars + 1);
+      memcpy(other, defined, (size_t)scope->nvars + 1);
+      defs_stmt(e, scope, node->child[3], other);
+      defs_assign(e, scope, node->child[2], other);
+      free(other);
+      break;
+    case NODE_IF:
+      defs_expr(e, scope, node->child[0], defined);
+      defs_block(e, scope, node->child[1], defined);
+      break;
+    case NODE_IFELSE:
+      defs_expr(e, scope, node->child[0], defined);
+      other = emit_alloc(NULL, (size_t)scope->nvars + 1);
+      memcpy(other, defined, (size_t)scope->nvars + 1);
+      defs_stmt(e, scope, node->child[1], other);
+      defs_stmt(e, scope, node->child[2], defined);
+      for (int i = 0; i < scope->nvars; i++) defined[i] = defined[i] && other[i];
+      free(other);
+      break;
+    default:
+      defs_expr(e, scope, node, defined);
+      break;
+  }
+}
+
+static void check_definitions(Emitter *e, EmitScope *scope, astnode_t *body) {
+  char *defined = emit_alloc(NULL, (size_t)scope->nvars + 1);
+  memset(defined, 0, (size_t)scope->nvars + 1);
+  for (int i = 0; i < scope->nparams; i++) defined[i] = 1;
+  defs_stmt(e, scope, body, defined);
+  free(defined);
+}
+
+// ----------- TYPE INFERENCE -----------
+
+// Each variable needs one C type for its whole scope, so this joins every
+// assignment; typeinfer.c proves types per expression, which emit_arith uses
+// to unbox operands read from BzValue variables
+
+static StaticType infer_expr(Emitter *e, EmitScope *scope, astnode_t *node);
+
+static EmitVar *resolve_var(Emitter *e, EmitScope *scope, const char *name) {
+  EmitVar *var = find_var(scope, name);
+  if (!var && scope->def) var = find_var(&e->top, name);
+  return var;
+}
+
+static void widen(Emitter *e, StaticType *slot, StaticType type) {
+  StaticType joined = join(*slot, type);
+  if (joined != *slot) {
+    *slot = joined;
+    e->changed = 1;
+  }
+}
+
+static StaticType arith_type(astnode_t *node, StaticType l, StaticType r) {
+  if (l == ST_BOT || r == ST_BOT) return ST_BOT;
+  if (l == ST_DYN || r == ST_DYN || l == ST_STRING || r == ST_STRING) return ST_DYN;
+  // An int to an int power is an int unless the exponent is negative
+  if (node->type == NODE_EXP && l == ST_INT && r == ST_INT) return ST_DYN;
+  if (node->type == NODE_DIV || node->type == NODE_EXP) return ST_FLOAT;
+  if (l == ST_FLOAT || r == ST_FLOAT) return ST_FLOAT;
+  // Adding bools is a runtime error raised by the generic path
+  if (node->type == NODE_ADD && (l != ST_INT || r != ST_INT)) return ST_DYN;
+  return ST_INT;
+}
+
+static StaticType infer_call(Emitter *e, EmitScope *scope, astnode_t *node) {
+  EmitScope *callee = find_func(e, node->data.id);
+  astnode_t *args = node->child[0];
+  int argc = 0;
+  for (int i = 0; i < MAXCHILDREN && args && args->child[i]; i++) {
+    StaticType type = infer_expr(e, scope, args->child[i]);
+    if (callee && i < callee->nparams) widen(e, &callee->vars[i].type, type);
+    argc++;
+  }
+  if (!callee || argc > callee->nparams) return ST_BOT;
+  return callee->ret;
+}
+
+static StaticType infer_expr(Emitter *e, EmitScope *scope, astnode_t *node) {
+  if (!node) return ST_BOT;
+  EmitVar *var;
+  StaticType l, r;
+
+  switch (node->type) {
+    case NODE_INT:    return ST_INT;
+    case NODE_BIGINT: return ST_INT;
+    case NODE_FLOAT:  return ST_FLOAT;
+    case NODE_BOOL:   return ST_BOOL;
+    case NODE_STRING: return ST_STRING;
+    case NODE_ID:
+      var = resolve_var(e, scope, node->data.id);
+      return var ? var->type : ST_BOT;
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+      l = infer_expr(e, scope, node->child[0]);
+      r = infer_expr(e, scope, node->child[1]);
+      return arith_type(node, l, r);
+    case NODE_BOOL_OP:
+      infer_expr(e, scope, node->child[0]);
+      if (node->data.bool_op != OP_NOT) infer_expr(e, scope, node->child[1]);
+      return ST_BOOL;
+    case NODE_FUNCCALL:
+      return infer_call(e, scope, node);
+    case NODE_FUNCRET:
+      return infer_expr(e, scope, node->child[0]);
+    case NODE_INDEX:
+      if (node->child[0]) {
+        infer_expr(e, scope, node->child[0]->child[0]);
+        infer_expr(e, scope, node->child[0]->child[1]);
+      }
+      return ST_STRING;
+    case NODE_STRLEN:
+      return ST_INT;
+    default:
+      return ST_BOT;
+  }
+}
+
+static void infer_stmt(Emitter *e, EmitScope *scope, astnode_t *node) {
+  if (!node) return;
+  switch (node->type) {
+    case NODE_ASSIGN:
+      widen(e, &find_var(scope, node->data.id)->type, infer_expr(e, scope, node->child[0]));
+      break;
+    case NODE_READ:
+      widen(e, &find_var(scope, node->data.id)->type, ST_STRING);
+      break;
+    case NODE_PRINT:
+      for (int i = 0; i < MAXCHILDREN && node->child[0]; i++) {
+        if (node->child[0]->child[i]) infer_expr(e, scope, node->child[0]->child[i]);
+      }
+      break;
+    case NODE_FUNC:
+      break;
+    case NODE_STMTS:
+    case NODE_WHILE:
+    case NODE_FOR:
+    case NODE_IF:
+    case NODE_IFELSE:
+      for (int i = 0; i < MAXCHILDREN; i++) {
+        astnode_t *child = node->child[i];
+        if (!child) continue;
+        // Conditions are expressions, everything else a statement
+        if ((node->type != NODE_STMTS && i == 0 && node->type != NODE_FOR) ||
+            (node->type == NODE_FOR && i == 1)) {
+          infer_expr(e, scope, child);
+        } else {
+          infer_stmt(e, scope, child);
+        }
+      }
+      break;
+    default:
+      infer_expr(e, scope, node);
+      break;
+  }
+}
+
+// Mirrors evaluate_funcbody: a return counts only as a direct child of the body
+static astnode_t *body_return(astnode_t *body) {
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (body->child[i] && body->child[i]->type == NODE_FUNCRET) return body->child[i];
+  }
+  return NULL;
+}
+
+static void infer_storage(Emitter *e, astnode_t *root) {
+  do {
+    e->changed = 0;
+    infer_stmt(e, &e->top, root);
+    for (int i = 0; i < e->nfuncs; i++) {
+      EmitScope *f = &e->funcs[i];
+      astnode_t *body = f->def->child[1];
+      infer_stmt(e, f, body);
+      astnode_t *ret = body_return(body);
+      widen(e, &f->ret, ret ? infer_expr(e, f, ret->child[0]) : ST_INT);
+    }
+  } while (e->changed);
+
+  // Whatever is still unknown is never produced by a completed expression
+  for (int i = 0; i < e->top.nvars; i++) {
+    if (e->top.vars[i].type == ST_BOT) e->top.vars[i].type = ST_DYN;
+  }
+  for (int i = 0; i < e->nfuncs; i++) {
+    EmitScope *f = &e->funcs[i];
+    if (f->ret == ST_BOT) f->ret = ST_INT;
+    for (int j = 0; j < f->nvars; j++) {
+      if (f->vars[j].type == ST_BOT) f->vars[j].type = ST_DYN;
+    }
+  }
+}
+
+// ----------- OPERANDS -----------
+
+// Variables that may be unset or change type live in a BzValue
+static int boxed(Emitter *e, EmitVar *var) {
+  return e->frames || var->checked || var->type == ST_DYN;
+}
+
+static char *var_ref(Emitter *e, EmitScope *scope, EmitVar *var) {
+  if (e->frames) return format(scope->def ? "l[%d]" : "bz_g[%d]", var->slot);
+  return format(scope->def ? "l_%s" : "g_%s", var->name);
+}
+
+static char *temp(Emitter *e, EmitScope *scope, StaticType type, char *code) {
+  char *name = format("t%d", scope->temps++);
+  const char *ctype = c_type(type);
+  line(e, "%s%s%s = %s;", ctype, ctype[strlen(ctype) - 1] == '*' ? "" : " ", name, code);
+  free(code);
+  return name;
+}
+
+static char *box(Operand op) {
+  switch (op.type) {
+    case ST_INT:    return format("bz_box_int(%s)", op.code);
+    case ST_FLOAT:  return format("bz_float(%s)", op.code);
+    case ST_BOOL:   return format("bz_bool(%s)", op.code);
+    case ST_STRING: return format("bz_string(%s)", op.code);
+    case ST_DYN:    return format("%s", op.code);
+    default:        return format("bz_int(0)");
+  }
+}
+
+static char *payload(Operand op) {
+  switch (op.type) {
+    case ST_INT:    return format("bz_ipayload(%s)", op.code);
+    case ST_FLOAT:  return format("bz_bits(%s)", op.code);
+    case ST_STRING: return format("bz_payload(bz_string(%s))", op.code);
+    case ST_DYN:    return format("bz_payload(%s)", op.code);
+    default:        return format("%s", op.code);
+  }
+}
+
+static char *as_float(Operand op) {
+  if (op.type == ST_FLOAT) return format("%s", op.code);
+  if (op.type == ST_INT) return format("bz_ifloat(%s)", op.code);
+  return format("(float)%s", op.code);
+}
+
+// Code of an operand as a value of the given type
+static char *convert(Operand op, StaticType to) {
+  if (op.type == to) return format("%s", op.code);
+  if (to == ST_DYN) return box(op);
+  if (op.type == ST_DYN) {
+    switch (to) {
+      case ST_INT:    return format("bz_unbox_int(%s)", op.code);
+      case ST_FLOAT:  return format("%s.v.f", op.code);
+      case ST_STRING: return format("%s.v.s", op.code);
+      default:        return format("%s.v.i", op.code);
+    }
+  }
+  switch (to) {
+    case ST_FLOAT:  return format("0.0f");
+    case ST_STRING: return format("\"\"");
+    default:        return format("0");
+  }
+}
+
+static void release(Operand op) {
+  free(op.code);
+}
+
+// ----------- EXPRESSIONS -----------
+
+static Operand emit_expr(Emitter *e, EmitScope *scope, astnode_t *node);
+
+static Operand emit_error(Emitter *e, const char *message) {
+  line(e, "bz_error(\"%s\");", message);
+  return unreachable();
+}
+
+static Operand emit_undefined(Emitter *e, const char *name) {
+  line(e, "bz_error(\"Error: Undefined variable '%%s'\\n\", \"%s\");", name);
+  return unreachable();
+}
+
+static Operand emit_read(Emitter *e, EmitScope *scope, const char *name) {
+  if (e->frames && scope->def) {
+    return operand(temp(e, scope, ST_DYN, format("bz_load(bz_lookup(\"%s\"))", name)), ST_DYN);
+  }
+  EmitVar *var = resolve_var(e, scope, name);
+  if (!var) return emit_undefined(e, name);
+
+  EmitScope *owner = find_var(scope, name) ? scope : &e->top;
+  char *ref = var_ref(e, owner, var);
+  Operand op;
+
+  if (!boxed(e, var)) {
+    if (var->type == ST_STRING) {
+      op = operand(temp(e, scope, ST_STRING, format("bz_str_value(%s)", ref)), ST_STRING);
+    } else {
+      op = operand(format("%s", ref), var->type);
+    }
+  } else if (var->checked) {
+    char *value = temp(e, scope, ST_DYN, format("bz_get(\"%s\", %s)", name, ref));
+    if (var->type == ST_DYN) {
+      op = operand(temp(e, scope, ST_DYN, format("bz_load(%s)", value)), ST_DYN);
+    } else if (var->type == ST_STRING) {
+      op = operand(temp(e, scope, ST_STRING, format("bz_str_value(%s.v.s)", value)), ST_STRING);
+    } else {
+      op = operand(convert(operand(value, ST_DYN), var->type), var->type);
+    }
+    free(value);
+  } else {
+    op = operand(temp(e, scope, ST_DYN, format("bz_load(%s)", ref)), ST_DYN);
+  }
+  free(ref);
+  return op;
+}
+
+// The variable itself, as NODE_INDEX and NODE_STRLEN see it (no escape processing)
+static Operand emit_raw(Emitter *e, EmitScope *scope, const char *name) {
+  if (e->frames && scope->def) {
+    return operand(format("bz_lookup(\"%s\")", name), ST_DYN);
+  }
+  EmitVar *var = resolve_var(e, scope, name);
+  if (!var) return emit_undefined(e, name);
+
+  EmitScope *owner = find_var(scope, name) ? scope : &e->top;
+  char *ref = var_ref(e, owner, var);
+  if (!boxed(e, var)) return operand(ref, var->type);
+  return operand(ref, ST_DYN);
+}
+
+static Operand emit_string(Emitter *e, EmitScope *scope, astnode_t *node) {
+  // Escapes are processed every time a literal is evaluated; only
+  // literals that produce warnings need to do that at run time
+  const char *raw = node->data.str;
+  size_t length = strlen(raw);
+  int quoted = length > 1 && raw[0] == '"' && raw[length - 1] == '"';
+  char *inner = quoted ? strndup(raw + 1, length - 2) : strdup(raw);
+
+  int plain = 1;
+  char *text = emit_alloc(NULL, strlen(inner) + 1), *dest = text;
+  for (const char *p = inner; *p; p++) {
+    if (*p != '\\') {
+      *dest++ = *p;
+      continue;
+    }
+    p++;
+    switch (*p) {
+      case 'n':  *dest++ = '\n'; break;
+      case 't':  *dest++ = '\t'; break;
+      case '\\': *dest++ = '\\'; break;
+      case '"':  *dest++ = '"'; break;
+      default:   plain = 0; break;
+    }
+    if (!plain) break;
+  }
+  *dest = '\0';
+
+  Operand op;
+  if (plain) {
+    op = operand(c_literal(text), ST_STRING);
+  } else {
+    char *literal = c_literal(raw);
+    op = operand(temp(e, scope, ST_STRING, format("bz_str_value(%s)", literal)), ST_STRING);
+    free(literal);
+  }
+  free(inner);
+  free(text);
+  return op;
+}
+
+// A boxed operand whose node the inference pass proved an int or a float
+static Operand narrow(Operand op, astnode_t *node) {
+  StaticType type = node->inferred == TI_INT ? ST_INT : node->inferred == TI_FLOAT ? ST_FLOAT : ST_DYN;
+  if (op.type != ST_DYN || type == ST_DYN) return op;
+  Operand narrowed = operand(convert(op, type), type);
+  release(op);
+  return narrowed;
+}
+
+static Operand emit_arith(Emitter *e, EmitScope *scope, astnode_t *node) {
+  Operand l = narrow(emit_expr(e, scope, node->child[0]), node->child[0]);
+  Operand r = narrow(emit_expr(e, scope, node->child[1]), node->child[1]);
+  StaticType type = arith_type(node, l.type, r.type);
+  char *code;
+
+  if (type == ST_BOT) {
+    release(l);
+    release(r);
+    return unreachable();
+  }
+
+  if (type == ST_DYN) {
+    static const char *generic[] = { [NODE_ADD] = "bz_add", [NODE_SUB] = "bz_sub",
+                                     [NODE_MUL] = "bz_mul", [NODE_DIV] = "bz_div",
+                                     [NODE_EXP] = "bz_exp" };
+    char *a = box(l), *b = box(r);
+    code = temp(e, scope, ST_DYN, format("%s(%s, %s)", generic[node->type], a, b));
+    free(a);
+    free(b);
+    release(l);
+    release(r);
+    return operand(code, ST_DYN);
+  }
+
+  char *a, *b;
+  if (node->type == NODE_DIV) {
+    // The divisor is tested before it is used
+    if (r.type != ST_BOOL) {
+      r.code = temp(e, scope, r.type, r.code);
+      line(e, "if (%s == 0) bz_division_by_zero();", r.code);
+    }
+    a = as_float(l);
+    b = as_float(r);
+    code = format("(%s / %s)", a, b);
+  } else if (node->type == NODE_EXP) {
+    a = as_float(l);
+    b = as_float(r);
+    code = format("bz_pow(%s, %s)", a, b);
+  } else if (type == ST_FLOAT) {
+    a = as_float(l);
+    b = as_float(r);
+    code = format("(%s %c %s)", a, node->type == NODE_ADD ? '+' : node->type == NODE_SUB ? '-' : '*', b);
+  } else {
+    a = format("%s", l.code);
+    b = format("%s", r.code);
+    code = format("%s(%s, %s)", node->type == NODE_ADD ? "bz_iadd" : node->type == NODE_SUB ? "bz_isub" : "bz_imul", a, b);
+  }
+  free(a);
+  free(b);
+  release(l);
+  release(r);
+  return operand(code, type);
+}
+
+static Operand emit_bool_op(Emitter *e, EmitScope *scope, astnode_t *node) {
+  Operand l = emit_expr(e, scope, node->child[0]);
+  if (node->data.bool_op == OP_NOT) {
+    if (l.type == ST_BOT) return l;
+    char *p = payload(l);
+    Operand op = operand(format("(!%s)", p), ST_BOOL);
+    free(p);
+    release(l);
+    return op;
+  }
+
+  Operand r = emit_expr(e, scope, node->child[1]);
+  if (l.type == ST_BOT || r.type == ST_BOT) {
+    release(l);
+    release(r);
+    return unreachable();
+  }
+
+  static const char *ops[] = { [OP_AND] = "&&", [OP_OR] = "||", [OP_EQ] = "==", [OP_NEQ] = "!=",
+                               [OP_LT] = "<", [OP_LE] = "<=", [OP_GT] = ">", [OP_GE] = ">=" };
+  static const char *names[] = { [OP_AND] = "BZ_OP_AND", [OP_OR] = "BZ_OP_OR", [OP_EQ] = "BZ_OP_EQ",
+                                 [OP_NEQ] = "BZ_OP_NEQ", [OP_LT] = "BZ_OP_LT", [OP_LE] = "BZ_OP_LE",
+                                 [OP_GT] = "BZ_OP_GT", [OP_GE] = "BZ_OP_GE" };
+  enum BoolOpType op = node->data.bool_op;
+  char *code;
+
+  if (l.type == ST_STRING && r.type == ST_STRING && (op == OP_EQ || op == OP_NEQ)) {
+    code = format("(strcmp(%s, %s) == %d)", l.code, r.code, op == OP_EQ ? 0 : 1);
+  } else if (l.type == ST_DYN || r.type == ST_DYN || l.type == ST_STRING || r.type == ST_STRING ||
+             ((l.type == ST_INT || r.type == ST_INT) && (l.type == ST_FLOAT || r.type == ST_FLOAT))) {
+    char *a = box(l), *b = box(r);
+    code = format("bz_compare(%s, %s, %s)", names[op], a, b);
+    free(a);
+    free(b);
+  } else if (l.type == ST_INT || r.type == ST_INT) {
+    // Ints may be bignums, which compare by value
+    code = format("bz_icmp(%s, %s, %s)", names[op], l.code, r.code);
+  } else {
+    // Numbers compare by payload, like the interpreter (floats by their bits)
+    char *a = payload(l), *b = payload(r);
+    code = format("(%s %s %s)", a, ops[op], b);
+    free(a);
+    free(b);
+  }
+  release(l);
+  release(r);
+  return operand(code, ST_BOOL);
+}
+
+static Operand emit_call(Emitter *e, EmitScope *scope, astnode_t *node) {
+  EmitScope *callee = find_func(e, node->data.id);
+  if (!callee) {
+    line(e, "bz_error(\"Error: '%%s' is not defined as a function.\\n\", \"%s\");", node->data.id);
+    return unreachable();
+  }
+  line(e, "if (!d_%s) bz_error(\"Error: '%%s' is not defined as a function.\\n\", \"%s\");",
+       callee->name, callee->name);
+
+  astnode_t *args = node->child[0];
+  Operand values[MAXCHILDREN];
+  int argc = 0;
+  for (int i = 0; i < MAXCHILDREN && args && args->child[i]; i++) {
+    values[argc++] = emit_expr(e, scope, args->child[i]);
+  }
+
+  Operand result;
+  if (argc > callee->nparams) {
+    line(e, "bz_error(\"Error: too many arguments for function '%%s'.\\n\", \"%s\");", callee->name);
+    result = unreachable();
+  } else {
+    size_t size = 1;
+    char *list = emit_alloc(NULL, size);
+    list[0] = '\0';
+    for (int i = 0; i < callee->nparams; i++) {
+      char *arg = i < argc ? convert(values[i], e->frames ? ST_DYN : callee->vars[i].type)
+                           : format("(BzValue)BZ_UNSET_VALUE");
+      size += strlen(arg) + 2;
+      list = emit_alloc(list, size);
+      if (i > 0) strcat(list, ", ");
+      strcat(list, arg);
+      free(arg);
+    }
+    StaticType ret = e->frames ? ST_DYN : callee->ret;
+    result = operand(temp(e, scope, ret, format("f_%s(%s)", callee->name, list)), ret);
+    free(list);
+  }
+  for (int i = 0; i < argc; i++) release(values[i]);
+  return result;
+}
+
+static Operand emit_index(Emitter *e, EmitScope *scope, astnode_t *node) {
+  Operand var = emit_raw(e, scope, node->data.id);
+  if (var.type == ST_BOT) return var;
+
+  char *s;
+  if (var.type == ST_STRING) {
+    s = var.code;
+  } else {
+    char *boxed_var = box(var);
+    s = temp(e, scope, ST_STRING, format("bz_indexed(\"%s\", %s)", node->data.id, boxed_var));
+    free(boxed_var);
+    release(var);
+  }
+
+  astnode_t *slice = node->child[0];
+  if (!slice || slice->type != NODE_SLICE) {
+    free(s);
+    return emit_error(e, "Error: element inside braces has to be a slice!\\n");
+  }
+
+  Operand first = emit_expr(e, scope, slice->child[0]);
+  if (first.type == ST_BOT) {
+    free(s);
+    return first;
+  }
+  char *start = temp(e, scope, ST_INT, payload(first));
+  release(first);
+  line(e, "bz_check_index(%s, %s);", s, start);
+
+  Operand result;
+  if (slice->child[1]) {
+    Operand second = emit_expr(e, scope, slice->child[1]);
+    if (second.type == ST_BOT) {
+      result = second;
+    } else {
+      char *end = payload(second);
+      result = operand(temp(e, scope, ST_STRING, format("bz_slice(%s, %s, %s)", s, start, end)), ST_STRING);
+      free(end);
+      release(second);
+    }
+  } else {
+    result = operand(temp(e, scope, ST_STRING, format("bz_char_at(%s, %s)", s, start)), ST_STRING);
+  }
+  free(start);
+  free(s);
+  return result;
+}
+
+static Operand emit_strlen(Emitter *e, EmitScope *scope, astnode_t *node) {
+  Operand var = emit_raw(e, scope, node->data.id);
+  if (var.type == ST_BOT) return var;
+
+  char *code;
+  if (var.type == ST_STRING) {
+    code = format("(int)strlen(%s)", var.code);
+  } else {
+    char *boxed_var = box(var);
+    code = temp(e, scope, ST_INT, format("bz_len(\"%s\", %s)", node->data.id, boxed_var));
+    free(boxed_var);
+  }
+  release(var);
+  return operand(code, ST_INT);
+}
+
+static Operand emit_expr(Emitter *e, EmitScope *scope, astnode_t *node) {
+  if (!node) return emit_error(e, "Error: NULL pointer in evaluate_expr.\\n");
+
+  switch (node->type) {
+    case NODE_INT:
+      if (node->data.num == INT_MIN) return operand(format("(-2147483647 - 1)"), ST_INT);
+      return operand(format("(%d)", node->data.num), ST_INT);
+    case NODE_FLOAT:
+      // Hexadecimal literals reproduce the parsed float exactly
+      return operand(format("(%af)", (double)node->data.dec), ST_FLOAT);
+    case NODE_BOOL:
+      return operand(format("%d", node->data.boolean ? 1 : 0), ST_BOOL);
+    case NODE_STRING:
+      return emit_string(e, scope, node);
+    case NODE_ID:
+      return emit_read(e, scope, node->data.id);
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+      return emit_arith(e, scope, node);
+    case NODE_BOOL_OP:
+      return emit_bool_op(e, scope, node);
+    case NODE_FUNCCALL:
+      return emit_call(e, scope, node);
+    case NODE_FUNCRET:
+      return emit_expr(e, scope, node->child[0]);
+    case NODE_INDEX:
+      return emit_index(e, scope, node);
+    case NODE_STRLEN:
+      return emit_strlen(e, scope, node);
+    case NODE_BIGINT: {
+      // Converted once, on first use
+      char *digits = bigint_to_string(node->data.big);
+      char *literal = c_literal(digits);
+      char *name = format("t%d", scope->temps++);
+      line(e, "static BzInt %s;", name);
+      line(e, "if (!%s) %s = bz_big_digits(%s);", name, name, literal);
+      free(digits);
+      free(literal);
+      return operand(name, ST_INT);
+    }
+    default:
+      line(e, "bz_error(\"%s\", %d);", ERR_UNKNOWN_NODE, node->type);
+      return unreachable();
+  }
+}
+
+// ----------- STATEMENTS -----------
+
+static void emit_stmt(Emitter *e, EmitScope *scope, astnode_t *node);
+
+static void emit_store(Emitter *e, EmitScope *scope, const char *name, Operand op) {
+  if (op.type == ST_BOT) {
+    release(op);
+    return;
+  }
+  EmitVar *var = find_var(scope, name);
+  char *ref = var_ref(e, scope, var);
+  char *value = convert(op, boxed(e, var) ? ST_DYN : var->type);
+  line(e, "%s = %s;", ref, value);
+  free(ref);
+  free(value);
+  release(op);
+}
+
+static void emit_assign(Emitter *e, EmitScope *scope, astnode_t *node) {
+  emit_store(e, scope, node->data.id, emit_expr(e, scope, node->child[0]));
+}
+
+static void emit_print(Emitter *e, EmitScope *scope, astnode_t *node) {
+  astnode_t *args = node->child[0];
+  for (int i = 0; i < MAXCHILDREN && args; i++) {
+    if (!args->child[i]) continue;
+    Operand op = emit_expr(e, scope, args->child[i]);
+    switch (op.type) {
+      case ST_INT:    line(e, "bz_print_int(%s);", op.code); break;
+      case ST_FLOAT:  line(e, "bz_print_float(%s);", op.code); break;
+      case ST_BOOL:   line(e, "bz_print_bool(%s);", op.code); break;
+      case ST_STRING: line(e, "bz_print_str(%s);", op.code); break;
+      case ST_DYN:    line(e, "bz_print(%s);", op.code); break;
+      default:        break;
+    }
+    release(op);
+  }
+}
+
+// C truth value of a loop or if condition
+static char *emit_condition(Emitter *e, EmitScope *scope, astnode_t *node, const char *error) {
+  Operand op = emit_expr(e, scope, node);
+  char *code;
+  if (op.type == ST_BOOL) {
+    code = format("%s", op.code);
+  } else if (op.type == ST_DYN) {
+    code = format("bz_cond(%s, \"%s\")", op.code, error);
+  } else {
+    if (op.type != ST_BOT) line(e, "bz_error(\"%s\");", error);
+    code = format("0");
+  }
+  release(op);
+  return code;
+}
+
+// Mirrors evaluate_loop: only a direct break/continue of the body is understood
+static void emit_loop_body(Emitter *e, EmitScope *scope, astnode_t *body) {
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    astnode_t *child = body->child[i];
+    if (!child) continue;
+    if (child->type == NODE_BREAK) break;
+    if (child->type == NODE_CONTINUE) continue;
+    emit_stmt(e, scope, child);
+  }
+}
+
+static void emit_loop(Emitter *e, EmitScope *scope, astnode_t *node) {
+  int isFor = node->type == NODE_FOR;
+  if (isFor) emit_assign(e, scope, node->child[0]);
+
+  line(e, "for (;;) {");
+  e->indent++;
+  char *cond = emit_condition(e, scope, node->child[isFor ? 1 : 0],
+                              isFor ? "Error: For loop condition must evaluate to a boolean\\n"
+                                    : "Error: While loop condition must evaluate to a boolean\\n");
+  line(e, "if (!%s) break;", cond);
+  free(cond);
+  emit_loop_body(e, scope, node->child[isFor ? 3 : 1]);
+  if (isFor) emit_assign(e, scope, node->child[2]);
+  e->indent--;
+  line(e, "}");
+}
+
+static void emit_if(Emitter *e, EmitScope *scope, astnode_t *node) {
+  char *cond = emit_condition(e, scope, node->child[0],
+                              "Error: If statement condition must evaluate to a boolean\\n");
+  line(e, "if (%s) {", cond);
+  free(cond);
+  e->indent++;
+  emit_stmt(e, scope, node->child[1]);
+  e->indent--;
+  if (node->type == NODE_IFELSE) {
+    line(e, "} else {");
+    e->indent++;
+    emit_stmt(e, scope, node->child[2]);
+    e->indent--;
+  }
+  line(e, "}");
+}
+
+static void emit_stmt(Emitter *e, EmitScope *scope, astnode_t *node) {
+  if (!node) return;
+  Operand op;
+
+  switch (node->type) {
+    case NODE_STMTS:
+      for (int i = 0; i < MAXCHILDREN; i++) emit_stmt(e, scope, node->child[i]);
+      break;
+    case NODE_ASSIGN:
+      emit_assign(e, scope, node);
+      break;
+    case NODE_PRINT:
+      emit_print(e, scope, node);
+      break;
+    case NODE_READ:
+      emit_store(e, scope, node->data.id, operand(format("bz_read()"), ST_STRING));
+      break;
+    case NODE_WHILE:
+    case NODE_FOR:
+      emit_loop(e, scope, node);
+      break;
+    case NODE_IF:
+    case NODE_IFELSE:
+      emit_if(e, scope, node);
+      break;
+    case NODE_FUNC:
+      line(e, "if (d_%s) bz_error(\"Error: this function has already been defined in the script!\\n\");",
+           node->data.id);
+      line(e, "d_%s = 1;", node->data.id);
+      break;
+    case NODE_SNAPSHOT:
+      // Only the interpreter takes snapshots
+      break;
+    default:
+      // Expression statements are evaluated for their effects only
+      op = emit_expr(e, scope, node);
+      if (op.type != ST_BOT && strcmp(op.code, "0") != 0) line(e, "(void)%s;", op.code);
+      release(op);
+      break;
+  }
+}
+
+// ----------- PROGRAM -----------
+
+static void emit_function(Emitter *e, EmitScope *f, int prototype) {
+  StaticType ret = e->frames ? ST_DYN : f->ret;
+  fprintf(e->out, "static %s f_%s(", c_type(ret), f->name);
+  for (int i = 0; i < f->nparams; i++) {
+    if (e->frames) fprintf(e->out, "%sBzValue a%d", i ? ", " : "", i);
+    else fprintf(e->out, "%s%s%s%s", i ? ", " : "", c_type(f->vars[i].type),
+                 f->vars[i].type == ST_STRING ? "" : " ", f->vars[i].name);
+  }
+  if (f->nparams == 0) fprintf(e->out, "void");
+  if (prototype) {
+    fprintf(e->out, ");\n");
+    return;
+  }
+  fprintf(e->out, ") {\n");
+  e->indent = 1;
+
+  if (e->frames) {
+    int count = f->nvars > 0 ? f->nvars : 1;
+    fprintf(e->out, "  static const char *const names[%d] = {", count);
+    for (int i = 0; i < f->nvars; i++) fprintf(e->out, "%s\"%s\"", i ? ", " : " ", f->vars[i].name);
+    fprintf(e->out, "%s};\n", f->nvars ? " " : " \"\" ");
+    fprintf(e->out, "  BzValue l[%d] = {", count);
+    for (int i = 0; i < count; i++) {
+      if (i < f->nparams) fprintf(e->out, "%sa%d", i ? ", " : " ", i);
+      else fprintf(e->out, "%sBZ_UNSET_VALUE", i ? ", " : " ");
+    }
+    fprintf(e->out, " };\n");
+    line(e, "BzFrame frame = { bz_frame, %d, names, l };", f->nvars);
+    line(e, "BzValue result = bz_int(0);");
+    line(e, "bz_frame = &frame;");
+  } else {
+    // Parameters keep their C names; other locals get a prefix
+    for (int i = 0; i < f->nparams; i++) {
+      line(e, "%s%sl_%s = %s;", c_type(f->vars[i].type), f->vars[i].type == ST_STRING ? "" : " ",
+           f->vars[i].name, f->vars[i].name);
+    }
+    for (int i = f->nparams; i < f->nvars; i++) {
+      EmitVar *var = &f->vars[i];
+      if (boxed(e, var)) line(e, "BzValue l_%s = BZ_UNSET_VALUE;", var->name);
+      else line(e, "%s%sl_%s = %s;", c_type(var->type), var->type == ST_STRING ? "" : " ", var->name,
+                var->type == ST_STRING ? "\"\"" : var->type == ST_FLOAT ? "0.0f" : "0");
+    }
+  }
+
+  astnode_t *body = f->def->child[1];
+  int returned = 0;
+  for (int i = 0; i < MAXCHILDREN && !returned; i++) {
+    astnode_t *child = body->child[i];
+    if (!child) continue;
+    if (child->type != NODE_FUNCRET) {
+      emit_stmt(e, f, child);
+      continue;
+    }
+    Operand op = emit_expr(e, f, child->child[0]);
+    char *value = convert(op, ret);
+    if (e->frames) line(e, "result = %s;", value);
+    else line(e, "return %s;", value);
+    free(value);
+    release(op);
+    returned = 1;
+  }
+  if (e->frames) {
+    line(e, "bz_frame = frame.parent;");
+    line(e, "return result;");
+  } else if (!returned) {
+    Operand zero = operand(format("0"), ST_INT);
+    char *value = convert(zero, ret);
+    line(e, "return %s;", value);
+    free(value);
+    release(zero);
+  }
+  fprintf(e->out, "}\n\n");
+}
+
+static void emit_program(Emitter *e, astnode_t *root, const char *source_name) {
+  fprintf(e->out, "/* Generated by BreezeLangCompiler --emit-c from %s */\n", source_name);
+  fprintf(e->out, "#include \"breeze_rt.h\"\n\n");
+
+  if (e->frames) {
+    int count = e->top.nvars > 0 ? e->top.nvars : 1;
+    fprintf(e->out, "static const char *const bz_global_names[%d] = {", count);
+    for (int i = 0; i < e->top.nvars; i++) fprintf(e->out, "%s\"%s\"", i ? ", " : " ", e->top.vars[i].name);
+    fprintf(e->out, "%s};\n", e->top.nvars ? " " : " \"\" ");
+    fprintf(e->out, "static BzValue bz_g[%d];\n", count);
+    fprintf(e->out, "static BzFrame bz_globals = { NULL, %d, bz_global_names, bz_g };\n", e->top.nvars);
+  } else {
+    for (int i = 0; i < e->top.nvars; i++) {
+      EmitVar *var = &e->top.vars[i];
+      if (boxed(e, var)) fprintf(e->out, "static BzValue g_%s = BZ_UNSET_VALUE;\n", var->name);
+      else fprintf(e->out, "static %s%sg_%s;\n", c_type(var->type), var->type == ST_STRING ? "" : " ", var->name);
+    }
+  }
+  for (int i = 0; i < e->nfuncs; i++) fprintf(e->out, "static int d_%s;\n", e->funcs[i].name);
+  fprintf(e->out, "\n");
+
+  for (int i = 0; i < e->nfuncs; i++) emit_function(e, &e->funcs[i], 1);
+  if (e->nfuncs) fprintf(e->out, "\n");
+  for (int i = 0; i < e->nfuncs; i++) emit_function(e, &e->funcs[i], 0);
+
+  fprintf(e->out, "int main(void) {\n");
+  e->indent = 1;
+  if (e->frames) {
+    for (int i = 0; i < e->top.nvars; i++) line(e, "bz_g[%d].type = BZ_UNSET;", i);
+    line(e, "bz_frame = &bz_globals;");
+  }
+  line(e, "bz_start();");
+  emit_stmt(e, &e->top, root);
+  line(e, "return 0;");
+  fprintf(e->out, "}\n");
+}
+
+int emit_c_program(astnode_t *root, const char *source_name, FILE *out) {
+  Emitter e;
+  memset(&e, 0, sizeof(e));
+  e.out = out;
+
+  if (!root) {
+    fprintf(stderr, "Error: No program to compile.\n");
+    return -1;
+  }
+
+  collect_funcs(&e, root);
+  collect_vars(&e, &e.top, root);
+  for (int i = 0; i < e.nfuncs && !e.failed; i++) {
+    EmitScope *f = &e.funcs[i];
+    astnode_t *params = f->def->child[0];
+    for (int j = 0; j < MAXCHILDREN && params && params->child[j]; j++) {
+      if (find_var(f, params->child[j]->data.id)) {
+        reject(&e, "parameter '%s' appears twice", params->child[j]->data.id);
+      }
+      add_var(f, params->child[j]->data.id);
+      f->nparams++;
+    }
+    collect_vars(&e, f, f->def->child[1]);
+  }
+
+  // Functions and variables share one namespace in the interpreter
+  collect_names_in_exprs(&e, root);
+  for (int i = 0; i < e.nfuncs && !e.failed; i++) {
+    if (find_var(&e.top, e.funcs[i].name) || is_function_local(&e, e.funcs[i].name)) {
+      reject(&e, "'%s' is used both as a function and as a variable", e.funcs[i].name);
+    }
+  }
+
+  if (!e.failed) {
+    check_definitions(&e, &e.top, root);
+    for (int i = 0; i < e.nfuncs; i++) check_definitions(&e, &e.funcs[i], e.funcs[i].def->child[1]);
+
+    if (e.frames) {
+      for (int i = 0; i < e.top.nvars; i++) e.top.vars[i].type = ST_DYN;
+      for (int i = 0; i < e.nfuncs; i++) {
+        e.funcs[i].ret = ST_DYN;
+        for (int j = 0; j < e.funcs[i].nvars; j++) e.funcs[i].vars[j].type = ST_DYN;
+      }
+    } else {
+      infer_storage(&e, root);
+    }
+    emit_program(&e, root, source_name);
+  }
+
+  for (int i = 0; i < e.nfuncs; i++) free(e.funcs[i].vars);
+  free(e.funcs);
+  free(e.top.vars);
+  return e.failed ? -1 : 0;
+}
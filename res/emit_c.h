@@ -0,0 +1,26 @@
+#ifndef EMIT_C_H
+#define EMIT_C_H
+
+#include <stdio.h>
+#include "symtab.h"
+
+/**
+ * Ahead-of-time compilation (--emit-c): translate a parsed program into
+ * a standalone C program built on the runtime in breeze_rt.h.
+ *
+ * Variables and expressions whose type never changes are emitted as
+ * native C ints (64 bits wide, so that one can also hold a bignum, see
+ * breeze_rt.h), floats and strings. Everything else goes through the
+ * runtime's dynamic BzValue operations, which mirror evaluate_expr. If a
+ * function reads variables of its callers (dynamic scoping), the program
+ * keeps runtime scope frames so such reads resolve like they do in the
+ * interpreter.
+ *
+ * Programs defining functions inside functions, or using one name both
+ * for a function and a variable, are rejected.
+ *
+ * Returns 0 on success, -1 after printing an error to stderr.
+ */
+int emit_c_program(astnode_t *root, const char *source_name, FILE *out);
+
+#endif
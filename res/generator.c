@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "generator.h"
+#include "coroutine.h"
+#include "context.h"
+#include "ast.h"
+
+typedef enum {
+  GEN_NEW,            // Created, body not started
+  GEN_SUSPENDED,      // Stopped at a yield
+  GEN_RUNNING,        // Body is executing (or an error unwound past it)
+  GEN_DONE            // Body returned
+} GeneratorState;
+
+struct Generator {
+  int refs;
+  GeneratorState state;
+  BreezeContext *ctx;
+  astnode_t *func;            // NODE_FUNC whose body it runs, NULL for a native one
+  Scope *scope;               // Its frame while it is not running
+  Value value;                // Last yielded value, until generator_next takes it
+
+  Coroutine body;             // Its stack is freed once the body is done
+  Coroutine caller;           // Where a yield returns to
+
+  // Interpreter state of the body while it is suspended
+  struct LoopFrame *loop;
+  ForEachFrame *foreach;
+
+  // Native generators (see generator_native)
+  const char *name;
+  int (*next)(void *data, Value *value);
+  void (*drop)(void *data);
+  void *data;
+};
+
+int generator_yields(astnode_t *body) {
+  if (!body || body->type == NODE_FUNC) return 0;
+  if (body->type == NODE_YIELD) return 1;
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (body->child[i] && generator_yields(body->child[i])) return 1;
+  }
+  return 0;
+}
+
+static Generator *allocate_generator(void) {
+  Generator *g = calloc(1, sizeof(Generator));
+  if (!g) {
+    fprintf(stderr, "Error: Memory allocation for a generator failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  return g;
+}
+
+Generator *generator_new(BreezeContext *ctx, astnode_t *func, Scope *frame) {
+  Generator *g = allocate_generator();
+  g->refs = 1;
+  g->state = GEN_NEW;
+  g->ctx = ctx;
+  g->func = func;
+  g->scope = frame;
+  return g;
+}
+
+Generator *generator_native(const char *name, int (*next)(void *data, Value *value),
+                            void (*drop)(void *data), void *data) {
+  Generator *g = allocate_generator();
+  g->refs = 1;
+  g->state = GEN_SUSPENDED;
+  g->name = name;
+  g->next = next;
+  g->drop = drop;
+  g->data = data;
+  return g;
+}
+
+Generator *generator_retain(Generator *g) {
+  g->refs++;
+  return g;
+}
+
+void generator_release(Generator *g) {
+  if (!g || --g->refs > 0) return;
+
+  if (g->next) {
+    g->drop(g->data);
+    free(g);
+    return;
+  }
+
+  if (g->state == GEN_SUSPENDED) {
+    // Abandoned at a yield: drop what its running f{} loops hold
+    for (ForEachFrame *f = g->foreach; f; f = f->outer) {
+      release_value(f->source);
+    }
+  }
+  // A running generator's frame was on the scope stack when an error unwound it
+  if (g->state != GEN_RUNNING && g->scope) {
+    free_scope(g->scope);
+  }
+  coroutine_free(&g->body);
+  free(g);
+}
+
+const char *generator_name(const Generator *g) {
+  return g->func ? g->func->data.id : g->name;
+}
+
+static void run_body(void *arg) {
+  Generator *g = arg;
+  release_value(evaluate_funcbody(g->ctx, g->func->child[1]));
+  g->state = GEN_DONE;
+  coroutine_switch(&g->body, &g->caller);
+}
+
+int generator_next(BreezeContext *ctx, Generator *g, Value *value) {
+  if (g->state == GEN_DONE) return 0;
+  if (g->next) {
+    if (g->next(g->data, value)) return 1;
+    g->state = GEN_DONE;
+    return 0;
+  }
+  if (g->state == GEN_RUNNING) {
+    breeze_error(ctx, "Error: generator '%s' is already running.\n", generator_name(g));
+  }
+
+  // Resuming nests like a call
+  GOVERN(ctx, g->func, NULL);
+  if (ctx->depth >= ctx->max_depth) {
+    breeze_stack_overflow(ctx, generator_name(g));
+  }
+  if (g->state == GEN_NEW && coroutine_start(&g->body, run_body, g) != 0) {
+    breeze_error(ctx, "Error: could not allocate a stack for generator '%s'.\n", generator_name(g));
+  }
+
+  struct LoopFrame *loop = ctx->loop;
+  ForEachFrame *foreach = ctx->foreach;
+  Generator *outer = ctx->generator;
+  const char *function = ctx->function;
+  const char *stack_limit = ctx->stack_limit;
+
+  attach_scope(ctx, g->scope);
+  ctx->loop = g->loop;
+  ctx->foreach = g->foreach;
+  ctx->generator = g;
+  ctx->function = generator_name(g);
+  ctx->stack_limit = coroutine_stack_limit(&g->body);
+  ctx->depth++;
+  g->state = GEN_RUNNING;
+  coroutine_switch(&g->caller, &g->body);
+
+  // Back from a yield, or the body returned
+  g->loop = ctx->loop;
+  g->foreach = ctx->foreach;
+  ctx->loop = loop;
+  ctx->foreach = foreach;
+  ctx->generator = outer;
+  ctx->function = function;
+  ctx->stack_limit = stack_limit;
+  ctx->depth--;
+
+  if (g->state == GEN_DONE) {
+    pop_scope(ctx);
+    g->scope = NULL;
+    coroutine_free(&g->body);
+    return 0;
+  }
+  g->scope = detach_scope(ctx);
+  *value = g->value;
+  return 1;
+}
+
+void generator_yield(BreezeContext *ctx, Value value) {
+  Generator *g = ctx->generator;
+  if (!g) {
+    release_value(value);
+    breeze_error(ctx, "Error: yield outside a generator.\n");
+  }
+  g->value = value;
+  g->state = GEN_SUSPENDED;
+  coroutine_switch(&g->body, &g->caller);
+}
@@ -0,0 +1,68 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "symtab.h"
+#include "scope.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Generators. A d{} function whose body contains `yield` is a generator
+ * function: calling it binds the arguments and returns a generator
+ * without running anything. `f{ x in g -> ... };` resumes the body
+ * until its next `yield v`, runs the loop body with x = v, and ends
+ * when the function returns. Stages that pull from each other this way
+ * form a pipeline that holds one value per stage, never a whole stream.
+ *
+ * A generator's body runs as a coroutine (see coroutine.h), so suspending
+ * keeps its evaluation position as plain C frames. Its Scope is detached from the
+ * scope stack (and its names unbound) while suspended, and attached on
+ * top of the resuming caller's scopes again.
+ *
+ * Generators are reference counted like strings. Dropping the last
+ * reference to an unfinished one frees its frame without resuming it.
+ *
+ * Builtins such as split() return native generators, whose values are
+ * computed by a C function instead of a body.
+ */
+
+typedef struct Generator Generator;
+
+// A running f{ x in g } loop; the interpreter keeps a stack of them in its context
+typedef struct ForEachFrame {
+  Value source;               // Generator or channel it takes values from
+  struct ForEachFrame *outer;
+} ForEachFrame;
+
+// Whether a function body yields (function definitions inside it excluded)
+int generator_yields(astnode_t *body);
+
+/**
+ * A generator for a call of `func`, which takes over `frame`: a scope
+ * taken off the stack with detach_scope() that holds the parameters.
+ */
+Generator *generator_new(BreezeContext *ctx, astnode_t *func, Scope *frame);
+
+/**
+ * A native generator named `name` (static text): next(data, &value)
+ * stores the next value (a new reference) and returns 1, or returns 0
+ * at the end. drop(data) is called when the generator is freed.
+ */
+Generator *generator_native(const char *name, int (*next)(void *data, Value *value),
+                            void (*drop)(void *data), void *data);
+
+Generator *generator_retain(Generator *g);
+void generator_release(Generator *g);
+
+const char *generator_name(const Generator *g);
+
+/**
+ * Run g until it yields: store the value (a new reference) in *value and
+ * return 1. Returns 0 once the body has returned.
+ */
+int generator_next(BreezeContext *ctx, Generator *g, Value *value);
+
+// Suspend the running generator's body, handing `value` to its caller
+void generator_yield(BreezeContext *ctx, Value value);
+
+#endif
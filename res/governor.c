@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "governor.h"
+#include "context.h"
+
+// Fuel until the next check: the clock every interval, the op limit exactly
+static void refill(Governor *g) {
+  long long window = g->max_seconds > 0 ? GOVERNOR_INTERVAL : LLONG_MAX;
+  if (g->max_ops && g->max_ops - g->used < window) {
+    window = g->max_ops - g->used;
+  }
+  g->window = window;
+  g->fuel = window;
+}
+
+void governor_start(BreezeContext *ctx) {
+  Governor *g = &ctx->governor;
+  g->used = 0;
+  clock_gettime(CLOCK_MONOTONIC, &g->started);
+  if (g->max_seconds > 0) {
+    g->deadline = g->started;
+    long long ns = (long long)(g->max_seconds * 1e9) + g->deadline.tv_nsec;
+    g->deadline.tv_sec += (time_t)(ns / 1000000000);
+    g->deadline.tv_nsec = (long)(ns % 1000000000);
+  }
+  refill(g);
+}
+
+// "w{} loop at line 3", "f{} loop over 'i' at line 3 in function 'f'", "function 'f' at line 1"
+static void describe_site(char *buf, size_t size, astnode_t *site, const char *function) {
+  switch (site->type) {
+    case NODE_FUNC:
+      snprintf(buf, size, "function '%s' at line %d", site->data.id, site->line);
+      return;
+    case NODE_FOR:
+      if (site->child[0] && site->child[0]->type == NODE_ASSIGN) {
+        snprintf(buf, size, "f{} loop over '%s'", site->child[0]->data.id);
+      } else {
+        snprintf(buf, size, "f{} loop");
+      }
+      break;
+    case NODE_FOREACH:
+      snprintf(buf, size, "f{} loop over '%s'", site->data.id);
+      break;
+    case NODE_BENCH:
+      snprintf(buf, size, "b{} benchmark");
+      break;
+    default:
+      snprintf(buf, size, "w{} loop");
+      break;
+  }
+  size_t len = strlen(buf);
+  snprintf(buf + len, size - len, " at line %d", site->line);
+  if (function) {
+    len = strlen(buf);
+    snprintf(buf + len, size - len, " in function '%s'", function);
+  }
+}
+
+void governor_tick(BreezeContext *ctx, astnode_t *site, const char *function) {
+  Governor *g = &ctx->governor;
+  char where[BREEZE_ERROR_MAX / 2];
+
+  // This operation is the one that took fuel below zero
+  g->used += g->window - g->fuel;
+  if (g->max_ops && g->used > g->max_ops) {
+    describe_site(where, sizeof(where), site, function ? function : ctx->function);
+    breeze_limit_error(ctx, "Error: operation limit of %lld exceeded in %s.\n",
+                       g->max_ops, where);
+  }
+  if (g->max_seconds > 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > g->deadline.tv_sec ||
+        (now.tv_sec == g->deadline.tv_sec && now.tv_nsec >= g->deadline.tv_nsec)) {
+      describe_site(where, sizeof(where), site, function ? function : ctx->function);
+      breeze_limit_error(ctx, "Error: time limit of %gs exceeded in %s.\n",
+                         g->max_seconds, where);
+    }
+  }
+  refill(g);
+}
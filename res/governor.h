@@ -0,0 +1,47 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <time.h>
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Per-run resource limits. Every loop iteration and function call
+ * spends one operation from `fuel`, a countdown that only reaches zero
+ * when there is something to check: the operation limit, or the clock
+ * every GOVERNOR_INTERVAL operations when a deadline is set. Without
+ * limits the countdown never runs out, so the cost is one decrement.
+ *
+ * Exceeding a limit (these, --max-heap or --max-depth) is reported with
+ * breeze_limit_error(): the process exits with BREEZE_EXIT_LIMIT, and
+ * breeze_run() returns BREEZE_LIMIT.
+ */
+
+#define GOVERNOR_INTERVAL 10000
+
+typedef struct Governor {
+  long long fuel;             // Operations left before governor_tick
+  long long window;           // Fuel given by the last refill
+  long long used;             // Operations spent in earlier windows
+  long long max_ops;          // 0: unlimited
+  double max_seconds;         // 0: no deadline
+  struct timespec deadline;
+  struct timespec started;    // When the run began (clock() counts from it)
+} Governor;
+
+// Spend one operation at a loop back-edge or call (site: loop or NODE_FUNC)
+#define GOVERN(ctx, site, function) do { \
+    if (--(ctx)->governor.fuel < 0) governor_tick((ctx), (site), (function)); \
+  } while (0)
+
+// Reset the counters and start the clock for a new run
+void governor_start(BreezeContext *ctx);
+
+/**
+ * Slow path of GOVERN: fail if a limit is exceeded, naming the site
+ * and the function it is in (NULL: the one being interpreted).
+ */
+void governor_tick(BreezeContext *ctx, astnode_t *site, const char *function);
+
+#endif
@@ -0,0 +1,9 @@
+#include "heap.h"
+
+__thread HeapAccount *heap_account;
+
+HeapAccount *heap_enter(HeapAccount *account) {
+  HeapAccount *outer = heap_account;
+  heap_account = account;
+  return outer;
+}
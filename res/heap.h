@@ -0,0 +1,41 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stddef.h>
+
+/**
+ * Per-context heap accounting for --max-heap. Runtime strings (strval.h)
+ * and BigInts (bigint.h) charge their bytes to the account of the context
+ * evaluating on the thread that allocates them. Each keeps a pointer to
+ * that account and credits it when it is freed, on whatever thread that
+ * happens, so contexts running side by side only see their own bytes.
+ *
+ * Nothing is charged while no context is evaluating on the thread (the
+ * embedding API setting variables, the stdin reader of a task); literals
+ * owned by an AST are not charged either.
+ */
+
+typedef struct HeapAccount {
+  size_t in_use;              // Bytes of live values charged to it
+} HeapAccount;
+
+// The calling thread's account (NULL: none); set with heap_enter()
+extern __thread HeapAccount *heap_account;
+
+/**
+ * Make account the calling thread's (NULL: none) and return the one it
+ * replaces, for the caller to restore when its evaluation ends.
+ */
+HeapAccount *heap_enter(HeapAccount *account);
+
+// Add (or with a negative size, remove) bytes; a NULL account ignores them.
+// Atomic: a value may be freed by another context than the one it counts against
+static inline void heap_charge(HeapAccount *account, long size) {
+  if (account) __atomic_add_fetch(&account->in_use, (size_t)size, __ATOMIC_RELAXED);
+}
+
+static inline size_t heap_in_use(const HeapAccount *account) {
+  return __atomic_load_n(&account->in_use, __ATOMIC_RELAXED);
+}
+
+#endif
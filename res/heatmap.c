@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "heatmap.h"
+
+static Heatmap *volatile sampling;
+
+static void *heatmap_alloc(size_t size) {
+  void *mem = calloc(1, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation for the heatmap failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+Heatmap *heatmap_new(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) return NULL;
+
+  Heatmap *hm = heatmap_alloc(sizeof(Heatmap));
+  int capacity = 64;
+  hm->text = heatmap_alloc(sizeof(char *) * (size_t)capacity);
+  hm->text[0] = NULL;
+  hm->lines = 1;
+  hm->path = path;
+
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t length;
+  while ((length = getline(&line, &size, file)) >= 0) {
+    if (length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+    if (hm->lines == capacity) {
+      capacity *= 2;
+      hm->text = realloc(hm->text, sizeof(char *) * (size_t)capacity);
+      if (!hm->text) {
+        fprintf(stderr, "Error: Memory allocation for the heatmap failed.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    hm->text[hm->lines++] = strdup(line);
+  }
+  free(line);
+  fclose(file);
+
+  hm->hits = heatmap_alloc(sizeof(unsigned long long) * (size_t)hm->lines);
+  hm->samples = heatmap_alloc(sizeof(unsigned long) * (size_t)hm->lines);
+  return hm;
+}
+
+void heatmap_free(Heatmap *hm) {
+  if (!hm) return;
+  heatmap_stop(hm);
+  for (int i = 1; i < hm->lines; i++) free(hm->text[i]);
+  free(hm->text);
+  free(hm->hits);
+  free(hm->samples);
+  free(hm);
+}
+
+static void on_sigprof(int sig) {
+  (void)sig;
+  Heatmap *hm = sampling;
+  if (!hm) return;
+  int line = hm->line;
+  hm->samples[line >= 0 && line < hm->lines ? line : 0]++;
+  hm->total_samples++;
+}
+
+int heatmap_start(Heatmap *hm, int hz) {
+  if (sampling || hz <= 0) return -1;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_sigprof;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) return -1;
+
+  sampling = hm;
+  hm->hz = hz;
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = hz >= 1000000 ? 1 : 1000000 / hz;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    sampling = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+void heatmap_stop(Heatmap *hm) {
+  if (sampling != hm) return;
+  struct itimerval off;
+  memset(&off, 0, sizeof(off));
+  setitimer(ITIMER_PROF, &off, NULL);
+  sampling = NULL;
+}
+
+void heatmap_report(const Heatmap *hm, FILE *out) {
+  unsigned long long total_hits = 0;
+  for (int i = 0; i < hm->lines; i++) total_hits += hm->hits[i];
+
+  fprintf(out, "\nHeatmap of %s: %llu line executions", hm->path, total_hits);
+  if (hm->hz) {
+    fprintf(out, ", %lu time samples", hm->total_samples);
+  }
+  fprintf(out, "\n%12s %7s | %5s\n", "hits", hm->hz ? "time" : "", "line");
+
+  for (int i = 1; i < hm->lines; i++) {
+    char hits[24] = "", share[16] = "";
+    if (hm->hits[i]) snprintf(hits, sizeof(hits), "%llu", hm->hits[i]);
+    if (hm->samples[i] && hm->total_samples) {
+      snprintf(share, sizeof(share), "%.1f%%", 100.0 * hm->samples[i] / hm->total_samples);
+    }
+    fprintf(out, "%12s %7s | %5d  %s\n", hits, share, i, hm->text[i]);
+  }
+  if (hm->samples[0] && hm->total_samples) {
+    fprintf(out, "%12s %6.1f%% | (outside statements)\n", "",
+            100.0 * hm->samples[0] / hm->total_samples);
+  }
+}
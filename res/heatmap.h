@@ -0,0 +1,50 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdio.h>
+
+/**
+ * Per-line execution profile of one script (--heatmap). The interpreter
+ * counts every statement it runs, and every loop condition check, on the
+ * line where it starts. Optionally a SIGPROF timer samples the line
+ * being executed, to show where the time goes. Line 0 collects what
+ * runs outside any statement.
+ */
+typedef struct Heatmap {
+  int lines;                      // Lines of the script, plus line 0
+  char **text;                    // Source of each line, without its newline
+  const char *path;
+  unsigned long long *hits;
+  unsigned long *samples;
+  unsigned long total_samples;
+  int hz;                         // Sampling rate (0: hits only)
+  volatile int line;              // Line being executed
+} Heatmap;
+
+// Count one execution of node's line; costs a branch when ctx has no heatmap
+#define HEATMAP_HIT(ctx, node) do { \
+    if ((ctx)->heatmap) heatmap_hit((ctx)->heatmap, (node)->line); \
+  } while (0)
+
+static inline void heatmap_hit(Heatmap *hm, int line) {
+  if (line >= hm->lines) line = 0;
+  hm->hits[line]++;
+  hm->line = line;
+}
+
+// Load the source listing of `path`; NULL if it cannot be read
+Heatmap *heatmap_new(const char *path);
+void heatmap_free(Heatmap *hm);
+
+/**
+ * Sample the current line `hz` times per second of CPU time until
+ * heatmap_stop(). Signals are process-wide, so only one heatmap can
+ * sample at a time; returns -1 if the timer cannot be set up.
+ */
+int heatmap_start(Heatmap *hm, int hz);
+void heatmap_stop(Heatmap *hm);
+
+// Write the annotated listing: hits and share of samples for every line
+void heatmap_report(const Heatmap *hm, FILE *out);
+
+#endif
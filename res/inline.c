@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inline.h"
+#include "ast.h"
+#include "strval.h"
+#include "bigint.h"
+#include "strlib.h"
+
+// Calls inlined into copies of calls, at most
+#define INLINE_DEPTH 4
+
+typedef struct Candidate {
+  const char *name;
+  astnode_t *def;
+  astnode_t *expr;      // Its return expression, NULL if it is not inlined
+  int nparams;
+  int repeated;         // Defined more than once
+  int leaf;             // See leaf()
+} Candidate;
+
+typedef struct Pass {
+  Candidate *funcs;     // Sorted by name
+  int count;
+} Pass;
+
+static void *inline_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed while inlining.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+// ----------- CANDIDATES -----------
+
+static int compare_candidates(const void *a, const void *b) {
+  return strcmp(((const Candidate *)a)->name, ((const Candidate *)b)->name);
+}
+
+static Candidate *find(Pass *p, const char *name) {
+  Candidate key;
+  key.name = name;
+  return p->count ? bsearch(&key, p->funcs, p->count, sizeof(Candidate), compare_candidates) : NULL;
+}
+
+static void collect(Pass *p, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC) {
+    p->funcs = inline_alloc(p->funcs, sizeof(Candidate) * (p->count + 1));
+    Candidate *c = &p->funcs[p->count++];
+    c->name = node->data.id;
+    c->def = node;
+    c->expr = NULL;
+    c->nparams = 0;
+    c->repeated = c->leaf = 0;
+    while (node->child[0] && c->nparams < MAXCHILDREN && node->child[0]->child[c->nparams]) {
+      c->nparams++;
+    }
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect(p, node->child[i]);
+}
+
+// Slot of a parameter, -1 for other names (the last of repeated ones binds)
+static int param_slot(astnode_t *def, const char *name) {
+  astnode_t *params = def->child[0];
+  int slot = -1;
+  for (int i = 0; params && i < MAXCHILDREN && params->child[i]; i++) {
+    if (strcmp(params->child[i]->data.id, name) == 0) slot = i;
+  }
+  return slot;
+}
+
+// `return expr;` as the whole body
+static astnode_t *return_expr(astnode_t *def) {
+  astnode_t *body = def->child[1];
+  if (!body || def->generator || body->type != NODE_STMTS || body->child[1]) return NULL;
+  astnode_t *ret = body->child[0];
+  if (!ret || ret->type != NODE_FUNCRET) return NULL;
+  return ret->child[0];
+}
+
+// Reads nothing but its parameters and calls only builtins: a callee
+// that cannot see the variables of its caller
+static int leaf(Pass *p, astnode_t *def, astnode_t *node) {
+  if (!node) return 1;
+  switch (node->type) {
+    case NODE_ID:
+      if (param_slot(def, node->data.id) < 0) return 0;
+      break;
+    case NODE_STRLEN: case NODE_INDEX:
+      return 0;
+    case NODE_FUNCCALL:
+      if (find(p, node->data.id) || !strlib_lookup(node->data.id)) return 0;
+      return leaf(p, def, node->child[0]);
+    default:
+      break;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (!leaf(p, def, node->child[i])) return 0;
+  }
+  return 1;
+}
+
+// AST nodes in an expression that can be copied, -1 if it has other kinds
+static int expr_size(Pass *p, astnode_t *def, astnode_t *node) {
+  if (!node) return 0;
+  int size = 1;
+  switch (node->type) {
+    case NODE_INT: case NODE_FLOAT: case NODE_BOOL: case NODE_STRING: case NODE_BIGINT:
+    case NODE_ID: case NODE_ADD: case NODE_SUB: case NODE_MUL: case NODE_DIV: case NODE_EXP:
+    case NODE_BOOL_OP: case NODE_SLICE:
+      break;
+    case NODE_STRLEN:
+    case NODE_INDEX:
+      // They read their variable by name, which a parameter no longer has
+      if (param_slot(def, node->data.id) >= 0) return -1;
+      break;
+    case NODE_FUNCCALL: {
+      // Scoping is dynamic: a callee that may read the parameters needs them bound
+      Candidate *callee = find(p, node->data.id);
+      if (strcmp(node->data.id, def->data.id) == 0 || param_slot(def, node->data.id) >= 0) return -1;
+      int blind = callee ? !callee->repeated && callee->leaf : strlib_lookup(node->data.id) != NULL;
+      if (!blind && def->child[0] && def->child[0]->child[0]) return -1;
+      // Its arguments are in a container node
+      for (int i = 0; node->child[0] && i < MAXCHILDREN; i++) {
+        int arg = expr_size(p, def, node->child[0]->child[i]);
+        if (arg < 0) return -1;
+        size += arg;
+      }
+      return size;
+    }
+    default:
+      return -1;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    int child = expr_size(p, def, node->child[i]);
+    if (child < 0) return -1;
+    size += child;
+  }
+  return size;
+}
+
+static void choose(Pass *p, int max_size) {
+  qsort(p->funcs, p->count, sizeof(Candidate), compare_candidates);
+  for (int i = 0; i < p->count; i++) {
+    Candidate *c = &p->funcs[i];
+    // With several definitions a call may reach any of them
+    c->repeated = (i > 0 && strcmp(c[-1].name, c->name) == 0) ||
+                  (i + 1 < p->count && strcmp(c[1].name, c->name) == 0);
+    astnode_t *expr = return_expr(c->def);
+    c->leaf = expr && leaf(p, c->def, expr);
+  }
+  for (int i = 0; i < p->count; i++) {
+    Candidate *c = &p->funcs[i];
+    astnode_t *expr = c->repeated ? NULL : return_expr(c->def);
+    int size = expr ? expr_size(p, c->def, expr) : -1;
+    if (size > 0 && size <= max_size) c->expr = expr;
+  }
+}
+
+// ----------- COPIES -----------
+
+static astnode_t *copy_expr(astnode_t *def, astnode_t *node) {
+  if (!node) return NULL;
+  astnode_t *copy;
+  int slot = node->type == NODE_ID ? param_slot(def, node->data.id) : -1;
+  if (slot >= 0) {
+    copy = astnode_new(NODE_ARG);
+    copy->data.num = slot;
+  } else {
+    copy = astnode_new(node->type);
+    // Shares the names and text free_ast() leaves alone, copies what it frees
+    copy->data = node->data;
+    if (node->type == NODE_ID) copy->data.id = strdup(node->data.id);
+    if (node->type == NODE_BIGINT) copy->data.big = bigint_literal(node->data.big);
+    if (node->literal) copy->literal = string_literal(node->data.str);
+  }
+  copy->line = node->line;
+  copy->column = node->column;
+  copy->inferred = node->inferred;
+  for (int i = 0; i < MAXCHILDREN; i++) copy->child[i] = copy_expr(def, node->child[i]);
+  return copy;
+}
+
+// `chain` holds the functions whose copies node is in
+static void annotate(Pass *p, astnode_t *node, astnode_t **chain, int depth) {
+  if (!node) return;
+  for (int i = 0; i < MAXCHILDREN; i++) annotate(p, node->child[i], chain, depth);
+  if (node->type != NODE_FUNCCALL || node->inlined || depth >= INLINE_DEPTH) return;
+
+  Candidate *c = find(p, node->data.id);
+  if (!c || !c->expr) return;
+  int argc = 0;
+  while (node->child[0] && argc < MAXCHILDREN && node->child[0]->child[argc]) argc++;
+  if (argc != c->nparams) return;
+  for (int i = 0; i < depth; i++) {
+    if (chain[i] == c->def) return;
+  }
+
+  Inline *in = inline_alloc(NULL, sizeof(Inline));
+  in->def = c->def;
+  in->argc = argc;
+  in->expr = copy_expr(c->def, c->expr);
+  node->inlined = in;
+  chain[depth] = c->def;
+  annotate(p, in->expr, chain, depth + 1);
+}
+
+void inline_calls(astnode_t *root, int max_size) {
+  if (!root || max_size <= 0) return;
+  Pass p = { NULL, 0 };
+  collect(&p, root);
+  if (!p.count) return;
+  choose(&p, max_size);
+  astnode_t *chain[INLINE_DEPTH];
+  annotate(&p, root, chain, 0);
+  free(p.funcs);
+}
+
+void inline_free(Inline *in) {
+  if (!in) return;
+  free_ast(in->expr);
+  free(in);
+}
@@ -0,0 +1,40 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "symtab.h"
+
+/**
+ * Inlining of small functions. A function whose body is a single
+ * `return expr;` of at most ctx->inline_size AST nodes (--inline N, 0
+ * turns it off) is substituted at its call sites: each call gets a copy
+ * of expr in which the parameters read the call's arguments (NODE_ARG)
+ * instead of variables of a new scope. Such a call costs its arguments
+ * and expr alone, with no scope pushed and no parameter bound.
+ *
+ * Names are resolved when a script runs, so an inlined call first checks
+ * that its name still refers to the definition it copied, and makes an
+ * ordinary call otherwise. Calls are only inlined with as many arguments
+ * as parameters (fewer would read the rest from the caller) and never
+ * into themselves. Scoping is dynamic, so a function with parameters is
+ * not inlined if its expression calls one that might read them. Calls
+ * inside a copy are inlined too, a few levels deep. Modules and bodies
+ * parsed by --lazy are left alone.
+ * Inlined calls count as operations for --max-ops, but not towards
+ * --max-depth.
+ */
+
+#define INLINE_DEFAULT_SIZE 16
+
+// A call site's copy of its callee's expression
+typedef struct Inline {
+  astnode_t *def;       // NODE_FUNC it was copied from
+  astnode_t *expr;      // Its return expression, parameters as NODE_ARG
+  int argc;
+} Inline;
+
+// Annotate the calls of a parsed program (after infer_types, whose types the copies keep)
+void inline_calls(astnode_t *root, int max_size);
+
+void inline_free(Inline *in);
+
+#endif
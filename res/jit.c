@@ -0,0 +1,1229 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "common_lib.h"
+#include "jit.h"
+#include "lazy.h"
+
+#define JIT_HOT_CALLS        50    // Calls before a function is compiled
+#define JIT_HOT_ITERATIONS   1000  // Loop iterations before a loop is compiled
+#define JIT_LOOP_ATTEMPTS    4     // Compile attempts before a loop is given up on
+#define JIT_MAX_VARS         64
+#define JIT_MAX_ARGS         5     // Payloads are passed in rsi, rdx, rcx, r8, r9
+#define JIT_MAX_VARIANTS     4     // Type signatures compiled per function
+#define JIT_MAX_CALLEES      32
+#define JIT_BUCKETS          256
+
+/**
+ * Every value handled by compiled code is its 32-bit Value payload: the
+ * int, the float bits or the 0/1 of a bool. Static types decide which
+ * instructions operate on it, exactly mirroring evaluate_expr (including
+ * comparisons on the raw payload).
+ *
+ * Where the interpreter would leave machine ints (an overflow promoting
+ * to a bignum, an int to a negative power) compiled code bails out
+ * instead: jit_deopt() unwinds to jit_call or jit_loop, which drop what
+ * the compiled run did and let the interpreter redo it. Printing cannot
+ * be taken back, so code that prints is only compiled if it cannot bail.
+ */
+typedef uint32_t (*JitFunctionEntry)(BreezeContext *, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+typedef void (*JitLoopEntry)(BreezeContext *, uint32_t *);
+
+typedef enum { JIT_COMPILING, JIT_READY, JIT_FAILED } JitStatus;
+
+// Executable memory plus the string literals it prints
+typedef struct {
+  void *mem;
+  size_t size;
+  char **strings;
+  int nstrings;
+} JitCode;
+
+// A function the compiled code calls; re-checked on entry from the interpreter
+typedef struct {
+  const char *name;
+  astnode_t *def;
+} JitCallee;
+
+typedef struct JitFunction {
+  astnode_t *def;
+  int argc;
+  ValueType argTypes[JIT_MAX_ARGS];
+  ValueType retType;
+  int usedRetType;      // a recursive call relied on retType while compiling
+  JitStatus status;
+  void *entry;          // compiled callers call through this cell
+  JitCode code;
+  JitCallee callees[JIT_MAX_CALLEES];
+  int ncallees;
+  int prints;           // it or a callee prints
+  int deopts;           // it or a callee may bail out (see jit_deopt)
+} JitFunction;
+
+typedef struct {
+  const char *name;
+  ValueType type;
+  int assigned;
+} JitLoopVar;
+
+typedef struct JitLoop {
+  JitLoopEntry entry;
+  JitCode code;
+  JitLoopVar vars[JIT_MAX_VARS];
+  int nvars;
+  JitCallee callees[JIT_MAX_CALLEES];
+  int ncallees;
+} JitLoop;
+
+// Counters and compiled code for one function definition or loop node
+typedef struct JitEntry {
+  astnode_t *node;
+  unsigned long counter;
+  unsigned long threshold;
+  int attempts;
+  int failed;
+  JitLoop *loop;
+  JitFunction *variants[JIT_MAX_VARIANTS];
+  int nvariants;
+  struct JitEntry *next;
+} JitEntry;
+
+struct JitState {
+  JitEntry *buckets[JIT_BUCKETS];
+  jmp_buf *deopt;           // Armed while compiled code runs
+};
+
+// ----------- COMPILATION UNITS -----------
+
+typedef struct {
+  const char *name;
+  ValueType type;
+  int typed;      // type is known
+  int defined;    // definitely assigned at the current point
+} UnitVar;
+
+typedef struct {
+  BreezeContext *ctx;
+  JitState *jit;
+  JitFunction *fn;          // function being compiled, NULL for a loop
+  unsigned char *code;
+  size_t len, cap;
+  int depth;                // 8-byte pushes outstanding since the last aligned point
+  int ok;
+  UnitVar vars[JIT_MAX_VARS];
+  int nvars;
+  JitCallee callees[JIT_MAX_CALLEES];
+  int ncallees;
+  char **strings;
+  int nstrings;
+  int prints;
+  int deopts;
+} JitUnit;
+
+static void fail(JitUnit *u) {
+  u->ok = 0;
+}
+
+static void emit(JitUnit *u, const void *bytes, size_t n) {
+  if (u->len + n > u->cap) {
+    size_t cap = u->cap ? u->cap * 2 : 1024;
+    while (cap < u->len + n) cap *= 2;
+    unsigned char *code = realloc(u->code, cap);
+    if (!code) {
+      fprintf(stderr, "Error: Memory allocation for JIT code failed.\n");
+      exit(EXIT_FAILURE);
+    }
+    u->code = code;
+    u->cap = cap;
+  }
+  memcpy(u->code + u->len, bytes, n);
+  u->len += n;
+}
+
+#define EMIT(u, ...) do { \
+    const unsigned char bytes_[] = { __VA_ARGS__ }; \
+    emit((u), bytes_, sizeof(bytes_)); \
+  } while (0)
+
+static void emit32(JitUnit *u, uint32_t v) {
+  emit(u, &v, 4);
+}
+
+static void emit64(JitUnit *u, uint64_t v) {
+  emit(u, &v, 8);
+}
+
+static void patch32(JitUnit *u, size_t at, uint32_t v) {
+  memcpy(u->code + at, &v, 4);
+}
+
+// Forward jumps return the position of their rel32 for patch_jump
+static size_t emit_jz(JitUnit *u) {
+  EMIT(u, 0x85, 0xC0);              // test eax, eax
+  EMIT(u, 0x0F, 0x84);              // jz rel32
+  emit32(u, 0);
+  return u->len - 4;
+}
+
+static size_t emit_jmp(JitUnit *u) {
+  EMIT(u, 0xE9);                    // jmp rel32
+  emit32(u, 0);
+  return u->len - 4;
+}
+
+static void patch_jump(JitUnit *u, size_t at, size_t target) {
+  patch32(u, at, (uint32_t)(int32_t)(target - (at + 4)));
+}
+
+static void emit_jmp_back(JitUnit *u, size_t target) {
+  EMIT(u, 0xE9);
+  emit32(u, (uint32_t)(int32_t)(target - (u->len + 4)));
+}
+
+static void emit_push(JitUnit *u) {
+  EMIT(u, 0x50);                    // push rax
+  u->depth++;
+}
+
+// Left operand in eax, right operand in ecx
+static void emit_pop_operands(JitUnit *u) {
+  EMIT(u, 0x89, 0xC1);              // mov ecx, eax
+  EMIT(u, 0x58);                    // pop rax
+  u->depth--;
+}
+
+// Call an absolute address with the stack 16-byte aligned (SysV ABI)
+static void emit_call(JitUnit *u, const void *target, int indirect) {
+  int pad = u->depth % 2;
+  if (pad) { EMIT(u, 0x48, 0x83, 0xEC, 0x08); }     // sub rsp, 8
+  EMIT(u, 0x48, 0xB8);                              // mov rax, imm64
+  emit64(u, (uint64_t)(uintptr_t)target);
+  if (indirect) { EMIT(u, 0x48, 0x8B, 0x00); }      // mov rax, [rax]
+  EMIT(u, 0xFF, 0xD0);                              // call rax
+  if (pad) { EMIT(u, 0x48, 0x83, 0xC4, 0x08); }     // add rsp, 8
+}
+
+// GOVERN(ctx, site, function) with the context in r12
+static void emit_govern(JitUnit *u, astnode_t *site) {
+  EMIT(u, 0x49, 0xFF, 0x8C, 0x24);                  // dec qword [r12 + fuel]
+  emit32(u, (uint32_t)offsetof(BreezeContext, governor.fuel));
+  EMIT(u, 0x0F, 0x89);                              // jns done
+  size_t done = u->len;
+  emit32(u, 0);
+  EMIT(u, 0x4C, 0x89, 0xE7);                        // mov rdi, r12
+  EMIT(u, 0x48, 0xBE);                              // mov rsi, imm64
+  emit64(u, (uint64_t)(uintptr_t)site);
+  EMIT(u, 0x48, 0xBA);                              // mov rdx, imm64
+  emit64(u, (uint64_t)(uintptr_t)(u->fn ? u->fn->def->data.id : NULL));
+  emit_call(u, (const void *)governor_tick, 0);
+  patch32(u, done, (uint32_t)(u->len - (done + 4)));
+}
+
+static void emit_load_slot(JitUnit *u, int slot) {
+  EMIT(u, 0x8B, 0x83);              // mov eax, [rbx + disp32]
+  emit32(u, (uint32_t)(slot * 4));
+}
+
+static void emit_store_slot(JitUnit *u, int slot) {
+  EMIT(u, 0x89, 0x83);              // mov [rbx + disp32], eax
+  emit32(u, (uint32_t)(slot * 4));
+}
+
+// Move both operands to xmm0/xmm1 as floats, converting ints and bools
+static void emit_float_operands(JitUnit *u, ValueType lt, ValueType rt) {
+  if (lt == TYPE_FLOAT) { EMIT(u, 0x66, 0x0F, 0x6E, 0xC0); }  // movd xmm0, eax
+  else                  { EMIT(u, 0xF3, 0x0F, 0x2A, 0xC0); }  // cvtsi2ss xmm0, eax
+  if (rt == TYPE_FLOAT) { EMIT(u, 0x66, 0x0F, 0x6E, 0xC9); }  // movd xmm1, ecx
+  else                  { EMIT(u, 0xF3, 0x0F, 0x2A, 0xC9); }  // cvtsi2ss xmm1, ecx
+}
+
+static int find_var(JitUnit *u, const char *name) {
+  for (int i = 0; i < u->nvars; i++) {
+    if (strcmp(u->vars[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+static int add_var(JitUnit *u, const char *name) {
+  if (u->nvars >= JIT_MAX_VARS) {
+    fail(u);
+    return 0;
+  }
+  UnitVar *v = &u->vars[u->nvars];
+  v->name = name;
+  v->typed = 0;
+  v->defined = 0;
+  return u->nvars++;
+}
+
+static void add_callee(JitUnit *u, const char *name, astnode_t *def) {
+  for (int i = 0; i < u->ncallees; i++) {
+    if (u->callees[i].def == def && strcmp(u->callees[i].name, name) == 0) return;
+  }
+  if (u->ncallees >= JIT_MAX_CALLEES) {
+    fail(u);
+    return;
+  }
+  u->callees[u->ncallees].name = name;
+  u->callees[u->ncallees].def = def;
+  u->ncallees++;
+}
+
+// ----------- RUNTIME HELPERS CALLED FROM COMPILED CODE -----------
+
+static void jit_print_value(BreezeContext *ctx, int type, uint32_t payload) {
+  if (!ctx->out) return;
+  Value value;
+  value.data.int_val = (int)payload;
+  if (type == TYPE_FLOAT) {
+    fprintf(ctx->out, "%f", value.data.float_val);
+  } else if (type == TYPE_INT) {
+    fprintf(ctx->out, "%d", value.data.int_val);
+  } else {
+    fprintf(ctx->out, "%s", value.data.int_val ? "true" : "false");
+  }
+}
+
+static void jit_print_string(BreezeContext *ctx, const char *s) {
+  if (ctx->out) fprintf(ctx->out, "%s", s);
+}
+
+static void jit_division_by_zero(BreezeContext *ctx) {
+  breeze_error(ctx, "Error: Division by zero\n");
+}
+
+// Leave compiled code for the interpreter (see the top of this file)
+static void jit_deopt(BreezeContext *ctx) {
+  longjmp(*ctx->jit->deopt, 1);
+}
+
+// An int to an int power, while the result is an int
+static uint32_t jit_int_pow(BreezeContext *ctx, uint32_t base_bits, uint32_t exponent_bits) {
+  int result = 1, square = (int)base_bits, exponent = (int)exponent_bits;
+  if (exponent < 0) jit_deopt(ctx);
+  while (exponent) {
+    if ((exponent & 1) && __builtin_mul_overflow(result, square, &result)) jit_deopt(ctx);
+    exponent >>= 1;
+    if (exponent && __builtin_mul_overflow(square, square, &square)) jit_deopt(ctx);
+  }
+  return (uint32_t)result;
+}
+
+static uint32_t jit_pow(uint32_t base_bits, uint32_t exponent_bits) {
+  Value base, exponent, result;
+  base.data.int_val = (int)base_bits;
+  exponent.data.int_val = (int)exponent_bits;
+  result.data.float_val = pow(base.data.float_val, exponent.data.float_val);
+  return (uint32_t)result.data.int_val;
+}
+
+// ----------- EXPRESSIONS -----------
+
+static JitFunction *get_function(JitState *jit, BreezeContext *ctx, astnode_t *def,
+                                 const ValueType *argTypes, int argc);
+static void compile_stmt(JitUnit *u, astnode_t *node);
+
+static ValueType compile_expr(JitUnit *u, astnode_t *node);
+
+static void compile_operands(JitUnit *u, astnode_t *node, ValueType *lt, ValueType *rt) {
+  *lt = compile_expr(u, node->child[0]);
+  emit_push(u);
+  *rt = compile_expr(u, node->child[1]);
+  emit_pop_operands(u);
+}
+
+// Bail out if the int operation just emitted overflowed
+static void emit_overflow_check(JitUnit *u) {
+  EMIT(u, 0x0F, 0x81);                            // jno done
+  emit32(u, 0);
+  size_t done = u->len - 4;
+  EMIT(u, 0x4C, 0x89, 0xE7);                      // mov rdi, r12
+  emit_call(u, (const void *)jit_deopt, 0);
+  patch_jump(u, done, u->len);
+  u->deopts = 1;
+}
+
+static ValueType compile_arith(JitUnit *u, astnode_t *node) {
+  ValueType lt, rt;
+  compile_operands(u, node, &lt, &rt);
+  int isFloat = (lt == TYPE_FLOAT || rt == TYPE_FLOAT);
+
+  switch (node->type) {
+    case NODE_ADD:
+      if (isFloat) {
+        emit_float_operands(u, lt, rt);
+        EMIT(u, 0xF3, 0x0F, 0x58, 0xC1);          // addss xmm0, xmm1
+        break;
+      }
+      // Adding bools is a runtime error: leave it to the interpreter
+      if (lt != TYPE_INT || rt != TYPE_INT) fail(u);
+      EMIT(u, 0x01, 0xC8);                        // add eax, ecx
+      emit_overflow_check(u);
+      return TYPE_INT;
+
+    case NODE_SUB:
+      if (isFloat) {
+        emit_float_operands(u, lt, rt);
+        EMIT(u, 0xF3, 0x0F, 0x5C, 0xC1);          // subss xmm0, xmm1
+        break;
+      }
+      EMIT(u, 0x29, 0xC8);                        // sub eax, ecx
+      emit_overflow_check(u);
+      return TYPE_INT;
+
+    case NODE_MUL:
+      if (isFloat) {
+        emit_float_operands(u, lt, rt);
+        EMIT(u, 0xF3, 0x0F, 0x59, 0xC1);          // mulss xmm0, xmm1
+        break;
+      }
+      EMIT(u, 0x0F, 0xAF, 0xC1);                  // imul eax, ecx
+      emit_overflow_check(u);
+      return TYPE_INT;
+
+    case NODE_DIV: {
+      size_t ok = 0;
+      if (rt == TYPE_INT) {
+        EMIT(u, 0x85, 0xC9);                      // test ecx, ecx
+      } else if (rt == TYPE_FLOAT) {
+        EMIT(u, 0x89, 0xCA);                      // mov edx, ecx
+        EMIT(u, 0x81, 0xE2);                      // and edx, 0x7fffffff (+0.0 and -0.0)
+        emit32(u, 0x7fffffff);
+      }
+      if (rt != TYPE_BOOL) {
+        EMIT(u, 0x0F, 0x85);                      // jnz ok
+        emit32(u, 0);
+        ok = u->len - 4;
+        EMIT(u, 0x4C, 0x89, 0xE7);                // mov rdi, r12
+        emit_call(u, (const void *)jit_division_by_zero, 0);
+        patch_jump(u, ok, u->len);
+      }
+      emit_float_operands(u, lt, rt);
+      EMIT(u, 0xF3, 0x0F, 0x5E, 0xC1);            // divss xmm0, xmm1
+      break;
+    }
+
+    case NODE_EXP:
+      if (lt == TYPE_INT && rt == TYPE_INT) {
+        EMIT(u, 0x89, 0xC6);                      // mov esi, eax
+        EMIT(u, 0x89, 0xCA);                      // mov edx, ecx
+        EMIT(u, 0x4C, 0x89, 0xE7);                // mov rdi, r12
+        emit_call(u, (const void *)jit_int_pow, 0);
+        u->deopts = 1;
+        return TYPE_INT;
+      }
+      emit_float_operands(u, lt, rt);
+      EMIT(u, 0x66, 0x0F, 0x7E, 0xC7);            // movd edi, xmm0
+      EMIT(u, 0x66, 0x0F, 0x7E, 0xCE);            // movd esi, xmm1
+      emit_call(u, (const void *)jit_pow, 0);
+      return TYPE_FLOAT;
+
+    default:
+      fail(u);
+      return TYPE_INT;
+  }
+
+  EMIT(u, 0x66, 0x0F, 0x7E, 0xC0);                // movd eax, xmm0
+  return TYPE_FLOAT;
+}
+
+static ValueType compile_bool_op(JitUnit *u, astnode_t *node) {
+  if (node->data.bool_op == OP_NOT) {
+    compile_expr(u, node->child[0]);
+    EMIT(u, 0x85, 0xC0);                          // test eax, eax
+    EMIT(u, 0x0F, 0x94, 0xC0);                    // sete al
+    EMIT(u, 0x0F, 0xB6, 0xC0);                    // movzx eax, al
+    return TYPE_BOOL;
+  }
+
+  ValueType lt, rt;
+  compile_operands(u, node, &lt, &rt);
+
+  unsigned char setcc;
+  switch (node->data.bool_op) {
+    case OP_AND:
+    case OP_OR:
+      EMIT(u, 0x85, 0xC0);                        // test eax, eax
+      EMIT(u, 0x0F, 0x95, 0xC0);                  // setne al
+      EMIT(u, 0x85, 0xC9);                        // test ecx, ecx
+      EMIT(u, 0x0F, 0x95, 0xC1);                  // setne cl
+      if (node->data.bool_op == OP_AND) { EMIT(u, 0x20, 0xC8); }   // and al, cl
+      else                              { EMIT(u, 0x08, 0xC8); }   // or al, cl
+      EMIT(u, 0x0F, 0xB6, 0xC0);                  // movzx eax, al
+      return TYPE_BOOL;
+    case OP_EQ:  setcc = 0x94; break;             // sete
+    case OP_NEQ: setcc = 0x95; break;             // setne
+    case OP_LT:  setcc = 0x9C; break;             // setl
+    case OP_LE:  setcc = 0x9E; break;             // setle
+    case OP_GT:  setcc = 0x9F; break;             // setg
+    case OP_GE:  setcc = 0x9D; break;             // setge
+    default:
+      fail(u);
+      return TYPE_BOOL;
+  }
+  // Comparisons look at the raw payloads, like the interpreter
+  EMIT(u, 0x39, 0xC8);                            // cmp eax, ecx
+  EMIT(u, 0x0F, setcc, 0xC0);                     // setcc al
+  EMIT(u, 0x0F, 0xB6, 0xC0);                      // movzx eax, al
+  return TYPE_BOOL;
+}
+
+static ValueType compile_call(JitUnit *u, astnode_t *node) {
+  SymbolNode *fnSymbol = lookup_symbol(u->ctx, node->data.id);
+  astnode_t *argList = node->child[0];
+  if (!fnSymbol || fnSymbol->type != TYPE_FUNCTION || !argList) {
+    fail(u);
+    return TYPE_INT;
+  }
+  astnode_t *def = fnSymbol->data.func_ast;
+  // A lazily parsed callee is parsed now, so that its generator flag is known
+  if (!lazy_ready(def) || def->generator) {
+    fail(u);
+    return TYPE_INT;
+  }
+
+  ValueType argTypes[JIT_MAX_ARGS];
+  int argc = 0;
+  for (int i = 0; i < MAXCHILDREN && argList->child[i]; i++) {
+    if (argc >= JIT_MAX_ARGS) {
+      fail(u);
+      return TYPE_INT;
+    }
+    argTypes[argc++] = compile_expr(u, argList->child[i]);
+    emit_push(u);
+  }
+  if (!u->ok) return TYPE_INT;
+
+  // Only direct recursion may target a function that is still being compiled
+  JitFunction *callee = get_function(u->jit, u->ctx, def, argTypes, argc);
+  if (!callee || callee->status == JIT_FAILED ||
+      (callee->status == JIT_COMPILING && callee != u->fn)) {
+    fail(u);
+    return TYPE_INT;
+  }
+
+  static const unsigned char pops[JIT_MAX_ARGS][2] = {
+    { 0x5E, 0x90 },   // pop rsi
+    { 0x5A, 0x90 },   // pop rdx
+    { 0x59, 0x90 },   // pop rcx
+    { 0x41, 0x58 },   // pop r8
+    { 0x41, 0x59 },   // pop r9
+  };
+  for (int i = argc - 1; i >= 0; i--) {
+    emit(u, pops[i], pops[i][0] == 0x41 ? 2 : 1);
+    u->depth--;
+  }
+  EMIT(u, 0x4C, 0x89, 0xE7);                      // mov rdi, r12
+  emit_call(u, &callee->entry, 1);
+
+  if (callee == u->fn) {
+    callee->usedRetType = 1;
+  } else {
+    for (int i = 0; i < callee->ncallees; i++) {
+      add_callee(u, callee->callees[i].name, callee->callees[i].def);
+    }
+    u->prints |= callee->prints;
+    u->deopts |= callee->deopts;
+  }
+  add_callee(u, node->data.id, def);
+  return callee->retType;
+}
+
+static ValueType compile_expr(JitUnit *u, astnode_t *node) {
+  if (!u->ok || !node) {
+    fail(u);
+    return TYPE_INT;
+  }
+
+  Value literal;
+  int slot;
+
+  switch (node->type) {
+    case NODE_INT:
+      EMIT(u, 0xB8);                              // mov eax, imm32
+      emit32(u, (uint32_t)node->data.num);
+      return TYPE_INT;
+
+    case NODE_FLOAT:
+      literal.data.float_val = node->data.dec;
+      EMIT(u, 0xB8);
+      emit32(u, (uint32_t)literal.data.int_val);
+      return TYPE_FLOAT;
+
+    case NODE_BOOL:
+      EMIT(u, 0xB8);
+      emit32(u, node->data.boolean ? 1 : 0);
+      return TYPE_BOOL;
+
+    case NODE_ID:
+      slot = find_var(u, node->data.id);
+      if (slot < 0 || !u->vars[slot].defined) {
+        fail(u);
+        return TYPE_INT;
+      }
+      emit_load_slot(u, slot);
+      return u->vars[slot].type;
+
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+      return compile_arith(u, node);
+
+    case NODE_BOOL_OP:
+      return compile_bool_op(u, node);
+
+    case NODE_FUNCCALL:
+      return compile_call(u, node);
+
+    case NODE_FUNCRET:
+      return compile_expr(u, node->child[0]);
+
+    default:
+      fail(u);
+      return TYPE_INT;
+  }
+}
+
+// ----------- STATEMENTS -----------
+
+static void compile_assign(JitUnit *u, const char *name, astnode_t *expr) {
+  ValueType type = compile_expr(u, expr);
+  if (!u->ok) return;
+
+  int slot = find_var(u, name);
+  if (slot < 0) {
+    // Loop units know every variable up front; functions grow locals
+    if (!u->fn) {
+      fail(u);
+      return;
+    }
+    slot = add_var(u, name);
+    if (!u->ok) return;
+  }
+  UnitVar *v = &u->vars[slot];
+  if (v->typed && v->type != type) {
+    // A variable changing type is not type-stable
+    fail(u);
+    return;
+  }
+  v->type = type;
+  v->typed = 1;
+  v->defined = 1;
+  emit_store_slot(u, slot);
+}
+
+static void compile_print(JitUnit *u, astnode_t *node) {
+  astnode_t *args = node->child[0];
+  if (!args) {
+    fail(u);
+    return;
+  }
+  u->prints = 1;
+  for (int i = 0; i < MAXCHILDREN && u->ok; i++) {
+    astnode_t *arg = args->child[i];
+    if (!arg) continue;
+
+    if (arg->type == NODE_STRING) {
+      // String literals are printed as-is; escapes that warn stay interpreted
+      if (!arg->literal) {
+        fail(u);
+        return;
+      }
+      char **strings = realloc(u->strings, sizeof(char *) * (u->nstrings + 1));
+      if (!strings) {
+        fail(u);
+        return;
+      }
+      u->strings = strings;
+      char *text = strdup(arg->literal->chars);
+      if (!text) {
+        fail(u);
+        return;
+      }
+      u->strings[u->nstrings++] = text;
+      EMIT(u, 0x4C, 0x89, 0xE7);                  // mov rdi, r12
+      EMIT(u, 0x48, 0xBE);                        // mov rsi, imm64
+      emit64(u, (uint64_t)(uintptr_t)text);
+      emit_call(u, (const void *)jit_print_string, 0);
+    } else {
+      ValueType type = compile_expr(u, arg);
+      EMIT(u, 0x89, 0xC2);                        // mov edx, eax
+      EMIT(u, 0xBE);                              // mov esi, imm32
+      emit32(u, (uint32_t)type);
+      EMIT(u, 0x4C, 0x89, 0xE7);                  // mov rdi, r12
+      emit_call(u, (const void *)jit_print_value, 0);
+    }
+  }
+}
+
+static void compile_condition(JitUnit *u, astnode_t *condition) {
+  // Non-boolean conditions are runtime errors
+  if (compile_expr(u, condition) != TYPE_BOOL) fail(u);
+}
+
+// Snapshot of which variables are definitely assigned, for branches
+static void save_defined(JitUnit *u, int *defined) {
+  for (int i = 0; i < JIT_MAX_VARS; i++) {
+    defined[i] = i < u->nvars ? u->vars[i].defined : 0;
+  }
+}
+
+static void restore_defined(JitUnit *u, const int *defined) {
+  for (int i = 0; i < u->nvars; i++) u->vars[i].defined = defined[i];
+}
+
+// Mirrors evaluate_loop: only a top-level break/continue is understood
+static void compile_loop_body(JitUnit *u, astnode_t *body) {
+  if (!body || body->type != NODE_STMTS) {
+    fail(u);
+    return;
+  }
+  for (int i = 0; i < MAXCHILDREN && u->ok; i++) {
+    astnode_t *child = body->child[i];
+    if (!child) continue;
+    if (child->type == NODE_BREAK) break;
+    if (child->type == NODE_CONTINUE) continue;
+    compile_stmt(u, child);
+  }
+}
+
+// condition; jz end; body; [update]; jmp condition
+static void compile_loop_from_condition(JitUnit *u, astnode_t *node) {
+  astnode_t *condition = node->type == NODE_WHILE ? node->child[0] : node->child[1];
+  astnode_t *body      = node->type == NODE_WHILE ? node->child[1] : node->child[3];
+
+  int before[JIT_MAX_VARS];
+  save_defined(u, before);
+
+  size_t top = u->len;
+  compile_condition(u, condition);
+  size_t exit = emit_jz(u);
+  compile_loop_body(u, body);
+  if (node->type == NODE_FOR) {
+    astnode_t *update = node->child[2];
+    if (!update || update->type != NODE_ASSIGN) {
+      fail(u);
+      return;
+    }
+    compile_assign(u, update->data.id, update->child[0]);
+  }
+  // The interpreter governs the first check, so only the back-edge counts
+  emit_govern(u, node);
+  emit_jmp_back(u, top);
+  patch_jump(u, exit, u->len);
+
+  // The body may not have run at all
+  restore_defined(u, before);
+}
+
+static void compile_stmt(JitUnit *u, astnode_t *node) {
+  if (!u->ok || !node) {
+    fail(u);
+    return;
+  }
+
+  int before[JIT_MAX_VARS], taken[JIT_MAX_VARS];
+  size_t skip, end;
+
+  switch (node->type) {
+    case NODE_STMTS:
+      for (int i = 0; i < MAXCHILDREN && u->ok; i++) {
+        if (node->child[i]) compile_stmt(u, node->child[i]);
+      }
+      break;
+
+    case NODE_ASSIGN:
+      compile_assign(u, node->data.id, node->child[0]);
+      break;
+
+    case NODE_PRINT:
+      compile_print(u, node);
+      break;
+
+    case NODE_WHILE:
+      compile_loop_from_condition(u, node);
+      break;
+
+    case NODE_FOR:
+      if (!node->child[0] || node->child[0]->type != NODE_ASSIGN) {
+        fail(u);
+        return;
+      }
+      compile_assign(u, node->child[0]->data.id, node->child[0]->child[0]);
+      compile_loop_from_condition(u, node);
+      break;
+
+    case NODE_IF:
+      compile_condition(u, node->child[0]);
+      save_defined(u, before);
+      skip = emit_jz(u);
+      compile_stmt(u, node->child[1]);
+      patch_jump(u, skip, u->len);
+      restore_defined(u, before);
+      break;
+
+    case NODE_IFELSE:
+      compile_condition(u, node->child[0]);
+      save_defined(u, before);
+      skip = emit_jz(u);
+      compile_stmt(u, node->child[1]);
+      end = emit_jmp(u);
+      save_defined(u, taken);
+      restore_defined(u, before);
+      patch_jump(u, skip, u->len);
+      compile_stmt(u, node->child[2]);
+      patch_jump(u, end, u->len);
+      // Only what both branches assign is definitely assigned afterwards
+      for (int i = 0; i < u->nvars; i++) {
+        u->vars[i].defined = u->vars[i].defined && taken[i];
+      }
+      break;
+
+    case NODE_FUNC:
+    case NODE_READ:
+    case NODE_BREAK:
+    case NODE_CONTINUE:
+    case NODE_FOREACH:
+    case NODE_YIELD:
+    case NODE_SPAWN:
+    case NODE_SNAPSHOT:
+    case NODE_IMPORT:
+    case NODE_BENCH:
+      fail(u);
+      break;
+
+    default:
+      // Expression statement, evaluated for its effects only
+      compile_expr(u, node);
+      break;
+  }
+}
+
+// ----------- CODE MEMORY -----------
+
+static int finish_code(JitUnit *u, JitCode *code) {
+  long page = sysconf(_SC_PAGESIZE);
+  size_t size = (u->len + (size_t)page - 1) & ~((size_t)page - 1);
+
+  void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return 0;
+  memcpy(mem, u->code, u->len);
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, size);
+    return 0;
+  }
+
+  code->mem = mem;
+  code->size = size;
+  code->strings = u->strings;
+  code->nstrings = u->nstrings;
+  u->strings = NULL;
+  u->nstrings = 0;
+  return 1;
+}
+
+static void release_code(JitCode *code) {
+  if (code->mem) munmap(code->mem, code->size);
+  for (int i = 0; i < code->nstrings; i++) free(code->strings[i]);
+  free(code->strings);
+  memset(code, 0, sizeof(*code));
+}
+
+static void release_unit(JitUnit *u) {
+  for (int i = 0; i < u->nstrings; i++) free(u->strings[i]);
+  free(u->strings);
+  free(u->code);
+}
+
+// Output already written cannot be unwound by a bail-out
+static int prints_and_deopts(JitUnit *u) {
+  return u->prints && u->deopts;
+}
+
+// Locals that shadow a called function would change name resolution
+static int shadows_callee(JitUnit *u) {
+  for (int i = 0; i < u->ncallees; i++) {
+    if (find_var(u, u->callees[i].name) >= 0) return 1;
+  }
+  return 0;
+}
+
+// ----------- ENTRIES -----------
+
+static JitEntry *get_entry(JitState *jit, astnode_t *node) {
+  size_t bucket = ((uintptr_t)node >> 4) % JIT_BUCKETS;
+  for (JitEntry *e = jit->buckets[bucket]; e; e = e->next) {
+    if (e->node == node) return e;
+  }
+  JitEntry *e = calloc(1, sizeof(JitEntry));
+  if (!e) {
+    fprintf(stderr, "Error: Memory allocation for JIT entry failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  e->node = node;
+  e->threshold = JIT_HOT_ITERATIONS;
+  e->next = jit->buckets[bucket];
+  jit->buckets[bucket] = e;
+  return e;
+}
+
+JitState *jit_new(void) {
+  JitState *jit = calloc(1, sizeof(JitState));
+  if (!jit) {
+    fprintf(stderr, "Error: Memory allocation for JIT state failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  return jit;
+}
+
+void jit_free(JitState *jit) {
+  if (!jit) return;
+  for (int b = 0; b < JIT_BUCKETS; b++) {
+    JitEntry *e = jit->buckets[b];
+    while (e) {
+      JitEntry *next = e->next;
+      if (e->loop) {
+        release_code(&e->loop->code);
+        free(e->loop);
+      }
+      for (int i = 0; i < e->nvariants; i++) {
+        release_code(&e->variants[i]->code);
+        free(e->variants[i]);
+      }
+      free(e);
+      e = next;
+    }
+  }
+  free(jit);
+}
+
+// ----------- FUNCTIONS -----------
+
+static int compile_function_body(JitFunction *fn, JitUnit *u) {
+  astnode_t *params = fn->def->child[0];
+  astnode_t *body = fn->def->child[1];
+  if (!params || !body || body->type != NODE_STMTS) return 0;
+
+  for (int i = 0; i < MAXCHILDREN && params->child[i]; i++) {
+    const char *name = params->child[i]->data.id;
+    if (i >= fn->argc || find_var(u, name) >= 0) return 0;
+    int slot = add_var(u, name);
+    u->vars[slot].type = fn->argTypes[i];
+    u->vars[slot].typed = 1;
+    u->vars[slot].defined = 1;
+  }
+  // Missing or surplus arguments are runtime errors
+  if (u->nvars != fn->argc) return 0;
+
+  // push rbx; push r12; push rbp; sub rsp, frame; mov rbx, rsp; mov r12, rdi
+  EMIT(u, 0x53, 0x41, 0x54, 0x55);
+  EMIT(u, 0x48, 0x81, 0xEC);
+  size_t frameSub = u->len;
+  emit32(u, 0);
+  EMIT(u, 0x48, 0x89, 0xE3);
+  EMIT(u, 0x49, 0x89, 0xFC);
+
+  static const unsigned char stores[JIT_MAX_ARGS][3] = {
+    { 0x89, 0xB3, 0 },      // mov [rbx + d], esi
+    { 0x89, 0x93, 0 },      // mov [rbx + d], edx
+    { 0x89, 0x8B, 0 },      // mov [rbx + d], ecx
+    { 0x44, 0x89, 0x83 },   // mov [rbx + d], r8d
+    { 0x44, 0x89, 0x8B },   // mov [rbx + d], r9d
+  };
+  for (int i = 0; i < fn->argc; i++) {
+    emit(u, stores[i], stores[i][2] ? 3 : 2);
+    emit32(u, (uint32_t)(i * 4));
+  }
+
+  // Same operation, depth and native stack limits as evaluate_funccall
+  emit_govern(u, fn->def);
+  EMIT(u, 0x41, 0x8B, 0x84, 0x24);                // mov eax, [r12 + depth]
+  emit32(u, (uint32_t)offsetof(BreezeContext, depth));
+  EMIT(u, 0x41, 0x3B, 0x84, 0x24);                // cmp eax, [r12 + max_depth]
+  emit32(u, (uint32_t)offsetof(BreezeContext, max_depth));
+  EMIT(u, 0x0F, 0x8D);                            // jge overflow
+  size_t tooDeep = u->len;
+  emit32(u, 0);
+  EMIT(u, 0x49, 0x8B, 0x84, 0x24);                // mov rax, [r12 + stack_limit]
+  emit32(u, (uint32_t)offsetof(BreezeContext, stack_limit));
+  EMIT(u, 0x48, 0x39, 0xC4);                      // cmp rsp, rax
+  EMIT(u, 0x0F, 0x83);                            // jae enter
+  size_t fits = u->len;
+  emit32(u, 0);
+  patch_jump(u, tooDeep, u->len);
+  EMIT(u, 0x4C, 0x89, 0xE7);                      // mov rdi, r12
+  EMIT(u, 0x48, 0xBE);                            // mov rsi, imm64
+  emit64(u, (uint64_t)(uintptr_t)fn->def->data.id);
+  emit_call(u, (const void *)breeze_stack_overflow, 0);
+  patch_jump(u, fits, u->len);
+  EMIT(u, 0x41, 0xFF, 0x84, 0x24);                // inc dword [r12 + depth]
+  emit32(u, (uint32_t)offsetof(BreezeContext, depth));
+
+  // Mirrors evaluate_funcbody: only a top-level return ends the function
+  ValueType retType = TYPE_INT;
+  int returned = 0;
+  for (int i = 0; i < MAXCHILDREN && u->ok; i++) {
+    astnode_t *child = body->child[i];
+    if (!child) continue;
+    if (child->type == NODE_FUNCRET) {
+      retType = compile_expr(u, child->child[0]);
+      returned = 1;
+      break;
+    }
+    compile_stmt(u, child);
+  }
+  if (!returned) {
+    EMIT(u, 0xB8);                                // mov eax, 0
+    emit32(u, 0);
+  }
+
+  uint32_t frame = (uint32_t)((u->nvars * 4 + 15) & ~15);
+  patch32(u, frameSub, frame);
+  EMIT(u, 0x41, 0xFF, 0x8C, 0x24);                // dec dword [r12 + depth]
+  emit32(u, (uint32_t)offsetof(BreezeContext, depth));
+  EMIT(u, 0x48, 0x81, 0xC4);                      // add rsp, frame
+  emit32(u, frame);
+  EMIT(u, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);          // pop rbp; pop r12; pop rbx; ret
+
+  if (!u->ok || shadows_callee(u) || prints_and_deopts(u)) return 0;
+  if (fn->usedRetType && retType != fn->retType) {
+    // A recursive call assumed the wrong type; the caller retries once
+    fn->retType = retType;
+    return -1;
+  }
+  fn->retType = retType;
+  return 1;
+}
+
+static JitFunction *compile_function(JitState *jit, BreezeContext *ctx, JitEntry *e,
+                                     const ValueType *argTypes, int argc) {
+  JitFunction *fn = calloc(1, sizeof(JitFunction));
+  if (!fn) return NULL;
+  fn->def = e->node;
+  fn->argc = argc;
+  memcpy(fn->argTypes, argTypes, sizeof(ValueType) * argc);
+  fn->retType = TYPE_INT;
+  fn->status = JIT_COMPILING;
+  e->variants[e->nvariants++] = fn;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    JitUnit u = { .ctx = ctx, .jit = jit, .fn = fn, .ok = 1 };
+    fn->usedRetType = 0;
+    int status = compile_function_body(fn, &u);
+    if (status == 1 && finish_code(&u, &fn->code)) {
+      memcpy(fn->callees, u.callees, sizeof(JitCallee) * u.ncallees);
+      fn->ncallees = u.ncallees;
+      fn->prints = u.prints;
+      fn->deopts = u.deopts;
+      fn->entry = fn->code.mem;
+      fn->status = JIT_READY;
+      release_unit(&u);
+      return fn;
+    }
+    release_unit(&u);
+    if (status != -1) break;
+  }
+  fn->status = JIT_FAILED;
+  return fn;
+}
+
+static JitFunction *get_function(JitState *jit, BreezeContext *ctx, astnode_t *def,
+                                 const ValueType *argTypes, int argc) {
+  JitEntry *e = get_entry(jit, def);
+  for (int i = 0; i < e->nvariants; i++) {
+    JitFunction *fn = e->variants[i];
+    if (fn->argc == argc && memcmp(fn->argTypes, argTypes, sizeof(ValueType) * argc) == 0) {
+      return fn;
+    }
+  }
+  if (e->nvariants >= JIT_MAX_VARIANTS) return NULL;
+  return compile_function(jit, ctx, e, argTypes, argc);
+}
+
+// Entry guard: every function the code calls must still resolve the same way
+static int callees_match(BreezeContext *ctx, const JitCallee *callees, int count) {
+  for (int i = 0; i < count; i++) {
+    SymbolNode *sym = lookup_symbol(ctx, callees[i].name);
+    if (!sym || sym->type != TYPE_FUNCTION || sym->data.func_ast != callees[i].def) return 0;
+  }
+  return 1;
+}
+
+static int jit_type(ValueType type) {
+  return type == TYPE_INT || type == TYPE_FLOAT || type == TYPE_BOOL;
+}
+
+// A bail-out leaves no trace but the depth; the interpreter makes the call
+static int run_function(BreezeContext *ctx, JitEntry *e, JitFunction *fn, const uint32_t *a, uint32_t *ret) {
+  jmp_buf deopt, *outer = ctx->jit->deopt;
+  int depth = ctx->depth;
+  if (setjmp(deopt)) {
+    ctx->jit->deopt = outer;
+    ctx->depth = depth;
+    e->failed = 1;
+    return 0;
+  }
+  ctx->jit->deopt = &deopt;
+  *ret = ((JitFunctionEntry)fn->entry)(ctx, a[0], a[1], a[2], a[3], a[4]);
+  ctx->jit->deopt = outer;
+  return 1;
+}
+
+int jit_call(BreezeContext *ctx, astnode_t *funcDefNode, Value *args, int argCount, Value *result) {
+  JitEntry *e = get_entry(ctx->jit, funcDefNode);
+  if (e->failed || argCount > JIT_MAX_ARGS) return 0;
+
+  ValueType argTypes[JIT_MAX_ARGS];
+  for (int i = 0; i < argCount; i++) {
+    if (!jit_type(args[i].type)) return 0;
+    argTypes[i] = args[i].type;
+  }
+
+  JitFunction *fn = NULL;
+  for (int i = 0; i < e->nvariants && !fn; i++) {
+    JitFunction *v = e->variants[i];
+    if (v->argc == argCount && memcmp(v->argTypes, argTypes, sizeof(ValueType) * argCount) == 0) fn = v;
+  }
+  if (!fn) {
+    if (++e->counter < JIT_HOT_CALLS) return 0;
+    fn = get_function(ctx->jit, ctx, funcDefNode, argTypes, argCount);
+  }
+  if (!fn || fn->status != JIT_READY) return 0;
+  if (!callees_match(ctx, fn->callees, fn->ncallees)) return 0;
+
+  uint32_t a[JIT_MAX_ARGS] = {0};
+  for (int i = 0; i < argCount; i++) a[i] = (uint32_t)args[i].data.int_val;
+  uint32_t ret;
+  if (!run_function(ctx, e, fn, a, &ret)) return 0;
+
+  result->type = fn->retType;
+  result->data.int_val = (int)ret;
+  return 1;
+}
+
+// ----------- LOOPS -----------
+
+static void collect_loop_vars(JitUnit *u, astnode_t *node, int *assigned) {
+  if (!node || !u->ok) return;
+  if (node->type == NODE_ID || node->type == NODE_ASSIGN) {
+    int slot = find_var(u, node->data.id);
+    if (slot < 0) slot = add_var(u, node->data.id);
+    if (!u->ok) return;
+    if (node->type == NODE_ASSIGN) assigned[slot] = 1;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (node->child[i]) collect_loop_vars(u, node->child[i], assigned);
+  }
+}
+
+static int in_top_scope(BreezeContext *ctx, SymbolNode *sym) {
+  return sym->scope == ctx->current_scope;
+}
+
+/**
+ * Compile a loop for on-stack entry at its condition check. The frame
+ * holds every variable the loop touches; they must all exist already
+ * with a JIT type, and those it assigns must live in the top scope.
+ */
+static JitLoop *compile_loop(JitState *jit, BreezeContext *ctx, astnode_t *node) {
+  JitUnit u = { .ctx = ctx, .jit = jit, .ok = 1 };
+  int assigned[JIT_MAX_VARS] = {0};
+  collect_loop_vars(&u, node, assigned);
+
+  for (int i = 0; i < u.nvars && u.ok; i++) {
+    SymbolNode *sym = lookup_symbol(ctx, u.vars[i].name);
+    if (!sym || !jit_type(sym->type) || (assigned[i] && !in_top_scope(ctx, sym))) fail(&u);
+    else {
+      u.vars[i].type = sym->type;
+      u.vars[i].typed = 1;
+      u.vars[i].defined = 1;
+    }
+  }
+  if (!u.ok) {
+    release_unit(&u);
+    return NULL;
+  }
+
+  // push rbx; push r12; push rbp; mov rbx, rsi; mov r12, rdi
+  EMIT(&u, 0x53, 0x41, 0x54, 0x55);
+  EMIT(&u, 0x48, 0x89, 0xF3);
+  EMIT(&u, 0x49, 0x89, 0xFC);
+  compile_loop_from_condition(&u, node);
+  EMIT(&u, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);        // pop rbp; pop r12; pop rbx; ret
+
+  JitLoop *loop = calloc(1, sizeof(JitLoop));
+  if (!loop || !u.ok || shadows_callee(&u) || prints_and_deopts(&u) ||
+      !finish_code(&u, &loop->code)) {
+    free(loop);
+    release_unit(&u);
+    return NULL;
+  }
+  loop->entry = (JitLoopEntry)loop->code.mem;
+  loop->nvars = u.nvars;
+  for (int i = 0; i < u.nvars; i++) {
+    loop->vars[i].name = u.vars[i].name;
+    loop->vars[i].type = u.vars[i].type;
+    loop->vars[i].assigned = assigned[i];
+  }
+  memcpy(loop->callees, u.callees, sizeof(JitCallee) * u.ncallees);
+  loop->ncallees = u.ncallees;
+  release_unit(&u);
+  return loop;
+}
+
+static int run_loop(BreezeContext *ctx, JitEntry *e) {
+  JitLoop *loop = e->loop;
+  SymbolNode *syms[JIT_MAX_VARS];
+  uint32_t frame[JIT_MAX_VARS];
+
+  // Type guards: anything unexpected deoptimizes this entry
+  for (int i = 0; i < loop->nvars; i++) {
+    SymbolNode *sym = lookup_symbol(ctx, loop->vars[i].name);
+    if (!sym || sym->type != loop->vars[i].type) return 0;
+    if (loop->vars[i].assigned && !in_top_scope(ctx, sym)) return 0;
+    syms[i] = sym;
+    frame[i] = (uint32_t)sym->data.int_val;
+  }
+  if (!callees_match(ctx, loop->callees, loop->ncallees)) return 0;
+
+  // After a bail-out the variables still hold what they had on entry
+  jmp_buf deopt, *outer = ctx->jit->deopt;
+  int depth = ctx->depth;
+  if (setjmp(deopt)) {
+    ctx->jit->deopt = outer;
+    ctx->depth = depth;
+    e->failed = 1;
+    return 0;
+  }
+  ctx->jit->deopt = &deopt;
+  loop->entry(ctx, frame);
+  ctx->jit->deopt = outer;
+
+  for (int i = 0; i < loop->nvars; i++) {
+    if (loop->vars[i].assigned) syms[i]->data.int_val = (int)frame[i];
+  }
+  return 1;
+}
+
+int jit_loop(BreezeContext *ctx, astnode_t *loopNode) {
+  JitEntry *e = get_entry(ctx->jit, loopNode);
+  if (e->failed) return 0;
+
+  if (!e->loop) {
+    if (++e->counter < e->threshold) return 0;
+    e->loop = compile_loop(ctx->jit, ctx, loopNode);
+    if (!e->loop) {
+      // Variables may simply not exist yet; back off before retrying
+      e->counter = 0;
+      e->threshold *= 2;
+      if (++e->attempts >= JIT_LOOP_ATTEMPTS) e->failed = 1;
+      return 0;
+    }
+  }
+  return run_loop(ctx, e);
+}
@@ -0,0 +1,40 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "symtab.h"
+
+/**
+ * Optional baseline JIT for x86-64 (enabled with --jit).
+ *
+ * The evaluator counts calls per function and iterations per loop. Once a
+ * function or loop is hot, and every value it touches is an int, float or
+ * bool, its AST is translated template-by-template into machine code in an
+ * mmap'd executable region. Code is specialized on the types seen when it
+ * was compiled. Those types are checked again on every entry, and a
+ * mismatch deoptimizes that entry back to the tree-walking interpreter.
+ * Anything outside the supported subset (strings, input, nested function
+ * definitions...) simply stays interpreted.
+ */
+
+typedef struct JitState JitState;
+typedef struct BreezeContext BreezeContext;
+
+// Allocate/release the per-context JIT state (counters and compiled code).
+JitState *jit_new(void);
+void jit_free(JitState *jit);
+
+/**
+ * Hook for evaluate_funccall, after the arguments have been evaluated.
+ * Returns 1 and stores the result if compiled code handled the call,
+ * 0 if the interpreter should perform it.
+ */
+int jit_call(BreezeContext *ctx, astnode_t *funcDefNode, Value *args, int argCount, Value *result);
+
+/**
+ * Hook for the loop evaluators, called before every condition check.
+ * Returns 1 if compiled code ran the remaining iterations of the loop,
+ * 0 if the interpreter should keep going.
+ */
+int jit_loop(BreezeContext *ctx, astnode_t *loopNode);
+
+#endif
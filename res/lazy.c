@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include "lazy.h"
+#include "context.h"
+#include "ast.h"
+#include "generator.h"
+#include "loopopt.h"
+#include "typeinfer.h"
+
+enum { SCAN_CODE, SCAN_STRING, SCAN_LINE_COMMENT, SCAN_BLOCK_COMMENT };
+
+static pthread_mutex_t parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *lazy_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation for a function body failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+// ----------- SCANNING -----------
+
+void lazy_scan_start(LazyScan *scan, int line, int column) {
+  memset(scan, 0, sizeof(*scan));
+  scan->line = line;
+  scan->column = column;
+  scan->prev[0] = scan->prev[1] = ' ';
+}
+
+static int name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+// `c{` as a token of its own, not the end of a longer name
+static int block_token(const LazyScan *scan, char c) {
+  return scan->prev[1] == c && !name_char(scan->prev[0]);
+}
+
+static void append(LazyScan *scan, char c) {
+  if (scan->length + 1 >= scan->size) {
+    scan->size = scan->size ? scan->size * 2 : 256;
+    scan->text = lazy_alloc(scan->text, scan->size);
+  }
+  scan->text[scan->length++] = c;
+}
+
+int lazy_scan_step(LazyScan *scan, int c) {
+  // What the next character sees before it; comment delimiters are not reused
+  char seen = (char)c;
+  int found = LAZY_SCAN_MORE;
+  switch (scan->state) {
+    case SCAN_STRING:
+      if (c == '"') scan->state = SCAN_CODE;
+      break;
+    case SCAN_LINE_COMMENT:
+      if (c == '\n') scan->state = SCAN_CODE;
+      break;
+    case SCAN_BLOCK_COMMENT:
+      if (c == '/' && scan->prev[1] == '*') {
+        scan->state = SCAN_CODE;
+        seen = ' ';
+      }
+      break;
+    default:
+      if (c == '"') {
+        scan->state = SCAN_STRING;
+      } else if (c == '/' && scan->prev[1] == '/') {
+        scan->state = SCAN_LINE_COMMENT;
+      } else if (c == '*' && scan->prev[1] == '/') {
+        scan->state = SCAN_BLOCK_COMMENT;
+        seen = ' ';
+      } else if (c == '}') {
+        if (scan->depth == 0) return LAZY_SCAN_CLOSE;
+        scan->depth--;
+      } else if (c == '{') {
+        // e{ continues an i{ block rather than opening one
+        if (!block_token(scan, 'e')) scan->depth++;
+        if (block_token(scan, 'd')) scan->defines = 1;
+      } else if (c == ';' && scan->depth == 0) {
+        found = LAZY_SCAN_STATEMENT;
+      }
+      break;
+  }
+  if (scan->state == SCAN_CODE || scan->state == SCAN_BLOCK_COMMENT) {
+    scan->prev[0] = scan->prev[1];
+    scan->prev[1] = seen;
+  }
+  return found;
+}
+
+int lazy_scan_char(LazyScan *scan, int c) {
+  if (lazy_scan_step(scan, c) == LAZY_SCAN_CLOSE) return 1;
+  append(scan, (char)c);
+  return 0;
+}
+
+LazyBody *lazy_scan_finish(LazyScan *scan) {
+  LazyBody *lazy = lazy_alloc(NULL, sizeof(LazyBody));
+  memset(lazy, 0, sizeof(*lazy));
+  append(scan, '\0');
+  lazy->text = scan->text;
+  lazy->length = scan->length - 1;
+  lazy->line = scan->line;
+  lazy->column = scan->column;
+  lazy->defines = scan->defines;
+  return lazy;
+}
+
+void lazy_scan_abort(LazyScan *scan) {
+  free(scan->text);
+  scan->text = NULL;
+}
+
+// ----------- PARSING -----------
+
+// Parse the text in a context of its own, as a program of the body's statements
+static void parse(astnode_t *func) {
+  LazyBody *lazy = func->lazy;
+  BreezeContext *parser = breeze_context_new();
+  parser->err = NULL;
+  parser->lazy_parse = 1;
+  parser->parse_line = lazy->line;
+  parser->parse_column = lazy->column;
+
+  // Grammar actions report some errors through breeze_error
+  jmp_buf recover;
+  volatile int status = 1;
+  parser->error_jmp = &recover;
+  if (setjmp(recover) == 0) {
+    status = breeze_parse_source(parser, lazy->text, lazy->length);
+  }
+  parser->error_jmp = NULL;
+
+  if (status == 0 && parser->root_ast) {
+    astnode_t *body = parser->root_ast;
+    parser->root_ast = NULL;
+    loop_optimize(body);
+    func->child[1] = body;
+    func->generator = generator_yields(body);
+    infer_types_late(func);
+  } else {
+    const char *why = parser->error[0] ? parser->error : "Parsing failed.";
+    if (strncmp(why, "Error: ", 7) == 0) why += 7;
+    int n = (int)strcspn(why, "\n");
+    size_t size = strlen(func->data.id) + (size_t)n + 32;
+    lazy->error = lazy_alloc(NULL, size);
+    snprintf(lazy->error, size, "Error: in function '%s': %.*s\n", func->data.id, n, why);
+  }
+  breeze_context_free(parser);
+  free(lazy->text);
+  lazy->text = NULL;
+}
+
+astnode_t *lazy_ready(astnode_t *func) {
+  LazyBody *lazy = func->lazy;
+  if (lazy && !__atomic_load_n(&lazy->parsed, __ATOMIC_ACQUIRE)) {
+    pthread_mutex_lock(&parse_lock);
+    if (!lazy->parsed) {
+      parse(func);
+      __atomic_store_n(&lazy->parsed, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&parse_lock);
+  }
+  return func->child[1];
+}
+
+astnode_t *lazy_body(BreezeContext *ctx, astnode_t *func) {
+  astnode_t *body = lazy_ready(func);
+  if (!body && func->lazy) {
+    breeze_error(ctx, "%s", func->lazy->error);
+  }
+  return body;
+}
+
+astnode_t *lazy_ready_all(astnode_t *node) {
+  if (!node) return NULL;
+  if (node->type == NODE_FUNC && node->lazy && !lazy_ready(node)) return node;
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    astnode_t *failed = lazy_ready_all(node->child[i]);
+    if (failed) return failed;
+  }
+  return NULL;
+}
+
+void lazy_free(LazyBody *lazy) {
+  if (!lazy) return;
+  free(lazy->text);
+  free(lazy->error);
+  free(lazy);
+}
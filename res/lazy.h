@@ -0,0 +1,74 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <stddef.h>
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Lazy parsing (--lazy, ctx->lazy_parse). The scanner does not tokenize
+ * function bodies: after a definition's `->` it only skips to the
+ * matching `}`, and the NODE_FUNC keeps that source text with no body
+ * (child[1] is NULL). The body is parsed the first time the function is
+ * called, so a script defining many functions and calling few of them
+ * starts faster. Its syntax errors are reported by that call.
+ *
+ * A body parsed late gets the loop optimizer and type inference of its
+ * own locals; its parameters and the functions it calls stay untyped.
+ * Bodies are parsed once per process, under a lock, so a program stays
+ * shareable across contexts and threads.
+ */
+
+typedef struct LazyBody {
+  char *text;         // Source between `->` and the closing `}` (freed once parsed)
+  size_t length;
+  int line, column;   // Where the text starts in the script
+  int defines;        // The text defines functions (see typeinfer.c)
+  int parsed;         // Set (atomically) once the parse was tried
+  char *error;        // Its syntax error, if it failed
+} LazyBody;
+
+/**
+ * Scanner side: from the character after `->`, feed every character to
+ * lazy_scan_char() until it returns 1 for the closing brace. Strings and
+ * comments are skipped the way the scanner would.
+ */
+typedef struct LazyScan {
+  char *text;
+  size_t length, size;
+  int line, column;
+  int depth;          // Blocks opened in the body
+  int state;          // Code, string or comment
+  char prev[2];       // The last two characters of code
+  int defines;
+} LazyScan;
+
+void lazy_scan_start(LazyScan *scan, int line, int column);
+int lazy_scan_char(LazyScan *scan, int c);
+
+/**
+ * The same without keeping the text, to find the statements of a whole
+ * script (see parallel.h): LAZY_SCAN_STATEMENT for the `;` ending one,
+ * LAZY_SCAN_CLOSE for a `}` closing no block.
+ */
+enum { LAZY_SCAN_MORE, LAZY_SCAN_CLOSE, LAZY_SCAN_STATEMENT };
+
+int lazy_scan_step(LazyScan *scan, int c);
+LazyBody *lazy_scan_finish(LazyScan *scan);
+
+// Drop the text of an unfinished body (the source ended first)
+void lazy_scan_abort(LazyScan *scan);
+
+// A function's body, parsed first if need be; a syntax error is a runtime error
+astnode_t *lazy_body(BreezeContext *ctx, astnode_t *func);
+
+// The same, NULL on a syntax error
+astnode_t *lazy_ready(astnode_t *func);
+
+// Parse every body left in node; the function whose body fails, or NULL
+astnode_t *lazy_ready_all(astnode_t *node);
+
+void lazy_free(LazyBody *lazy);
+
+#endif
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loopopt.h"
+#include "generator.h"
+
+// Names assigned somewhere in a loop, with how often
+typedef struct {
+  const char **names;
+  astnode_t **stores;   // The assignment, when there is exactly one
+  int *counts;
+  int count;
+} Assigned;
+
+typedef struct {
+  Assigned assigned;
+  LoopPlan *plan;
+} Analysis;
+
+static void *loopopt_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed in the loop optimizer.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+static int find_name(const Assigned *assigned, const char *name) {
+  for (int i = 0; i < assigned->count; i++) {
+    if (strcmp(assigned->names[i], name) == 0) return i;
+  }
+  return -1;
+}
+
+static void add_name(Assigned *assigned, const char *name, astnode_t *store) {
+  int i = find_name(assigned, name);
+  if (i >= 0) {
+    assigned->counts[i]++;
+    return;
+  }
+  size_t n = (size_t)assigned->count + 1;
+  assigned->names = loopopt_alloc(assigned->names, n * sizeof(*assigned->names));
+  assigned->stores = loopopt_alloc(assigned->stores, n * sizeof(*assigned->stores));
+  assigned->counts = loopopt_alloc(assigned->counts, n * sizeof(*assigned->counts));
+  assigned->names[assigned->count] = name;
+  assigned->stores[assigned->count] = store;
+  assigned->counts[assigned->count] = 1;
+  assigned->count++;
+}
+
+// Everything a loop can write: nested loops included, nested function bodies not
+static void collect_assigned(Assigned *assigned, astnode_t *node) {
+  if (!node) return;
+  switch (node->type) {
+    case NODE_ASSIGN:
+      add_name(assigned, node->data.id, node);
+      break;
+    case NODE_READ:
+    case NODE_FOREACH:
+      add_name(assigned, node->data.id, NULL);
+      break;
+    case NODE_FUNC:
+      add_name(assigned, node->data.id, NULL);
+      return;
+    default:
+      break;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    collect_assigned(assigned, node->child[i]);
+  }
+}
+
+static int is_invariant(const Analysis *a, astnode_t *node) {
+  if (!node) return 1;
+  switch (node->type) {
+    case NODE_INT:
+    case NODE_BIGINT:
+    case NODE_FLOAT:
+    case NODE_BOOL:
+      return 1;
+    case NODE_STRING:
+      // Literals with unknown escapes warn every time they are evaluated
+      return node->literal != NULL;
+    case NODE_ID:
+    case NODE_STRLEN:
+      return find_name(&a->assigned, node->data.id) < 0;
+    case NODE_INDEX:
+      if (find_name(&a->assigned, node->data.id) >= 0 || !node->child[0]) return 0;
+      return is_invariant(a, node->child[0]->child[0]) && is_invariant(a, node->child[0]->child[1]);
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+    case NODE_BOOL_OP:
+      return is_invariant(a, node->child[0]) && is_invariant(a, node->child[1]);
+    default:
+      return 0;
+  }
+}
+
+static int is_literal(astnode_t *node) {
+  return node->type == NODE_INT || node->type == NODE_BIGINT || node->type == NODE_FLOAT ||
+         node->type == NODE_BOOL || node->type == NODE_STRING;
+}
+
+static int add_slot(Analysis *a, astnode_t *node, LoopSlotKind kind) {
+  LoopPlan *plan = a->plan;
+  plan->slots = loopopt_alloc(plan->slots, sizeof(LoopSlot) * (plan->count + 1));
+  plan->slots[plan->count].kind = kind;
+  plan->slots[plan->count].var_child = 0;
+  plan->slots[plan->count].step = 0;
+  node->cached_in = plan;
+  node->cache_slot = plan->count;
+  return plan->count++;
+}
+
+/**
+ * The step of an induction variable: its only assignment in the loop
+ * must be `v = v + c`, `v = c + v` or `v = v - c` with an int literal c.
+ */
+static int induction_step(const Analysis *a, const char *name, int *step) {
+  int i = find_name(&a->assigned, name);
+  if (i < 0 || a->assigned.counts[i] != 1 || !a->assigned.stores[i]) return 0;
+
+  astnode_t *rhs = a->assigned.stores[i]->child[0];
+  if (!rhs || (rhs->type != NODE_ADD && rhs->type != NODE_SUB)) return 0;
+
+  for (int side = 0; side < 2; side++) {
+    astnode_t *var = rhs->child[side], *c = rhs->child[1 - side];
+    if (!var || !c || var->type != NODE_ID || c->type != NODE_INT) continue;
+    if (strcmp(var->data.id, name) != 0) continue;
+    if (rhs->type == NODE_SUB && side == 1) continue;
+    *step = rhs->type == NODE_SUB ? -c->data.num : c->data.num;
+    return 1;
+  }
+  return 0;
+}
+
+static void plan_expr(Analysis *a, astnode_t *node);
+
+static void plan_children(Analysis *a, astnode_t *node) {
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (node->child[i]) plan_expr(a, node->child[i]);
+  }
+}
+
+// Give the largest invariant subexpressions of an expression their slots
+static void plan_expr(Analysis *a, astnode_t *node) {
+  if (is_literal(node)) return;
+
+  if (is_invariant(a, node)) {
+    add_slot(a, node, LOOP_INVARIANT);
+    return;
+  }
+
+  if (node->type == NODE_MUL && node->child[0] && node->child[1]) {
+    for (int side = 0; side < 2; side++) {
+      astnode_t *var = node->child[side], *factor = node->child[1 - side];
+      int step;
+      if (var->type != NODE_ID || !is_invariant(a, factor)) continue;
+      if (!induction_step(a, var->data.id, &step)) continue;
+
+      int slot = add_slot(a, node, LOOP_INDUCTION);
+      a->plan->slots[slot].var_child = side;
+      a->plan->slots[slot].step = step;
+      plan_expr(a, factor);
+      return;
+    }
+  }
+
+  switch (node->type) {
+    case NODE_FUNCCALL:
+    case NODE_SPAWN:
+    case NODE_INDEX:
+      // Arguments and slice bounds hang off a list node
+      if (node->child[0]) plan_children(a, node->child[0]);
+      break;
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+    case NODE_BOOL_OP:
+    case NODE_FUNCRET:
+      plan_children(a, node);
+      break;
+    default:
+      break;
+  }
+}
+
+static void plan_stmt(Analysis *a, astnode_t *node) {
+  if (!node) return;
+  switch (node->type) {
+    case NODE_STMTS:
+      for (int i = 0; i < MAXCHILDREN; i++) plan_stmt(a, node->child[i]);
+      break;
+    case NODE_ASSIGN:
+      if (node->child[0]) plan_expr(a, node->child[0]);
+      break;
+    case NODE_PRINT:
+      if (node->child[0]) plan_children(a, node->child[0]);
+      break;
+    case NODE_IF:
+    case NODE_IFELSE:
+      if (node->child[0]) plan_expr(a, node->child[0]);
+      plan_stmt(a, node->child[1]);
+      plan_stmt(a, node->child[2]);
+      break;
+    case NODE_FOR:
+      // A nested loop caches its own invariants; only its init runs in ours
+      plan_stmt(a, node->child[0]);
+      break;
+    case NODE_WHILE:
+    case NODE_FOREACH:
+    case NODE_BENCH:
+    case NODE_YIELD:
+    case NODE_FUNC:
+    case NODE_READ:
+    case NODE_BREAK:
+    case NODE_CONTINUE:
+      break;
+    default:
+      plan_expr(a, node);
+      break;
+  }
+}
+
+// f{ i = a, i OP b, i = i + c -> } where nothing else assigns i
+static void plan_counter(Analysis *a, astnode_t *node) {
+  astnode_t *init = node->child[0], *condition = node->child[1], *update = node->child[2];
+  int step;
+
+  if (!init || init->type != NODE_ASSIGN || !update || update->type != NODE_ASSIGN) return;
+  if (strcmp(init->data.id, update->data.id) != 0) return;
+  if (!induction_step(a, update->data.id, &step)) return;
+
+  if (condition->type != NODE_BOOL_OP || condition->data.bool_op == OP_AND ||
+      condition->data.bool_op == OP_OR || condition->data.bool_op == OP_NOT) {
+    return;
+  }
+  for (int side = 0; side < 2; side++) {
+    astnode_t *var = condition->child[side];
+    if (var && var->type == NODE_ID && strcmp(var->data.id, init->data.id) == 0) {
+      a->plan->counted = 1;
+      a->plan->counter_child = side;
+      a->plan->counter_step = step;
+      return;
+    }
+  }
+}
+
+static int imports(astnode_t *node) {
+  if (!node || node->type == NODE_FUNC) return 0;
+  if (node->type == NODE_IMPORT) return 1;
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    if (imports(node->child[i])) return 1;
+  }
+  return 0;
+}
+
+static void plan_loop(astnode_t *node) {
+  int isFor = node->type == NODE_FOR;
+  astnode_t *condition = node->child[isFor ? 1 : 0];
+  astnode_t *update = isFor ? node->child[2] : NULL;
+  astnode_t *body = node->child[isFor ? 3 : 1];
+  if (!condition || !body) return;
+
+  Analysis a;
+  memset(&a, 0, sizeof(a));
+  collect_assigned(&a.assigned, condition);
+  collect_assigned(&a.assigned, update);
+  collect_assigned(&a.assigned, body);
+
+  a.plan = loopopt_alloc(NULL, sizeof(LoopPlan));
+  memset(a.plan, 0, sizeof(LoopPlan));
+
+  if (isFor) plan_counter(&a, node);
+  // At a yield the caller runs and may change what the loop reads, and
+  // an import runs a module's top level
+  if (!generator_yields(body) && !imports(body)) {
+    plan_expr(&a, condition);
+    plan_stmt(&a, body);
+    plan_stmt(&a, update);
+  }
+
+  if (a.plan->count > 0 || a.plan->counted) {
+    node->plan = a.plan;
+  } else {
+    loop_plan_free(a.plan);
+  }
+  free(a.assigned.names);
+  free(a.assigned.stores);
+  free(a.assigned.counts);
+}
+
+void loop_optimize(astnode_t *root) {
+  if (!root) return;
+  if ((root->type == NODE_WHILE || root->type == NODE_FOR) && !root->plan) {
+    plan_loop(root);
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    loop_optimize(root->child[i]);
+  }
+}
+
+void loop_plan_free(LoopPlan *plan) {
+  if (!plan) return;
+  free(plan->slots);
+  free(plan);
+}
+
+void loop_invalidate(LoopFrame *frame) {
+  for (; frame; frame = frame->parent) {
+    for (int i = 0; i < frame->plan->count; i++) {
+      if (frame->plan->slots[i].kind == LOOP_INVARIANT) {
+        frame->cache[i].state = LOOP_EMPTY;
+      }
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef LOOPOPT_H
+#define LOOPOPT_H
+
+#include "symtab.h"
+
+/**
+ * Loop optimizer. After parsing, every w{} and f{} loop is analyzed once:
+ *
+ * - Expressions that only read variables the loop never assigns (and do
+ *   not call functions) are invariant. The largest such expressions get
+ *   a cache slot, so `len(s)` in `i < len(s)` or `w * h + 1` in the body
+ *   are computed on first use and reused for the rest of that loop run.
+ * - `x * i`, where i is an induction variable (only ever assigned by
+ *   `i = i + c` or `i = i - c`) and x is invariant, is strength-reduced:
+ *   the product is updated by adding x * c whenever i advanced by c.
+ *
+ * Function calls cannot change the variables a loop reads: assignments
+ * always go to the innermost scope, which is the callee's own. A call
+ * can still print or read input, so expressions containing one are
+ * never cached. A loop that yields suspends its generator and lets the
+ * consumer run, so it caches nothing (it may still be counted); neither
+ * does one that imports a module, whose top level assigns globals.
+ *
+ * Results are cached per run of a loop (a LoopFrame on the interpreter's
+ * C stack), never in the AST, so recursion and concurrent contexts
+ * sharing a program see independent values. Only ints, floats and bools
+ * are cached; each induction step is checked against the variable's
+ * actual value before it is trusted.
+ */
+
+typedef enum {
+  LOOP_INVARIANT,     // Computed once per loop run
+  LOOP_INDUCTION      // Product of an induction variable and an invariant
+} LoopSlotKind;
+
+typedef struct {
+  LoopSlotKind kind;
+  int var_child;      // LOOP_INDUCTION: child of the NODE_MUL that is the variable
+  int step;           // LOOP_INDUCTION: c in i = i + c
+} LoopSlot;
+
+/**
+ * Attached to a NODE_WHILE / NODE_FOR with at least one slot, or to a
+ * counted f{ i = a, i < b, i = i + c -> } loop whose body never assigns
+ * i. The interpreter drives counted loops with a native counter written
+ * straight into i's symbol (any comparison, c may be negative).
+ */
+typedef struct LoopPlan {
+  int count;
+  LoopSlot *slots;
+
+  int counted;
+  int counter_child;  // Child of the condition that reads the counter
+  int counter_step;
+} LoopPlan;
+
+typedef enum { LOOP_EMPTY, LOOP_CACHED, LOOP_UNCACHED } LoopCacheState;
+
+typedef struct {
+  LoopCacheState state;
+  Value value;        // LOOP_INVARIANT: the cached result
+  int last;           // LOOP_INDUCTION: variable the product was computed for
+  int product;        // LOOP_INDUCTION: wrapped int product
+  int step;           // LOOP_INDUCTION: factor * c
+} LoopCache;
+
+// One running loop; the interpreter keeps a stack of them in its context
+typedef struct LoopFrame {
+  const LoopPlan *plan;
+  LoopCache *cache;
+  struct LoopFrame *parent;
+} LoopFrame;
+
+// Analyze all loops of a parsed program (function bodies included)
+void loop_optimize(astnode_t *root);
+
+/**
+ * Forget the invariants cached by `frame` and the loops around it, for a
+ * task resuming after others ran (see task.h): they may have changed
+ * the global variables it reads.
+ */
+void loop_invalidate(LoopFrame *frame);
+
+void loop_plan_free(LoopPlan *plan);
+
+#endif
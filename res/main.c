@@ -1,47 +1,332 @@
 #include <stdio.h>
 #include <string.h> // For strcmp
+#include <unistd.h> // For sysconf
+#include <limits.h> // For INT_MAX
 #include "common_lib.h"
 #include "ast.h"
 #include "parser.tab.h"
+#include "server.h"
+#include "batch.h"
+#include "jit.h"
+#include "emit_c.h"
+#include "typeinfer.h"
+#include "heatmap.h"
+#include "snapshot.h"
+#include "inline.h"
+#include "trace.h"
 
-extern int yyparse(void);
-extern astnode_t *root_ast;
-extern FILE *yyin;
 extern int yydebug;
 
+// Interpreter settings shared by single runs and batch workers
+typedef struct {
+    int use_jit;
+    size_t max_heap;
+    int max_depth;
+    long long max_ops;
+    double timeout;
+    int lazy;
+    int inline_size;
+    int parse_jobs;
+} RunOptions;
+
+// Reported at exit, so runs that stop on an error or a limit get one too
+static Heatmap *heatmap;
+
+static void report_heatmap(void) {
+    fflush(stdout);
+    heatmap_stop(heatmap);
+    heatmap_report(heatmap, stderr);
+    heatmap_free(heatmap);
+}
+
+// Written at exit too when a run stops early; before the program is freed otherwise
+static Trace *trace;
+static FILE *trace_out;
+static const char *trace_path;
+
+static void write_trace(void) {
+    if (!trace) return;
+    if (trace_write(trace, trace_out) != 0 || fclose(trace_out) != 0) {
+        fprintf(stderr, "Error: could not write the trace to '%s'.\n", trace_path);
+    }
+    trace_free(trace);
+    trace = NULL;
+}
+
+// "64M" -> 67108864; returns 0 on a malformed size
+static size_t parse_size(const char *text) {
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'G': case 'g': size <<= 10; /* fall through */
+        case 'M': case 'm': size <<= 10; /* fall through */
+        case 'K': case 'k': size <<= 10; end++; break;
+        default: break;
+    }
+    return (end == text || *end) ? 0 : (size_t)size;
+}
+
+// The whole script, for --snapshot to hash (malloc'd; NULL on a read error)
+static char *read_source(FILE *file, size_t *length) {
+    size_t size = 4096;
+    char *source = malloc(size);
+    *length = 0;
+    while (source) {
+        *length += fread(source + *length, 1, size - *length, file);
+        if (*length < size) break;
+        size *= 2;
+        char *bigger = realloc(source, size);
+        if (!bigger) free(source);
+        source = bigger;
+    }
+    if (source && ferror(file)) {
+        free(source);
+        source = NULL;
+    }
+    return source;
+}
+
+// Directory of a script, where its imports are found (NULL: the working directory)
+static char *script_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return NULL;
+    return strndup(path, slash == path ? 1 : (size_t)(slash - path));
+}
+
+static BreezeContext *new_context(const RunOptions *options) {
+    BreezeContext *ctx = breeze_context_new();
+    if (options->use_jit) {
+        ctx->jit = jit_new();
+    }
+    breeze_set_max_heap(ctx, options->max_heap);
+    breeze_set_max_depth(ctx, options->max_depth);
+    breeze_set_max_ops(ctx, options->max_ops);
+    breeze_set_timeout(ctx, options->timeout);
+    ctx->lazy_parse = options->lazy;
+    ctx->inline_size = options->inline_size;
+    ctx->parse_jobs = options->parse_jobs;
+    return ctx;
+}
+
+// One script of a --jobs batch, run inside its worker process
+static int run_batch_script(const char *path, void *arg) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("Failed to open file");
+        return 1;
+    }
+
+    BreezeContext *ctx = new_context(arg);
+    char *dir = script_dir(path);
+    ctx->import_dir = dir;
+    int status = breeze_parse_file(ctx, file);
+    fclose(file);
+    if (status != 0) {
+        fprintf(stderr, "Parsing failed.\n");
+        breeze_context_free(ctx);
+        free(dir);
+        return 1;
+    }
+    printf("Parsing completed successfully.\n");
+    printf("\nBreezeLang script output: \n");
+    breeze_evaluate(ctx);
+    breeze_context_free(ctx);
+    free(dir);
+    return 0;
+}
+
+#define USAGE "Usage: %s [-v] [--jit] [--lazy] [--inline N] [--parse-jobs N] [--max-heap SIZE[K|M|G]]\n" \
+              "              [--max-depth N] [--max-ops N] [--timeout SECONDS] [--heatmap | --heatmap-time]\n" \
+              "              [--trace FILE] [--snapshot FILE] <input_file>\n" \
+              "       %s [--jobs N] [--jit] [--lazy] [--inline N] [limits...] <input_file>...\n" \
+              "       %s --emit-c <out.c> <input_file>\n" \
+              "       %s --server <socket> <script>...\n" \
+              "       %s --client <socket> [--repeat N] [--stdin] <script>\n"
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [-v] <input_file>\n", argv[0]);
+        fprintf(stderr, USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
 
     int verbose = 0; // Flag to track if -v is present
+    RunOptions options = {0};
+    options.inline_size = INLINE_DEFAULT_SIZE;
+    int jobs = 0;           // 0: no --jobs given
+    int heatmap_hz = -1;    // -1: no heatmap, 0: hit counts only
     char *input_file = NULL;
+    char *server_socket = NULL;
+    char *client_socket = NULL;
+    char *emit_c_file = NULL;
+    char *snapshot_file = NULL;
+    int repeat = 1;
+    int forward_stdin = 0;
+    char **scripts = calloc((size_t)argc, sizeof(char *));
+    int script_count = 0;
 
     // Process command-line arguments
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-v") == 0) {
             verbose = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            options.use_jit = 1;
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+            options.lazy = 1;
+        } else if (strcmp(argv[i], "--inline") == 0 && i + 1 < argc) {
+            char *end;
+            long size = strtol(argv[++i], &end, 10);
+            if (*end || end == argv[i] || size < 0 || size > INT_MAX) {
+                fprintf(stderr, "Error: invalid inlining size '%s'.\n", argv[i]);
+                return 1;
+            }
+            options.inline_size = (int)size;
+        } else if (strcmp(argv[i], "--parse-jobs") == 0 && i + 1 < argc) {
+            options.parse_jobs = atoi(argv[++i]);
+            if (options.parse_jobs <= 0) {
+                fprintf(stderr, "Error: invalid parse thread count '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-heap") == 0 && i + 1 < argc) {
+            options.max_heap = parse_size(argv[++i]);
+            if (!options.max_heap) {
+                fprintf(stderr, "Error: invalid heap size '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            options.max_depth = atoi(argv[++i]);
+            if (options.max_depth <= 0) {
+                fprintf(stderr, "Error: invalid call depth '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-ops") == 0 && i + 1 < argc) {
+            options.max_ops = atoll(argv[++i]);
+            if (options.max_ops <= 0) {
+                fprintf(stderr, "Error: invalid operation limit '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            options.timeout = atof(argv[++i]);
+            if (options.timeout <= 0) {
+                fprintf(stderr, "Error: invalid timeout '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            if (jobs <= 0) {
+                fprintf(stderr, "Error: invalid job count '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--heatmap") == 0) {
+            heatmap_hz = 0;
+        } else if (strcmp(argv[i], "--heatmap-time") == 0) {
+            heatmap_hz = 1000;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot_file = argv[++i];
+        } else if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+            emit_c_file = argv[++i];
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_socket = argv[++i];
+        } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            client_socket = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stdin") == 0) {
+            forward_stdin = 1;
         } else {
             input_file = argv[i];
+            scripts[script_count++] = argv[i];
         }
     }
 
     if (!input_file) {
         fprintf(stderr, "Error: No input file provided.\n");
-        fprintf(stderr, "Usage: %s [-v] <input_file>\n", argv[0]);
+        fprintf(stderr, USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
 
+    if (server_socket) {
+        return breeze_serve(server_socket, scripts, script_count);
+    }
+    if (client_socket) {
+        return breeze_client(client_socket, input_file, repeat > 0 ? repeat : 1, forward_stdin);
+    }
+    if (jobs || script_count > 1) {
+        if (verbose || emit_c_file || heatmap_hz >= 0 || trace_path || snapshot_file) {
+            fprintf(stderr, "Error: -v, --emit-c, --heatmap, --trace and --snapshot take a single script.\n");
+            return 1;
+        }
+        if (!jobs) {
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            jobs = cores > 0 ? (int)cores : 1;
+        }
+        int status = breeze_batch(scripts, script_count, jobs, run_batch_script, &options);
+        free(scripts);
+        return status;
+    }
+    free(scripts);
+
     FILE *file = fopen(input_file, "r");
     if (!file) {
         perror("Failed to open file");
         return 1;
     }
 
+    BreezeContext *ctx = new_context(&options);
+
     yydebug = 0;
-    yyin = file; // Set the input file for Flex
-    if (yyparse() == 0) {
+    if (emit_c_file) {
+        // The C code holds every body
+        ctx->lazy_parse = 0;
+        int status = breeze_parse_file(ctx, file);
+        fclose(file);
+        if (status != 0) {
+            fprintf(stderr, "Parsing failed.\n");
+            breeze_context_free(ctx);
+            return 1;
+        }
+
+        FILE *out = fopen(emit_c_file, "w");
+        if (!out) {
+            perror("Failed to open output file");
+            breeze_context_free(ctx);
+            return 1;
+        }
+        status = emit_c_program(ctx->root_ast, input_file, out);
+        fclose(out);
+        breeze_context_free(ctx);
+        if (status != 0) {
+            remove(emit_c_file);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (snapshot_file) {
+        // Resume after the script's `snapshot;` if a run of this very source saved one
+        size_t length;
+        char *source = read_source(file, &length);
+        if (!source) {
+            perror("Failed to read the script");
+            fclose(file);
+            breeze_context_free(ctx);
+            return 1;
+        }
+        unsigned long long key = snapshot_key(source, length);
+        if (snapshot_restore(ctx, snapshot_file, key) == 0) {
+            printf("Resumed from snapshot '%s'.\n", snapshot_file);
+        } else {
+            if (breeze_parse_buffer(ctx, source, length) == 0) {
+                printf("Parsing completed successfully.\n");
+            } else {
+                fprintf(stderr, "Parsing failed.\n");
+            }
+            ctx->snapshot = snapshot_file;
+            ctx->snapshot_key = key;
+        }
+        free(source);
+    } else if (breeze_parse_file(ctx, file) == 0) {
         printf("Parsing completed successfully.\n");
     } else {
         fprintf(stderr, "Parsing failed.\n");
@@ -51,11 +336,55 @@ int main(int argc, char *argv[]) {
 
     if (verbose) {
         printf("\nScript's Abstract Syntax Tree:\n");
-        print_ast(root_ast, 0);
+        print_ast(ctx->root_ast, 0);
+        report_types(ctx->root_ast, stdout);
+    }
+
+    if (heatmap_hz >= 0) {
+        heatmap = heatmap_new(input_file);
+        if (!heatmap) {
+            perror("Failed to read the script for --heatmap");
+            breeze_context_free(ctx);
+            return 1;
+        }
+        // Compiled code is not counted, so profile the interpreter
+        if (ctx->jit) {
+            fprintf(stderr, "Warning: --heatmap disables --jit.\n");
+            jit_free(ctx->jit);
+            ctx->jit = NULL;
+        }
+        ctx->heatmap = heatmap;
+        atexit(report_heatmap);
+        if (heatmap_hz > 0 && heatmap_start(heatmap, heatmap_hz) != 0) {
+            fprintf(stderr, "Warning: could not start the SIGPROF timer; counting hits only.\n");
+        }
+    }
+
+    if (trace_path) {
+        trace_out = fopen(trace_path, "w");
+        if (!trace_out) {
+            perror("Failed to open the --trace file");
+            breeze_context_free(ctx);
+            return 1;
+        }
+        // Compiled calls and loops are not timed one by one
+        if (ctx->jit) {
+            fprintf(stderr, "Warning: --trace disables --jit.\n");
+            jit_free(ctx->jit);
+            ctx->jit = NULL;
+        }
+        trace = trace_new();
+        ctx->trace = trace;
+        atexit(write_trace);
     }
 
+    char *dir = script_dir(input_file);
+    ctx->import_dir = dir;
     printf("\nBreezeLang script output: \n");
-    evaluate_ast(root_ast);
-    free_ast(root_ast);
+    breeze_evaluate(ctx);
+    write_trace();
+    ctx->trace = NULL;
+    breeze_context_free(ctx);
+    free(dir);
     return 0;
 }
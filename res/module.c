@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "module.h"
+#include "astio.h"
+#include "context.h"
+#include "ast.h"
+#include "strlib.h"
+#include "task.h"
+#include "bench.h"
+#include "loopopt.h"
+#include "typeinfer.h"
+#include "parallel.h"
+
+/**
+ * Cache file layout (see astio.h): magic, NODE_ERROR, the hash of the
+ * source, the module's name, then its AST with the names qualified and
+ * the types inferred. Loading it leaves only the loop plans to compute.
+ */
+#define MODULE_MAGIC "BZMODL03"
+
+// A module loaded by this process; never freed, as runs may still use it
+typedef struct Module {
+  char *name;
+  char *path;
+  char *dir;                // Where the module's own imports are found
+  unsigned long long hash;  // Of the source it was loaded from
+  astnode_t *root;          // Qualified, analyzed and shared read-only
+  struct Module *next;
+} Module;
+
+static Module *modules;
+static pthread_mutex_t modules_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *module_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation for a module failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+static char *join_path(const char *dir, const char *file) {
+  size_t size = strlen(dir) + strlen(file) + 2;
+  char *path = module_alloc(NULL, size);
+  snprintf(path, size, "%s/%s", dir, file);
+  return path;
+}
+
+// ----------- QUALIFIED NAMES -----------
+
+// Sorted copies, as qualifying frees the names it replaces
+typedef struct Names {
+  char **names;
+  int count;
+} Names;
+
+// Where name is, or where it would go
+static int find_name(const Names *n, const char *name, int *found) {
+  int low = 0, high = n ? n->count : 0;
+  *found = 0;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    int order = strcmp(n->names[mid], name);
+    if (order == 0) {
+      *found = 1;
+      return mid;
+    }
+    if (order < 0) low = mid + 1; else high = mid;
+  }
+  return low;
+}
+
+static int has_name(const Names *n, const char *name) {
+  int found;
+  find_name(n, name, &found);
+  return found;
+}
+
+static void add_name(Names *n, const char *name) {
+  int found, at = find_name(n, name, &found);
+  if (found) return;
+  n->names = module_alloc(n->names, sizeof(*n->names) * (size_t)(n->count + 1));
+  memmove(n->names + at + 1, n->names + at, sizeof(*n->names) * (size_t)(n->count - at));
+  n->names[at] = strdup(name);
+  n->count++;
+}
+
+static void free_names(Names *n) {
+  for (int i = 0; i < n->count; i++) free(n->names[i]);
+  free(n->names);
+}
+
+// Names a scope binds: what it assigns and the functions it defines, not their bodies
+static void collect_bound(Names *n, astnode_t *node) {
+  if (!node) return;
+  switch (node->type) {
+    case NODE_FUNC:
+      add_name(n, node->data.id);
+      return;
+    case NODE_ASSIGN:
+    case NODE_READ:
+    case NODE_FOREACH:
+      add_name(n, node->data.id);
+      break;
+    default:
+      break;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect_bound(n, node->child[i]);
+}
+
+static void collect_functions(Names *n, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC) add_name(n, node->data.id);
+  for (int i = 0; i < MAXCHILDREN; i++) collect_functions(n, node->child[i]);
+}
+
+typedef struct Qualify {
+  const char *module;
+  Names top;        // The module's namespace
+  Names functions;  // Every function it defines, nested ones too
+  char *error;
+  size_t error_size;
+  int failed;
+} Qualify;
+
+static void qualify(Qualify *q, astnode_t *node) {
+  size_t size = strlen(q->module) + strlen(node->data.id) + 2;
+  char *name = module_alloc(NULL, size);
+  snprintf(name, size, "%s.%s", q->module, node->data.id);
+  free(node->data.id);
+  node->data.id = name;
+}
+
+/**
+ * Qualify the module's names in node. `locals` are the names bound by
+ * the functions around it (NULL at the top level): the variables they
+ * assign and their parameters stay plain.
+ */
+static void qualify_node(Qualify *q, astnode_t *node, const Names *locals) {
+  if (!node || q->failed) return;
+
+  if (node->type == NODE_FUNC) {
+    if (!locals) qualify(q, node);
+    Names inner = { NULL, 0 };
+    for (int i = 0; locals && i < locals->count; i++) add_name(&inner, locals->names[i]);
+    for (int i = 0; node->child[0] && i < MAXCHILDREN; i++) {
+      if (node->child[0]->child[i]) add_name(&inner, node->child[0]->child[i]->data.id);
+    }
+    collect_bound(&inner, node->child[1]);
+    qualify_node(q, node->child[1], &inner);
+    free_names(&inner);
+    return;
+  }
+
+  switch (node->type) {
+    case NODE_ID: case NODE_ASSIGN: case NODE_READ: case NODE_FOREACH:
+    case NODE_INDEX: case NODE_STRLEN: case NODE_FUNCCALL: case NODE_SPAWN:
+      if (has_name(&q->top, node->data.id) && !has_name(locals, node->data.id)) {
+        qualify(q, node);
+      } else if ((node->type == NODE_FUNCCALL || node->type == NODE_SPAWN) &&
+                 !has_name(&q->functions, node->data.id) && !strchr(node->data.id, '.') &&
+                 !strlib_lookup(node->data.id) && !channel_builtin(node->data.id) &&
+                 !bench_builtin(node->data.id)) {
+        // Functions of the importing script are not visible to analysis
+        snprintf(q->error, q->error_size,
+                 "Error: module '%s' calls %s() at line %d, which it neither defines nor imports.\n",
+                 q->module, node->data.id, node->line);
+        q->failed = 1;
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) qualify_node(q, node->child[i], locals);
+}
+
+static int qualify_module(astnode_t *root, const char *name, char *error, size_t size) {
+  Qualify q = { name, { NULL, 0 }, { NULL, 0 }, error, size, 0 };
+  Names bound = { NULL, 0 };
+  collect_bound(&bound, root);
+  // Names like util.limit belong to the modules this one imports
+  for (int i = 0; i < bound.count; i++) {
+    if (!strchr(bound.names[i], '.')) add_name(&q.top, bound.names[i]);
+  }
+  collect_functions(&q.functions, root);
+  qualify_node(&q, root, NULL);
+  free_names(&bound);
+  free_names(&q.top);
+  free_names(&q.functions);
+  return q.failed ? -1 : 0;
+}
+
+// ----------- DISK CACHE -----------
+
+// NULL when there is no cache: $BREEZE_CACHE is set but empty, or there is no home
+static char *cache_dir(void) {
+  const char *dir = getenv("BREEZE_CACHE");
+  if (dir) return *dir ? strdup(dir) : NULL;
+  dir = getenv("XDG_CACHE_HOME");
+  if (dir && *dir) return join_path(dir, "breeze");
+  dir = getenv("HOME");
+  if (dir && *dir) return join_path(dir, ".cache/breeze");
+  return NULL;
+}
+
+static char *cache_file(unsigned long long hash, const char *name) {
+  char *dir = cache_dir();
+  if (!dir) return NULL;
+  size_t size = strlen(name) + 32;
+  char *file = module_alloc(NULL, size);
+  snprintf(file, size, "%016llx-%s.bzm", hash, name);
+  char *path = join_path(dir, file);
+  free(file);
+  free(dir);
+  return path;
+}
+
+// mkdir -p of the directory holding path
+static int make_parents(char *path) {
+  for (char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    int failed = mkdir(path, 0755) != 0 && errno != EEXIST;
+    *slash = '/';
+    if (failed) return -1;
+  }
+  return 0;
+}
+
+static astnode_t *cache_read(unsigned long long hash, const char *name) {
+  char *path = cache_file(hash, name);
+  size_t size;
+  const char *map = path ? astio_map(path, &size) : NULL;
+  free(path);
+  if (!map) return NULL;
+
+  AstReader r = { map, map + size, 0, 1 };
+  const char *magic = astio_take(&r, 8);
+  astnode_t *root = NULL;
+  uint32_t length;
+  const char *stored;
+  if (magic && memcmp(magic, MODULE_MAGIC, 8) == 0 &&
+      astio_take_u32(&r) == NODE_ERROR && astio_take_u64(&r) == hash &&
+      (stored = astio_take_text(&r, &length)) && length == strlen(name) &&
+      memcmp(stored, name, length) == 0) {
+    root = astio_take_node(&r);
+    if (r.failed || r.p != r.end) {
+      // Damaged: parse again, and the cache is written over
+      free_ast(root);
+      root = NULL;
+    }
+  }
+  astio_unmap(map, size);
+  return root;
+}
+
+// Caching is an optimization: failures are silent
+static void cache_write(unsigned long long hash, const char *name, const astnode_t *root) {
+  char *path = cache_file(hash, name);
+  char *partial;
+  FILE *out = path && make_parents(path) == 0 ? astio_create(path, &partial) : NULL;
+  if (out) {
+    astio_put(out, MODULE_MAGIC, 8);
+    astio_put_u32(out, NODE_ERROR);
+    astio_put_u64(out, hash);
+    astio_put_text(out, name, strlen(name));
+    astio_put_node(out, root);
+    astio_commit(out, partial, path);
+  }
+  free(path);
+}
+
+// ----------- LOADING -----------
+
+// Parse in a context of its own; NULL with the error message on failure
+static astnode_t *parse_module(const char *name, const char *source, size_t length,
+                               char *error, size_t size) {
+  BreezeContext *parser = breeze_context_new();
+  parser->err = NULL;
+
+  // Grammar actions report some errors through breeze_error
+  jmp_buf recover;
+  volatile int status = 1;
+  parser->error_jmp = &recover;
+  if (setjmp(recover) == 0) {
+    status = parse_parallel(parser, source, length);
+  }
+  parser->error_jmp = NULL;
+
+  astnode_t *root = NULL;
+  if (status == 0 && parser->root_ast) {
+    root = parser->root_ast;
+    parser->root_ast = NULL;
+  } else {
+    const char *why = parser->error[0] ? parser->error : "Parsing failed.";
+    if (strncmp(why, "Error: ", 7) == 0) why += 7;
+    int n = (int)strcspn(why, "\n");
+    snprintf(error, size, "Error: in module '%s': %.*s\n", name, n, why);
+  }
+  breeze_context_free(parser);
+  return root;
+}
+
+// The module file for `name` (lib.text: lib/text.bl), searched in dir then $BREEZE_PATH
+static char *find_file(const char *name, const char *dir) {
+  size_t size = strlen(name) + 4;
+  char *relative = module_alloc(NULL, size);
+  snprintf(relative, size, "%s.bl", name);
+  for (char *dot = strchr(relative, '.'); dot && dot < relative + strlen(name); dot = strchr(dot + 1, '.')) {
+    *dot = '/';
+  }
+
+  struct stat st;
+  char *path = join_path(dir ? dir : ".", relative);
+  if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+    free(path);
+    path = NULL;
+    const char *search = getenv("BREEZE_PATH");
+    while (search && *search && !path) {
+      size_t n = strcspn(search, ":");
+      char *entry = strndup(search, n);
+      path = join_path(n > 0 ? entry : ".", relative);
+      free(entry);
+      if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        free(path);
+        path = NULL;
+      }
+      search += n;
+      if (*search == ':') search++;
+    }
+  }
+  free(relative);
+  return path;
+}
+
+static char *parent_dir(const char *path) {
+  const char *slash = strrchr(path, '/');
+  if (!slash) return strdup(".");
+  return strndup(path, slash == path ? 1 : (size_t)(slash - path));
+}
+
+/**
+ * The loaded module for this source, parsing it (or reading its cached
+ * AST) if the process has not seen it yet. Called with modules_lock held.
+ */
+static Module *load_module(const char *name, const char *path, const char *source, size_t length,
+                           char *error, size_t size) {
+  unsigned long long hash = astio_hash(source, length);
+  for (Module *m = modules; m; m = m->next) {
+    if (m->hash == hash && strcmp(m->name, name) == 0 && strcmp(m->path, path) == 0) return m;
+  }
+
+  astnode_t *root = cache_read(hash, name);
+  if (!root) {
+    root = parse_module(name, source, length, error, size);
+    if (!root) return NULL;
+    if (qualify_module(root, name, error, size) != 0) {
+      free_ast(root);
+      return NULL;
+    }
+    infer_types_open(root);
+    cache_write(hash, name, root);
+  }
+  loop_optimize(root);
+
+  Module *m = module_alloc(NULL, sizeof(Module));
+  m->name = strdup(name);
+  m->path = strdup(path);
+  m->dir = parent_dir(path);
+  m->hash = hash;
+  m->root = root;
+  m->next = modules;
+  modules = m;
+  return m;
+}
+
+static Module *find_module(BreezeContext *ctx, const char *name, char *error, size_t size) {
+  char *path = find_file(name, ctx->module ? ctx->module->dir : ctx->import_dir);
+  if (!path) {
+    snprintf(error, size, "Error: cannot find module '%s'.\n", name);
+    return NULL;
+  }
+  size_t length;
+  const char *source = astio_map(path, &length);
+  if (!source) {
+    snprintf(error, size, "Error: cannot read module '%s' from %s.\n", name, path);
+    free(path);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&modules_lock);
+  Module *m = load_module(name, path, source, length, error, size);
+  pthread_mutex_unlock(&modules_lock);
+
+  astio_unmap(source, length);
+  free(path);
+  return m;
+}
+
+// ----------- IMPORTING -----------
+
+void module_import(BreezeContext *ctx, astnode_t *node) {
+  const char *name = node->data.id;
+  if (ctx->depth > 0) {
+    breeze_error(ctx, "Error: import %s is only allowed at the top level of a script.\n", name);
+  }
+  for (ImportedModule *m = ctx->imports; m; m = m->next) {
+    if (strcmp(m->name, name) == 0) return;
+  }
+
+  char error[BREEZE_ERROR_MAX];
+  Module *m = find_module(ctx, name, error, sizeof(error));
+  if (!m) breeze_error(ctx, "%s", error);
+
+  // Marked first, so that modules importing each other run once
+  module_mark_imported(ctx, name);
+  Module *outer = ctx->module;
+  ctx->module = m;
+  evaluate_ast(ctx, m->root);
+  ctx->module = outer;
+}
+
+void module_mark_imported(BreezeContext *ctx, const char *name) {
+  ImportedModule *m = module_alloc(NULL, sizeof(ImportedModule));
+  m->name = strdup(name);
+  m->next = ctx->imports;
+  ctx->imports = m;
+}
+
+void module_forget(BreezeContext *ctx) {
+  while (ctx->imports) {
+    ImportedModule *m = ctx->imports;
+    ctx->imports = m->next;
+    free(m->name);
+    free(m);
+  }
+}
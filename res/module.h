@@ -0,0 +1,41 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Modules. `import helpers;` runs helpers.bl, found next to the script
+ * (ctx->import_dir) or in one of the directories listed in $BREEZE_PATH;
+ * `import lib.text;` loads lib/text.bl. The module's top-level names,
+ * its functions and globals, live in its own namespace and are used
+ * qualified: helpers.clamp(x), helpers.limit. Inside the module they
+ * keep their plain names, and its own imports are found next to it.
+ *
+ * A module's top level runs once per run, at its first import, and only
+ * scripts import (not functions). A module may call the functions it
+ * defines, those of the modules it imports and the string builtins.
+ *
+ * Parsed modules are shared read-only by every context of the process.
+ * They are also cached on disk by a hash of their source ($BREEZE_CACHE,
+ * else $XDG_CACHE_HOME/breeze or ~/.cache/breeze), so a module is only
+ * parsed the first time its source is seen.
+ */
+
+// One module the current run imported
+typedef struct ImportedModule {
+  char *name;
+  struct ImportedModule *next;
+} ImportedModule;
+
+// Run `import name;` (a NODE_IMPORT)
+void module_import(BreezeContext *ctx, astnode_t *node);
+
+// Record that the current run imported `name` already
+void module_mark_imported(BreezeContext *ctx, const char *name);
+
+// Forget what the current run imported, as it starts over
+void module_forget(BreezeContext *ctx);
+
+#endif
@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "parallel.h"
+#include "context.h"
+#include "ast.h"
+#include "lazy.h"
+
+typedef struct Chunk {
+  const char *text;
+  size_t length;
+  int line, column;         // Where it starts in the script
+  int lazy_parse;
+  astnode_t *ast;           // Its statements, once parsed
+  int status;               // What breeze_parse_source returned
+  int aborted;              // A grammar action raised breeze_error
+  char error[BREEZE_ERROR_MAX];
+  char *messages;           // What its parser printed
+  size_t messages_length;
+} Chunk;
+
+// ----------- SPLITTING -----------
+
+// Cut the source after top-level statements into at most `jobs` chunks of
+// about equal size; returns their count, 0 if it cannot be cut
+static int split(const BreezeContext *ctx, const char *source, size_t length,
+                 int jobs, Chunk *chunks) {
+  size_t target = length / (size_t)jobs;
+  size_t start = 0;
+  size_t statement_end = 0;   // After the last statement's `;`
+  int line = ctx->parse_line > 0 ? ctx->parse_line : 1;
+  int column = ctx->parse_line > 0 ? ctx->parse_column : 1;
+  int count = 0;
+  LazyScan scan;
+  lazy_scan_start(&scan, line, column);
+
+  memset(chunks, 0, sizeof(Chunk) * (size_t)jobs);
+  chunks[0].text = source;
+  chunks[0].line = line;
+  chunks[0].column = column;
+  for (size_t i = 0; i < length; i++) {
+    int c = (unsigned char)source[i];
+    // The lexer's count: where the next character is
+    if (c == '\n') {
+      line++;
+      column = 1;
+    } else {
+      column++;
+    }
+    int found = lazy_scan_step(&scan, c);
+    if (found == LAZY_SCAN_CLOSE) return 0;
+    if (found != LAZY_SCAN_STATEMENT) continue;
+
+    statement_end = i + 1;
+    if (statement_end - start >= target && count + 1 < jobs) {
+      chunks[count++].length = statement_end - start;
+      start = statement_end;
+      chunks[count].text = source + start;
+      chunks[count].line = line;
+      chunks[count].column = column;
+    }
+  }
+
+  if (count > 0 && start == statement_end) {
+    // Only space or comments after the last cut: not a program of its own
+    chunks[count - 1].length += length - start;
+  } else {
+    chunks[count++].length = length - start;
+  }
+  return count;
+}
+
+// ----------- PARSING -----------
+
+// Drop the message breeze_error printed last: the caller's context raises it again
+static void drop_error(Chunk *chunk) {
+  size_t n = strlen(chunk->error);
+  size_t end = chunk->messages_length;
+  if (end > n && chunk->messages[end - 1] == '\n' &&
+      memcmp(chunk->messages + end - 1 - n, chunk->error, n) == 0) {
+    chunk->messages_length = end - 1 - n;
+  }
+}
+
+// Parse a chunk in a context of its own, keeping what it prints
+static void *parse_chunk(void *arg) {
+  Chunk *chunk = arg;
+  BreezeContext *parser = breeze_context_new();
+  parser->err = open_memstream(&chunk->messages, &chunk->messages_length);
+  parser->lazy_parse = chunk->lazy_parse;
+  parser->parse_line = chunk->line;
+  parser->parse_column = chunk->column;
+
+  // Grammar actions report some errors through breeze_error
+  jmp_buf recover;
+  volatile int status = 1;
+  parser->error_jmp = &recover;
+  if (setjmp(recover) == 0) {
+    status = breeze_parse_source(parser, chunk->text, chunk->length);
+  } else {
+    chunk->aborted = 1;
+  }
+  parser->error_jmp = NULL;
+  if (parser->err) fclose(parser->err);
+  parser->err = NULL;
+
+  chunk->status = status;
+  memcpy(chunk->error, parser->error, sizeof(chunk->error));
+  if (chunk->aborted && chunk->messages) drop_error(chunk);
+  if (status == 0) {
+    chunk->ast = parser->root_ast;
+    parser->root_ast = NULL;
+  }
+  breeze_context_free(parser);
+  return NULL;
+}
+
+// Join the chunks in source order, or report the first one that failed
+static int stitch(BreezeContext *ctx, Chunk *chunks, int count) {
+  Chunk *failed = NULL;
+  for (int i = 0; i < count && !failed; i++) {
+    if (ctx->err && chunks[i].messages_length) {
+      fwrite(chunks[i].messages, 1, chunks[i].messages_length, ctx->err);
+    }
+    if (chunks[i].status != 0) failed = &chunks[i];
+  }
+
+  astnode_t *program = NULL;
+  for (int i = 0; i < count; i++) {
+    if (failed) {
+      free_ast(chunks[i].ast);
+    } else {
+      program = stmts_join(program, chunks[i].ast);
+    }
+    free(chunks[i].messages);
+  }
+  if (!failed) {
+    ctx->root_ast = program;
+    return 0;
+  }
+
+  if (failed->aborted) {
+    breeze_error(ctx, "%s\n", failed->error);
+  }
+  memcpy(ctx->error, failed->error, sizeof(ctx->error));
+  return failed->status;
+}
+
+int parse_parallel(BreezeContext *ctx, const char *source, size_t length) {
+  int jobs = ctx->parse_jobs;
+  if (jobs <= 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cores > 0 ? (int)cores : 1;
+  }
+  if (jobs > PARALLEL_MAX_JOBS) jobs = PARALLEL_MAX_JOBS;
+  if ((size_t)jobs > length / PARALLEL_MIN_CHUNK) jobs = (int)(length / PARALLEL_MIN_CHUNK);
+
+  Chunk chunks[PARALLEL_MAX_JOBS];
+  int count = jobs >= 2 ? split(ctx, source, length, jobs, chunks) : 0;
+  if (count < 2) return breeze_parse_source(ctx, source, length);
+
+  // The first chunk is parsed here, and any a thread could not be started for
+  pthread_t threads[PARALLEL_MAX_JOBS];
+  int started[PARALLEL_MAX_JOBS];
+  for (int i = 1; i < count; i++) {
+    chunks[i].lazy_parse = ctx->lazy_parse;
+    started[i] = pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]) == 0;
+  }
+  chunks[0].lazy_parse = ctx->lazy_parse;
+  parse_chunk(&chunks[0]);
+  for (int i = 1; i < count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      parse_chunk(&chunks[i]);
+    }
+  }
+  return stitch(ctx, chunks, count);
+}
@@ -0,0 +1,37 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Parallel parsing of long scripts (ctx->parse_jobs, --parse-jobs N).
+ * A pre-scan finds the `;` ending every top-level statement, skipping
+ * strings, comments and blocks the way the lazy scanner does (see
+ * lazy.h), and cuts the source at some of them into chunks of about
+ * equal size. Each chunk is parsed on a thread of its own, by a parser
+ * in a context of its own that starts at the chunk's line and column,
+ * and the statement lists are joined in source order. The program is
+ * the one a serial parse builds, node for node.
+ *
+ * A syntax error is reported as a serial parse would: what the chunks
+ * before the first failing one printed, then its error, and nothing
+ * after. Sources shorter than two PARALLEL_MIN_CHUNK, and ones with a
+ * `}` closing no block, are parsed serially.
+ */
+
+// Fewest bytes worth a thread of their own
+#define PARALLEL_MIN_CHUNK (32 * 1024)
+
+// Most threads one parse uses
+#define PARALLEL_MAX_JOBS 64
+
+/**
+ * Parse source into ctx->root_ast, as breeze_parse_source does (no
+ * analysis passes), with up to ctx->parse_jobs threads (0: one per
+ * core). Returns 0 on success, non-zero on a syntax error.
+ */
+int parse_parallel(BreezeContext *ctx, const char *source, size_t length);
+
+#endif
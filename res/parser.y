@@ -1,25 +1,72 @@
-%{
+%code requires {
 #include "common_lib.h"
 
-int yylex(void);
-void yyerror(const char *s);
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+}
+
+%code {
+#include "generator.h"
+
+int yylex(YYSTYPE *yylval_param, YYLTYPE *yylloc_param, yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, BreezeContext *ctx, const char *s);
+
+// A node positioned at the first token of what it was built from
+static astnode_t *node_at(int type, YYLTYPE loc) {
+    astnode_t *node = astnode_new(type);
+    node->line = loc.first_line;
+    node->column = loc.first_column;
+    return node;
+}
 
-astnode_t *root_ast;
-%}
+// An int literal, or a bignum one if the value does not fit (releases value)
+static astnode_t *int_literal(BigInt *value, YYLTYPE loc) {
+    astnode_t *node;
+    int num;
+    if (bigint_to_int(value, &num)) {
+        bigint_release(value);
+        node = node_at(NODE_INT, loc);
+        node->data.num = num;
+    } else {
+        node = node_at(NODE_BIGINT, loc);
+        node->data.big = bigint_literal(value);
+        bigint_release(value);
+    }
+    return node;
+}
+}
 
 %debug
 
+/* Pure parser: all state lives in the caller's BreezeContext and scanner */
+%define api.pure full
+%locations
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {BreezeContext *ctx}
+
+/* A function body parsed at its first call keeps its place in the script */
+%initial-action {
+    if (ctx->parse_line > 0) {
+        @$.first_line = @$.last_line = ctx->parse_line;
+        @$.first_column = @$.last_column = ctx->parse_column;
+    }
+}
+
 %union {
     astnode_t *ast;
     int number;
     float dec; 
     char* string;
     int boolean;
+    struct LazyBody *lazy;
 }
 
 %token <number> INT
 %token <dec> FLOAT
-%token <string> IDENTIFIER STRING
+%token <string> IDENTIFIER STRING BIGINT
 %token WHILE FOR FUNC IF ELSE IFELSE FUNCSTART FUNCEND FUNCRET
 %token TRUE FALSE
 %token AND OR NOT
@@ -29,6 +76,11 @@ astnode_t *root_ast;
 %token OPENPAR CLOSEPAR OPENBRKT CLOSEBRKT
 %token READ STRLEN
 %token BREAK CONTINUE
+%token YIELD
+%token SPAWN
+%token IMPORT
+%token BENCH
+%token <lazy> LAZYBODY
 
 /* Declare types for our new non-terminals */
 %type <ast> stmt stmts expr term factor 
@@ -50,20 +102,19 @@ astnode_t *root_ast;
 program
     : stmts 
       {
-        init_scopes();
-        root_ast = $1;
+        ctx->root_ast = $1;
       }
     ;
 
 stmts
     : stmt SEMICOLON
       {
-        $$ = astnode_new(NODE_STMTS);
+        $$ = node_at(NODE_STMTS, @$);
         astnode_add_child($$, $1, 0);
       }
     | stmts stmt SEMICOLON
       {
-        $$ = astnode_new(NODE_STMTS);
+        $$ = node_at(NODE_STMTS, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $2, 1);
       }
@@ -72,70 +123,124 @@ stmts
 stmt
     : IDENTIFIER ASSIGN expr
       {
-        $$ = astnode_new(NODE_ASSIGN);
+        $$ = node_at(NODE_ASSIGN, @$);
         $$->data.id = $1;
         astnode_add_child($$, $3, 0);
       }
     | PRINT args
       {
-        $$ = astnode_new(NODE_PRINT);
+        $$ = node_at(NODE_PRINT, @$);
         astnode_add_child($$, $2, 0);
       }
     | WHILE expr FUNCSTART stmts FUNCEND
       {
-        $$ = astnode_new(NODE_WHILE);
+        $$ = node_at(NODE_WHILE, @$);
         astnode_add_child($$, $2, 0);  // condition (now expr)
         astnode_add_child($$, $4, 1);  // body
       }
     | FOR for_init COMMA expr COMMA for_update FUNCSTART stmts FUNCEND
       {
-        $$ = astnode_new(NODE_FOR);
+        $$ = node_at(NODE_FOR, @$);
         astnode_add_child($$, $2, 0);  // for init
         astnode_add_child($$, $4, 1);  // for condition (now expr)
         astnode_add_child($$, $6, 2);  // for update
         astnode_add_child($$, $8, 3);  // body
       }
+    | FOR IDENTIFIER IDENTIFIER
+      {
+        // `in` is only a word here, so scripts may still use it as a name
+        int is_in = strcmp($3, "in") == 0;
+        free($3);
+        if (!is_in) {
+            yyerror(&@3, scanner, ctx, "syntax error, expected 'in'");
+            YYERROR;
+        }
+      }
+      expr FUNCSTART stmts FUNCEND
+      {
+        $$ = node_at(NODE_FOREACH, @$);
+        $$->data.id = $2;              // loop variable
+        astnode_add_child($$, $5, 0);  // generator
+        astnode_add_child($$, $7, 1);  // body
+      }
     | IF expr FUNCSTART stmts FUNCEND
       {
-        $$ = astnode_new(NODE_IF);
+        $$ = node_at(NODE_IF, @$);
         astnode_add_child($$, $2, 0);
         astnode_add_child($$, $4, 1);
       }
     | IF expr FUNCSTART stmts ELSE FUNCSTART stmts FUNCEND
       {
-        $$ = astnode_new(NODE_IFELSE);
+        $$ = node_at(NODE_IFELSE, @$);
         astnode_add_child($$, $2, 0);
         astnode_add_child($$, $4, 1);
         astnode_add_child($$, $7, 2);
       }
     | FUNC IDENTIFIER OPENPAR params CLOSEPAR FUNCSTART stmts FUNCEND
       {
-        $$ = astnode_new(NODE_FUNC);
+        $$ = node_at(NODE_FUNC, @$);
         $$->data.id = $2;
         astnode_add_child($$, $4, 0);
         astnode_add_child($$, $7, 1);
+        $$->generator = generator_yields($7);
+      }
+    | FUNC IDENTIFIER OPENPAR params CLOSEPAR LAZYBODY
+      {
+        // The scanner kept the body's source (see lazy.h)
+        $$ = node_at(NODE_FUNC, @$);
+        $$->data.id = $2;
+        astnode_add_child($$, $4, 0);
+        $$->lazy = $6;
       }
     | READ IDENTIFIER
       {
-        $$ = astnode_new(NODE_READ);
+        $$ = node_at(NODE_READ, @$);
         $$->data.id = $2;
       }
     | expr    // Temporary fallback
       {
         $$ = $1;
+        // A bare `snapshot;` is the snapshot marker; the word is no keyword
+        if ($1->type == NODE_ID && strcmp($1->data.id, "snapshot") == 0) {
+            free_ast($1);
+            $$ = node_at(NODE_SNAPSHOT, @$);
+        }
       }
     | FUNCRET expr
       {
-        $$ = astnode_new(NODE_FUNCRET);
+        $$ = node_at(NODE_FUNCRET, @$);
+        astnode_add_child($$, $2, 0);
+      }
+    | YIELD expr
+      {
+        $$ = node_at(NODE_YIELD, @$);
         astnode_add_child($$, $2, 0);
       }
+    | SPAWN IDENTIFIER OPENPAR args CLOSEPAR
+      {
+        $$ = node_at(NODE_SPAWN, @$);
+        $$->data.id = $2;
+        astnode_add_child($$, $4, 0);  // arguments, as in a call
+      }
+    | IMPORT IDENTIFIER
+      {
+        $$ = node_at(NODE_IMPORT, @$);
+        $$->data.id = $2;
+      }
+    | BENCH expr COMMA expr FUNCSTART stmts FUNCEND
+      {
+        $$ = node_at(NODE_BENCH, @$);
+        astnode_add_child($$, $2, 0);  // label
+        astnode_add_child($$, $4, 1);  // timed runs
+        astnode_add_child($$, $6, 2);  // body
+      }
     ;
 
 
 for_init
     : IDENTIFIER ASSIGN expr
       {
-        $$ = astnode_new(NODE_ASSIGN);
+        $$ = node_at(NODE_ASSIGN, @$);
         $$->data.id = $1;
         astnode_add_child($$, $3, 0);
       }
@@ -144,7 +249,7 @@ for_init
 for_update
     : IDENTIFIER ASSIGN expr
       {
-        $$ = astnode_new(NODE_ASSIGN);
+        $$ = node_at(NODE_ASSIGN, @$);
         $$->data.id = $1;
         astnode_add_child($$, $3, 0);
       }
@@ -155,26 +260,25 @@ params
       {
         /* Instead of returning null, we return a node with no children
         Just so we have a valid ast node returned.*/
-        $$ = astnode_new(NODE_STMTS);
+        $$ = node_at(NODE_STMTS, @$);
       }
     | IDENTIFIER
       {
-        astnode_t* paramNode = astnode_new(NODE_ID);
+        astnode_t* paramNode = node_at(NODE_ID, @1);
         paramNode->data.id = $1;
         
-        $$ = astnode_new(NODE_STMTS);
+        $$ = node_at(NODE_STMTS, @$);
         astnode_add_child($$, paramNode, 0);
       }
     | params COMMA IDENTIFIER
       {
-        astnode_t* paramNode = astnode_new(NODE_ID);
+        astnode_t* paramNode = node_at(NODE_ID, @3);
         paramNode->data.id = $3;
 
         int i = 0;
         while ($1->child[i] != NULL && i < MAXCHILDREN) i++;
         if (i >= MAXCHILDREN) {
-          fprintf(stderr, "Too many parameters!\n");
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Too many parameters!\n");
         }
         astnode_add_child($1, paramNode, i);
 
@@ -185,11 +289,11 @@ params
 args
   : /* no arguments */
     {
-      $$ = astnode_new(NODE_STMTS); /* empty container node */
+      $$ = node_at(NODE_STMTS, @$); /* empty container node */
     }
   | expr
     {
-      astnode_t* listNode = astnode_new(NODE_STMTS);
+      astnode_t* listNode = node_at(NODE_STMTS, @$);
       astnode_add_child(listNode, $1, 0);
       $$ = listNode;
     }
@@ -198,8 +302,7 @@ args
       int i = 0;
       while ($1->child[i] != NULL && i < MAXCHILDREN) i++;
       if (i >= MAXCHILDREN) {
-        fprintf(stderr, "Too many arguments!\n");
-        exit(EXIT_FAILURE);
+        breeze_error(ctx, "Too many arguments!\n");
       }
       astnode_add_child($1, $3, i);
       $$ = $1;
@@ -209,12 +312,12 @@ args
 slice
     : expr
       {
-        $$ = astnode_new(NODE_SLICE);
+        $$ = node_at(NODE_SLICE, @$);
         astnode_add_child($$, $1, 0);
       }
     | expr COLON expr
       {
-        $$ = astnode_new(NODE_SLICE);
+        $$ = node_at(NODE_SLICE, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
@@ -222,75 +325,75 @@ slice
 expr
     : expr OR expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_OR;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr AND expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_AND;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | NOT expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_NOT;
         astnode_add_child($$, $2, 0);
       }
     | expr EQ expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_EQ;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr NEQ expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_NEQ;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr LT expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_LT;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr LE expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_LE;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr GT expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_GT;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr GE expr
       {
-        $$ = astnode_new(NODE_BOOL_OP);
+        $$ = node_at(NODE_BOOL_OP, @$);
         $$->data.bool_op = OP_GE;
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr PLUS term
       {
-        $$ = astnode_new(NODE_ADD);
+        $$ = node_at(NODE_ADD, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | expr MINUS term
       {
-        $$ = astnode_new(NODE_SUB);
+        $$ = node_at(NODE_SUB, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
@@ -300,44 +403,43 @@ expr
       }
     | TRUE
       {
-        $$ = astnode_new(NODE_BOOL);
+        $$ = node_at(NODE_BOOL, @$);
         $$->data.boolean = 1;
       }
     | FALSE
       {
-        $$ = astnode_new(NODE_BOOL);
+        $$ = node_at(NODE_BOOL, @$);
         $$->data.boolean = 0;
       }
     | BREAK
       {
-        $$ = astnode_new(NODE_BREAK);
+        $$ = node_at(NODE_BREAK, @$);
       }
     | CONTINUE
       {
-        $$ = astnode_new(NODE_CONTINUE);
+        $$ = node_at(NODE_CONTINUE, @$);
       }
     ;
 
 term
     : term MUL factor
       {
-        $$ = astnode_new(NODE_MUL);
+        $$ = node_at(NODE_MUL, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | term DIV factor
       {
         if ($3 == 0) {
-            fprintf(stderr, "Error: Division by zero\n");
-            exit(EXIT_FAILURE);
+            breeze_error(ctx, "Error: Division by zero\n");
         }
-        $$ = astnode_new(NODE_DIV);
+        $$ = node_at(NODE_DIV, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
     | term EXP factor
       {
-        $$ = astnode_new(NODE_EXP);
+        $$ = node_at(NODE_EXP, @$);
         astnode_add_child($$, $1, 0);
         astnode_add_child($$, $3, 1);
       }
@@ -350,22 +452,28 @@ term
 factor
     : INT
       {
-        $$ = astnode_new(NODE_INT);
+        $$ = node_at(NODE_INT, @$);
         $$->data.num = $1;
       }
+    | BIGINT
+      {
+        $$ = int_literal(bigint_from_string($1), @$);
+        free($1);
+      }
     | FLOAT
       {
-        $$ = astnode_new(NODE_FLOAT);
+        $$ = node_at(NODE_FLOAT, @$);
         $$->data.dec = $1;
       }
     | STRING
       {
-        $$ = astnode_new(NODE_STRING);
+        $$ = node_at(NODE_STRING, @$);
         $$->data.str = strdup($1);
+        $$->literal = string_literal($1);
       }
     | IDENTIFIER
       {
-        $$ = astnode_new(NODE_ID);
+        $$ = node_at(NODE_ID, @$);
         $$->data.id = $1;
       }
     | OPENPAR expr CLOSEPAR
@@ -379,43 +487,49 @@ factor
 
       if ($2->type == NODE_INT)
         {
-          $$ = astnode_new(NODE_INT);
+          $$ = node_at(NODE_INT, @$);
           $$->data.num = -($2->data.num);
         }
+        else if ($2->type == NODE_BIGINT)
+        {
+          $$ = int_literal(bigint_negate($2->data.big), @$);
+          free_ast($2);
+        }
         else if ($2->type == NODE_FLOAT)
         {
-          $$ = astnode_new(NODE_FLOAT);
+          $$ = node_at(NODE_FLOAT, @$);
           $$->data.dec = -($2->data.dec);
         }
         else
         {
-          fprintf(stderr, "Error: invalid type in unary minus\n");
-          exit(EXIT_FAILURE);
+          breeze_error(ctx, "Error: invalid type in unary minus\n");
         }
       }
     | IDENTIFIER OPENPAR args CLOSEPAR 
       {
-        $$ = astnode_new(NODE_FUNCCALL);
+        $$ = node_at(NODE_FUNCCALL, @$);
         $$->data.id = $1;
         astnode_add_child($$, $3, 0);
       }
     | IDENTIFIER OPENBRKT slice CLOSEBRKT
       {
-        $$ = astnode_new(NODE_INDEX);
+        $$ = node_at(NODE_INDEX, @$);
         $$->data.id = $1;
         astnode_add_child($$, $3, 0);
       }
     | STRLEN OPENPAR IDENTIFIER CLOSEPAR
       {
-        $$ = astnode_new(NODE_STRLEN);
+        $$ = node_at(NODE_STRLEN, @$);
         $$->data.id = $3;
       }
     ;
 
 %%
 
-void yyerror(const char *s) {
-    extern char *yytext;
-    extern int yylineno;
-    fprintf(stderr, "Error: %s at line %d, near token '%s'\n", s, yylineno, yytext);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, BreezeContext *ctx, const char *s) {
+    snprintf(ctx->error, sizeof(ctx->error), "Error: %s at line %d, column %d, near token '%s'",
+             s, loc->first_line, loc->first_column, yyget_text(scanner));
+    if (ctx->err) {
+        fprintf(ctx->err, "%s\n", ctx->error);
+    }
 }
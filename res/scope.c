@@ -2,220 +2,275 @@
 #include <stdlib.h>
 #include <string.h>
 #include "scope.h"
+#include "context.h"
+#include "generator.h"
+#include "task.h"
 
-// Global pointer to the top of our scope stack
-static Scope *current_scope = NULL;
+#define BINDINGS_INITIAL 64
 
-// Create a new SymbolNode
-static SymbolNode* create_symbol_node(const char *name, ValueType type) {
-    SymbolNode* node = (SymbolNode*)malloc(sizeof(SymbolNode));
-    if (!node) {
-        fprintf(stderr, "Error: Memory allocation for SymbolNode failed.\n");
+static void *scope_alloc(size_t size) {
+    void *mem = malloc(size);
+    if (!mem) {
+        fprintf(stderr, "Error: Memory allocation for the symbol table failed.\n");
         exit(EXIT_FAILURE);
     }
-    node->name = strdup(name);
-    node->type = type;
-    node->next = NULL;
-    return node;
+    return mem;
+}
+
+// FNV-1a
+static size_t hash_name(const char *name) {
+    size_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static void grow_bindings(BindingTable *table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : BINDINGS_INITIAL;
+    Binding **buckets = calloc(capacity, sizeof(Binding *));
+    if (!buckets) {
+        fprintf(stderr, "Error: Memory allocation for the symbol table failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        Binding *b = table->buckets[i];
+        while (b) {
+            Binding *next = b->next;
+            size_t slot = hash_name(b->name) & (capacity - 1);
+            b->next = buckets[slot];
+            buckets[slot] = b;
+            b = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->capacity = capacity;
+}
+
+static Binding *find_binding(BindingTable *table, const char *name) {
+    if (!table->capacity) return NULL;
+    for (Binding *b = table->buckets[hash_name(name) & (table->capacity - 1)]; b; b = b->next) {
+        if (strcmp(b->name, name) == 0) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static Binding *get_binding(BindingTable *table, const char *name) {
+    Binding *b = find_binding(table, name);
+    if (b) return b;
+
+    if (table->count * 4 >= table->capacity * 3) {
+        grow_bindings(table);
+    }
+    size_t slot = hash_name(name) & (table->capacity - 1);
+    b = scope_alloc(sizeof(Binding));
+    b->name = strdup(name);
+    b->top = NULL;
+    b->next = table->buckets[slot];
+    table->buckets[slot] = b;
+    table->count++;
+    return b;
+}
+
+// Drop the string, bignum, generator or channel a symbol holds
+static void release_symbol(SymbolNode *sym) {
+    if (sym->type == TYPE_STRING && sym->data.string_val) {
+        string_release(sym->data.string_val);
+    } else if (sym->type == TYPE_BIGINT) {
+        bigint_release(sym->data.big_val);
+    } else if (sym->type == TYPE_GENERATOR) {
+        generator_release(sym->data.gen_val);
+    } else if (sym->type == TYPE_CHANNEL) {
+        channel_release(sym->data.chan_val);
+    }
+}
+
+/**
+ * The symbol `name` in the top scope, ready to take a value of `type`:
+ * an existing one drops its string, otherwise a new one shadows any
+ * outer symbol with that name.
+ */
+static SymbolNode *bind_symbol(BreezeContext *ctx, const char *name, ValueType type) {
+    if (!ctx->current_scope) {
+        fprintf(stderr, "Error: No scope to put symbol '%s' in.\n", name);
+        exit(EXIT_FAILURE);
+    }
+    Binding *binding = get_binding(&ctx->bindings, name);
+    SymbolNode *sym = binding->top;
+    if (sym && sym->scope == ctx->current_scope) {
+        // update
+        release_symbol(sym);
+        sym->type = type;
+        return sym;
+    }
+    // create new
+    sym = scope_alloc(sizeof(SymbolNode));
+    sym->name = binding->name;
+    sym->type = type;
+    sym->scope = ctx->current_scope;
+    sym->binding = binding;
+    sym->shadowed = binding->top;
+    binding->top = sym;
+    sym->next = ctx->current_scope->symbols;
+    ctx->current_scope->symbols = sym;
+    return sym;
 }
 
 /**
  * init_scopes
- * Called once at the start of runtime.
+ * Called once when a context is created.
  * We push one "global" scope so there's always at least
  * one scope on the stack.
  */
-void init_scopes(void) {
-    current_scope = NULL;
-    push_scope(); // push one global scope by default
+void init_scopes(BreezeContext *ctx) {
+    ctx->current_scope = NULL;
+    push_scope(ctx); // push one global scope by default
 }
 
 // push_scope
-void push_scope(void) {
-    Scope *newScope = (Scope*)malloc(sizeof(Scope));
-    if (!newScope) {
-        fprintf(stderr, "Error: Memory allocation for Scope failed.\n");
-        exit(EXIT_FAILURE);
-    }
+void push_scope(BreezeContext *ctx) {
+    Scope *newScope = scope_alloc(sizeof(Scope));
     newScope->symbols = NULL;
-    newScope->parent = current_scope;
-    current_scope = newScope;
+    newScope->parent = ctx->current_scope;
+    ctx->current_scope = newScope;
 }
 
 /**
  * pop_scope
  * frees all symbols in the top scope, then discards it
  */
-void pop_scope(void) {
-    if (!current_scope) {
+void pop_scope(BreezeContext *ctx) {
+    if (!ctx->current_scope) {
         fprintf(stderr, "Warning: pop_scope() called with no current scope.\n");
         return;
     }
     // free all symbol nodes in this scope
-    SymbolNode *sym = current_scope->symbols;
+    SymbolNode *sym = ctx->current_scope->symbols;
     while (sym) {
         SymbolNode *tmp = sym->next;
-        // If it's a string, free the string
-        if (sym->type == TYPE_STRING && sym->data.string_val) {
-            free(sym->data.string_val);
-        }
+        // Uncover the symbol it was shadowing
+        sym->binding->top = sym->shadowed;
+        // If it holds a value with a reference, drop it
+        release_symbol(sym);
         // If it's a function name, we do not free the AST
-        free(sym->name);
         free(sym);
         sym = tmp;
     }
     // lastly, pop old
-    Scope *oldScope = current_scope;
-    current_scope = current_scope->parent;
+    Scope *oldScope = ctx->current_scope;
+    ctx->current_scope = ctx->current_scope->parent;
     free(oldScope);
 }
 
-/**
- * lookup_symbol
- * Search from top scope outward
- */
-SymbolNode* lookup_symbol(const char *name) {
-    Scope *scopeIter = current_scope;
-    while (scopeIter) {
-        SymbolNode *sym = scopeIter->symbols;
-        while (sym) {
-            if (strcmp(sym->name, name) == 0) {
-                return sym;
-            }
-            sym = sym->next;
-        }
-        scopeIter = scopeIter->parent;  // go outward
+Scope *detach_scope(BreezeContext *ctx) {
+    Scope *scope = ctx->current_scope;
+    for (SymbolNode *sym = scope->symbols; sym; sym = sym->next) {
+        sym->binding->top = sym->shadowed;
     }
-    return NULL; // not found
+    ctx->current_scope = scope->parent;
+    scope->parent = NULL;
+    return scope;
 }
 
-SymbolNode* put_symbol_int(const char *name, int value) {
-    if (!current_scope) {
-        fprintf(stderr, "Error: No scope to put symbol '%s' in.\n", name);
-        exit(EXIT_FAILURE);
+void attach_scope(BreezeContext *ctx, Scope *scope) {
+    for (SymbolNode *sym = scope->symbols; sym; sym = sym->next) {
+        sym->shadowed = sym->binding->top;
+        sym->binding->top = sym;
     }
-    // see if it already exists in the current scope
-    SymbolNode* sym = current_scope->symbols;
-    while (sym) {
-        if (strcmp(sym->name, name) == 0) {
-            // update
-            if (sym->type == TYPE_STRING && sym->data.string_val) {
-                free(sym->data.string_val);
-            }
-            sym->type = TYPE_INT;
-            sym->data.int_val = value;
-            return sym;
-        }
-        sym = sym->next;
-    }
-    // create new
-    SymbolNode* newNode = create_symbol_node(name, TYPE_INT);
-    newNode->data.int_val = value;
-    newNode->next = current_scope->symbols;
-    current_scope->symbols = newNode;
-    return newNode;
+    scope->parent = ctx->current_scope;
+    ctx->current_scope = scope;
 }
 
-SymbolNode* put_symbol_float(const char *name, float value) {
-    if (!current_scope) {
-        fprintf(stderr, "Error: No scope to put symbol '%s' in.\n", name);
-        exit(EXIT_FAILURE);
-    }
-    SymbolNode* sym = current_scope->symbols;
+void free_scope(Scope *scope) {
+    SymbolNode *sym = scope->symbols;
     while (sym) {
-        if (strcmp(sym->name, name) == 0) {
-            // update
-            if (sym->type == TYPE_STRING && sym->data.string_val) {
-                free(sym->data.string_val);
-            }
-            sym->type = TYPE_FLOAT;
-            sym->data.float_val = value;
-            return sym;
-        }
-        sym = sym->next;
+        SymbolNode *tmp = sym->next;
+        release_symbol(sym);
+        free(sym);
+        sym = tmp;
     }
-    // create new
-    SymbolNode* newNode = create_symbol_node(name, TYPE_FLOAT);
-    newNode->data.float_val = value;
-    newNode->next = current_scope->symbols;
-    current_scope->symbols = newNode;
-    return newNode;
+    free(scope);
 }
 
-SymbolNode* put_symbol_string(const char *name, const char *value) {
-    if (!current_scope) {
-        fprintf(stderr, "Error: No scope to put symbol '%s' in.\n", name);
-        exit(EXIT_FAILURE);
+void free_scopes(BreezeContext *ctx) {
+    while (ctx->current_scope) {
+        pop_scope(ctx);
     }
-    SymbolNode* sym = current_scope->symbols;
-    while (sym) {
-        if (strcmp(sym->name, name) == 0) {
-            // update
-            if (sym->type == TYPE_STRING && sym->data.string_val) {
-                free(sym->data.string_val);
-            }
-            sym->type = TYPE_STRING;
-            sym->data.string_val = strdup(value);
-            return sym;
+    BindingTable *table = &ctx->bindings;
+    for (size_t i = 0; i < table->capacity; i++) {
+        Binding *b = table->buckets[i];
+        while (b) {
+            Binding *next = b->next;
+            free(b->name);
+            free(b);
+            b = next;
         }
-        sym = sym->next;
     }
-    // create new
-    SymbolNode* newNode = create_symbol_node(name, TYPE_STRING);
-    newNode->data.string_val = strdup(value);
-    newNode->next = current_scope->symbols;
-    current_scope->symbols = newNode;
-    return newNode;
+    free(table->buckets);
+    memset(table, 0, sizeof(*table));
 }
 
-SymbolNode* put_symbol_bool(const char *name, int value) {
-    if (!current_scope) {
-        fprintf(stderr, "Error: No scope to put symbol '%s' in.\n", name);
-        exit(EXIT_FAILURE);
-    }
-    SymbolNode* sym = current_scope->symbols;
-    while (sym) {
-        if (strcmp(sym->name, name) == 0) {
-            // update
-            if (sym->type == TYPE_STRING && sym->data.string_val) {
-                free(sym->data.string_val);
-            }
-            sym->type = TYPE_BOOL;
-            sym->data.bool_val = value ? 1 : 0;
-            return sym;
-        }
-        sym = sym->next;
-    }
-    // create new
-    SymbolNode* newNode = create_symbol_node(name, TYPE_BOOL);
-    newNode->data.bool_val = value ? 1 : 0;
-    newNode->next = current_scope->symbols;
-    current_scope->symbols = newNode;
-    return newNode;
+/**
+ * lookup_symbol
+ * The innermost live symbol with this name
+ */
+SymbolNode* lookup_symbol(BreezeContext *ctx, const char *name) {
+    Binding *binding = find_binding(&ctx->bindings, name);
+    return binding ? binding->top : NULL;
 }
 
-SymbolNode* put_symbol_function(const char *name, astnode_t *func_ast) {
-    if (!current_scope) {
-        fprintf(stderr, "Error: No scope to put function '%s' in.\n", name);
-        exit(EXIT_FAILURE);
-    }
-    SymbolNode* sym = current_scope->symbols;
-    while (sym) {
-        if (strcmp(sym->name, name) == 0) {
-            // If previously something else, overwrite
-            if (sym->type == TYPE_STRING && sym->data.string_val) {
-                free(sym->data.string_val);
-            }
-            sym->type = TYPE_FUNCTION;
-            sym->data.func_ast = func_ast;
-            return sym;
-        }
-        sym = sym->next;
-    }
-    // create new
-    SymbolNode* newNode = create_symbol_node(name, TYPE_FUNCTION);
-    newNode->data.func_ast = func_ast;
-    newNode->next = current_scope->symbols;
-    current_scope->symbols = newNode;
-    return newNode;
+SymbolNode* put_symbol_int(BreezeContext *ctx, const char *name, int value) {
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_INT);
+    sym->data.int_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_float(BreezeContext *ctx, const char *name, float value) {
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_FLOAT);
+    sym->data.float_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_string(BreezeContext *ctx, const char *name, String *value) {
+    // Retain first: the value may be the string the symbol holds now
+    string_retain(value);
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_STRING);
+    sym->data.string_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_bigint(BreezeContext *ctx, const char *name, BigInt *value) {
+    bigint_retain(value);
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_BIGINT);
+    sym->data.big_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_generator(BreezeContext *ctx, const char *name, Generator *value) {
+    generator_retain(value);
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_GENERATOR);
+    sym->data.gen_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_channel(BreezeContext *ctx, const char *name, Channel *value) {
+    channel_retain(value);
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_CHANNEL);
+    sym->data.chan_val = value;
+    return sym;
+}
+
+SymbolNode* put_symbol_bool(BreezeContext *ctx, const char *name, int value) {
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_BOOL);
+    sym->data.bool_val = value ? 1 : 0;
+    return sym;
+}
+
+SymbolNode* put_symbol_function(BreezeContext *ctx, const char *name, astnode_t *func_ast) {
+    SymbolNode *sym = bind_symbol(ctx, name, TYPE_FUNCTION);
+    sym->data.func_ast = func_ast;
+    return sym;
 }
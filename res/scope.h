@@ -2,6 +2,8 @@
 #define SCOPE_H
 
 #include "symtab.h"
+#include "strval.h"
+#include "bigint.h"
 
 /**
  * Each scope has its own linked list of SymbolNodes, plus
@@ -12,30 +14,66 @@ typedef struct Scope {
     struct Scope *parent;     // Next scope on the stack (the "previous" scope)
 } Scope;
 
-// Initialize the scope stack (called once at the beginning).
-void init_scopes(void);
+/**
+ * Shallow binding: every name seen by a context has one Binding that
+ * points at its innermost live symbol, and each symbol remembers the
+ * one it shadows. Lookups cost the same at any call depth.
+ */
+typedef struct Binding {
+    char *name;
+    SymbolNode *top;          // Innermost live symbol with this name, or NULL
+    struct Binding *next;     // Hash chain
+} Binding;
+
+typedef struct BindingTable {
+    Binding **buckets;
+    size_t count;
+    size_t capacity;          // Power of two
+} BindingTable;
+
+// The scope stack lives in the interpreter context (see context.h).
+typedef struct BreezeContext BreezeContext;
+
+// Initialize the context's scope stack (called once per context).
+void init_scopes(BreezeContext *ctx);
 
 // Push a new scope onto the scope stack.
-void push_scope(void);
+void push_scope(BreezeContext *ctx);
 
 // Pop the top scope (freeing its symbols) and restore the previous scope.
-void pop_scope(void);
+void pop_scope(BreezeContext *ctx);
+
+/**
+ * Take the top scope off the stack without freeing it: its symbols keep
+ * their values but their names no longer resolve to them. A detached
+ * scope is either attached again (on top of whatever is current then)
+ * or freed with free_scope(). Generators keep their frames this way.
+ */
+Scope *detach_scope(BreezeContext *ctx);
+void attach_scope(BreezeContext *ctx, Scope *scope);
+void free_scope(Scope *scope);
+
+// Pop every scope and free the binding table (when the context goes away).
+void free_scopes(BreezeContext *ctx);
 
 /**
- * Look up a symbol (variable or function) by name, starting
- * in the top scope and going outward until found or we run out of scopes.
- * Returns NULL if not found.
+ * Look up a symbol (variable or function) by name: the one in the
+ * innermost scope that has it. Returns NULL if not found.
  */
-SymbolNode* lookup_symbol(const char *name);
+SymbolNode* lookup_symbol(BreezeContext *ctx, const char *name);
 
 /**
  * The put_symbol_* functions always insert (or update) the symbol
- * in the current top scope.
+ * in the current top scope. A string, bignum, generator or channel
+ * symbol takes its own reference to the value.
  */
-SymbolNode* put_symbol_int(const char *name, int value);
-SymbolNode* put_symbol_float(const char *name, float value);
-SymbolNode* put_symbol_bool(const char *name, int value);
-SymbolNode* put_symbol_string(const char *name, const char *value);
-SymbolNode* put_symbol_function(const char *name, astnode_t *func_ast);
+SymbolNode* put_symbol_int(BreezeContext *ctx, const char *name, int value);
+SymbolNode* put_symbol_float(BreezeContext *ctx, const char *name, float value);
+SymbolNode* put_symbol_bool(BreezeContext *ctx, const char *name, int value);
+SymbolNode* put_symbol_string(BreezeContext *ctx, const char *name, String *value);
+SymbolNode* put_symbol_bigint(BreezeContext *ctx, const char *name, BigInt *value);
+SymbolNode* put_symbol_generator(BreezeContext *ctx, const char *name, struct Generator *value);
+SymbolNode* put_symbol_channel(BreezeContext *ctx, const char *name, struct Channel *value);
+SymbolNode* put_symbol_function(BreezeContext *ctx, const char *name, astnode_t *func_ast);
 
 #endif
@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "common_lib.h"
+#include "server.h"
+
+#define REQUEST_MAX 4096
+#define REQUEST_TIMEOUT 5   // Seconds a client gets to send its request line
+#define FRAME_HEADER 5      // Kind byte and big-endian payload length
+
+// A script parsed at startup, ready to be run by a forked child
+typedef struct {
+    const char *path;
+    BreezeContext *ctx;
+} Preloaded;
+
+static int make_address(struct sockaddr_un *addr, const char *socket_path) {
+    if (strlen(socket_path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Error: socket path '%s' is too long.\n", socket_path);
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socket_path);
+    return 0;
+}
+
+// Read one '\n' terminated line byte by byte, leaving the rest in the socket
+static int read_request_line(int fd, char *line, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        if (c == '\n') break;
+        line[len++] = c;
+    }
+    line[len] = '\0';
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Match a request against the path as given on the command line or its basename
+static Preloaded *find_script(Preloaded *scripts, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        const char *base = strrchr(scripts[i].path, '/');
+        base = base ? base + 1 : scripts[i].path;
+        if (strcmp(scripts[i].path, name) == 0 || strcmp(base, name) == 0) {
+            return &scripts[i];
+        }
+    }
+    return NULL;
+}
+
+static int write_frame(int fd, char kind, const char *data, size_t len) {
+    unsigned char header[FRAME_HEADER] = {
+        (unsigned char)kind,
+        (unsigned char)(len >> 24), (unsigned char)(len >> 16),
+        (unsigned char)(len >> 8), (unsigned char)len,
+    };
+    if (write_all(fd, (const char *)header, sizeof(header)) != 0) return -1;
+    return write_all(fd, data, len);
+}
+
+static void send_status(int conn, int status) {
+    char code = (char)status;
+    write_frame(conn, FRAME_EXIT, &code, 1);
+}
+
+static void run_script(Preloaded *script, int conn, int out, int err) {
+    // The connection is the script's stdin; its output goes through the relay
+    dup2(conn, STDIN_FILENO);
+    dup2(out, STDOUT_FILENO);
+    dup2(err, STDERR_FILENO);
+    close(conn);
+    close(out);
+    close(err);
+
+    // Runtime errors and limits exit with their own status from inside
+    breeze_evaluate(script->ctx);
+    fflush(NULL);
+    _exit(EXIT_SUCCESS);
+}
+
+// Forward the runner's two streams as frames until both are closed
+static void relay_output(int conn, int out, int err) {
+    struct pollfd fds[2] = {{out, POLLIN, 0}, {err, POLLIN, 0}};
+    const char kinds[2] = {FRAME_STDOUT, FRAME_STDERR};
+    int open_streams = 2;
+    char buffer[4096];
+    while (open_streams > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].fd < 0 || !fds[i].revents) continue;
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_streams--;
+                continue;
+            }
+            // A client that went away only means nobody reads the rest
+            write_frame(conn, kinds[i], buffer, (size_t)n);
+        }
+    }
+}
+
+/**
+ * Handle one connection in a child of the server: read the request under a
+ * deadline, run the script in a grandchild and frame its output and status.
+ */
+static void serve_connection(Preloaded *scripts, int count, int conn) {
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct timeval deadline = {REQUEST_TIMEOUT, 0};
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &deadline, sizeof(deadline));
+    char request[REQUEST_MAX];
+    Preloaded *script = NULL;
+    if (read_request_line(conn, request, sizeof(request)) == 0 && strncmp(request, "RUN ", 4) == 0) {
+        script = find_script(scripts, count, request + 4);
+    }
+    if (!script) {
+        const char *msg = "Error: unknown request or script not preloaded.\n";
+        write_frame(conn, FRAME_STDERR, msg, strlen(msg));
+        send_status(conn, EXIT_FAILURE);
+        _exit(EXIT_FAILURE);
+    }
+    // `what? ->` may legitimately wait on the client for as long as it likes
+    struct timeval forever = {0, 0};
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &forever, sizeof(forever));
+
+    int out[2], err[2];
+    if (pipe(out) != 0 || pipe(err) != 0) {
+        perror("pipe");
+        send_status(conn, EXIT_FAILURE);
+        _exit(EXIT_FAILURE);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(out[0]);
+        close(err[0]);
+        run_script(script, conn, out[1], err[1]);
+    }
+    close(out[1]);
+    close(err[1]);
+    if (pid < 0) {
+        perror("fork");
+        send_status(conn, EXIT_FAILURE);
+        _exit(EXIT_FAILURE);
+    }
+
+    relay_output(conn, out[0], err[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    int code = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+    send_status(conn, code);
+    _exit(code);
+}
+
+int breeze_serve(const char *socket_path, char **paths, int count) {
+    Preloaded *scripts = calloc((size_t)count, sizeof(Preloaded));
+    if (!scripts) {
+        fprintf(stderr, "Error: Memory allocation for preloaded scripts failed.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        FILE *file = fopen(paths[i], "r");
+        if (!file) {
+            perror("Failed to open file");
+            return 1;
+        }
+        scripts[i].path = paths[i];
+        scripts[i].ctx = breeze_context_new();
+        // Imports are found next to the script (the context lives as long as the server)
+        const char *slash = strrchr(paths[i], '/');
+        if (slash) {
+            scripts[i].ctx->import_dir = strndup(paths[i], slash == paths[i] ? 1 : (size_t)(slash - paths[i]));
+        }
+        int status = breeze_parse_file(scripts[i].ctx, file);
+        fclose(file);
+        if (status != 0) {
+            fprintf(stderr, "Parsing of '%s' failed.\n", paths[i]);
+            return 1;
+        }
+        fprintf(stderr, "Preloaded %s\n", paths[i]);
+    }
+
+    struct sockaddr_un addr;
+    if (make_address(&addr, socket_path) != 0) return 1;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+        perror("bind/listen");
+        close(listener);
+        return 1;
+    }
+
+    // Children are never waited for explicitly; let the kernel reap them
+    signal(SIGCHLD, SIG_IGN);
+    fprintf(stderr, "Listening on %s\n", socket_path);
+
+    for (;;) {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+
+        // The child reads the request, so a slow client cannot stall the loop
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            serve_connection(scripts, count, conn);
+        } else if (pid < 0) {
+            perror("fork");
+        }
+        close(conn);
+    }
+
+    close(listener);
+    return 1;
+}
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Slurp the client's stdin once so every run receives the same input
+static char *read_stdin(size_t *len) {
+    *len = 0;
+    size_t cap = 4096;
+    char *data = malloc(cap);
+    ssize_t n;
+    while (data && (n = read(STDIN_FILENO, data + *len, cap - *len)) > 0) {
+        *len += (size_t)n;
+        if (*len == cap) {
+            cap *= 2;
+            data = realloc(data, cap);
+        }
+    }
+    return data;
+}
+
+static int read_all(int fd, char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Copy one run's frames to stdout/stderr and return its exit status
+static int read_frames(int fd) {
+    unsigned char header[FRAME_HEADER];
+    char buffer[4096];
+    while (read_all(fd, (char *)header, sizeof(header)) == 0) {
+        size_t len = (size_t)header[1] << 24 | (size_t)header[2] << 16 |
+                     (size_t)header[3] << 8 | header[4];
+        if (header[0] == FRAME_EXIT) {
+            unsigned char code = 0;
+            if (len != 1 || read_all(fd, (char *)&code, 1) != 0) break;
+            return code;
+        }
+        FILE *stream = header[0] == FRAME_STDERR ? stderr : stdout;
+        while (len > 0) {
+            size_t chunk = len < sizeof(buffer) ? len : sizeof(buffer);
+            if (read_all(fd, buffer, chunk) != 0) break;
+            fwrite(buffer, 1, chunk, stream);
+            len -= chunk;
+        }
+        fflush(stream);
+        if (len > 0) break;
+    }
+    fprintf(stderr, "Error: the server closed the connection before the run finished.\n");
+    return EXIT_FAILURE;
+}
+
+int breeze_client(const char *socket_path, const char *script, int repeat, int forward_stdin) {
+    struct sockaddr_un addr;
+    if (make_address(&addr, socket_path) != 0) return 1;
+
+    size_t input_len = 0;
+    char *input = forward_stdin ? read_stdin(&input_len) : NULL;
+
+    double total = 0, min = 0, max = 0;
+    int failed = 0;
+    for (int run = 0; run < repeat; run++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            free(input);
+            return 1;
+        }
+
+        char request[REQUEST_MAX];
+        snprintf(request, sizeof(request), "RUN %s\n", script);
+        if (write_all(fd, request, strlen(request)) != 0 ||
+            (input_len > 0 && write_all(fd, input, input_len) != 0)) {
+            perror("write");
+            close(fd);
+            free(input);
+            return 1;
+        }
+        shutdown(fd, SHUT_WR);
+
+        int status = read_frames(fd);
+        close(fd);
+        if (status != 0) failed = status;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = elapsed_ms(&start, &end);
+        total += ms;
+        if (run == 0 || ms < min) min = ms;
+        if (run == 0 || ms > max) max = ms;
+    }
+
+    fprintf(stderr, "runs: %d, latency min %.3f ms, avg %.3f ms, max %.3f ms\n",
+            repeat, min, total / repeat, max);
+    free(input);
+    return failed;
+}
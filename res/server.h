@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/**
+ * Warm fork-server mode.
+ *
+ * The server parses every script once, then listens on a unix socket.
+ * Each run request forks a copy-on-write child that inherits the parsed
+ * AST and initialized scopes, so a run costs a fork instead of an exec,
+ * a parse and init_scopes. The child reads the request itself (a client
+ * that sends nothing is dropped after a few seconds), runs the script in
+ * a grandchild and relays its output as it is produced.
+ *
+ * Protocol (one request per connection): the client sends
+ * "RUN <script>\n" followed by the data the script reads with `what?`.
+ * The server answers with frames of one kind byte, a 4-byte big-endian
+ * length and the payload: FRAME_STDOUT and FRAME_STDERR carry the
+ * script's two streams, and a final FRAME_EXIT carries its exit status
+ * as one byte (128 + signal number if it was killed).
+ */
+
+#define FRAME_STDOUT 'O'
+#define FRAME_STDERR 'E'
+#define FRAME_EXIT   'X'
+
+// Preload `count` scripts and serve run requests forever. Returns 1 on setup failure.
+int breeze_serve(const char *socket_path, char **scripts, int count);
+
+/**
+ * Submit `repeat` runs of `script` to a server, copy their output to
+ * stdout and stderr and print latency statistics to stderr. With
+ * `forward_stdin` the client's stdin is read once and sent to every run.
+ * Returns 0 if every run exited with 0, else the last failing status.
+ */
+int breeze_client(const char *socket_path, const char *script, int repeat, int forward_stdin);
+
+#endif
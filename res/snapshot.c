@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include "snapshot.h"
+#include "astio.h"
+#include "context.h"
+#include "ast.h"
+#include "module.h"
+#include "lazy.h"
+#include "inline.h"
+#include "loopopt.h"
+#include "typeinfer.h"
+#include "task.h"
+
+/**
+ * File layout (see astio.h for texts and ASTs):
+ *
+ *   magic, NODE_ERROR, key
+ *   u32 globals, then each: name, type, value (a function: its NODE_FUNC)
+ *   u32 imported modules, then each: its name
+ *   u32 statements after the marker, then each as an AST
+ */
+#define SNAPSHOT_MAGIC "BZSNAP04"
+
+unsigned long long snapshot_key(const char *source, size_t length) {
+  return astio_hash(source, length);
+}
+
+static void put_symbol(FILE *out, const SymbolNode *sym) {
+  astio_put_text(out, sym->name, strlen(sym->name));
+  astio_put_i32(out, sym->type);
+  switch (sym->type) {
+    case TYPE_INT:      astio_put_i32(out, sym->data.int_val); break;
+    case TYPE_BOOL:     astio_put_i32(out, sym->data.bool_val); break;
+    case TYPE_FLOAT:    astio_put(out, &sym->data.float_val, sizeof(float)); break;
+    case TYPE_BIGINT:   astio_put_bigint(out, sym->data.big_val); break;
+    case TYPE_FUNCTION: astio_put_node(out, sym->data.func_ast); break;
+    case TYPE_STRING: {
+      String *s = sym->data.string_val;
+      astio_put_text(out, s ? s->chars : "", s ? (size_t)s->length : 0);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/**
+ * The statements of a program in order. The parser chains them to the
+ * left: NODE_STMTS(NODE_STMTS(NODE_STMTS(s1), s2), s3).
+ */
+static astnode_t **top_level(astnode_t *root, int *count) {
+  int n = 0;
+  astnode_t *s = root;
+  for (; s && s->child[1]; s = s->child[0]) n++;
+  if (s && s->child[0]) n++;
+
+  astnode_t **statements = malloc(sizeof(astnode_t *) * (size_t)(n > 0 ? n : 1));
+  if (!statements) {
+    fprintf(stderr, "Error: Memory allocation for a snapshot failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  int i = n;
+  for (s = root; s && s->child[1]; s = s->child[0]) statements[--i] = s->child[1];
+  if (s && s->child[0]) statements[--i] = s->child[0];
+  *count = n;
+  return statements;
+}
+
+__attribute__((format(printf, 3, 4)))
+static void refuse(BreezeContext *ctx, const char *path, const char *fmt, ...) {
+  if (!ctx->err) return;
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(ctx->err, "Warning: no snapshot written to '%s': ", path);
+  vfprintf(ctx->err, fmt, ap);
+  fprintf(ctx->err, ".\n");
+  va_end(ap);
+}
+
+void snapshot_take(BreezeContext *ctx, astnode_t *marker) {
+  const char *path = ctx->snapshot;
+  ctx->snapshot = NULL;
+
+  int count, at = -1;
+  astnode_t **statements = top_level(ctx->root_ast, &count);
+  for (int i = 0; i < count && at < 0; i++) {
+    if (statements[i] == marker) at = i;
+  }
+  if (at < 0) {
+    refuse(ctx, path, "the snapshot; at line %d is not a top-level statement", marker->line);
+    free(statements);
+    return;
+  }
+  if (task_running(ctx)) {
+    refuse(ctx, path, "spawned tasks are still running at line %d", marker->line);
+    free(statements);
+    return;
+  }
+  // Function bodies are stored parsed, as the file keeps no source
+  astnode_t *broken = lazy_ready_all(ctx->root_ast);
+  if (broken) {
+    refuse(ctx, path, "function '%s' at line %d has a syntax error", broken->data.id, broken->line);
+    free(statements);
+    return;
+  }
+
+  // At the top level the only scope is the global one
+  uint32_t globals = 0;
+  for (SymbolNode *sym = ctx->current_scope->symbols; sym; sym = sym->next) {
+    if (sym->type == TYPE_GENERATOR || sym->type == TYPE_CHANNEL) {
+      refuse(ctx, path, "global '%s' holds a %s", sym->name,
+             sym->type == TYPE_GENERATOR ? "generator" : "channel");
+      free(statements);
+      return;
+    }
+    globals++;
+  }
+
+  char *partial;
+  FILE *out = astio_create(path, &partial);
+  if (!out) {
+    refuse(ctx, path, "cannot create it");
+    free(statements);
+    return;
+  }
+
+  astio_put(out, SNAPSHOT_MAGIC, 8);
+  astio_put_u32(out, NODE_ERROR);
+  astio_put_u64(out, ctx->snapshot_key);
+  astio_put_u32(out, globals);
+  for (SymbolNode *sym = ctx->current_scope->symbols; sym; sym = sym->next) {
+    put_symbol(out, sym);
+  }
+  uint32_t imports = 0;
+  for (ImportedModule *m = ctx->imports; m; m = m->next) imports++;
+  astio_put_u32(out, imports);
+  for (ImportedModule *m = ctx->imports; m; m = m->next) {
+    astio_put_text(out, m->name, strlen(m->name));
+  }
+  astio_put_u32(out, (uint32_t)(count - at - 1));
+  for (int i = at + 1; i < count; i++) {
+    astio_put_node(out, statements[i]);
+  }
+  free(statements);
+
+  if (astio_commit(out, partial, path) != 0) refuse(ctx, path, "writing failed");
+}
+
+// ----------- READING -----------
+
+// A global read from the file, defined once the whole file has been read
+typedef struct Global {
+  char *name;
+  ValueType type;
+  Value value;
+  astnode_t *func;
+} Global;
+
+static void take_global(AstReader *r, Global *g) {
+  uint32_t length;
+  const char *text;
+
+  g->name = astio_take_string(r);
+  g->type = (ValueType)astio_take_i32(r);
+  g->value = create_int_value(0);
+  switch (g->type) {
+    case TYPE_INT:      g->value = create_int_value(astio_take_i32(r)); break;
+    case TYPE_BOOL:     g->value = create_bool_value(astio_take_i32(r)); break;
+    case TYPE_FLOAT:    g->value = create_float_value(astio_take_float(r)); break;
+    case TYPE_FUNCTION: g->func = astio_take_node(r); break;
+    case TYPE_BIGINT: {
+      BigInt *b = astio_take_bigint(r);
+      if (b) {
+        g->value.type = TYPE_BIGINT;
+        g->value.data.big_val = b;
+      }
+      break;
+    }
+    case TYPE_STRING:
+      text = astio_take_text(r, &length);
+      if (text) {
+        g->value = create_string_value(string_from(text, (int)length));
+      } else {
+        r->failed = 1;
+      }
+      break;
+    default:
+      r->failed = 1;
+      break;
+  }
+  if (!g->name || (g->type == TYPE_FUNCTION && (!g->func || g->func->type != NODE_FUNC))) {
+    r->failed = 1;
+  }
+}
+
+// Chain statements the way the parser does
+static astnode_t *chain(astnode_t *program, astnode_t *statement) {
+  astnode_t *node = astnode_new(NODE_STMTS);
+  node->child[0] = program ? program : statement;
+  node->child[1] = program ? statement : NULL;
+  return node;
+}
+
+int snapshot_restore(BreezeContext *ctx, const char *path, unsigned long long key) {
+  size_t size;
+  const char *map = astio_map(path, &size);
+  if (!map) return -1;
+
+  AstReader r = { map, map + size, 0, 0 };
+  const char *magic = astio_take(&r, 8);
+  if (!magic || memcmp(magic, SNAPSHOT_MAGIC, 8) != 0 ||
+      astio_take_u32(&r) != NODE_ERROR || astio_take_u64(&r) != key) {
+    // Taken from another script, or by another build
+    astio_unmap(map, size);
+    return -1;
+  }
+
+  uint32_t count = astio_take_u32(&r);
+  Global *globals = calloc(count > 0 ? count : 1, sizeof(Global));
+  uint32_t read = 0;
+  while (globals && read < count && !r.failed) {
+    take_global(&r, &globals[read++]);
+  }
+  uint32_t imports = astio_take_u32(&r);
+  const char *first_import = r.p;
+  for (uint32_t i = 0; i < imports && !r.failed; i++) {
+    uint32_t length;
+    if (!astio_take_text(&r, &length)) r.failed = 1;
+  }
+  uint32_t statements = astio_take_u32(&r);
+  astnode_t *rest = NULL;
+  for (uint32_t i = 0; i < statements && !r.failed; i++) {
+    astnode_t *statement = astio_take_node(&r);
+    rest = chain(rest, statement);
+  }
+  if (r.p != r.end || !globals) r.failed = 1;
+
+  if (r.failed) {
+    astio_unmap(map, size);
+    if (ctx->err) fprintf(ctx->err, "Warning: ignoring damaged snapshot '%s'.\n", path);
+    for (uint32_t i = 0; globals && i < read; i++) {
+      free(globals[i].name);
+      release_value(globals[i].value);
+      free_ast(globals[i].func);
+    }
+    free(globals);
+    free_ast(rest);
+    return -1;
+  }
+
+  // Values go straight into the global scope, functions are defined again
+  // by the program ahead of the statements after the marker
+  astnode_t *program = NULL;
+  for (uint32_t i = 0; i < count; i++) {
+    Global *g = &globals[i];
+    switch (g->type) {
+      case TYPE_INT:      put_symbol_int(ctx, g->name, g->value.data.int_val); break;
+      case TYPE_BOOL:     put_symbol_bool(ctx, g->name, g->value.data.int_val); break;
+      case TYPE_FLOAT:    put_symbol_float(ctx, g->name, g->value.data.float_val); break;
+      case TYPE_BIGINT:   put_symbol_bigint(ctx, g->name, g->value.data.big_val); break;
+      case TYPE_STRING:   put_symbol_string(ctx, g->name, g->value.data.str_val); break;
+      case TYPE_FUNCTION: program = chain(program, g->func); break;
+      default: break;
+    }
+    release_value(g->value);
+    free(g->name);
+  }
+  free(globals);
+
+  // The modules stay imported: importing them again would define their functions twice
+  AstReader names = { first_import, map + size, 0, 0 };
+  for (uint32_t i = 0; i < imports; i++) {
+    char *name = astio_take_string(&names);
+    module_mark_imported(ctx, name);
+    free(name);
+  }
+  astio_unmap(map, size);
+
+  program = stmts_join(program, rest);
+  if (!program) program = astnode_new(NODE_STMTS);
+
+  ctx->root_ast = program;
+  loop_optimize(program);
+  infer_types(program);
+  inline_calls(program, ctx->inline_size);
+  return 0;
+}
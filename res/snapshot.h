@@ -0,0 +1,42 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Snapshots of a script's prelude (--snapshot FILE). A top-level
+ * `snapshot;` statement marks where the prelude ends: a run that reaches
+ * it saves the globals (the function definitions too) and the statements
+ * after the marker to FILE. A later run of the same script maps FILE and
+ * continues from the marker, skipping both the parse and the prelude.
+ *
+ * A snapshot belongs to the exact source it was taken from (see
+ * snapshot_key), so editing the script makes the next run start over and
+ * take a new one. Output printed by the prelude is not repeated by
+ * resumed runs. Preludes holding generators or channels in globals, or
+ * with tasks still running at the marker, cannot be saved. Runs without
+ * --snapshot ignore the marker.
+ */
+
+// Hash of a script's source that a snapshot records
+unsigned long long snapshot_key(const char *source, size_t length);
+
+/**
+ * Resume from the snapshot at `path` if it was taken from a script with
+ * this key: define its globals and make the rest of the program (the
+ * functions defined before the marker, then the statements after it)
+ * ctx->root_ast. Returns 0, or -1 without touching ctx when there is
+ * no usable snapshot.
+ */
+int snapshot_restore(BreezeContext *ctx, const char *path, unsigned long long key);
+
+/**
+ * `snapshot;` in a run with ctx->snapshot set: write the snapshot of the
+ * globals and of the top-level statements after `marker`. Problems are
+ * warnings, and only the first marker reached is considered.
+ */
+void snapshot_take(BreezeContext *ctx, astnode_t *marker);
+
+#endif
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include "strlib.h"
+#include "strscan.h"
+#include "strval.h"
+#include "generator.h"
+#include "context.h"
+#include "ast.h"
+
+// A builtin being called: its arguments are all strings
+typedef struct Call {
+  BreezeContext *ctx;
+  const StringBuiltin *builtin;
+  Value *args;
+  int argc;
+} Call;
+
+struct StringBuiltin {
+  const char *name;
+  int min_args, max_args;
+  Value (*call)(Call *call);
+};
+
+// Drop the arguments and fail with "Error: name() <message>."
+static void fail(Call *call, const char *format, ...) {
+  char message[256];
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(message, sizeof(message), format, ap);
+  va_end(ap);
+
+  for (int i = 0; i < call->argc; i++) release_value(call->args[i]);
+  breeze_error(call->ctx, "Error: %s() %s.\n", call->builtin->name, message);
+}
+
+static String *arg(Call *call, int i) {
+  return call->args[i].data.str_val;
+}
+
+static int is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// ----------- SEARCHING -----------
+
+static Value builtin_find(Call *call) {
+  String *s = arg(call, 0), *sub = arg(call, 1);
+  return create_int_value((int)strscan_find(s->chars, (size_t)s->length, sub->chars, (size_t)sub->length));
+}
+
+static Value builtin_contains(Call *call) {
+  String *s = arg(call, 0), *sub = arg(call, 1);
+  return create_bool_value(strscan_find(s->chars, (size_t)s->length, sub->chars, (size_t)sub->length) >= 0);
+}
+
+static Value builtin_count(Call *call) {
+  String *s = arg(call, 0), *sub = arg(call, 1);
+  // The empty string occurs before every character and at the end
+  if (sub->length == 0) return create_int_value(s->length + 1);
+  return create_int_value((int)strscan_count(s->chars, (size_t)s->length, sub->chars, (size_t)sub->length));
+}
+
+// ----------- SPLITTING -----------
+
+typedef struct Split {
+  String *s;
+  String *sep;          // NULL: split at runs of whitespace
+  int pos;
+  int done;
+} Split;
+
+static int split_next(void *data, Value *value) {
+  Split *split = data;
+  String *s = split->s;
+  int start, length;
+
+  if (!split->sep) {
+    while (split->pos < s->length && is_space(s->chars[split->pos])) split->pos++;
+    if (split->pos == s->length) return 0;
+    start = split->pos;
+    while (split->pos < s->length && !is_space(s->chars[split->pos])) split->pos++;
+    length = split->pos - start;
+  } else {
+    if (split->done) return 0;
+    start = split->pos;
+    long at = strscan_find(s->chars + start, (size_t)(s->length - start),
+                           split->sep->chars, (size_t)split->sep->length);
+    if (at < 0) {
+      length = s->length - start;
+      split->done = 1;
+    } else {
+      length = (int)at;
+      split->pos = start + length + split->sep->length;
+    }
+  }
+  *value = create_string_value(string_slice(s, start, length));
+  return 1;
+}
+
+static void split_drop(void *data) {
+  Split *split = data;
+  string_release(split->s);
+  if (split->sep) string_release(split->sep);
+  free(split);
+}
+
+static Value builtin_split(Call *call) {
+  if (call->argc == 2 && arg(call, 1)->length == 0) {
+    fail(call, "needs a separator that is not empty");
+  }
+  Split *split = calloc(1, sizeof(Split));
+  if (!split) {
+    fprintf(stderr, "Error: Memory allocation for split() failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  split->s = string_retain(arg(call, 0));
+  split->sep = call->argc == 2 ? string_retain(arg(call, 1)) : NULL;
+  return create_generator_value(generator_native("split", split_next, split_drop, split));
+}
+
+// ----------- NEW STRINGS -----------
+
+static Value builtin_replace(Call *call) {
+  String *s = arg(call, 0), *old = arg(call, 1), *new = arg(call, 2);
+  if (old->length == 0) {
+    fail(call, "needs a string to replace that is not empty");
+  }
+
+  size_t n = (size_t)s->length, m = (size_t)old->length;
+  size_t matches = strscan_count(s->chars, n, old->chars, m);
+  if (matches == 0) return create_string_value(string_retain(s));
+
+  long long length = (long long)n + (long long)matches * ((long long)new->length - (long long)m);
+  if (length > INT_MAX) {
+    fail(call, "would make a string of %lld characters", length);
+  }
+
+  String *result = string_blank((int)length);
+  char *out = result->data;
+  size_t pos = 0;
+  long at;
+  while (n - pos >= m && (at = strscan_find(s->chars + pos, n - pos, old->chars, m)) >= 0) {
+    memcpy(out, s->chars + pos, (size_t)at);
+    out += at;
+    memcpy(out, new->chars, (size_t)new->length);
+    out += new->length;
+    pos += (size_t)at + m;
+  }
+  memcpy(out, s->chars + pos, n - pos);
+  string_finish(result);
+  return create_string_value(result);
+}
+
+static Value builtin_strip(Call *call) {
+  String *s = arg(call, 0);
+  int start = 0, end = s->length;
+  while (start < end && is_space(s->chars[start])) start++;
+  while (end > start && is_space(s->chars[end - 1])) end--;
+
+  if (start == 0 && end == s->length) return create_string_value(string_retain(s));
+  return create_string_value(string_slice(s, start, end - start));
+}
+
+static Value map_case(Call *call, void (*map)(char *dst, const char *src, size_t n)) {
+  String *s = arg(call, 0);
+  String *result = string_blank(s->length);
+  map(result->data, s->chars, (size_t)s->length);
+  string_finish(result);
+  return create_string_value(result);
+}
+
+static Value builtin_upper(Call *call) {
+  return map_case(call, strscan_upper);
+}
+
+static Value builtin_lower(Call *call) {
+  return map_case(call, strscan_lower);
+}
+
+// ----------- DISPATCH -----------
+
+static const StringBuiltin builtins[] = {
+  { "find",     2, 2, builtin_find },
+  { "contains", 2, 2, builtin_contains },
+  { "count",    2, 2, builtin_count },
+  { "split",    1, 2, builtin_split },
+  { "replace",  3, 3, builtin_replace },
+  { "strip",    1, 1, builtin_strip },
+  { "upper",    1, 1, builtin_upper },
+  { "lower",    1, 1, builtin_lower },
+};
+
+const StringBuiltin *strlib_lookup(const char *name) {
+  for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+    if (strcmp(builtins[i].name, name) == 0) return &builtins[i];
+  }
+  return NULL;
+}
+
+Value strlib_call(BreezeContext *ctx, const StringBuiltin *b, Value *args, int argc) {
+  Call call = { ctx, b, args, argc };
+
+  if (argc < b->min_args || argc > b->max_args) {
+    if (b->min_args == b->max_args) {
+      fail(&call, "takes %d argument%s, not %d", b->min_args, b->min_args == 1 ? "" : "s", argc);
+    }
+    fail(&call, "takes %d or %d arguments, not %d", b->min_args, b->max_args, argc);
+  }
+  for (int i = 0; i < argc; i++) {
+    if (args[i].type != TYPE_STRING) {
+      fail(&call, "takes strings, but argument %d is not one", i + 1);
+    }
+  }
+
+  Value result = b->call(&call);
+  for (int i = 0; i < argc; i++) release_value(args[i]);
+  return result;
+}
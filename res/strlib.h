@@ -0,0 +1,34 @@
+#ifndef STRLIB_H
+#define STRLIB_H
+
+#include "symtab.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Built-in string functions. A call whose name is not bound to a d{}
+ * function is looked up here, so a script can still define its own
+ * find() or use `count` as a variable.
+ *
+ *   find(s, sub)          offset of the first sub in s, or -1
+ *   contains(s, sub)      whether s contains sub
+ *   count(s, sub)         occurrences of sub in s that do not overlap
+ *   split(s, sep)         generator of the pieces of s between the seps
+ *   split(s)              generator of the words of s between whitespace
+ *   replace(s, old, new)  s with every old replaced by new
+ *   strip(s)              s without leading and trailing whitespace
+ *   upper(s), lower(s)    s with its ASCII letters in one case
+ *
+ * Scans run on the vector kernels of strscan.h. split() and strip()
+ * return views into s instead of copies.
+ */
+
+typedef struct StringBuiltin StringBuiltin;
+
+// The builtin called `name`, or NULL
+const StringBuiltin *strlib_lookup(const char *name);
+
+// Call b with the argc values in args, taking over their references
+Value strlib_call(BreezeContext *ctx, const StringBuiltin *b, Value *args, int argc);
+
+#endif
@@ -0,0 +1,226 @@
+#include <string.h>
+#include <pthread.h>
+#include "strscan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define STRSCAN_SIMD 1
+#endif
+
+// Kernels for the processor we run on; find() gets needles of 2 bytes or more
+typedef struct Kernels {
+  long (*find)(const char *haystack, size_t n, const char *needle, size_t m);
+  size_t (*count_byte)(const char *haystack, size_t n, char c);
+  void (*map_case)(char *dst, const char *src, size_t n, char from);
+} Kernels;
+
+// ----------- PORTABLE -----------
+
+static long find_portable(const char *haystack, size_t n, const char *needle, size_t m) {
+  const char *p = haystack;
+  const char *end = haystack + n - m + 1;   // Last place a match can start, plus one
+
+  while (p < end) {
+    p = memchr(p, needle[0], (size_t)(end - p));
+    if (!p) return -1;
+    if (memcmp(p + 1, needle + 1, m - 1) == 0) return p - haystack;
+    p++;
+  }
+  return -1;
+}
+
+static size_t count_byte_portable(const char *haystack, size_t n, char c) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) count += haystack[i] == c;
+  return count;
+}
+
+// Flip the case bit of the 26 bytes from `from` on: 'a' maps to upper case, 'A' to lower
+static void map_case_portable(char *dst, const char *src, size_t n, char from) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = (unsigned char)(src[i] - from) < 26 ? (char)(src[i] ^ 0x20) : src[i];
+  }
+}
+
+// What a vector loop left from offset i on
+static long find_tail(const char *haystack, size_t n, size_t i, const char *needle, size_t m) {
+  if (n - i < m) return -1;
+  long at = find_portable(haystack + i, n - i, needle, m);
+  return at < 0 ? -1 : (long)i + at;
+}
+
+#ifdef STRSCAN_SIMD
+
+// ----------- SSE2 -----------
+
+static long find_sse2(const char *haystack, size_t n, const char *needle, size_t m) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+
+  // Bit k of the mask: a match could start at i + k
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(haystack + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(haystack + i + m - 1));
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+    while (mask) {
+      size_t at = i + (size_t)__builtin_ctz(mask);
+      if (memcmp(haystack + at + 1, needle + 1, m - 2) == 0) return (long)at;
+      mask &= mask - 1;
+    }
+  }
+  return find_tail(haystack, n, i, needle, m);
+}
+
+static size_t count_byte_sse2(const char *haystack, size_t n, char c) {
+  const __m128i target = _mm_set1_epi8(c);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i total = zero;
+  size_t i = 0;
+
+  while (n - i >= 16) {
+    // Each byte lane counts up to 255 matches before they are summed
+    size_t blocks = (n - i) / 16;
+    if (blocks > 255) blocks = 255;
+    __m128i lanes = zero;
+    for (size_t end = i + blocks * 16; i < end; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(haystack + i));
+      lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(a, target));
+    }
+    total = _mm_add_epi64(total, _mm_sad_epu8(lanes, zero));
+  }
+  size_t count = (size_t)_mm_cvtsi128_si64(total) +
+                 (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+  return count + count_byte_portable(haystack + i, n - i, c);
+}
+
+static void map_case_sse2(char *dst, const char *src, size_t n, char from) {
+  // Moves the 26 letters to the bottom of the signed byte range
+  const __m128i shift = _mm_set1_epi8((char)(-128 - from));
+  const __m128i limit = _mm_set1_epi8(-128 + 26);
+  const __m128i flip = _mm_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i letter = _mm_cmpgt_epi8(limit, _mm_add_epi8(a, shift));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(a, _mm_and_si128(letter, flip)));
+  }
+  map_case_portable(dst + i, src + i, n - i, from);
+}
+
+// ----------- AVX2 -----------
+
+__attribute__((target("avx2")))
+static long find_avx2(const char *haystack, size_t n, const char *needle, size_t m) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(haystack + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(haystack + i + m - 1));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+    while (mask) {
+      size_t at = i + (size_t)__builtin_ctz(mask);
+      if (memcmp(haystack + at + 1, needle + 1, m - 2) == 0) return (long)at;
+      mask &= mask - 1;
+    }
+  }
+  return find_tail(haystack, n, i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static size_t count_byte_avx2(const char *haystack, size_t n, char c) {
+  const __m256i target = _mm256_set1_epi8(c);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i total = zero;
+  size_t i = 0;
+
+  while (n - i >= 32) {
+    size_t blocks = (n - i) / 32;
+    if (blocks > 255) blocks = 255;
+    __m256i lanes = zero;
+    for (size_t end = i + blocks * 32; i < end; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(haystack + i));
+      lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(a, target));
+    }
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(lanes, zero));
+  }
+  size_t count = (size_t)_mm256_extract_epi64(total, 0) + (size_t)_mm256_extract_epi64(total, 1) +
+                 (size_t)_mm256_extract_epi64(total, 2) + (size_t)_mm256_extract_epi64(total, 3);
+  return count + count_byte_portable(haystack + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static void map_case_avx2(char *dst, const char *src, size_t n, char from) {
+  const __m256i shift = _mm256_set1_epi8((char)(-128 - from));
+  const __m256i limit = _mm256_set1_epi8(-128 + 26);
+  const __m256i flip = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i letter = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(a, shift));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a, _mm256_and_si256(letter, flip)));
+  }
+  map_case_portable(dst + i, src + i, n - i, from);
+}
+
+#endif
+
+// ----------- DISPATCH -----------
+
+static Kernels kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernels(void) {
+#ifdef STRSCAN_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels = (Kernels){ find_avx2, count_byte_avx2, map_case_avx2 };
+  } else {
+    kernels = (Kernels){ find_sse2, count_byte_sse2, map_case_sse2 };
+  }
+#else
+  kernels = (Kernels){ find_portable, count_byte_portable, map_case_portable };
+#endif
+}
+
+static const Kernels *get_kernels(void) {
+  pthread_once(&kernels_once, choose_kernels);
+  return &kernels;
+}
+
+long strscan_find(const char *haystack, size_t n, const char *needle, size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return -1;
+  if (m == 1) {
+    // The C library's memchr() is vectorized already
+    const char *p = memchr(haystack, needle[0], n);
+    return p ? p - haystack : -1;
+  }
+  return get_kernels()->find(haystack, n, needle, m);
+}
+
+size_t strscan_count(const char *haystack, size_t n, const char *needle, size_t m) {
+  if (m == 1) return get_kernels()->count_byte(haystack, n, needle[0]);
+
+  size_t count = 0, pos = 0;
+  long at;
+  while (n - pos >= m && (at = strscan_find(haystack + pos, n - pos, needle, m)) >= 0) {
+    count++;
+    pos += (size_t)at + m;
+  }
+  return count;
+}
+
+void strscan_upper(char *dst, const char *src, size_t n) {
+  get_kernels()->map_case(dst, src, n, 'a');
+}
+
+void strscan_lower(char *dst, const char *src, size_t n) {
+  get_kernels()->map_case(dst, src, n, 'A');
+}
@@ -0,0 +1,27 @@
+#ifndef STRSCAN_H
+#define STRSCAN_H
+
+#include <stddef.h>
+
+/**
+ * Byte-scanning kernels behind the string builtins (see strlib.h). On
+ * x86-64 they compare 16 bytes at a time with SSE2, or 32 with AVX2 when
+ * the processor has it (checked once, at the first call). Other targets
+ * use portable loops built on memchr() and memcmp().
+ *
+ * Substring search tests the first and the last byte of the needle at
+ * every position of a block at once, and only compares the rest where
+ * both match.
+ */
+
+// Offset of the first occurrence of needle in haystack, or -1 (0 for an empty needle)
+long strscan_find(const char *haystack, size_t n, const char *needle, size_t m);
+
+// Occurrences of a non-empty needle that do not overlap, counted left to right
+size_t strscan_count(const char *haystack, size_t n, const char *needle, size_t m);
+
+// Copy n bytes from src to dst, mapping ASCII letters to upper / lower case
+void strscan_upper(char *dst, const char *src, size_t n);
+void strscan_lower(char *dst, const char *src, size_t n);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "strval.h"
+
+#define STRING_HEAP_CHARS 4   // A flattened view: chars were malloc'd separately
+
+static void *string_alloc(size_t size) {
+  void *mem = malloc(size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed for a string.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+// An owned string with room for length characters, not yet filled in
+static String *string_make(int length) {
+  String *s = string_alloc(sizeof(String) + (size_t)length + 1);
+  s->refs = 1;
+  s->length = length;
+  s->flags = 0;
+  s->size = (int)sizeof(String) + length + 1;
+  s->account = heap_account;
+  heap_charge(s->account, s->size);
+  s->chars = s->data;
+  s->base = NULL;
+  s->data[length] = '\0';
+  return s;
+}
+
+String *string_blank(int length) {
+  return string_make(length);
+}
+
+void string_finish(String *s) {
+  if (memchr(s->data, '\\', (size_t)s->length)) s->flags |= STRING_BACKSLASH;
+}
+
+String *string_from(const char *chars, int length) {
+  String *s = string_make(length);
+  memcpy(s->data, chars, (size_t)length);
+  if (memchr(chars, '\\', (size_t)length)) s->flags |= STRING_BACKSLASH;
+  return s;
+}
+
+String *string_new(const char *s) {
+  return string_from(s, (int)strlen(s));
+}
+
+String *string_slice(String *s, int start, int length) {
+  String *view = string_alloc(sizeof(String));
+  String *base = s->base ? s->base : s;
+
+  view->refs = 1;
+  view->length = length;
+  view->flags = 0;
+  view->size = (int)sizeof(String);
+  view->account = heap_account;
+  heap_charge(view->account, view->size);
+  view->chars = s->chars + start;
+  view->base = string_retain(base);
+  if ((s->flags & STRING_BACKSLASH) && memchr(view->chars, '\\', (size_t)length)) {
+    view->flags |= STRING_BACKSLASH;
+  }
+  return view;
+}
+
+static String single_chars[256];
+static char single_text[256][2];
+static pthread_once_t single_once = PTHREAD_ONCE_INIT;
+
+static void init_single_chars(void) {
+  for (int c = 0; c < 256; c++) {
+    single_text[c][0] = (char)c;
+    single_text[c][1] = '\0';
+    single_chars[c].refs = 1;
+    single_chars[c].length = c ? 1 : 0;
+    single_chars[c].flags = STRING_STATIC | (c == '\\' ? STRING_BACKSLASH : 0);
+    single_chars[c].size = 0;
+    single_chars[c].account = NULL;
+    single_chars[c].chars = single_text[c];
+    single_chars[c].base = NULL;
+  }
+}
+
+String *string_char(unsigned char c) {
+  pthread_once(&single_once, init_single_chars);
+  return &single_chars[c];
+}
+
+String *string_retain(String *s) {
+  if (!(s->flags & STRING_STATIC)) s->refs++;
+  return s;
+}
+
+void string_release(String *s) {
+  if (!s || (s->flags & STRING_STATIC) || --s->refs > 0) return;
+  if (s->base) string_release(s->base);
+  if (s->flags & STRING_HEAP_CHARS) free((char *)s->chars);
+  heap_charge(s->account, -s->size);
+  free(s);
+}
+
+const char *string_cstr(String *s) {
+  if (!s->base) return s->chars;
+
+  char *chars = string_alloc((size_t)s->length + 1);
+  memcpy(chars, s->chars, (size_t)s->length);
+  chars[s->length] = '\0';
+  string_release(s->base);
+  s->base = NULL;
+  s->chars = chars;
+  s->flags |= STRING_HEAP_CHARS;
+  s->size += s->length + 1;
+  heap_charge(s->account, s->length + 1);
+  return chars;
+}
+
+// Handle \n, \t, \\ and \"; other escapes warn and keep the character
+static String *process_escapes(const char *input, int length) {
+  String *s = string_make(length);
+  char *dest = s->data;
+  const char *end = input + length;
+
+  while (input < end) {
+    if (*input == '\\') {
+      input++;
+      if (input == end) {
+        // A trailing backslash escapes the terminator
+        fprintf(stderr, "Warning: Unknown escape \\%c\n", '\0');
+        break;
+      }
+      switch (*input) {
+        case 'n': *dest++ = '\n'; break;
+        case 't': *dest++ = '\t'; break;
+        case '\\': *dest++ = '\\'; break;
+        case '"': *dest++ = '"'; break;
+        default:  // Handle unknown escapes
+          fprintf(stderr, "Warning: Unknown escape \\%c\n", *input);
+          *dest++ = *input;
+      }
+    } else {
+      *dest++ = *input;
+    }
+    input++;
+  }
+  *dest = '\0';
+  s->length = (int)(dest - s->data);
+  if (memchr(s->data, '\\', (size_t)s->length)) s->flags |= STRING_BACKSLASH;
+  return s;
+}
+
+static int quoted(const char *chars, int length) {
+  return length > 0 && chars[0] == '"' && chars[length - 1] == '"';
+}
+
+// The characters create_str_value() processes: a lone quote leaves nothing
+static const char *unquoted_range(const char *s, int *length) {
+  *length = (int)strlen(s);
+  if (!quoted(s, *length)) return s;
+  *length = *length > 1 ? *length - 2 : 0;
+  return s + 1;
+}
+
+String *string_unquote(const char *s) {
+  int length;
+  const char *chars = unquoted_range(s, &length);
+  return process_escapes(chars, length);
+}
+
+String *string_value(String *s) {
+  if (!(s->flags & STRING_BACKSLASH) && !quoted(s->chars, s->length)) {
+    return string_retain(s);
+  }
+  return string_unquote(string_cstr(s));
+}
+
+String *string_literal(const char *source) {
+  int length;
+  const char *chars = unquoted_range(source, &length);
+
+  // Would processing print a warning?
+  for (int i = 0; i < length; i++) {
+    if (chars[i] != '\\') continue;
+    if (++i == length) return NULL;
+    if (!strchr("nt\\\"", chars[i])) return NULL;
+  }
+  String *s = process_escapes(chars, length);
+  s->flags |= STRING_STATIC;
+  // Owned by the AST, not a runtime value
+  heap_charge(s->account, -s->size);
+  s->account = NULL;
+  return s;
+}
+
+void string_literal_free(String *s) {
+  free(s);
+}
+
+int string_compare(const String *a, const String *b) {
+  int n = a->length < b->length ? a->length : b->length;
+  const unsigned char *p = (const unsigned char *)a->chars;
+  const unsigned char *q = (const unsigned char *)b->chars;
+
+  if (memcmp(p, q, (size_t)n) != 0) {
+    for (int i = 0; i < n; i++) {
+      if (p[i] != q[i]) return p[i] - q[i];
+    }
+  }
+  if (a->length > n) return p[n];
+  if (b->length > n) return -q[n];
+  return 0;
+}
+
+void string_write(const String *s, FILE *out) {
+  fwrite(s->chars, 1, (size_t)s->length, out);
+}
@@ -0,0 +1,76 @@
+#ifndef STRVAL_H
+#define STRVAL_H
+
+#include <stdio.h>
+#include "heap.h"
+
+/**
+ * Immutable runtime strings. A String knows its length, and a slice is
+ * a view (pointer and length) into the buffer of the string it was cut
+ * from, which it keeps alive with a reference. Indexing a single
+ * character returns an interned one-character string, so `s[i]` and
+ * `len(s)` are O(1) and allocate nothing.
+ *
+ * Values, symbols and views hold references. String literals and the
+ * interned characters are static: references to them are not counted,
+ * so they can be shared by contexts running on different threads.
+ */
+
+#define STRING_BACKSLASH 1    // Contains a backslash (reads must process escapes)
+#define STRING_STATIC    2    // Never freed, not reference counted
+
+typedef struct String {
+  int refs;
+  int length;
+  int flags;
+  int size;                 // Bytes allocated for it
+  HeapAccount *account;     // Charged with size (see heap.h)
+  const char *chars;        // NUL-terminated, except in views
+  struct String *base;      // View: the string owning the buffer
+  char data[];              // Owned characters
+} String;
+
+// Copy a C string / a byte range into a new string with one reference
+String *string_new(const char *s);
+String *string_from(const char *chars, int length);
+
+// View of length characters of s starting at start
+String *string_slice(String *s, int start, int length);
+
+/**
+ * An owned string with room for length characters, for code that
+ * computes them in place: fill in s->data, then call string_finish().
+ */
+String *string_blank(int length);
+void string_finish(String *s);
+
+// Interned string holding the single character c
+String *string_char(unsigned char c);
+
+String *string_retain(String *s);
+void string_release(String *s);
+
+// NUL-terminated characters; a view is flattened into its own copy
+const char *string_cstr(String *s);
+
+/**
+ * create_str_value()'s transformation: strip surrounding quotes, then
+ * process escapes, warning about unknown ones on stderr. string_value()
+ * returns s itself (with a new reference) when there is nothing to do.
+ */
+String *string_unquote(const char *s);
+String *string_value(String *s);
+
+/**
+ * Processed form of a string literal, made static, or NULL if processing
+ * warns: then every evaluation has to repeat the warning.
+ */
+String *string_literal(const char *source);
+void string_literal_free(String *s);
+
+// strcmp(): the difference of the first differing bytes
+int string_compare(const String *a, const String *b);
+
+void string_write(const String *s, FILE *out);
+
+#endif
@@ -9,7 +9,10 @@ typedef enum {
   TYPE_INT,
   TYPE_STRING,
   TYPE_BOOL,
-  TYPE_FUNCTION
+  TYPE_FUNCTION,
+  TYPE_BIGINT,          // An int that outgrew a machine word (see bigint.h)
+  TYPE_GENERATOR,       // A suspended d{} function that yields (see generator.h)
+  TYPE_CHANNEL          // Queue between tasks (see task.h)
 } ValueType;
 
 typedef struct {
@@ -17,8 +20,11 @@ typedef struct {
   union {
     float float_val;
     int int_val;
-    char* str_val;
+    struct String *str_val;   // See strval.h
     int bool_val;
+    struct BigInt *big_val;
+    struct Generator *gen_val;
+    struct Channel *chan_val;
   } data;
 } Value;
 
@@ -51,6 +57,14 @@ enum NodeType {
   NODE_STRLEN,
   NODE_BREAK,
   NODE_CONTINUE,
+  NODE_BIGINT,
+  NODE_YIELD,
+  NODE_FOREACH,
+  NODE_SPAWN,
+  NODE_SNAPSHOT,
+  NODE_IMPORT,
+  NODE_BENCH,
+  NODE_ARG,             // Argument of an inlined call (see inline.h)
   NODE_ERROR
 };
 
@@ -76,8 +90,23 @@ typedef struct astnode {
     char *str;            // For NODE_STRING
     int boolean;          // For NODE_BOOL
     enum BoolOpType bool_op; // For NODE_BOOL_OP
+    struct BigInt *big;   // For NODE_BIGINT: an int literal beyond an int
+                          // (NODE_ARG keeps its argument's position in num)
   } data;
   struct astnode *child[MAXCHILDREN];
+  int line, column;             // Source position of its first token (1-based)
+
+  // Loop optimizer annotations (see loopopt.h)
+  struct LoopPlan *plan;        // Loops: cache slots of their invariants
+  struct LoopPlan *cached_in;   // Expressions: loop plan holding their slot
+  int cache_slot;
+
+  unsigned char inferred;       // Proven InferredType (see typeinfer.h)
+  unsigned char generator;      // NODE_FUNC: its body yields (see generator.h)
+  struct LazyBody *lazy;        // NODE_FUNC: source of a body parsed later (see lazy.h)
+  struct Inline *inlined;       // NODE_FUNCCALL: copy of the callee's expression (see inline.h)
+
+  struct String *literal;       // NODE_STRING: processed text, unless it warns
 } astnode_t;
 
 // Symbol data for each variable or function
@@ -85,15 +114,22 @@ typedef union SymbolData {
   float float_val;
   int int_val;
   int bool_val;
-  char* string_val;
+  struct String *string_val;
+  struct BigInt *big_val;
+  struct Generator *gen_val;
+  struct Channel *chan_val;
   astnode_t *func_ast;  // For storing function definitions
 } SymbolData;
 
 typedef struct SymbolNode {
-  char *name;           // Variable or function name
+  char *name;           // Variable or function name (owned by its Binding)
   ValueType type;       // e.g., TYPE_INT, TYPE_FLOAT, etc.
   SymbolData data;
   struct SymbolNode *next;
+
+  struct Scope *scope;          // Scope the symbol belongs to
+  struct Binding *binding;      // Entry of its name (see scope.h)
+  struct SymbolNode *shadowed;  // Same name in an outer scope, if any
 } SymbolNode;
 
 #endif
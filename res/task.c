@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "task.h"
+#include "coroutine.h"
+#include "generator.h"
+#include "loopopt.h"
+#include "context.h"
+#include "ast.h"
+
+typedef enum {
+  TASK_READY,         // In the run queue
+  TASK_RUNNING,
+  TASK_BLOCKED,       // Waiting on a channel or for input
+  TASK_DONE           // Body returned; its stack goes once it is off it
+} TaskState;
+
+typedef struct Task {
+  Coroutine co;
+  TaskState state;
+  int id;                     // Spawn order from 1 (0: the program)
+  BreezeContext *ctx;
+  astnode_t *func;            // NODE_FUNC it runs (NULL: the program itself)
+  Scope *scopes;              // Its scopes above the global one while not running, lowest first
+
+  // Interpreter state while it is not running
+  struct LoopFrame *loop;
+  ForEachFrame *foreach;
+  struct Generator *generator;
+  const char *function;
+  Value *args;
+  int depth;
+  const char *stack_limit;
+
+  // What it is blocked on
+  Channel *channel;
+  Value value;                // Sent value, or the one received
+  int ok;                     // Operation completed (0: channel closed, read failed)
+  char *line;                 // Buffer of a pending read
+  int line_size;
+
+  struct Task *next;          // In the run queue or a wait queue
+  struct Task *prev_task, *next_task; // All spawned tasks that are not done
+} Task;
+
+typedef struct {
+  Task *head, *tail;
+} TaskQueue;
+
+struct Channel {
+  int refs;
+  int capacity;
+  int count, head;            // Buffered values: a ring of `capacity`
+  Value *items;
+  int closed;
+  TaskQueue senders;          // Blocked in send(), their value in Task.value
+  TaskQueue receivers;
+};
+
+typedef struct Scheduler {
+  Task main;                  // The program, on the interpreter's own stack
+  Task *current;
+  Scope *global;
+  TaskQueue ready;
+  Task *tasks;                // Spawned and not done
+  Task *finished;             // Done, stack still to be freed
+  int spawned;                // Tasks spawned so far
+  int waiting;                // The program has ended and waits for the others
+
+  // `what? ->` lines are read on a helper thread, one at a time
+  Task *reading;
+  TaskQueue readers;          // Queued behind it
+  pthread_t reader;
+  pthread_mutex_t lock;
+  pthread_cond_t read_done;
+  int done;
+  int read_ok;
+  FILE *in;
+} Scheduler;
+
+static void enqueue(TaskQueue *q, Task *t) {
+  t->next = NULL;
+  if (q->tail) {
+    q->tail->next = t;
+  } else {
+    q->head = t;
+  }
+  q->tail = t;
+}
+
+static Task *dequeue(TaskQueue *q) {
+  Task *t = q->head;
+  if (t) {
+    q->head = t->next;
+    if (!q->head) q->tail = NULL;
+    t->next = NULL;
+  }
+  return t;
+}
+
+// Take t out of a wait queue; returns whether it was in it
+static int unlink_waiter(TaskQueue *q, Task *t) {
+  Task *prev = NULL;
+  for (Task *w = q->head; w; prev = w, w = w->next) {
+    if (w != t) continue;
+    if (prev) {
+      prev->next = w->next;
+    } else {
+      q->head = w->next;
+    }
+    if (q->tail == w) q->tail = prev;
+    return 1;
+  }
+  return 0;
+}
+
+static Scheduler *scheduler(BreezeContext *ctx) {
+  if (ctx->tasks) return ctx->tasks;
+
+  Scheduler *s = calloc(1, sizeof(Scheduler));
+  if (!s) {
+    fprintf(stderr, "Error: Memory allocation for the task scheduler failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  s->main.state = TASK_RUNNING;
+  s->current = &s->main;
+  s->global = ctx->current_scope;
+  while (s->global && s->global->parent) {
+    s->global = s->global->parent;
+  }
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->read_done, NULL);
+  ctx->tasks = s;
+  return s;
+}
+
+static void wake(Scheduler *s, Task *t) {
+  t->state = TASK_READY;
+  t->channel = NULL;
+  enqueue(&s->ready, t);
+}
+
+static void free_task(Task *t) {
+  coroutine_free(&t->co);
+  free(t);
+}
+
+// Free the stack of a task that finished, now that nothing runs on it
+static void reap(Scheduler *s) {
+  if (s->finished && s->finished != s->current) {
+    free_task(s->finished);
+    s->finished = NULL;
+  }
+}
+
+static void *read_line(void *arg) {
+  Scheduler *s = arg;
+  int ok = fgets(s->reading->line, s->reading->line_size, s->in) != NULL;
+  pthread_mutex_lock(&s->lock);
+  s->read_ok = ok;
+  s->done = 1;
+  pthread_cond_signal(&s->read_done);
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+static void start_read(BreezeContext *ctx, Scheduler *s, Task *t) {
+  s->reading = t;
+  s->done = 0;
+  s->in = ctx->in;
+  if (pthread_create(&s->reader, NULL, read_line, s) != 0) {
+    // No thread: read right here
+    t->ok = fgets(t->line, t->line_size, ctx->in) != NULL;
+    s->reading = NULL;
+    wake(s, t);
+  }
+}
+
+// Wake the reading task if its line has arrived (or once it does, if `wait`)
+static void check_read(BreezeContext *ctx, Scheduler *s, int wait) {
+  if (!s->reading) return;
+  pthread_mutex_lock(&s->lock);
+  while (wait && !s->done) {
+    pthread_cond_wait(&s->read_done, &s->lock);
+  }
+  int done = s->done;
+  pthread_mutex_unlock(&s->lock);
+  if (!done) return;
+
+  pthread_join(s->reader, NULL);
+  Task *t = s->reading;
+  s->reading = NULL;
+  t->ok = s->read_ok;
+  wake(s, t);
+  Task *queued = dequeue(&s->readers);
+  if (queued) start_read(ctx, s, queued);
+}
+
+static Task *pick_next(BreezeContext *ctx, Scheduler *s) {
+  while (1) {
+    check_read(ctx, s, 0);
+    Task *t = dequeue(&s->ready);
+    if (t) return t;
+    if (s->reading) {
+      check_read(ctx, s, 1);
+    } else if (s->waiting) {
+      // The program ended: whatever is still blocked stays blocked
+      return &s->main;
+    } else {
+      breeze_error(ctx, "Error: every task is blocked on a channel (deadlock).\n");
+    }
+  }
+}
+
+static void switch_to(BreezeContext *ctx, Scheduler *s, Task *next) {
+  Task *t = s->current;
+  if (next == t) {
+    t->state = TASK_RUNNING;
+    return;
+  }
+
+  t->loop = ctx->loop;
+  t->foreach = ctx->foreach;
+  t->generator = ctx->generator;
+  t->function = ctx->function;
+  t->args = ctx->args;
+  t->depth = ctx->depth;
+  t->stack_limit = ctx->stack_limit;
+  // Its scopes come off the stack, lowest first through `parent`
+  Scope *scopes = NULL;
+  while (ctx->current_scope != s->global) {
+    Scope *scope = detach_scope(ctx);
+    scope->parent = scopes;
+    scopes = scope;
+  }
+  t->scopes = scopes;
+
+  for (Scope *scope = next->scopes; scope; ) {
+    Scope *above = scope->parent;
+    attach_scope(ctx, scope);
+    scope = above;
+  }
+  next->scopes = NULL;
+  ctx->loop = next->loop;
+  ctx->foreach = next->foreach;
+  ctx->generator = next->generator;
+  ctx->function = next->function;
+  ctx->args = next->args;
+  ctx->depth = next->depth;
+  ctx->stack_limit = next->stack_limit;
+  // Other tasks ran since: global variables may have changed under its loops
+  loop_invalidate(ctx->loop);
+
+  next->state = TASK_RUNNING;
+  s->current = next;
+  coroutine_switch(&t->co, &next->co);
+  reap(s);
+}
+
+// Suspend the running task until something wakes it
+static void block(BreezeContext *ctx, Scheduler *s) {
+  s->current->state = TASK_BLOCKED;
+  switch_to(ctx, s, pick_next(ctx, s));
+}
+
+static void run_task(void *arg) {
+  Task *t = arg;
+  BreezeContext *ctx = t->ctx;
+  Scheduler *s = ctx->tasks;
+  reap(s);
+
+  release_value(evaluate_funcbody(ctx, t->func->child[1]));
+  pop_scope(ctx);
+
+  t->state = TASK_DONE;
+  if (t->prev_task) {
+    t->prev_task->next_task = t->next_task;
+  } else {
+    s->tasks = t->next_task;
+  }
+  if (t->next_task) t->next_task->prev_task = t->prev_task;
+  s->finished = t;
+  switch_to(ctx, s, pick_next(ctx, s));
+}
+
+void task_spawn(BreezeContext *ctx, astnode_t *func, Scope *frame) {
+  Scheduler *s = scheduler(ctx);
+  Task *t = calloc(1, sizeof(Task));
+  if (!t) {
+    fprintf(stderr, "Error: Memory allocation for a task failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (coroutine_start(&t->co, run_task, t) != 0) {
+    free(t);
+    free_scope(frame);
+    breeze_error(ctx, "Error: could not allocate a stack for task '%s'.\n", func->data.id);
+  }
+  t->id = ++s->spawned;
+  t->ctx = ctx;
+  t->func = func;
+  t->scopes = frame;
+  t->function = func->data.id;
+  t->depth = 1;
+  t->stack_limit = coroutine_stack_limit(&t->co);
+
+  t->next_task = s->tasks;
+  if (s->tasks) s->tasks->prev_task = t;
+  s->tasks = t;
+  wake(s, t);
+}
+
+// Drop a task that will never run again, with what it holds
+static void drop_task(Task *t) {
+  if (t->channel) {
+    // A sender still owns the value it was blocked on, both own their channel reference
+    if (unlink_waiter(&t->channel->senders, t)) release_value(t->value);
+    unlink_waiter(&t->channel->receivers, t);
+    channel_release(t->channel);
+  }
+  for (ForEachFrame *f = t->foreach; f; f = f->outer) {
+    release_value(f->source);
+  }
+  while (t->scopes) {
+    Scope *above = t->scopes->parent;
+    free_scope(t->scopes);
+    t->scopes = above;
+  }
+}
+
+static void free_scheduler(BreezeContext *ctx, Scheduler *s) {
+  while (s->tasks) {
+    Task *t = s->tasks;
+    s->tasks = t->next_task;
+    drop_task(t);
+    free_task(t);
+  }
+  if (s->finished) free_task(s->finished);
+  pthread_mutex_destroy(&s->lock);
+  pthread_cond_destroy(&s->read_done);
+  free(s);
+  ctx->tasks = NULL;
+}
+
+void task_wait_all(BreezeContext *ctx) {
+  Scheduler *s = ctx->tasks;
+  if (!s) return;
+  s->waiting = 1;
+  while (s->ready.head || s->reading) {
+    block(ctx, s);
+  }
+  free_scheduler(ctx, s);
+}
+
+int task_running(BreezeContext *ctx) {
+  return ctx->tasks && ctx->tasks->tasks;
+}
+
+int task_id(BreezeContext *ctx) {
+  return ctx->tasks ? ctx->tasks->current->id : 0;
+}
+
+void task_discard_all(BreezeContext *ctx) {
+  Scheduler *s = ctx->tasks;
+  if (!s) return;
+  if (s->reading) {
+    // Nobody waits for that line any more
+    pthread_cancel(s->reader);
+    pthread_join(s->reader, NULL);
+  }
+  // The loops of the running task and of the program were on stacks the
+  // error unwound; the scopes of a spawned task that failed are popped
+  s->current->foreach = NULL;
+  s->main.foreach = NULL;
+  drop_task(&s->main);
+  free_scheduler(ctx, s);
+}
+
+int task_read_line(BreezeContext *ctx, char *buffer, int size) {
+  Scheduler *s = ctx->tasks;
+  if (!s || (!s->ready.head && !s->reading)) {
+    return ctx->in && fgets(buffer, size, ctx->in) != NULL;
+  }
+  if (!ctx->in) return 0;
+
+  Task *t = s->current;
+  t->line = buffer;
+  t->line_size = size;
+  if (s->reading) {
+    enqueue(&s->readers, t);
+  } else {
+    start_read(ctx, s, t);
+  }
+  block(ctx, s);
+  return t->ok;
+}
+
+Channel *channel_new(int capacity) {
+  Channel *c = calloc(1, sizeof(Channel));
+  if (c) c->items = calloc(capacity > 0 ? (size_t)capacity : 1, sizeof(Value));
+  if (!c || !c->items) {
+    fprintf(stderr, "Error: Memory allocation for a channel failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  c->refs = 1;
+  c->capacity = capacity;
+  return c;
+}
+
+Channel *channel_retain(Channel *c) {
+  c->refs++;
+  return c;
+}
+
+void channel_release(Channel *c) {
+  if (!c || --c->refs > 0) return;
+  for (int i = 0; i < c->count; i++) {
+    release_value(c->items[(c->head + i) % c->capacity]);
+  }
+  free(c->items);
+  free(c);
+}
+
+// Returns 0 if c is closed (the value is dropped then)
+static int send_value(BreezeContext *ctx, Channel *c, Value value) {
+  if (c->closed) {
+    release_value(value);
+    return 0;
+  }
+  Task *receiver = dequeue(&c->receivers);
+  if (receiver) {
+    receiver->value = value;
+    receiver->ok = 1;
+    wake(ctx->tasks, receiver);
+    return 1;
+  }
+  if (c->count < c->capacity) {
+    c->items[(c->head + c->count++) % c->capacity] = value;
+    return 1;
+  }
+
+  Scheduler *s = scheduler(ctx);
+  Task *t = s->current;
+  t->value = value;
+  t->channel = c;
+  enqueue(&c->senders, t);
+  block(ctx, s);
+  return t->ok;
+}
+
+static int recv_value(BreezeContext *ctx, Channel *c, Value *value) {
+  if (c->count > 0) {
+    *value = c->items[c->head];
+    c->head = (c->head + 1) % c->capacity;
+    c->count--;
+    // Its slot goes to the first blocked sender
+    Task *sender = dequeue(&c->senders);
+    if (sender) {
+      c->items[(c->head + c->count++) % c->capacity] = sender->value;
+      sender->ok = 1;
+      wake(ctx->tasks, sender);
+    }
+    return 1;
+  }
+  Task *sender = dequeue(&c->senders);
+  if (sender) {
+    // Unbuffered: straight from the sender
+    *value = sender->value;
+    sender->ok = 1;
+    wake(ctx->tasks, sender);
+    return 1;
+  }
+  if (c->closed) return 0;
+
+  Scheduler *s = scheduler(ctx);
+  Task *t = s->current;
+  t->channel = c;
+  enqueue(&c->receivers, t);
+  block(ctx, s);
+  if (!t->ok) return 0;
+  *value = t->value;
+  return 1;
+}
+
+void channel_send(BreezeContext *ctx, Channel *c, Value value) {
+  int sent = send_value(ctx, c, value);
+  channel_release(c);
+  if (!sent) {
+    breeze_error(ctx, "Error: send() on a closed channel.\n");
+  }
+}
+
+int channel_recv(BreezeContext *ctx, Channel *c, Value *value) {
+  int received = recv_value(ctx, c, value);
+  channel_release(c);
+  return received;
+}
+
+void channel_close(BreezeContext *ctx, Channel *c) {
+  if (c->closed) {
+    breeze_error(ctx, "Error: close() on a closed channel.\n");
+  }
+  c->closed = 1;
+  Task *t;
+  while ((t = dequeue(&c->receivers))) {
+    t->ok = 0;
+    wake(ctx->tasks, t);
+  }
+  while ((t = dequeue(&c->senders))) {
+    release_value(t->value);
+    t->ok = 0;
+    wake(ctx->tasks, t);
+  }
+}
+
+// ----------- BUILTINS -----------
+
+static const char *const channel_names[] = { NULL, "channel", "send", "recv", "close" };
+static const int channel_argc[] = { 0, 1, 2, 1, 1 };
+
+ChannelOp channel_builtin(const char *name) {
+  for (int op = CHANNEL_NEW; op <= CHANNEL_CLOSE; op++) {
+    if (strcmp(channel_names[op], name) == 0) return (ChannelOp)op;
+  }
+  return CHANNEL_NONE;
+}
+
+__attribute__((noreturn))
+static void fail(BreezeContext *ctx, Value *args, int argc, const char *message) {
+  for (int i = 0; i < argc; i++) release_value(args[i]);
+  breeze_error(ctx, "Error: %s\n", message);
+}
+
+Value channel_call(BreezeContext *ctx, ChannelOp op, Value *args, int argc) {
+  const char *name = channel_names[op];
+  if (argc != channel_argc[op]) {
+    char message[64];
+    snprintf(message, sizeof(message), "%s() takes %d argument%s, not %d.",
+             name, channel_argc[op], channel_argc[op] == 1 ? "" : "s", argc);
+    fail(ctx, args, argc, message);
+  }
+
+  if (op == CHANNEL_NEW) {
+    if (args[0].type != TYPE_INT || args[0].data.int_val < 0) {
+      fail(ctx, args, argc, "channel() needs a capacity that is an int >= 0");
+    }
+    return create_channel_value(channel_new(args[0].data.int_val));
+  }
+  if (args[0].type != TYPE_CHANNEL) {
+    char message[64];
+    snprintf(message, sizeof(message), "%s() needs a channel", name);
+    fail(ctx, args, argc, message);
+  }
+
+  Channel *c = args[0].data.chan_val;
+  Value value = create_int_value(0);
+  switch (op) {
+    case CHANNEL_SEND:
+      channel_send(ctx, c, args[1]);
+      break;
+    case CHANNEL_RECV:
+      if (!channel_recv(ctx, c, &value)) {
+        breeze_error(ctx, "Error: recv() on a closed channel with nothing left in it\n");
+      }
+      break;
+    default:
+      channel_close(ctx, c);
+      channel_release(c);
+      break;
+  }
+  return value;
+}
@@ -0,0 +1,88 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "symtab.h"
+#include "scope.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Tasks and channels. `spawn f(args);` binds the arguments like a call
+ * and queues f's body as a task; the spawning code carries on. Tasks
+ * talk through channels: `c = channel(n);` buffers up to n values
+ * (0: every send waits for a receiver), `send(c, v);` waits while the
+ * buffer is full, `recv(c)` waits while it is empty and `close(c);`
+ * ends the stream, so that `f{ x in c -> }` loops finish.
+ *
+ * Tasks are coroutines (see coroutine.h) scheduled cooperatively on the
+ * interpreter's thread: one runs until it blocks on a channel, on input
+ * or finishes, then the next ready task continues. A task's stack only
+ * commits the pages it touches, so a task costs a few kilobytes. Every
+ * task runs on top of the global scope; the scopes of the others are
+ * detached while it runs. The program itself is a task too: when it
+ * ends, the tasks still ready run to completion and those blocked for
+ * good are dropped. When every task is blocked the run fails with a
+ * deadlock.
+ *
+ * `what? ->` inside a run with other ready tasks reads on a helper
+ * thread, so only the reading task waits for input.
+ *
+ * Tasks never run in parallel: spreading them over worker threads with
+ * work stealing (M:N) is still to be done.
+ */
+
+typedef struct Channel Channel;
+
+// Run the body of `func` as a new task with `frame`, a detached scope holding its parameters
+void task_spawn(BreezeContext *ctx, astnode_t *func, Scope *frame);
+
+// At the end of a run: let the other tasks finish, then drop those blocked for good
+void task_wait_all(BreezeContext *ctx);
+
+// Whether spawned tasks have not finished yet
+int task_running(BreezeContext *ctx);
+
+// The running task: 0 for the program, then 1, 2... in spawn order
+int task_id(BreezeContext *ctx);
+
+// After an error unwound a run: drop every task (the running one's scopes are popped already)
+void task_discard_all(BreezeContext *ctx);
+
+/**
+ * fgets() for `what? ->`. While other tasks are ready, the line is read
+ * on a helper thread and they run meanwhile. Returns 0 at end of input
+ * or on an error.
+ */
+int task_read_line(BreezeContext *ctx, char *buffer, int size);
+
+Channel *channel_new(int capacity);
+Channel *channel_retain(Channel *c);
+void channel_release(Channel *c);
+
+/**
+ * send() and recv() take over a reference to the channel, so a task
+ * dropped while blocked in them leaves nothing behind. send() also takes
+ * over the reference `value` holds.
+ */
+void channel_send(BreezeContext *ctx, Channel *c, Value value);
+
+// Store the next value (a new reference) in *value and return 1, or return 0 once closed and empty
+int channel_recv(BreezeContext *ctx, Channel *c, Value *value);
+
+void channel_close(BreezeContext *ctx, Channel *c);
+
+/**
+ * channel(), send(), recv() and close() are builtins rather than
+ * keywords: like those of strlib.h they serve calls to names that are
+ * not bound to a d{} function, so a script may still define its own
+ * send() or use `close` as a variable.
+ */
+typedef enum { CHANNEL_NONE, CHANNEL_NEW, CHANNEL_SEND, CHANNEL_RECV, CHANNEL_CLOSE } ChannelOp;
+
+// The builtin called `name`, or CHANNEL_NONE
+ChannelOp channel_builtin(const char *name);
+
+// Run op on the argc values in args, taking over their references; send() and close() return 0
+Value channel_call(BreezeContext *ctx, ChannelOp op, Value *args, int argc);
+
+#endif
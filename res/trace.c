@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+#include "context.h"
+#include "task.h"
+
+Trace *trace_new(void) {
+  Trace *trace = calloc(1, sizeof(Trace));
+  if (trace) trace->events = malloc(sizeof(TraceEvent) * TRACE_EVENTS);
+  if (!trace || !trace->events) {
+    fprintf(stderr, "Error: Memory allocation for the trace failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  trace->origin = bench_now();
+  return trace;
+}
+
+void trace_record(BreezeContext *ctx, const astnode_t *site, long long start, int iterations) {
+  Trace *trace = ctx->trace;
+  TraceEvent *event = &trace->events[trace->recorded++ % TRACE_EVENTS];
+  event->site = site;
+  event->start = start;
+  event->duration = bench_now() - start;
+  event->tid = task_id(ctx);
+  event->iterations = iterations;
+}
+
+// Names are identifiers, which need no escaping in JSON
+static void write_name(const astnode_t *site, FILE *out) {
+  switch (site->type) {
+    case NODE_FUNC:
+      fprintf(out, "\"name\":\"%s\",\"cat\":\"function\"", site->data.id);
+      return;
+    case NODE_FOR:
+      if (site->child[0] && site->child[0]->type == NODE_ASSIGN) {
+        fprintf(out, "\"name\":\"f{} over %s\",\"cat\":\"loop\"", site->child[0]->data.id);
+      } else {
+        fprintf(out, "\"name\":\"f{}\",\"cat\":\"loop\"");
+      }
+      return;
+    case NODE_FOREACH:
+      fprintf(out, "\"name\":\"f{} over %s\",\"cat\":\"loop\"", site->data.id);
+      return;
+    default:
+      fprintf(out, "\"name\":\"w{}\",\"cat\":\"loop\"");
+      return;
+  }
+}
+
+int trace_write(const Trace *trace, FILE *out) {
+  unsigned long long kept = trace->recorded < TRACE_EVENTS ? trace->recorded : TRACE_EVENTS;
+  unsigned long long first = trace->recorded - kept;
+  int pid = (int)getpid();
+
+  // A named lane for every task with events
+  int lanes = 0;
+  for (unsigned long long i = first; i < trace->recorded; i++) {
+    int tid = trace->events[i % TRACE_EVENTS].tid;
+    if (tid >= lanes) lanes = tid + 1;
+  }
+  char *used = calloc((size_t)lanes + 1, 1);
+  if (!used) return -1;
+  for (unsigned long long i = first; i < trace->recorded; i++) {
+    used[trace->events[i % TRACE_EVENTS].tid] = 1;
+  }
+
+  fprintf(out, "{\"traceEvents\":[\n");
+  int comma = 0;
+  for (int tid = 0; tid < lanes; tid++) {
+    if (!used[tid]) continue;
+    fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+            comma ? ",\n" : "", pid, tid);
+    if (tid == 0) {
+      fprintf(out, "\"program\"}}");
+    } else {
+      fprintf(out, "\"task %d\"}}", tid);
+    }
+    comma = 1;
+  }
+  free(used);
+
+  for (unsigned long long i = first; i < trace->recorded; i++) {
+    const TraceEvent *event = &trace->events[i % TRACE_EVENTS];
+    fprintf(out, "%s{", comma ? ",\n" : "");
+    write_name(event->site, out);
+    // Chrome wants microseconds
+    fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"line\":%d",
+            (event->start - trace->origin) / 1e3, event->duration / 1e3, pid, event->tid,
+            event->site->line);
+    if (event->site->type != NODE_FUNC) {
+      fprintf(out, ",\"iterations\":%d", event->iterations);
+    }
+    fprintf(out, "}}");
+    comma = 1;
+  }
+  fprintf(out, "\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"dropped\":%llu}}\n",
+          trace->recorded - kept);
+  return ferror(out) ? -1 : 0;
+}
+
+void trace_free(Trace *trace) {
+  if (!trace) return;
+  free(trace->events);
+  free(trace);
+}
@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include "symtab.h"
+#include "bench.h"
+
+typedef struct BreezeContext BreezeContext;
+
+/**
+ * Timeline of a run (--trace FILE) in the Chrome trace-event format, for
+ * chrome://tracing or Perfetto. Every call of a script function and
+ * every w{} or f{} loop becomes a complete event: its start and its
+ * duration ("ph": "X"), loops with their number of iterations. Each task
+ * gets a lane of its own ("tid"); generators run in their caller's.
+ *
+ * Events are recorded as they end, into a ring buffer owned by the
+ * context. Only the thread running the context writes to it, so an
+ * event costs two clock readings and a store, with no lock. Once the
+ * ring is full the oldest events are overwritten: a long run keeps its
+ * last TRACE_EVENTS, and the file records how many were dropped. Calls
+ * and loops an error unwinds never end, so they are not in the trace.
+ */
+
+#define TRACE_EVENTS (1 << 20)
+
+typedef struct TraceEvent {
+  const astnode_t *site;      // NODE_FUNC that was called, or the loop
+  long long start, duration;  // Nanoseconds (see bench_now)
+  int tid;                    // Task it ran in (see task_id)
+  int iterations;             // Loops only
+} TraceEvent;
+
+typedef struct Trace {
+  TraceEvent *events;         // Ring of TRACE_EVENTS
+  unsigned long long recorded;
+  long long origin;           // When tracing started
+} Trace;
+
+// Start of an event; costs a branch when ctx is not tracing
+#define TRACE_START(ctx) ((ctx)->trace ? bench_now() : 0)
+
+#define TRACE_END(ctx, site, start, iterations) do { \
+    if ((ctx)->trace) trace_record((ctx), (site), (start), (iterations)); \
+  } while (0)
+
+Trace *trace_new(void);
+void trace_record(BreezeContext *ctx, const astnode_t *site, long long start, int iterations);
+
+/**
+ * Write the events left in the ring as a JSON object. Their sites must
+ * still be alive: write the trace before the program is freed. Returns
+ * 0, or -1 if writing failed.
+ */
+int trace_write(const Trace *trace, FILE *out);
+
+void trace_free(Trace *trace);
+
+#endif
@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "typeinfer.h"
+#include "lazy.h"
+#include "bigint.h"
+
+// No information yet: the optimistic bottom of the lattice during the fixpoint
+#define TI_NONE 0xff
+
+#define REPORT_MAX 10
+
+typedef struct {
+  const char *name;
+  unsigned char type;
+} Binding;
+
+// Variables assigned in the current scope on every path so far
+typedef struct {
+  Binding *vars;
+  int count;
+} Env;
+
+typedef struct {
+  const char *name;
+  astnode_t *def;
+  int defs;           // Definitions with this name; results are only used if 1
+  int nparams;
+  unsigned char params[MAXCHILDREN];
+  unsigned char ret;
+} FuncInfo;
+
+typedef struct {
+  FuncInfo *funcs;
+  int nfuncs;
+  int changed;
+  int open;           // Functions may be called from code the pass does not see
+  int hidden;         // A body not parsed yet defines functions (see lazy.h)
+} Infer;
+
+static void *infer_alloc(void *ptr, size_t size) {
+  void *mem = realloc(ptr, size);
+  if (!mem) {
+    fprintf(stderr, "Error: Memory allocation failed in type inference.\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+static unsigned char join(unsigned char a, unsigned char b) {
+  if (a == TI_NONE) return b;
+  if (b == TI_NONE || a == b) return a;
+  return TI_UNKNOWN;
+}
+
+// ----------- ENVIRONMENTS -----------
+
+static Env env_copy(const Env *env) {
+  Env copy;
+  copy.count = env->count;
+  copy.vars = infer_alloc(NULL, sizeof(Binding) * (env->count + 1));
+  if (env->count) memcpy(copy.vars, env->vars, sizeof(Binding) * env->count);
+  return copy;
+}
+
+static Binding *env_find(const Env *env, const char *name) {
+  for (int i = 0; i < env->count; i++) {
+    if (strcmp(env->vars[i].name, name) == 0) return &env->vars[i];
+  }
+  return NULL;
+}
+
+static void env_set(Env *env, const char *name, unsigned char type) {
+  Binding *b = env_find(env, name);
+  if (!b) {
+    env->vars = infer_alloc(env->vars, sizeof(Binding) * (env->count + 1));
+    b = &env->vars[env->count++];
+    b->name = name;
+  }
+  b->type = type;
+}
+
+// Merge two paths into `into`: a variable assigned on only one of them is unknown
+static void env_join(Env *into, const Env *other) {
+  for (int i = 0; i < into->count; i++) {
+    Binding *b = env_find(other, into->vars[i].name);
+    into->vars[i].type = b ? join(into->vars[i].type, b->type) : TI_UNKNOWN;
+  }
+  for (int i = 0; i < other->count; i++) {
+    if (!env_find(into, other->vars[i].name)) env_set(into, other->vars[i].name, TI_UNKNOWN);
+  }
+}
+
+static int env_equal(const Env *a, const Env *b) {
+  if (a->count != b->count) return 0;
+  for (int i = 0; i < a->count; i++) {
+    Binding *other = env_find(b, a->vars[i].name);
+    if (!other || other->type != a->vars[i].type) return 0;
+  }
+  return 1;
+}
+
+static void env_replace(Env *env, Env *with) {
+  free(env->vars);
+  *env = *with;
+}
+
+// ----------- FUNCTIONS -----------
+
+static int compare_funcs(const void *a, const void *b) {
+  return strcmp(((const FuncInfo *)a)->name, ((const FuncInfo *)b)->name);
+}
+
+static FuncInfo *find_func(Infer *in, const char *name) {
+  FuncInfo key;
+  key.name = name;
+  return in->nfuncs ? bsearch(&key, in->funcs, in->nfuncs, sizeof(FuncInfo), compare_funcs) : NULL;
+}
+
+static void collect_defs(Infer *in, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC && !node->child[1] && node->lazy && node->lazy->defines) {
+    in->hidden = 1;
+  }
+  if (node->type == NODE_FUNC) {
+    in->funcs = infer_alloc(in->funcs, sizeof(FuncInfo) * (in->nfuncs + 1));
+    FuncInfo *f = &in->funcs[in->nfuncs++];
+    memset(f, 0, sizeof(*f));
+    f->name = node->data.id;
+    f->def = node;
+    f->defs = 1;
+    for (int i = 0; i < MAXCHILDREN && node->child[0] && node->child[0]->child[i]; i++) {
+      f->nparams++;
+    }
+    memset(f->params, in->open ? TI_UNKNOWN : TI_NONE, sizeof(f->params));
+    f->ret = TI_NONE;
+  }
+  for (int i = 0; i < MAXCHILDREN; i++) collect_defs(in, node->child[i]);
+}
+
+// One entry per name, sorted for find_func(), so large scripts stay linear-ish
+static void collect_funcs(Infer *in, astnode_t *node) {
+  collect_defs(in, node);
+  if (in->nfuncs == 0) return;
+  qsort(in->funcs, in->nfuncs, sizeof(FuncInfo), compare_funcs);
+  int n = 1;
+  for (int i = 1; i < in->nfuncs; i++) {
+    if (strcmp(in->funcs[n - 1].name, in->funcs[i].name) == 0) {
+      in->funcs[n - 1].defs++;
+    } else {
+      in->funcs[n++] = in->funcs[i];
+    }
+  }
+  in->nfuncs = n;
+}
+
+static void widen(Infer *in, unsigned char *slot, unsigned char type) {
+  unsigned char joined = join(*slot, type);
+  if (joined != *slot) {
+    *slot = joined;
+    in->changed = 1;
+  }
+}
+
+// ----------- EXPRESSIONS -----------
+
+static unsigned char annotate(astnode_t *node, unsigned char type) {
+  node->inferred = type == TI_NONE ? TI_UNKNOWN : type;
+  return type;
+}
+
+static unsigned char infer_expr(Infer *in, Env *env, astnode_t *node);
+
+static unsigned char infer_call(Infer *in, Env *env, astnode_t *node) {
+  FuncInfo *f = find_func(in, node->data.id);
+  astnode_t *args = node->child[0];
+  int argc = 0;
+
+  for (int i = 0; i < MAXCHILDREN && args && args->child[i]; i++) {
+    unsigned char type = infer_expr(in, env, args->child[i]);
+    if (f && f->defs == 1 && i < f->nparams) widen(in, &f->params[i], type);
+    argc++;
+  }
+  if (!f || f->defs != 1 || argc > f->nparams) return TI_UNKNOWN;
+
+  // Unbound parameters are looked up in the callers
+  for (int i = argc; i < f->nparams; i++) widen(in, &f->params[i], TI_UNKNOWN);
+  return f->ret;
+}
+
+static unsigned char arith_type(astnode_t *node, unsigned char l, unsigned char r) {
+  if (node->type == NODE_DIV) return TI_FLOAT;
+  if (node->type == NODE_EXP) {
+    // Ints to a negative power are floats, to any other power ints
+    int integral = (l == TI_INT || l == TI_UNKNOWN) && (r == TI_INT || r == TI_UNKNOWN);
+    return integral ? TI_UNKNOWN : TI_FLOAT;
+  }
+  if (l == TI_NONE || r == TI_NONE) return TI_NONE;
+  if (l == TI_UNKNOWN || r == TI_UNKNOWN || l == TI_STRING || r == TI_STRING) return TI_UNKNOWN;
+  if (l == TI_FLOAT || r == TI_FLOAT) return TI_FLOAT;
+  // Adding a bool is an error, SUB and MUL treat bools as ints
+  if (node->type == NODE_ADD && (l != TI_INT || r != TI_INT)) return TI_UNKNOWN;
+  return TI_INT;
+}
+
+static unsigned char infer_expr(Infer *in, Env *env, astnode_t *node) {
+  if (!node) return TI_UNKNOWN;
+  Binding *b;
+  unsigned char l, r;
+
+  switch (node->type) {
+    case NODE_INT:    return annotate(node, TI_INT);
+    case NODE_BIGINT: return annotate(node, TI_INT);
+    case NODE_FLOAT:  return annotate(node, TI_FLOAT);
+    case NODE_BOOL:   return annotate(node, TI_BOOL);
+    case NODE_STRING: return annotate(node, TI_STRING);
+    case NODE_ID:
+      b = env_find(env, node->data.id);
+      return annotate(node, b ? b->type : TI_UNKNOWN);
+    case NODE_ADD:
+    case NODE_SUB:
+    case NODE_MUL:
+    case NODE_DIV:
+    case NODE_EXP:
+      l = infer_expr(in, env, node->child[0]);
+      r = infer_expr(in, env, node->child[1]);
+      return annotate(node, arith_type(node, l, r));
+    case NODE_BOOL_OP:
+      infer_expr(in, env, node->child[0]);
+      if (node->data.bool_op != OP_NOT) infer_expr(in, env, node->child[1]);
+      return annotate(node, TI_BOOL);
+    case NODE_FUNCCALL:
+      return annotate(node, infer_call(in, env, node));
+    case NODE_FUNCRET:
+      return annotate(node, infer_expr(in, env, node->child[0]));
+    case NODE_INDEX:
+      if (node->child[0]) {
+        infer_expr(in, env, node->child[0]->child[0]);
+        if (node->child[0]->child[1]) infer_expr(in, env, node->child[0]->child[1]);
+      }
+      return annotate(node, TI_STRING);
+    case NODE_STRLEN:
+      return annotate(node, TI_INT);
+    default:
+      return annotate(node, TI_UNKNOWN);
+  }
+}
+
+// ----------- STATEMENTS -----------
+
+static void infer_stmt(Infer *in, Env *env, astnode_t *node);
+
+static void infer_assign(Infer *in, Env *env, astnode_t *node) {
+  env_set(env, node->data.id, infer_expr(in, env, node->child[0]));
+}
+
+// evaluate_loop(): a direct break ends the iteration, a direct continue does nothing
+static void infer_loop_body(Infer *in, Env *env, astnode_t *body) {
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    astnode_t *child = body->child[i];
+    if (!child || child->type == NODE_CONTINUE) continue;
+    if (child->type == NODE_BREAK) break;
+    infer_stmt(in, env, child);
+  }
+}
+
+// Iterate the loop head to a fixpoint; env becomes the state after the loop
+static void infer_loop(Infer *in, Env *env, astnode_t *node) {
+  int isFor = node->type == NODE_FOR;
+  int isForEach = node->type == NODE_FOREACH;
+  int isBench = node->type == NODE_BENCH;
+  // b{ label, n }: the run count stands in for the condition
+  astnode_t *condition = node->child[isFor || isBench ? 1 : 0];
+  astnode_t *body = node->child[isFor ? 3 : isBench ? 2 : 1];
+  if (!condition || !body) return;
+
+  if (isFor && node->child[0]) infer_assign(in, env, node->child[0]);
+  if (isBench) infer_expr(in, env, node->child[0]);
+  while (1) {
+    Env iteration = env_copy(env);
+    infer_expr(in, &iteration, condition);
+    // f{ x in g }: the generator is the "condition", x can hold anything it yields
+    if (isForEach) env_set(&iteration, node->data.id, TI_UNKNOWN);
+    infer_loop_body(in, &iteration, body);
+    if (isFor && node->child[2]) infer_assign(in, &iteration, node->child[2]);
+
+    Env head = env_copy(env);
+    env_join(&head, &iteration);
+    free(iteration.vars);
+    if (env_equal(&head, env)) {
+      free(head.vars);
+      break;
+    }
+    env_replace(env, &head);
+  }
+}
+
+static void infer_stmt(Infer *in, Env *env, astnode_t *node) {
+  if (!node) return;
+  Env other;
+
+  switch (node->type) {
+    case NODE_STMTS:
+      for (int i = 0; i < MAXCHILDREN; i++) infer_stmt(in, env, node->child[i]);
+      break;
+    case NODE_ASSIGN:
+      infer_assign(in, env, node);
+      break;
+    case NODE_READ:
+      env_set(env, node->data.id, TI_STRING);
+      break;
+    case NODE_PRINT:
+      for (int i = 0; i < MAXCHILDREN && node->child[0]; i++) {
+        if (node->child[0]->child[i]) infer_expr(in, env, node->child[0]->child[i]);
+      }
+      break;
+    case NODE_WHILE:
+    case NODE_FOR:
+    case NODE_FOREACH:
+    case NODE_BENCH:
+      infer_loop(in, env, node);
+      break;
+    case NODE_YIELD:
+      infer_expr(in, env, node->child[0]);
+      break;
+    case NODE_SPAWN:
+      infer_call(in, env, node);
+      break;
+    case NODE_IF:
+      infer_expr(in, env, node->child[0]);
+      other = env_copy(env);
+      infer_stmt(in, &other, node->child[1]);
+      env_join(env, &other);
+      free(other.vars);
+      break;
+    case NODE_IFELSE:
+      infer_expr(in, env, node->child[0]);
+      other = env_copy(env);
+      infer_stmt(in, &other, node->child[1]);
+      infer_stmt(in, env, node->child[2]);
+      env_join(env, &other);
+      free(other.vars);
+      break;
+    case NODE_FUNC: {
+      // The name now holds a function: reading it as a variable is an error.
+      // Names missing from env are unknown already, so only a variable is updated.
+      Binding *b = env_find(env, node->data.id);
+      if (b) b->type = TI_UNKNOWN;
+      break;
+    }
+    case NODE_IMPORT:
+      // A module's top level may assign any qualified name
+      for (int i = 0; i < env->count; i++) {
+        if (strchr(env->vars[i].name, '.')) env->vars[i].type = TI_UNKNOWN;
+      }
+      break;
+    default:
+      infer_expr(in, env, node);
+      break;
+  }
+}
+
+// evaluate_funcbody(): only a direct return ends the body
+static void infer_function(Infer *in, FuncInfo *f, astnode_t *def) {
+  Env env = { NULL, 0 };
+  astnode_t *params = def->child[0];
+  astnode_t *body = def->child[1];
+
+  for (int i = 0; i < f->nparams && params && params->child[i]; i++) {
+    env_set(&env, params->child[i]->data.id, f->defs == 1 ? f->params[i] : TI_UNKNOWN);
+  }
+
+  unsigned char ret = TI_INT;
+  for (int i = 0; body && i < MAXCHILDREN; i++) {
+    astnode_t *child = body->child[i];
+    if (!child) continue;
+    if (child->type == NODE_FUNCRET) {
+      ret = infer_expr(in, &env, child);
+      break;
+    }
+    infer_stmt(in, &env, child);
+  }
+  // Calling a generator function returns a generator; a body not parsed yet may return anything
+  if (def->generator || !body) ret = TI_UNKNOWN;
+  if (f->defs == 1) widen(in, &f->ret, ret);
+  free(env.vars);
+}
+
+static void infer_functions(Infer *in, astnode_t *node) {
+  if (!node) return;
+  if (node->type == NODE_FUNC) infer_function(in, find_func(in, node->data.id), node);
+  for (int i = 0; i < MAXCHILDREN; i++) infer_functions(in, node->child[i]);
+}
+
+// No call to these names may be assumed to reach the definition the pass saw
+static void distrust_funcs(Infer *in) {
+  for (int i = 0; i < in->nfuncs; i++) in->funcs[i].defs++;
+}
+
+static void infer_program(astnode_t *root, int open) {
+  if (!root) return;
+  Infer in = { NULL, 0, 0, open, 0 };
+  collect_funcs(&in, root);
+  if (in.hidden) distrust_funcs(&in);
+
+  // Parameter and result types only grow, so this terminates
+  do {
+    in.changed = 0;
+    Env env = { NULL, 0 };
+    infer_stmt(&in, &env, root);
+    free(env.vars);
+    infer_functions(&in, root);
+  } while (in.changed);
+
+  free(in.funcs);
+}
+
+void infer_types(astnode_t *root) {
+  infer_program(root, 0);
+}
+
+void infer_types_open(astnode_t *root) {
+  infer_program(root, 1);
+}
+
+void infer_types_late(astnode_t *func) {
+  Infer in = { NULL, 0, 0, 1, 0 };
+  collect_funcs(&in, func);
+  // The rest of the program may define the same names again
+  distrust_funcs(&in);
+  infer_functions(&in, func);
+  free(in.funcs);
+}
+
+// ----------- REPORT -----------
+
+typedef struct {
+  astnode_t *node;
+  const char *func;
+  int depth;
+} HotSpot;
+
+typedef struct {
+  int typed;
+  int total;
+  HotSpot spots[REPORT_MAX];
+  int nspots;
+  int untyped_in_loops;
+} Report;
+
+static int is_expression(astnode_t *node) {
+  switch (node->type) {
+    case NODE_INT: case NODE_BIGINT: case NODE_FLOAT: case NODE_BOOL: case NODE_STRING: case NODE_ID:
+    case NODE_ADD: case NODE_SUB: case NODE_MUL: case NODE_DIV: case NODE_EXP:
+    case NODE_BOOL_OP: case NODE_FUNCCALL: case NODE_INDEX: case NODE_STRLEN:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// Operations that still dispatch on operand types at runtime
+static int is_untyped_operation(astnode_t *node) {
+  switch (node->type) {
+    case NODE_ADD: case NODE_SUB: case NODE_MUL: case NODE_DIV: case NODE_EXP:
+      return node->child[0]->inferred == TI_UNKNOWN || node->child[1]->inferred == TI_UNKNOWN;
+    case NODE_BOOL_OP:
+      if (node->child[0]->inferred == TI_UNKNOWN) return 1;
+      return node->data.bool_op != OP_NOT && node->child[1]->inferred == TI_UNKNOWN;
+    default:
+      return 0;
+  }
+}
+
+static void format_expr(astnode_t *node, char *buf, size_t size) {
+  static const char *bool_ops[] = { "&&", "||", "!", "==", "!=", "<", "<=", ">", ">=" };
+  char left[128], right[128];
+  const char *op = NULL;
+
+  if (!node) {
+    snprintf(buf, size, "?");
+    return;
+  }
+  switch (node->type) {
+    case NODE_INT:     snprintf(buf, size, "%d", node->data.num); return;
+    case NODE_BIGINT: {
+      char *digits = bigint_to_string(node->data.big);
+      snprintf(buf, size, "%s", digits);
+      free(digits);
+      return;
+    }
+    case NODE_FLOAT:   snprintf(buf, size, "%g", node->data.dec); return;
+    case NODE_BOOL:    snprintf(buf, size, "%s", node->data.boolean ? "true" : "false"); return;
+    case NODE_STRING:  snprintf(buf, size, "%s", node->data.str); return;
+    case NODE_ID:      snprintf(buf, size, "%s", node->data.id); return;
+    case NODE_STRLEN:  snprintf(buf, size, "len(%s)", node->data.id); return;
+    case NODE_INDEX:   snprintf(buf, size, "%s[...]", node->data.id); return;
+    case NODE_FUNCCALL: snprintf(buf, size, "%s(...)", node->data.id); return;
+    case NODE_ADD: op = "+"; break;
+    case NODE_SUB: op = "-"; break;
+    case NODE_MUL: op = "*"; break;
+    case NODE_DIV: op = "/"; break;
+    case NODE_EXP: op = "**"; break;
+    case NODE_BOOL_OP: op = bool_ops[node->data.bool_op]; break;
+    default:
+      snprintf(buf, size, "...");
+      return;
+  }
+  format_expr(node->child[0], left, sizeof(left));
+  if (node->type == NODE_BOOL_OP && node->data.bool_op == OP_NOT) {
+    snprintf(buf, size, "!%.100s", left);
+    return;
+  }
+  format_expr(node->child[1], right, sizeof(right));
+  snprintf(buf, size, "(%.100s %s %.100s)", left, op, right);
+}
+
+static void collect_report(Report *report, astnode_t *node, const char *func, int depth) {
+  if (!node) return;
+
+  if (is_expression(node)) {
+    report->total++;
+    if (node->inferred != TI_UNKNOWN) report->typed++;
+    if (depth > 0 && is_untyped_operation(node)) {
+      report->untyped_in_loops++;
+      // Keep the most deeply nested ones
+      int at = report->nspots;
+      while (at > 0 && report->spots[at - 1].depth < depth) at--;
+      if (at < REPORT_MAX) {
+        int last = report->nspots < REPORT_MAX ? report->nspots : REPORT_MAX - 1;
+        memmove(&report->spots[at + 1], &report->spots[at], sizeof(HotSpot) * (last - at));
+        report->spots[at].node = node;
+        report->spots[at].func = func;
+        report->spots[at].depth = depth;
+        if (report->nspots < REPORT_MAX) report->nspots++;
+      }
+      // Its operands are reported through it
+      return;
+    }
+  }
+
+  if (node->type == NODE_FUNC) {
+    collect_report(report, node->child[1], node->data.id, 0);
+    return;
+  }
+  int inner = depth + (node->type == NODE_WHILE || node->type == NODE_FOR || node->type == NODE_BENCH);
+  for (int i = 0; i < MAXCHILDREN; i++) {
+    // A for loop's init runs once, outside the loop, and so do a benchmark's label and count
+    int child_depth = ((node->type == NODE_FOR && i == 0) || (node->type == NODE_BENCH && i < 2)) ? depth : inner;
+    collect_report(report, node->child[i], func, child_depth);
+  }
+}
+
+void report_types(astnode_t *root, FILE *out) {
+  Report report;
+  memset(&report, 0, sizeof(report));
+  collect_report(&report, root, NULL, 0);
+
+  fprintf(out, "\nStatic types: %d of %d expressions typed", report.typed, report.total);
+  if (report.total > 0) fprintf(out, " (%d%%)", report.typed * 100 / report.total);
+  fprintf(out, ".\n");
+
+  if (report.untyped_in_loops == 0) {
+    fprintf(out, "No untyped operations inside loops.\n");
+    return;
+  }
+  fprintf(out, "Untyped operations inside loops: %d", report.untyped_in_loops);
+  if (report.untyped_in_loops > report.nspots) fprintf(out, " (deepest %d shown)", report.nspots);
+  fprintf(out, "\n");
+  for (int i = 0; i < report.nspots; i++) {
+    char text[256];
+    format_expr(report.spots[i].node, text, sizeof(text));
+    if (report.spots[i].func) {
+      fprintf(out, "  loop depth %d in %s(): %s\n", report.spots[i].depth, report.spots[i].func, text);
+    } else {
+      fprintf(out, "  loop depth %d at top level: %s\n", report.spots[i].depth, text);
+    }
+  }
+}
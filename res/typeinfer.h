@@ -0,0 +1,48 @@
+#ifndef TYPEINFER_H
+#define TYPEINFER_H
+
+#include <stdio.h>
+#include "symtab.h"
+
+/**
+ * Static type inference. After parsing, a flow-sensitive pass walks the
+ * program and every function body and stores in astnode_t.inferred the
+ * type each expression is proven to have whenever it completes.
+ *
+ * A variable's type is known at a read if every path to it assigns the
+ * variable in the current scope. Reads that may reach a caller's variable
+ * (dynamic scoping) stay unknown. Loops are iterated to a fixpoint.
+ * Parameter types are the join of the arguments at all call sites, and
+ * results are the join of a function's returns; both are only used for
+ * functions defined once. Callees cannot assign their callers' variables,
+ * so calls never invalidate what is known about the caller.
+ *
+ * Expressions that fail at runtime (adding a string, a missing variable)
+ * never complete, so they cannot contradict their annotation.
+ */
+
+typedef enum {
+  TI_UNKNOWN,         // Not proven: the evaluator dispatches on the value
+  TI_INT,             // A machine int, or a bignum once it outgrows one
+  TI_FLOAT,
+  TI_BOOL,
+  TI_STRING
+} InferredType;
+
+// Annotate a parsed program (function bodies included)
+void infer_types(astnode_t *root);
+
+// The same for a module, whose functions other programs call with any arguments
+void infer_types_open(astnode_t *root);
+
+/**
+ * Annotate the body of a NODE_FUNC parsed after the rest of the program
+ * (see lazy.h). Only its locals are typed: nothing is known about its
+ * arguments or the functions it calls.
+ */
+void infer_types_late(astnode_t *func);
+
+// Summary for -v: how much is typed, and the untyped operations inside loops
+void report_types(astnode_t *root, FILE *out);
+
+#endif